@@ -6,6 +6,7 @@
 #include <md5.h>
 
 #include <cstring>
+#include <emmintrin.h>
 
 using namespace std;
 
@@ -36,6 +37,52 @@ bool checkMD5 ( const string& str, const char md5[16] )
 }
 
 
+uint32_t getFastHash ( const char *bytes, size_t len, uint32_t seed )
+{
+    // Fletcher-style running sums over 4 lanes of 32-bit words; the second sum makes the hash position dependent
+    __m128i a = _mm_set1_epi32 ( seed );
+    __m128i b = _mm_setzero_si128();
+
+    size_t i = 0;
+
+    for ( ; i + 16 <= len; i += 16 )
+    {
+        a = _mm_add_epi32 ( a, _mm_loadu_si128 ( ( const __m128i * ) ( bytes + i ) ) );
+        b = _mm_add_epi32 ( b, a );
+    }
+
+    if ( i < len )
+    {
+        char tail[16] = { 0 };
+        memcpy ( tail, bytes + i, len - i );
+
+        a = _mm_add_epi32 ( a, _mm_loadu_si128 ( ( const __m128i * ) tail ) );
+        b = _mm_add_epi32 ( b, a );
+    }
+
+    uint32_t lanes[8];
+    _mm_storeu_si128 ( ( __m128i * ) &lanes[0], a );
+    _mm_storeu_si128 ( ( __m128i * ) &lanes[4], b );
+
+    // Fold the lanes with FNV-1a, then finalize with the MurmurHash3 mixer
+    uint32_t hash = 2166136261u ^ seed ^ ( uint32_t ) len;
+
+    for ( uint32_t lane : lanes )
+    {
+        hash ^= lane;
+        hash *= 16777619u;
+    }
+
+    hash ^= hash >> 16;
+    hash *= 0x85EBCA6Bu;
+    hash ^= hash >> 13;
+    hash *= 0xC2B2AE35u;
+    hash ^= hash >> 16;
+
+    return hash;
+}
+
+
 size_t compress ( const char *src, size_t srcLen, char *dst, size_t dstLen, int level )
 {
     mz_ulong len = dstLen;
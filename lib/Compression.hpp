@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <cstdint>
 
 
 // MD5 calculation
@@ -10,6 +11,10 @@ bool checkMD5 ( const char *bytes, size_t len, const char md5[16] );
 bool checkMD5 ( const std::string& str, const char md5[16] );
 
 
+// Fast non-cryptographic hash, vectorised with SSE2, for comparing large buffers every frame
+uint32_t getFastHash ( const char *bytes, size_t len, uint32_t seed = 0 );
+
+
 // zlib compression
 size_t compress ( const char *src, size_t srcLen, char *dst, size_t dstLen, int level = 9 );
 size_t uncompress ( const char *src, size_t srcLen, char *dst, size_t dstLen );
@@ -12,8 +12,8 @@
 
 
 #define LOG_CONTROLLER(CONTROLLER, FORMAT, ...)                                                                 \
-    LOG ( "%s: controller=%08x; state=%08x; " FORMAT,                                                           \
-          CONTROLLER->getName(), CONTROLLER, CONTROLLER->_state, ## __VA_ARGS__ )
+    LOG_AT ( LOG_LEVEL_DEBUG, LOG_CAT_CONTROLLER, "%s: controller=%08x; state=%08x; " FORMAT,                   \
+             CONTROLLER->getName(), CONTROLLER, CONTROLLER->_state, ## __VA_ARGS__ )
 
 
 #define BIT_UP              ( 0x00000001u )
@@ -0,0 +1,80 @@
+#include "FramePacer.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+
+void FramePacer::setRateAdjust ( double factor )
+{
+    _rateAdjust = min ( max ( factor, 1.0 - FRAME_PACER_MAX_ADJUST ), 1.0 + FRAME_PACER_MAX_ADJUST );
+}
+
+double FramePacer::getPeriodUs() const
+{
+    const double periodUs = 1000000.0 / ( _targetFps * _rateAdjust );
+
+    if ( ! isfinite ( periodUs ) || periodUs < 1.0 )
+        return 0;
+
+    return periodUs;
+}
+
+uint32_t FramePacer::waitForNextFrame()
+{
+    const double periodUs = getPeriodUs();
+
+    uint64_t now = _now();
+
+    const uint32_t frameUs = uint32_t ( _lastFrame ? now - _lastFrame : 0 );
+
+    if ( periodUs == 0 )
+    {
+        _started = false;
+        _lastFrame = now;
+        return frameUs;
+    }
+
+    if ( ! _started )
+    {
+        _started = true;
+        _deadline = now;
+        _lastFrame = now;
+        return frameUs;
+    }
+
+    _deadline += periodUs;
+
+    if ( now > _deadline + periodUs )
+    {
+        // Too late to catch up without a burst of frames
+        ++_stats.missed;
+        _deadline = now;
+    }
+    else
+    {
+        const double remainingUs = _deadline - now;
+
+        if ( remainingUs > FRAME_PACER_SPIN_US + 1000 )
+            _sleep ( uint32_t ( ( remainingUs - FRAME_PACER_SPIN_US ) / 1000 ) );
+
+        while ( now < _deadline )
+            now = _now();
+    }
+
+    const uint32_t pacedUs = uint32_t ( now - _lastFrame );
+    _lastFrame = now;
+
+    _stats.frameUs.addSample ( pacedUs );
+    _stats.jitterUs.add ( uint32_t ( fabs ( pacedUs - periodUs ) + 0.5 ) );
+
+    return pacedUs;
+}
+
+string FramePacer::getStatsSummary() const
+{
+    return format ( "Frame time: mean=%.1f us stddev=%.1f us; jitter: p50=%u us p99=%u us max=%u us; missed=%u",
+                    _stats.frameUs.getMean(), _stats.frameUs.getStdDev(), _stats.jitterUs.percentile ( 50 ),
+                    _stats.jitterUs.percentile ( 99 ), _stats.jitterUs.max(), _stats.missed );
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include "Histogram.hpp"
+#include "Statistics.hpp"
+
+#include <string>
+#include <cstdint>
+
+
+// Microseconds before a frame deadline to stop sleeping and start spinning, since sleeping can overshoot by more
+// than a millisecond even with a 1 ms timer period
+#define FRAME_PACER_SPIN_US         ( 2000 )
+
+// Most the frame rate can be nudged by, as a fraction of the target, ie 59.94 to 60.06 fps at 60 fps
+#define FRAME_PACER_MAX_ADJUST      ( 0.001 )
+
+
+// Paces frames to a target period with microsecond precision, by sleeping until shortly before each deadline, then
+// spinning on a high resolution clock.
+//
+// Each deadline is one period after the previous deadline, not after the previous frame, so a late frame is made up
+// by the next one and the long run frame rate is exact. If a frame is more than a period late, eg. after loading,
+// pacing restarts from that frame instead of rushing to catch up.
+class FramePacer
+{
+public:
+
+    // Clock in microseconds, and sleep in milliseconds, so the pacer can run on simulated time
+    typedef uint64_t ( *NowFunc ) ();
+    typedef void ( *SleepFunc ) ( uint32_t milliseconds );
+
+    struct Stats
+    {
+        // Microseconds between paced frames
+        Statistics frameUs;
+
+        // Microseconds between the frame time and the target period
+        Histogram<16, true> jitterUs;
+
+        // Number of frames more than a period late, where pacing restarted
+        uint32_t missed = 0;
+    };
+
+    FramePacer ( NowFunc now, SleepFunc sleep ) : _now ( now ), _sleep ( sleep ) {}
+
+    // Set the target frames per second. Frames aren't paced if this is too high to have a 1 microsecond period.
+    void setTargetFps ( double fps ) { _targetFps = fps; }
+    double getTargetFps() const { return _targetFps; }
+
+    // Nudge the frame rate by a factor, limited to 1 +/- FRAME_PACER_MAX_ADJUST, eg. 0.999 for 59.94 fps
+    void setRateAdjust ( double factor );
+    double getRateAdjust() const { return _rateAdjust; }
+
+    // Get the frame period in fractional microseconds including the rate adjustment, 0 if not paced
+    double getPeriodUs() const;
+
+    // Wait until the deadline of the next frame, returns the microseconds since the previous frame
+    uint32_t waitForNextFrame();
+
+    // Start pacing again from the next frame
+    void restart() { _started = false; }
+
+    // Get / reset the frame time statistics
+    const Stats& getStats() const { return _stats; }
+    void resetStats() { _stats = Stats(); }
+
+    // Get a short summary of the frame time statistics
+    std::string getStatsSummary() const;
+
+private:
+
+    NowFunc _now;
+
+    SleepFunc _sleep;
+
+    double _targetFps = 60.0;
+
+    double _rateAdjust = 1.0;
+
+    // Indicates if the last frame was paced, so the deadline is valid
+    bool _started = false;
+
+    // Deadline of the last frame in fractional microseconds, so the period doesn't get rounded every frame
+    double _deadline = 0;
+
+    // Time of the last frame
+    uint64_t _lastFrame = 0;
+
+    Stats _stats;
+};
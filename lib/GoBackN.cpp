@@ -11,6 +11,11 @@ using namespace std;
 // TODO increase me
 #define MTU ( 256 )
 
+#define LOG_GBN(FORMAT, ...)        LOG_AT ( LOG_LEVEL_DEBUG, LOG_CAT_GBN, FORMAT, ## __VA_ARGS__ )
+
+// Logged for every message, ACK, and keep alive
+#define LOG_GBN_TRACE(FORMAT, ...)  LOG_AT ( LOG_LEVEL_TRACE, LOG_CAT_GBN, FORMAT, ## __VA_ARGS__ )
+
 
 string formatSerializableSequence ( const MsgPtr& msg )
 {
@@ -46,8 +51,8 @@ void GoBackN::timerExpired ( Timer *timer )
 
         const MsgPtr& msg = *_sendListPos;
 
-        LOG ( "Sending '%s'; sequence=%u; sendSequence=%d",
-              msg, msg->getAs<SerializableSequence>().getSequence(), _sendSequence );
+        LOG_GBN_TRACE ( "Sending '%s'; sequence=%u; sendSequence=%d",
+                        msg, msg->getAs<SerializableSequence>().getSequence(), _sendSequence );
 
         owner->goBackNSendRaw ( this, msg );
         ++_sendListPos;
@@ -55,7 +60,7 @@ void GoBackN::timerExpired ( Timer *timer )
 
     if ( _keepAlive )
     {
-        LOG ( "this=%08x; keepAlive=%llu; countDown=%d", this, _keepAlive, _countDown );
+        LOG_GBN_TRACE ( "this=%08x; keepAlive=%llu; countDown=%d", this, _keepAlive, _countDown );
 
         if ( _countDown )
         {
@@ -63,7 +68,7 @@ void GoBackN::timerExpired ( Timer *timer )
         }
         else
         {
-            LOG ( "owner->goBackNTimeout ( this=%08x ); owner=%08x", this, owner );
+            LOG_GBN ( "owner->goBackNTimeout ( this=%08x ); owner=%08x", this, owner );
             owner->goBackNTimeout ( this );
             return;
         }
@@ -89,7 +94,7 @@ void GoBackN::sendViaGoBackN ( SerializableSequence *message )
 
 void GoBackN::sendViaGoBackN ( const MsgPtr& msg )
 {
-    LOG ( "Adding '%s'; sendSequence=%d", msg, _sendSequence + 1 );
+    LOG_GBN_TRACE ( "Adding '%s'; sendSequence=%d", msg, _sendSequence + 1 );
 
     ASSERT ( msg->getBaseType() == BaseType::SerializableSequence );
     ASSERT ( _sendList.empty() || _sendList.back()->getAs<SerializableSequence>().getSequence() == _sendSequence );
@@ -143,7 +148,7 @@ void GoBackN::recvFromSocket ( const MsgPtr& msg )
     {
         refreshKeepAlive();
 
-        LOG ( "this=%08x; keepAlive=%llu; countDown=%d", this, _keepAlive, _countDown );
+        LOG_GBN_TRACE ( "this=%08x; keepAlive=%llu; countDown=%d", this, _keepAlive, _countDown );
 
         checkAndStartTimer();
     }
@@ -155,7 +160,7 @@ void GoBackN::recvFromSocket ( const MsgPtr& msg )
     // Filter non-sequential messages
     if ( msg->getBaseType() != BaseType::SerializableSequence )
     {
-        LOG ( "Received '%s'", msg );
+        LOG_GBN_TRACE ( "Received '%s'", msg );
         owner->goBackNRecvRaw ( this, msg );
         return;
     }
@@ -168,7 +173,7 @@ void GoBackN::recvFromSocket ( const MsgPtr& msg )
         if ( sequence > _ackSequence )
             _ackSequence = sequence;
 
-        LOG ( "Got AckSequence; sequence=%u; sendSequence=%u", sequence, _sendSequence );
+        LOG_GBN_TRACE ( "Got AckSequence; sequence=%u; sendSequence=%u", sequence, _sendSequence );
 
         // Remove messages from sendList with sequence <= the ACKed sequence
         while ( !_sendList.empty() && _sendList.front()->getAs<SerializableSequence>().getSequence() <= sequence )
@@ -185,7 +190,7 @@ void GoBackN::recvFromSocket ( const MsgPtr& msg )
         return;
     }
 
-    LOG ( "Received '%s'; sequence=%u; recvSequence=%u", msg, sequence, _recvSequence );
+    LOG_GBN_TRACE ( "Received '%s'; sequence=%u; recvSequence=%u", msg, sequence, _recvSequence );
 
     ++_recvSequence;
 
@@ -204,7 +209,7 @@ void GoBackN::recvFromSocket ( const MsgPtr& msg )
 
             if ( !msg.get() || msg->getMsgType() != splitMsg.origMsgType || consumed != _recvBuffer.size() )
             {
-                LOG ( "Failed to recreate '%s' from [ %u bytes ]", splitMsg.origMsgType, _recvBuffer.size() );
+                LOG_GBN ( "Failed to recreate '%s' from [ %u bytes ]", splitMsg.origMsgType, _recvBuffer.size() );
                 msg.reset();
             }
 
@@ -212,7 +217,7 @@ void GoBackN::recvFromSocket ( const MsgPtr& msg )
 
             if ( msg )
             {
-                LOG ( "Recreated '%s'", msg );
+                LOG_GBN_TRACE ( "Recreated '%s'", msg );
                 owner->goBackNRecvMsg ( this, msg );
             }
         }
@@ -231,7 +236,7 @@ void GoBackN::setSendInterval ( uint64_t interval )
 
     refreshKeepAlive();
 
-    LOG ( "interval=%llu; countDown=%d", _interval, _countDown );
+    LOG_GBN ( "interval=%llu; countDown=%d", _interval, _countDown );
 }
 
 void GoBackN::setKeepAlive ( uint64_t timeout )
@@ -240,12 +245,12 @@ void GoBackN::setKeepAlive ( uint64_t timeout )
 
     refreshKeepAlive();
 
-    LOG ( "keepAlive=%llu; countDown=%d", _keepAlive, _countDown );
+    LOG_GBN ( "keepAlive=%llu; countDown=%d", _keepAlive, _countDown );
 }
 
 void GoBackN::reset()
 {
-    LOG ( "this=%08x; sendTimer=%08x", this, _sendTimer.get() );
+    LOG_GBN ( "this=%08x; sendTimer=%08x", this, _sendTimer.get() );
 
     _sendSequence = _recvSequence = 0;
     _sendList.clear();
@@ -319,7 +324,7 @@ void GoBackN::load ( cereal::BinaryInputArchive& ar )
 
 void GoBackN::logSendList() const
 {
-    LOG_LIST ( _sendList, formatSerializableSequence );
+    LOG_LIST_AT ( LOG_LEVEL_TRACE, LOG_CAT_GBN, _sendList, formatSerializableSequence );
 }
 
 void GoBackN::delayKeepAliveOnce()
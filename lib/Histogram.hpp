@@ -0,0 +1,159 @@
+#pragma once
+
+#include "StringUtils.hpp"
+
+#include <array>
+#include <string>
+#include <cstdint>
+
+
+// Fixed size histogram of unsigned values, cheap enough to update every frame.
+// Linear histograms have one bucket per value; log2 histograms have buckets [0], [1], [2,3], [4,7], [8,15], ...
+// Values past the last bucket are counted in the last bucket.
+template<size_t N, bool Log2 = false>
+class Histogram
+{
+public:
+
+    Histogram() { reset(); }
+
+    void add ( uint32_t value )
+    {
+        ++_buckets[getBucket ( value )];
+        ++_count;
+        _total += value;
+
+        if ( value > _max )
+            _max = value;
+    }
+
+    void reset()
+    {
+        _buckets.fill ( 0 );
+        _count = _total = 0;
+        _max = 0;
+    }
+
+    size_t count() const
+    {
+        return _count;
+    }
+
+    uint64_t total() const
+    {
+        return _total;
+    }
+
+    uint32_t max() const
+    {
+        return _max;
+    }
+
+    double mean() const
+    {
+        if ( _count == 0 )
+            return 0;
+
+        return double ( _total ) / _count;
+    }
+
+    // Number of values in a bucket
+    uint32_t bucket ( size_t i ) const
+    {
+        return _buckets[i];
+    }
+
+    // Smallest value of a bucket
+    static uint32_t lowerBound ( size_t i )
+    {
+        if ( Log2 )
+            return ( i == 0 ? 0 : ( 1u << ( i - 1 ) ) );
+
+        return i;
+    }
+
+    // Largest value of a bucket, the last bucket has no upper bound
+    static uint32_t upperBound ( size_t i )
+    {
+        if ( i + 1 == N )
+            return UINT32_MAX;
+
+        return lowerBound ( i + 1 ) - 1;
+    }
+
+    static size_t getBucket ( uint32_t value )
+    {
+        size_t i = value;
+
+        if ( Log2 )
+            i = ( value == 0 ? 0 : 32 - __builtin_clz ( value ) );
+
+        return ( i < N ? i : N - 1 );
+    }
+
+    // Upper bound of the bucket containing the given percentile, or the max value if that is smaller
+    uint32_t percentile ( double p ) const
+    {
+        if ( _count == 0 )
+            return 0;
+
+        const uint64_t target = uint64_t ( p * _count / 100.0 + 0.5 );
+
+        uint64_t sum = 0;
+
+        for ( size_t i = 0; i < N; ++i )
+        {
+            sum += _buckets[i];
+
+            if ( sum >= target && sum > 0 )
+                return ( upperBound ( i ) < _max ? upperBound ( i ) : _max );
+        }
+
+        return _max;
+    }
+
+    // Summary of the distribution, eg. "n=20 mean=3.5 p50=3 p99=7 max=9"
+    std::string summary() const
+    {
+        return format ( "n=%u mean=%.1f p50=%u p99=%u max=%u", _count, mean(), percentile ( 50 ), percentile ( 99 ),
+                        _max );
+    }
+
+    // Non-empty buckets, eg. "0:12 1:5 2-3:1 64+:1"
+    std::string str() const
+    {
+        std::string str;
+
+        for ( size_t i = 0; i < N; ++i )
+        {
+            if ( ! _buckets[i] )
+                continue;
+
+            if ( ! str.empty() )
+                str += ' ';
+
+            if ( i + 1 == N )
+                str += format ( "%u+:%u", lowerBound ( i ), _buckets[i] );
+            else if ( lowerBound ( i ) == upperBound ( i ) )
+                str += format ( "%u:%u", lowerBound ( i ), _buckets[i] );
+            else
+                str += format ( "%u-%u:%u", lowerBound ( i ), upperBound ( i ), _buckets[i] );
+        }
+
+        return str;
+    }
+
+private:
+
+    // Number of values in each bucket
+    std::array<uint32_t, N> _buckets;
+
+    // Number of values
+    size_t _count;
+
+    // Sum of all values
+    uint64_t _total;
+
+    // Largest value
+    uint32_t _max;
+};
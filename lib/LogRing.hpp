@@ -0,0 +1,93 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+
+// Lock-free ring buffer of variable size records for exactly one producer thread and one consumer thread.
+// N must be a power of 2.
+//
+// Each record starts with its size as a uint32_t and is padded to 8 bytes. A record is always contiguous, so when it
+// doesn't fit before the end of the buffer, the producer leaves a size of 0 there and starts again at the beginning.
+template<size_t N>
+class LogRing
+{
+    static_assert ( N >= 8 && ( N & ( N - 1 ) ) == 0, "N must be a power of 2" );
+
+public:
+
+    // Reserve contiguous space for a record of up to size bytes, returns 0 if there isn't enough free space yet.
+    // The record isn't visible to the consumer until it is committed. Producer thread only.
+    char *reserve ( size_t size )
+    {
+        size_t tail = _tail.load ( std::memory_order_relaxed );
+
+        const size_t offset = ( tail & ( N - 1 ) );
+        const size_t skip = ( offset + size > N ? N - offset : 0 );
+
+        if ( tail + skip + size - _head.load ( std::memory_order_acquire ) > N )
+            return 0;
+
+        if ( skip )
+        {
+            * ( uint32_t * ) &_buffer[offset] = 0;
+            tail += skip;
+        }
+
+        _reserved = tail;
+        return &_buffer[tail & ( N - 1 )];
+    }
+
+    // Publish the last reserved record, with its actual size. Producer thread only.
+    void commit ( uint32_t size )
+    {
+        * ( uint32_t * ) &_buffer[_reserved & ( N - 1 )] = size;
+        _tail.store ( _reserved + padded ( size ), std::memory_order_release );
+    }
+
+    // Get the oldest record, returns 0 if there are none. Consumer thread only.
+    const char *front()
+    {
+        for ( ;; )
+        {
+            const size_t head = _head.load ( std::memory_order_relaxed );
+
+            if ( head == _tail.load ( std::memory_order_acquire ) )
+                return 0;
+
+            const char *record = &_buffer[head & ( N - 1 )];
+
+            if ( * ( const uint32_t * ) record )
+                return record;
+
+            // Skip the unused space at the end of the buffer
+            _head.store ( head + N - ( head & ( N - 1 ) ), std::memory_order_release );
+        }
+    }
+
+    // Release the record returned by front. Consumer thread only.
+    void pop()
+    {
+        const size_t head = _head.load ( std::memory_order_relaxed );
+        const uint32_t size = * ( const uint32_t * ) &_buffer[head & ( N - 1 )];
+        _head.store ( head + padded ( size ), std::memory_order_release );
+    }
+
+    bool empty() const { return _head.load ( std::memory_order_acquire ) == _tail.load ( std::memory_order_acquire ); }
+
+    static constexpr size_t capacity() { return N; }
+
+private:
+
+    // Keep the indexes on separate cache lines so the two threads don't contend
+    alignas ( 64 ) std::atomic<size_t> _head { 0 };
+    alignas ( 64 ) std::atomic<size_t> _tail { 0 };
+
+    // Start of the last reserved record, only used by the producer
+    size_t _reserved = 0;
+
+    alignas ( 64 ) char _buffer[N];
+
+    static constexpr size_t padded ( size_t size ) { return ( size + 7 ) & ~size_t ( 7 ); }
+};
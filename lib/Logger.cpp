@@ -2,6 +2,18 @@
 #include "Algorithms.hpp"
 #include "TimerManager.hpp"
 
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <csignal>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#define _getpid getpid
+#endif
+
 using namespace std;
 
 
@@ -11,11 +23,16 @@ void Logger::initialize ( const string& filePath, uint32_t _options ) {}
 void Logger::deinitialize() {}
 void Logger::flush() {}
 void Logger::log ( const char *srcFile, int srcLine, const char *srcFunc, const char *logMessage ) {}
+void Logger::flushAll() {}
 
 #else
 
 void Logger::initialize ( const string& filePath, uint32_t _options )
 {
+    // Write the messages queued for the previous file
+    if ( this->_options & LOG_ASYNC )
+        drain ( true );
+
 #ifdef LOGGER_MUTEXED
     LOCK ( _mutex );
 #endif
@@ -58,6 +75,9 @@ void Logger::initialize ( const string& filePath, uint32_t _options )
         _logId = generateRandomId();
 
     _initialized = true;
+
+    if ( _options & LOG_ASYNC )
+        startFlusher();
 }
 
 void Logger::deinitialize()
@@ -65,6 +85,10 @@ void Logger::deinitialize()
     if ( ! _initialized )
         return;
 
+    // Write the messages still queued for this logger
+    if ( _options & LOG_ASYNC )
+        drain ( true );
+
 #ifdef LOGGER_MUTEXED
     LOCK ( _mutex );
 #endif
@@ -82,6 +106,9 @@ void Logger::deinitialize()
 
 void Logger::flush()
 {
+    if ( _options & LOG_ASYNC )
+        drain ( true );
+
 #ifdef LOGGER_MUTEXED
     LOCK ( _mutex );
 #endif
@@ -98,13 +125,31 @@ void Logger::log ( const char *srcFile, int srcLine, const char *srcFunc, const
     LOCK ( _mutex );
 #endif
 
-    bool hasPrefix = false;
+    time_t t = 0;
+    uint32_t ms = 0;
 
     if ( _options & ( LOG_GM_TIME | LOG_LOCAL_TIME ) )
     {
-        time_t t;
         time ( &t );
+#ifdef _WIN32
+        ms = TimerManager::get().getNow ( true ) % 1000;
+#else
+        ms = chrono::duration_cast<chrono::milliseconds> ( chrono::system_clock::now().time_since_epoch() ).count()
+             % 1000;
+#endif // _WIN32
+    }
 
+    write ( t, ms, srcFile, srcLine, srcFunc, logMessage );
+    fflush ( _fd );
+}
+
+void Logger::write ( time_t t, uint32_t ms, const char *srcFile, int srcLine, const char *srcFunc,
+                     const char *logMessage )
+{
+    bool hasPrefix = false;
+
+    if ( _options & ( LOG_GM_TIME | LOG_LOCAL_TIME ) )
+    {
         tm *ts;
         if ( _options & LOG_GM_TIME )
             ts = gmtime ( &t );
@@ -113,9 +158,7 @@ void Logger::log ( const char *srcFile, int srcLine, const char *srcFunc, const
 
         strftime ( _buffer, sizeof ( _buffer ), "%H:%M:%S", ts );
 
-        const uint64_t now = TimerManager::get().getNow ( true );
-
-        fprintf ( _fd, "%s.%03u:", _buffer, ( uint32_t ) ( now % 1000 ) );
+        fprintf ( _fd, "%s.%03u:", _buffer, ms );
         hasPrefix = true;
     }
 
@@ -134,7 +177,289 @@ void Logger::log ( const char *srcFile, int srcLine, const char *srcFunc, const
     }
 
     fprintf ( _fd, ( hasPrefix ? " %s\n" : "%s\n" ), logMessage );
-    fflush ( _fd );
+}
+
+
+class LogFlusher;
+
+// Ring buffers of every thread that has logged asynchronously, and the background thread that drains them
+struct LogQueues
+{
+    Mutex mutex;
+
+    vector<LogRingBuffer *> rings;
+
+    // Only one thread drains the ring buffers at a time
+    Mutex drainMutex;
+
+    // Loggers written to by the current drain
+    vector<Logger *> written;
+
+    CondVar wake;
+
+    // Only written with the mutex held
+    LogFlusher *flusher = 0;
+
+    void ( *prevAbortHandler ) ( int ) = 0;
+};
+
+// This is never destroyed, since threads may still log while static objects are destroyed at exit
+static LogQueues& getLogQueues()
+{
+    static LogQueues *queues = new LogQueues();
+    return *queues;
+}
+
+class LogFlusher : public Thread
+{
+public:
+
+    void run() override
+    {
+        LogQueues& queues = getLogQueues();
+
+        for ( ;; )
+        {
+            Logger::drain ( true );
+
+            Lock lock ( queues.mutex );
+            queues.wake.wait ( queues.mutex, LOG_FLUSH_INTERVAL );
+        }
+    }
+};
+
+static void abortHandler ( int signum )
+{
+    Logger::flushAll();
+
+    LogQueues& queues = getLogQueues();
+
+    if ( queues.prevAbortHandler && queues.prevAbortHandler != SIG_IGN && queues.prevAbortHandler != SIG_DFL )
+        queues.prevAbortHandler ( signum );
+}
+
+void Logger::startFlusher()
+{
+    LogQueues& queues = getLogQueues();
+
+    Lock lock ( queues.mutex );
+
+    if ( queues.flusher )
+        return;
+
+    queues.flusher = new LogFlusher();
+    queues.flusher->start();
+
+    // Anything still queued is written on abort, which also covers asserts and std::terminate
+    queues.prevAbortHandler = signal ( SIGABRT, abortHandler );
+}
+
+LogRingBuffer *Logger::newThreadRing()
+{
+    LogQueues& queues = getLogQueues();
+
+    Lock lock ( queues.mutex );
+
+    queues.rings.push_back ( new LogRingBuffer() );
+    return queues.rings.back();
+}
+
+LogRecord *Logger::beginRecord ( const char *srcFile, int srcLine, const char *srcFunc, const char *fmt, char *& end )
+{
+    LogRingBuffer& ring = getThreadRing();
+
+    char *data;
+
+    // Wait instead of dropping the message if the background thread is behind
+    while ( ! ( data = ring.reserve ( LOG_RECORD_SIZE ) ) )
+    {
+        getLogQueues().wake.signal();
+        this_thread::yield();
+    }
+
+    end = data + LOG_RECORD_SIZE - LOG_RECORD_SLACK;
+
+    LogRecord *record = ( LogRecord * ) data;
+    record->numArgs = 0;
+    record->srcLine = srcLine;
+    record->time = chrono::duration_cast<chrono::microseconds> (
+                       chrono::system_clock::now().time_since_epoch() ).count();
+    record->logger = this;
+    record->srcFile = srcFile;
+    record->srcFunc = srcFunc;
+    record->format = fmt;
+    return record;
+}
+
+// Print one queued argument with a single format specifier, returns the position of the next argument
+static const char *printArg ( char *buffer, size_t len, const string& fmt, const char *arg )
+{
+    const LogArg::Type type = ( LogArg::Type ) *arg++;
+
+    switch ( type )
+    {
+#define PRINT_ARG(TYPE)                                                                                                \
+        {                                                                                                              \
+            TYPE val;                                                                                                  \
+            memcpy ( &val, arg, sizeof ( val ) );                                                                      \
+            snprintf ( buffer, len, fmt.c_str(), val );                                                                \
+            return arg + sizeof ( val );                                                                               \
+        }
+
+        case LogArg::Int:
+            PRINT_ARG ( int )
+
+        case LogArg::LongLong:
+            PRINT_ARG ( long long )
+
+        case LogArg::Double:
+            PRINT_ARG ( double )
+
+        case LogArg::LongDouble:
+            PRINT_ARG ( long double )
+
+        case LogArg::Pointer:
+            PRINT_ARG ( const void * )
+
+#undef PRINT_ARG
+
+        case LogArg::CharPointer:
+        {
+            const char *ptr;
+            memcpy ( &ptr, arg, sizeof ( ptr ) );
+            arg += sizeof ( ptr );
+
+            const char *str = ptr;
+
+            if ( ptr )
+            {
+                uint32_t n;
+                memcpy ( &n, arg, sizeof ( n ) );
+                str = arg + sizeof ( n );
+                arg = str + n + 1;
+            }
+
+            // Only %s reads the string, anything else prints the pointer itself
+            snprintf ( buffer, len, fmt.c_str(), ( fmt.back() == 's' ? str : ptr ) );
+            return arg;
+        }
+
+        case LogArg::String:
+        {
+            uint32_t n;
+            memcpy ( &n, arg, sizeof ( n ) );
+            const char *str = arg + sizeof ( n );
+            snprintf ( buffer, len, fmt.c_str(), str );
+            return str + n + 1;
+        }
+
+        default:
+            ASSERT_IMPOSSIBLE;
+            return arg;
+    }
+}
+
+// Format a queued message in exactly the same way as format
+static string formatRecord ( const LogRecord& record )
+{
+    const char *arg = ( const char * ) ( &record + 1 );
+
+    if ( ! record.format )
+        return ( record.numArgs ? arg + 1 + sizeof ( uint32_t ) : "" );
+
+    if ( record.numArgs == 0 )
+        return record.format;
+
+    string fmt = record.format, first, rest, message;
+    char buffer[4096];
+
+    for ( uint32_t i = 0; i < record.numArgs; ++i )
+    {
+        splitFormat ( fmt, first, rest );
+
+        if ( first.empty() )
+            return message + rest;
+
+        arg = printArg ( buffer, sizeof ( buffer ), first, arg );
+        message += buffer;
+
+        if ( rest.empty() )
+            return message;
+
+        fmt = rest;
+    }
+
+    return message + format ( fmt );
+}
+
+void Logger::write ( const LogRecord& record )
+{
+    if ( ! _fd )
+        return;
+
+#ifdef LOGGER_MUTEXED
+    LOCK ( _mutex );
+#endif
+
+    write ( record.time / 1000000, ( record.time / 1000 ) % 1000, record.srcFile, record.srcLine, record.srcFunc,
+            formatRecord ( record ).c_str() );
+}
+
+bool Logger::drain ( bool wait )
+{
+    LogQueues& queues = getLogQueues();
+
+    if ( wait )
+    {
+        queues.drainMutex.lock();
+    }
+    else if ( ! queues.drainMutex.tryLock() )
+    {
+        return false;
+    }
+
+    vector<LogRingBuffer *> rings;
+
+    {
+        Lock lock ( queues.mutex );
+        rings = queues.rings;
+    }
+
+    queues.written.clear();
+
+    for ( LogRingBuffer *ring : rings )
+    {
+        while ( const LogRecord *record = ( const LogRecord * ) ring->front() )
+        {
+            record->logger->write ( *record );
+
+            if ( find ( queues.written.begin(), queues.written.end(), record->logger ) == queues.written.end() )
+                queues.written.push_back ( record->logger );
+
+            ring->pop();
+        }
+    }
+
+    for ( Logger *logger : queues.written )
+    {
+        if ( logger->_fd )
+            fflush ( logger->_fd );
+    }
+
+    queues.drainMutex.unlock();
+    return true;
+}
+
+void Logger::flushAll()
+{
+    // The background thread may be in the middle of a drain, but don't wait forever in case it is stuck
+    for ( int i = 0; i < LOG_FLUSH_INTERVAL * 10; ++i )
+    {
+        if ( drain ( false ) )
+            return;
+
+        this_thread::sleep_for ( chrono::milliseconds ( 1 ) );
+    }
 }
 
 #endif // DISABLE_LOGGING
@@ -144,3 +469,32 @@ Logger& Logger::get()
     static Logger instance;
     return instance;
 }
+
+uint32_t Logger::parseCategories ( const string& names )
+{
+    static const pair<const char *, uint32_t> categories[] =
+    {
+        { "general", LOG_CAT_GENERAL },
+        { "net", LOG_CAT_NET },
+        { "socket", LOG_CAT_SOCKET },
+        { "gbn", LOG_CAT_GBN },
+        { "rollback", LOG_CAT_ROLLBACK },
+        { "ui", LOG_CAT_UI },
+        { "controller", LOG_CAT_CONTROLLER },
+        { "spectate", LOG_CAT_SPECTATE },
+        { "all", LOG_CAT_ALL },
+    };
+
+    uint32_t mask = 0;
+
+    for ( const string& name : split ( lowerCase ( names ), "," ) )
+    {
+        for ( const auto& category : categories )
+        {
+            if ( trimmed ( name ) == category.first )
+                mask |= category.second;
+        }
+    }
+
+    return mask;
+}
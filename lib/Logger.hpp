@@ -2,10 +2,14 @@
 
 #include "Thread.hpp"
 #include "StringUtils.hpp"
+#include "LogRing.hpp"
 
 #include <string>
+#include <algorithm>
 #include <cstdio>
+#include <cstring>
 #include <ctime>
+#include <type_traits>
 
 
 #define LOG_GM_TIME     ( 0x01 )    // Log the gmtime timestamp per message
@@ -13,9 +17,179 @@
 #define LOG_FILE_LINE   ( 0x04 )    // Log file:line per message
 #define LOG_FUNC_NAME   ( 0x08 )    // Log the function name per message
 #define PID_IN_FILENAME ( 0x10 )    // Add the PID to the log filename
+#define LOG_ASYNC       ( 0x20 )    // Queue messages for a background thread to format and write
+
+// Bytes of the ring buffer of queued messages per logging thread
+#define LOG_RING_SIZE   ( 256 * 1024 )
+
+// Most bytes per queued message, longer string arguments are truncated
+#define LOG_RECORD_SIZE ( 4096 )
+
+// Bytes at the end of a queued message that only the last string argument can use
+#define LOG_RECORD_SLACK ( 16 )
+
+// Milliseconds between writes of the queued messages
+#define LOG_FLUSH_INTERVAL ( 10 )
 
 #define LOG_DEFAULT_OPTIONS ( LOG_GM_TIME | LOG_FILE_LINE | LOG_FUNC_NAME )
 
+// Log levels, messages below LOG_MIN_LEVEL are compiled out along with their arguments
+#define LOG_LEVEL_TRACE ( 0 )       // Per packet and per frame messages
+#define LOG_LEVEL_DEBUG ( 1 )       // Default level of LOG and LOG_TO
+#define LOG_LEVEL_INFO  ( 2 )
+#define LOG_LEVEL_WARN  ( 3 )
+#define LOG_LEVEL_ERROR ( 4 )       // Failed assertions
+
+// Debug builds log everything, logging builds skip the per packet and per frame messages
+#ifndef LOG_MIN_LEVEL
+#ifdef DEBUG
+#define LOG_MIN_LEVEL   LOG_LEVEL_TRACE
+#else
+#define LOG_MIN_LEVEL   LOG_LEVEL_DEBUG
+#endif
+#endif
+
+// Log categories, each logger has a runtime mask of the categories it writes
+#define LOG_CAT_GENERAL     ( 0x01 )
+#define LOG_CAT_NET         ( 0x02 )    // Netplay state and inputs
+#define LOG_CAT_SOCKET      ( 0x04 )    // Socket events, and bytes sent and received
+#define LOG_CAT_GBN         ( 0x08 )    // GoBackN messages, ACKs, and keep alives
+#define LOG_CAT_ROLLBACK    ( 0x10 )    // Saving and loading rollback states
+#define LOG_CAT_UI          ( 0x20 )
+#define LOG_CAT_CONTROLLER  ( 0x40 )
+#define LOG_CAT_SPECTATE    ( 0x80 )    // Spectators joining, catching up, and relaying
+#define LOG_CAT_ALL         ( 0xFFFFFFFFu )
+
+
+class Logger;
+
+typedef LogRing<LOG_RING_SIZE> LogRingBuffer;
+
+// Header of a queued message, followed by the arguments, each a LogArg type then the raw value
+struct LogRecord
+{
+    // Total bytes, set by the ring buffer
+    uint32_t size;
+
+    uint32_t numArgs;
+
+    int srcLine;
+
+    // Microseconds since the epoch
+    int64_t time;
+
+    Logger *logger;
+
+    const char *srcFile, *srcFunc;
+
+    // String literal format, or 0 if the only argument is the already formatted message
+    const char *format;
+};
+
+namespace LogArg
+{
+enum Type : uint8_t { Int, LongLong, Double, LongDouble, Pointer, CharPointer, String };
+}
+
+// Writes the arguments of a queued message, in the same way format would print them
+class LogRecordWriter
+{
+public:
+
+    LogRecordWriter ( LogRecord *record, char *end )
+        : _record ( record ), _pos ( ( char * ) ( record + 1 ) ), _end ( end ) {}
+
+    template<typename T>
+    void add ( const T& val )
+    {
+        if constexpr ( std::is_floating_point<T>::value && sizeof ( T ) > sizeof ( double ) )
+            addRaw ( LogArg::LongDouble, ( long double ) val );
+        else if constexpr ( std::is_floating_point<T>::value )
+            addRaw ( LogArg::Double, ( double ) val );
+        else if constexpr ( std::is_arithmetic<T>::value && sizeof ( T ) <= sizeof ( int ) )
+            addRaw ( LogArg::Int, ( int ) val );
+        else if constexpr ( std::is_arithmetic<T>::value )
+            addRaw ( LogArg::LongLong, ( long long ) val );
+        else if constexpr ( std::is_array<T>::value && isChar<typename std::remove_extent<T>::type>() )
+            addString ( ( const char * ) val, std::strlen ( ( const char * ) val ) );
+        else if constexpr ( std::is_pointer<T>::value && isChar<typename std::remove_pointer<T>::type>() )
+            addCharPointer ( ( const char * ) val );
+        else if constexpr ( std::is_pointer<T>::value )
+            addRaw ( LogArg::Pointer, ( const void * ) val );
+        else if constexpr ( std::is_same<T, std::string>::value )
+            addString ( val.c_str(), val.size() );
+        else
+            add ( format ( val ) );
+    }
+
+    // Size of the written record
+    uint32_t size() const { return _pos - ( char * ) _record; }
+
+private:
+
+    LogRecord *_record;
+
+    char *_pos, *_end;
+
+    template<typename T>
+    void addRaw ( LogArg::Type type, const T& val )
+    {
+        if ( _end - _pos < ( long ) ( 1 + sizeof ( val ) ) )
+            return;
+
+        *_pos++ = type;
+        std::memcpy ( _pos, &val, sizeof ( val ) );
+        _pos += sizeof ( val );
+        ++_record->numArgs;
+    }
+
+    template<typename T>
+    static constexpr bool isChar()
+    {
+        typedef typename std::remove_cv<T>::type C;
+        return std::is_same<C, char>::value || std::is_same<C, signed char>::value
+               || std::is_same<C, unsigned char>::value;
+    }
+
+    // A char pointer is printed as a pointer unless the format is %s, so copy both the pointer and the string
+    void addCharPointer ( const char *str )
+    {
+        if ( _end - _pos < ( long ) ( 1 + sizeof ( str ) ) )
+            return;
+
+        *_pos++ = LogArg::CharPointer;
+        std::memcpy ( _pos, &str, sizeof ( str ) );
+        _pos += sizeof ( str );
+        ++_record->numArgs;
+
+        if ( str )
+            copyString ( str, std::strlen ( str ) );
+    }
+
+    void addString ( const char *str, size_t len )
+    {
+        if ( _end - _pos < 1 )
+            return;
+
+        *_pos++ = LogArg::String;
+        ++_record->numArgs;
+        copyString ( str, len );
+    }
+
+    // Copy the length and the NUL terminated string, truncated to fit. The record size always leaves room for this.
+    void copyString ( const char *str, size_t len )
+    {
+        const long room = ( _end - _pos ) - long ( sizeof ( uint32_t ) ) - 1;
+        const uint32_t n = std::min<size_t> ( len, std::max<long> ( 0, room ) );
+
+        std::memcpy ( _pos, &n, sizeof ( n ) );
+        _pos += sizeof ( n );
+        std::memcpy ( _pos, str, n );
+        _pos += n;
+        *_pos++ = '\0';
+    }
+};
+
 
 class Logger
 {
@@ -37,9 +211,66 @@ public:
     // Log the system version
     void logVersion();
 
+    // Check if this logger writes any of the given categories. This is checked before evaluating any arguments.
+    bool isEnabled ( uint32_t categories ) const { return _fd && ( _categories & categories ); }
+
+    // Set the mask of categories to write, every category by default
+    void setCategories ( uint32_t categories ) { _categories = categories; }
+    uint32_t getCategories() const { return _categories; }
+
+    // Parse a comma separated list of category names, eg "net,gbn,rollback", returns LOG_CAT_ALL for "all"
+    static uint32_t parseCategories ( const std::string& names );
+
     // Log a message with source file, line, and function
     void log ( const char *srcFile, int srcLine, const char *srcFunc, const char *logMessage );
 
+    // Log a string literal format with arguments. If logging asynchronously, this only copies the raw arguments, and
+    // the background thread formats them later, so the format must still exist then.
+    template<size_t N, typename ... V>
+    void logFormat ( const char *srcFile, int srcLine, const char *srcFunc, const char ( &fmt ) [N], const V& ... vals )
+    {
+        if ( ! _fd )
+            return;
+
+        if ( ! ( _options & LOG_ASYNC ) )
+        {
+            log ( srcFile, srcLine, srcFunc, format ( fmt, vals... ).c_str() );
+            return;
+        }
+
+        char *end;
+        LogRecord *record = beginRecord ( srcFile, srcLine, srcFunc, fmt, end );
+        LogRecordWriter writer ( record, end );
+        ( writer.add ( vals ), ... );
+        getThreadRing().commit ( writer.size() );
+    }
+
+    // Log any other format with arguments, which is always formatted first
+    template<typename F, typename ... V>
+    void logFormat ( const char *srcFile, int srcLine, const char *srcFunc, const F& fmt, const V& ... vals )
+    {
+        if ( ! _fd )
+            return;
+
+        const std::string message = format ( fmt, vals... );
+
+        if ( ! ( _options & LOG_ASYNC ) )
+        {
+            log ( srcFile, srcLine, srcFunc, message.c_str() );
+            return;
+        }
+
+        char *end;
+        LogRecord *record = beginRecord ( srcFile, srcLine, srcFunc, 0, end );
+        LogRecordWriter writer ( record, end );
+        writer.add ( message );
+        getThreadRing().commit ( writer.size() );
+    }
+
+    // Synchronously write the queued messages of every asynchronous logger, then flush them to file.
+    // This is safe to call while crashing, so nothing logged before an assert or abort is lost.
+    static void flushAll();
+
     // Get the singleton instance
     static Logger& get();
 
@@ -54,6 +285,9 @@ private:
     // Bit mask of options
     uint32_t _options = 0;
 
+    // Bit mask of categories to write
+    uint32_t _categories = LOG_CAT_ALL;
+
     // Log file descriptor
     FILE *_fd = 0;
 
@@ -63,6 +297,36 @@ private:
     // Flag to indicate if initialized
     bool _initialized = false;
 
+    // Write a message with a timestamp in seconds and milliseconds
+    void write ( time_t t, uint32_t ms, const char *srcFile, int srcLine, const char *srcFunc, const char *logMessage );
+
+    // Write a queued message, on the thread that drains the ring buffers
+    void write ( const LogRecord& record );
+
+    // Reserve a record in the ring buffer of this thread, waiting for the background thread if it is full
+    LogRecord *beginRecord ( const char *srcFile, int srcLine, const char *srcFunc, const char *fmt, char *& end );
+
+    // Get the ring buffer of this thread, which is created on first use
+    static LogRingBuffer& getThreadRing()
+    {
+        static thread_local LogRingBuffer *ring = 0;
+
+        if ( ! ring )
+            ring = newThreadRing();
+
+        return *ring;
+    }
+
+    static LogRingBuffer *newThreadRing();
+
+    // Start the background thread that writes the queued messages, once per process
+    static void startFlusher();
+
+    // Write the queued messages of every thread, returns false if another thread was already doing it
+    static bool drain ( bool wait );
+
+    friend class LogFlusher;
+
     // Optionally mutexed logging
 #ifdef LOGGER_MUTEXED
     Mutex _mutex;
@@ -72,32 +336,53 @@ private:
 
 #ifdef DISABLE_LOGGING
 
+#define LOG_TO_AT(...)
+#define LOG_AT(...)
 #define LOG_TO(...)
 #define LOG(...)
+#define LOG_LIST_AT(...)
 #define LOG_LIST(...)
+#define LOG_FLUSH_ALL()
 
 #else
 
-#define LOG_TO(LOGGER, FORMAT, ...)                                                                                    \
+// Log at a level and category. Below LOG_MIN_LEVEL this compiles to nothing, otherwise the arguments are only
+// evaluated if the logger is open and writes the category.
+#define LOG_TO_AT(LOGGER, LEVEL, CATEGORY, FORMAT, ...)                                                                \
     do {                                                                                                               \
-        LOGGER.log ( __BASE_FILE__, __LINE__, __PRETTY_FUNCTION__, format ( FORMAT, ## __VA_ARGS__ ).c_str() );        \
+        if constexpr ( ( LEVEL ) >= LOG_MIN_LEVEL ) {                                                                  \
+            if ( LOGGER.isEnabled ( CATEGORY ) )                                                                       \
+                LOGGER.logFormat ( __BASE_FILE__, __LINE__, __PRETTY_FUNCTION__, FORMAT, ## __VA_ARGS__ );             \
+        }                                                                                                              \
     } while ( 0 )
 
+#define LOG_AT(LEVEL, CATEGORY, FORMAT, ...)                                                                           \
+    LOG_TO_AT ( Logger::get(), LEVEL, CATEGORY, FORMAT, ## __VA_ARGS__ )
+
+#define LOG_TO(LOGGER, FORMAT, ...)                                                                                    \
+    LOG_TO_AT ( LOGGER, LOG_LEVEL_DEBUG, LOG_CAT_GENERAL, FORMAT, ## __VA_ARGS__ )
+
 #define LOG(FORMAT, ...)                                                                                               \
-    do {                                                                                                               \
-        Logger::get().log ( __BASE_FILE__, __LINE__, __PRETTY_FUNCTION__, format ( FORMAT, ## __VA_ARGS__ ).c_str() ); \
-    } while ( 0 )
+    LOG_AT ( LOG_LEVEL_DEBUG, LOG_CAT_GENERAL, FORMAT, ## __VA_ARGS__ )
+
+#define LOG_FLUSH_ALL() Logger::flushAll()
 
-#define LOG_LIST(LIST, TO_STRING)                                                                                      \
+#define LOG_LIST_AT(LEVEL, CATEGORY, LIST, TO_STRING)                                                                  \
     do {                                                                                                               \
-        std::string list;                                                                                              \
-        for ( const auto& val : LIST )                                                                                 \
-            list += " " + TO_STRING ( val ) + ",";                                                                     \
-        if ( ! LIST.empty() )                                                                                          \
-            list [ list.size() - 1 ] = ' ';                                                                            \
-        LOG ( "this=%08x; "#LIST "=[%s]", this, list );                                                                \
+        if constexpr ( ( LEVEL ) >= LOG_MIN_LEVEL ) {                                                                  \
+            if ( ! Logger::get().isEnabled ( CATEGORY ) )                                                              \
+                break;                                                                                                 \
+            std::string list;                                                                                          \
+            for ( const auto& val : LIST )                                                                             \
+                list += " " + TO_STRING ( val ) + ",";                                                                 \
+            if ( ! LIST.empty() )                                                                                      \
+                list [ list.size() - 1 ] = ' ';                                                                        \
+            LOG_AT ( LEVEL, CATEGORY, "this=%08x; "#LIST "=[%s]", this, list );                                        \
+        }                                                                                                              \
     } while ( 0 )
 
+#define LOG_LIST(LIST, TO_STRING) LOG_LIST_AT ( LOG_LEVEL_DEBUG, LOG_CAT_GENERAL, LIST, TO_STRING )
+
 #endif // DISABLE_LOGGING
 
 
@@ -111,7 +396,8 @@ private:
     do {                                                                                                               \
         if ( ASSERTION )                                                                                               \
             break;                                                                                                     \
-        LOG ( "Assertion '%s' failed", #ASSERTION );                                                                   \
+        LOG_AT ( LOG_LEVEL_ERROR, LOG_CAT_ALL, "Assertion '%s' failed", #ASSERTION );                                  \
+        LOG_FLUSH_ALL();                                                                                               \
         PRINT ( "Assertion '%s' failed", #ASSERTION );                                                                 \
         abort();                                                                                                       \
     } while ( 0 )
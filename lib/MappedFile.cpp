@@ -0,0 +1,129 @@
+#include "MappedFile.hpp"
+#include "Exceptions.hpp"
+#include "Logger.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+
+#ifdef _WIN32
+
+bool MappedFile::open ( const string& file )
+{
+    close();
+
+    _file = CreateFile ( file.c_str(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS, 0 );
+
+    if ( _file == INVALID_HANDLE_VALUE )
+    {
+        _file = 0;
+        LOG ( "CreateFile failed for '%s': %s", file, WinException::getLastError() );
+        return false;
+    }
+
+    LARGE_INTEGER size;
+
+    if ( ! GetFileSizeEx ( _file, &size ) || size.QuadPart == 0 || size.QuadPart > SIZE_MAX )
+    {
+        LOG ( "Invalid size for '%s'", file );
+        close();
+        return false;
+    }
+
+    _mapping = CreateFileMapping ( _file, 0, PAGE_READONLY, 0, 0, 0 );
+
+    if ( ! _mapping )
+    {
+        LOG ( "CreateFileMapping failed for '%s': %s", file, WinException::getLastError() );
+        close();
+        return false;
+    }
+
+    _data = ( const char * ) MapViewOfFile ( _mapping, FILE_MAP_READ, 0, 0, 0 );
+
+    if ( ! _data )
+    {
+        LOG ( "MapViewOfFile failed for '%s': %s", file, WinException::getLastError() );
+        close();
+        return false;
+    }
+
+    _size = size.QuadPart;
+    return true;
+}
+
+void MappedFile::close()
+{
+    if ( _data )
+        UnmapViewOfFile ( _data );
+
+    if ( _mapping )
+        CloseHandle ( _mapping );
+
+    if ( _file )
+        CloseHandle ( _file );
+
+    _data = 0;
+    _size = 0;
+    _mapping = _file = 0;
+}
+
+#else
+
+bool MappedFile::open ( const string& file )
+{
+    close();
+
+    _fd = ::open ( file.c_str(), O_RDONLY );
+
+    if ( _fd < 0 )
+    {
+        LOG ( "Failed to open '%s'", file );
+        return false;
+    }
+
+    struct stat st;
+
+    if ( fstat ( _fd, &st ) != 0 || st.st_size == 0 )
+    {
+        LOG ( "Invalid size for '%s'", file );
+        close();
+        return false;
+    }
+
+    void *data = mmap ( 0, st.st_size, PROT_READ, MAP_PRIVATE, _fd, 0 );
+
+    if ( data == MAP_FAILED )
+    {
+        LOG ( "mmap failed for '%s'", file );
+        close();
+        return false;
+    }
+
+    _data = ( const char * ) data;
+    _size = st.st_size;
+    return true;
+}
+
+void MappedFile::close()
+{
+    if ( _data )
+        munmap ( ( void * ) _data, _size );
+
+    if ( _fd >= 0 )
+        ::close ( _fd );
+
+    _data = 0;
+    _size = 0;
+    _fd = -1;
+}
+
+#endif // _WIN32
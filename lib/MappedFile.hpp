@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+
+// Read-only memory mapping of a whole file, pages are only read from disk when they are first touched
+class MappedFile
+{
+public:
+
+    MappedFile() {}
+
+    ~MappedFile() { close(); }
+
+    MappedFile ( const MappedFile& ) = delete;
+    MappedFile& operator= ( const MappedFile& ) = delete;
+
+    // Map the given file, returns false if it can't be opened or is empty
+    bool open ( const std::string& file );
+
+    // Unmap the file, any pointers into it become invalid
+    void close();
+
+    bool isOpen() const { return ( _data != 0 ); }
+
+    const char *data() const { return _data; }
+
+    size_t size() const { return _size; }
+
+private:
+
+    const char *_data = 0;
+
+    size_t _size = 0;
+
+#ifdef _WIN32
+    void *_file = 0, *_mapping = 0;
+#else
+    int _fd = -1;
+#endif
+};
@@ -121,31 +121,109 @@ void MemDumpList::update()
     totalSize = 0;
     for ( const MemDump& mem : addrs )
         totalSize += mem.getTotalSize();
+
+    updateHashSlices();
+}
+
+void MemDumpList::updateHashSlices()
+{
+    hashSlices.clear();
+
+    size_t dumpOffset = 0;
+
+    for ( size_t i = 0; i < addrs.size(); ++i )
+    {
+        const size_t memSize = addrs[i].getTotalSize();
+
+        for ( size_t offset = 0; offset < memSize; offset += MEM_DUMP_HASH_SLICE_SIZE )
+        {
+            hashSlices.push_back ( { i, dumpOffset + offset, offset,
+                                     min<size_t> ( MEM_DUMP_HASH_SLICE_SIZE, memSize - offset ) } );
+        }
+
+        dumpOffset += memSize;
+    }
+
+    ASSERT ( dumpOffset == totalSize );
+}
+
+void MemDumpList::hashDump ( const char *dump, uint32_t *hashes ) const
+{
+    ASSERT ( dump != 0 );
+
+    for ( const HashSlice& slice : hashSlices )
+        *hashes++ = getFastHash ( dump + slice.dumpOffset, slice.size );
+}
+
+static void appendLayout ( vector<MemDumpList::LayoutNode>& layout, const MemDumpBase& mem,
+                           size_t index, size_t depth, size_t& dumpOffset )
+{
+    layout.push_back ( { &mem, index, depth, dumpOffset } );
+
+    dumpOffset += mem.size;
+
+    for ( const MemDumpPtr& ptr : mem.ptrs )
+        appendLayout ( layout, ptr, index, depth + 1, dumpOffset );
+}
+
+vector<MemDumpList::LayoutNode> MemDumpList::getLayout() const
+{
+    vector<LayoutNode> layout;
+
+    size_t dumpOffset = 0;
+
+    for ( size_t i = 0; i < addrs.size(); ++i )
+        appendLayout ( layout, addrs[i], i, 0, dumpOffset );
+
+    ASSERT ( dumpOffset == totalSize );
+
+    return layout;
+}
+
+string MemDumpList::describeHashSlice ( size_t i ) const
+{
+    ASSERT ( i < hashSlices.size() );
+
+    const HashSlice& slice = hashSlices[i];
+    const MemDump& mem = addrs[slice.index];
+
+    string str = format ( "region %u { 0x%06X, 0x%06X } offset [0x%X, 0x%X)", slice.index,
+                          ( uint32_t ) ( uintptr_t ) mem.addr, ( uint32_t ) ( uintptr_t ) mem.addr + mem.size,
+                          slice.offset, slice.offset + slice.size );
+
+    // The saved data of child pointers comes after the memory dump itself
+    if ( slice.offset < mem.size )
+        str += format ( " at 0x%06X", ( uint32_t ) ( uintptr_t ) mem.addr + slice.offset );
+    else
+        str += format ( " in pointed-to data (%u pointers)", mem.ptrs.size() );
+
+    return str;
 }
 
 void MemDumpBase::save ( BinaryOutputArchive& ar ) const
 {
-    ar ( size, ptrs.size() );
+    // Sizes are always serialized as 32-bit, so the same data can be used by 64-bit tools
+    ar ( ( uint32_t ) size, ( uint32_t ) ptrs.size() );
     for ( const MemDumpPtr& ptr : ptrs )
         ptr.save ( ar );
 }
 
 void MemDumpPtr::save ( BinaryOutputArchive& ar ) const
 {
-    ar ( srcOffset, dstOffset );
+    ar ( ( uint32_t ) srcOffset, ( uint32_t ) dstOffset );
     MemDumpBase::save ( ar );
 }
 
 void MemDump::save ( BinaryOutputArchive& ar ) const
 {
-    uint32_t val = ( uint32_t ) addr;
+    uint32_t val = ( uint32_t ) ( uintptr_t ) addr;
     ar ( val );
     MemDumpBase::save ( ar );
 }
 
 void MemDumpList::save ( BinaryOutputArchive& ar ) const
 {
-    ar ( totalSize, addrs.size() );
+    ar ( ( uint32_t ) totalSize, ( uint32_t ) addrs.size() );
     for ( const MemDump& mem : addrs )
         mem.save ( ar );
 }
@@ -157,7 +235,7 @@ static vector<MemDumpPtr> loadPtrs ( size_t count, BinaryInputArchive& ar )
 
     for ( size_t i = 0; i < count; ++i )
     {
-        size_t srcOffset, dstOffset, size, ptrsCount;
+        uint32_t srcOffset, dstOffset, size, ptrsCount;
         ar ( srcOffset, dstOffset, size, ptrsCount );
 
         if ( ptrsCount )
@@ -171,20 +249,22 @@ static vector<MemDumpPtr> loadPtrs ( size_t count, BinaryInputArchive& ar )
 
 void MemDumpList::load ( BinaryInputArchive& ar )
 {
-    size_t count;
-    ar ( totalSize, count );
+    uint32_t size, count;
+    ar ( size, count );
+    totalSize = size;
 
     for ( size_t i = 0; i < count; ++i )
     {
-        uint32_t addr;
-        size_t size, ptrsCount;
+        uint32_t addr, size, ptrsCount;
         ar ( addr, size, ptrsCount );
 
         if ( ptrsCount )
-            append ( { ( char * ) addr, size, loadPtrs ( ptrsCount, ar ) } );
+            append ( { ( char * ) ( uintptr_t ) addr, size, loadPtrs ( ptrsCount, ar ) } );
         else
-            append ( { ( char * ) addr, size } );
+            append ( { ( char * ) ( uintptr_t ) addr, size } );
     }
+
+    updateHashSlices();
 }
 
 bool MemDumpList::save ( const string& filename ) const
@@ -8,6 +8,25 @@
 #include <string>
 
 
+// Max size of each slice when hashing a saved memory dump
+#define MEM_DUMP_HASH_SLICE_SIZE ( 1024 )
+
+
+// Magic number at the start of a state capture file, followed by the MemDumpList::totalSize as a uint32_t
+#define MEM_DUMP_CAPTURE_MAGIC ( 0x53434343 ) // "CCCS"
+
+
+// Header of each game state in a state capture file, followed by MemDumpList::totalSize raw bytes
+struct MemDumpCaptureHeader
+{
+    // The frame of this game state
+    uint32_t index, frame;
+
+    // 1 if the frame before this game state was rendered, 0 if rendering was skipped
+    uint32_t rendered;
+};
+
+
 class MemDumpPtr;
 
 
@@ -137,11 +156,11 @@ public:
 
     // Construct a memory dump with a memory range
     MemDump ( uint32_t start, uint32_t end )
-        : MemDumpBase ( end - start ), addr ( ( char * ) start ) {}
+        : MemDumpBase ( end - start ), addr ( ( char * ) ( uintptr_t ) start ) {}
 
     // Construct a memory dump with a memory range, with child pointers
     MemDump ( uint32_t start, uint32_t end, const std::vector<MemDumpPtr>& ptrs )
-        : MemDumpBase ( end - start, ptrs ), addr ( ( char * ) start ) {}
+        : MemDumpBase ( end - start, ptrs ), addr ( ( char * ) ( uintptr_t ) start ) {}
 
     // Copy constructor
     MemDump ( const MemDump& a )
@@ -172,11 +191,44 @@ public:
     // List of memory dumps
     std::vector<MemDump> addrs;
 
+    // A contiguous range of the saved dump that is hashed together, never spans more than one memory dump
+    struct HashSlice
+    {
+        // Index of the memory dump in addrs
+        size_t index;
+
+        // Offset of this slice from the start of the saved dump, and from the start of its memory dump
+        size_t dumpOffset, offset;
+
+        // Size of this slice
+        size_t size;
+    };
+
+    // List of hash slices in dump order, only valid after calling update() or load()
+    std::vector<HashSlice> hashSlices;
+
+    // A memory dump or child pointer, listed in the same order they are written to a saved dump
+    struct LayoutNode
+    {
+        // The memory dump or child pointer
+        const MemDumpBase *mem;
+
+        // Index of the top level memory dump in addrs
+        size_t index;
+
+        // Number of pointers followed to reach this node, 0 for a top level memory dump
+        size_t depth;
+
+        // Offset of the bytes of this node (excluding its children) from the start of the saved dump
+        size_t dumpOffset;
+    };
+
     // Clear all addresses
     void clear()
     {
         totalSize = 0;
         addrs.clear();
+        hashSlices.clear();
     }
 
     // True only if addrs.empty()
@@ -214,10 +266,24 @@ public:
     // Update the list of memory dumps: merge continuous address ranges, then compute total size
     void update();
 
+    // Hash a saved dump, writing one hash for each of the hash slices
+    void hashDump ( const char *dump, uint32_t *hashes ) const;
+
+    // Describe the memory location of a hash slice
+    std::string describeHashSlice ( size_t i ) const;
+
+    // Get the layout of a saved dump, only valid until addrs is modified
+    std::vector<LayoutNode> getLayout() const;
+
     // Serialization
     void save ( cereal::BinaryOutputArchive& ar ) const;
     void load ( cereal::BinaryInputArchive& ar );
     bool save ( const std::string& filename ) const;
     bool load ( const std::string& filename );
     bool load ( const char *data, size_t size );
+
+private:
+
+    // Split each memory dump into hash slices
+    void updateHashSlices();
 };
@@ -103,6 +103,27 @@ string Protocol::encode ( const MsgPtr& msg )
     return encodeStageTwo ( msg, ss.str() );
 }
 
+shared_ptr<const string> Protocol::encodeShared ( const MsgPtr& msg )
+{
+    if ( ! msg )
+        return 0;
+
+    if ( ! msg->_encoded )
+        msg->_encoded.reset ( new string ( encode ( msg ) ) );
+
+    return msg->_encoded;
+}
+
+const shared_ptr<const string>& Protocol::getShared ( const MsgPtr& msg )
+{
+    static const shared_ptr<const string> null;
+
+    if ( ! msg )
+        return null;
+
+    return msg->_encoded;
+}
+
 MsgPtr Protocol::decode ( const char *bytes, size_t len, size_t& consumed )
 {
     MsgPtr msg;
@@ -363,6 +384,7 @@ Serializable::Serializable() : compressionLevel ( 9 ) {}
 void Serializable::invalidate() const
 {
     _hashValid = true;
+    _encoded.reset();
 }
 
 
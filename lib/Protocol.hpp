@@ -68,6 +68,13 @@ public:
     static std::string encode ( Serializable *message );
     static std::string encode ( const MsgPtr& msg );
 
+    // Encode a message once and keep the encoded bytes with the message, so the same bytes can be sent to many
+    // sockets. The bytes are dropped when the message is invalidated.
+    static std::shared_ptr<const std::string> encodeShared ( const MsgPtr& msg );
+
+    // Get the encoded bytes kept by encodeShared, null if there are none
+    static const std::shared_ptr<const std::string>& getShared ( const MsgPtr& msg );
+
     // Decode a series of bytes into a message, consumed indicates the number of bytes read.
     // This returns null if the message failed to decode, NOTE consumed will still be updated.
     static MsgPtr decode ( const char *bytes, size_t len, size_t& consumed );
@@ -120,6 +127,9 @@ private:
     mutable HashType _hash;
     mutable bool _hashValid = true;
 
+    // Cached encoded bytes, only set by Protocol::encodeShared
+    mutable std::shared_ptr<const std::string> _encoded;
+
     // Serialize and deserialize the base type
     virtual void saveBase ( cereal::BinaryOutputArchive& ar ) const {}
     virtual void loadBase ( cereal::BinaryInputArchive& ar ) {}
@@ -32,3 +32,12 @@ VersionConfig,
 JoysticksChanged,
 TransitionIndex,
 PaletteManager,
+FrameHashes,
+RegionHashes,
+FrameAdvantage,
+LatencyProbe,
+DelayTuning,
+RelayUpdate,
+SpectateHistory,
+SpectateState,
+SpectateResume,
@@ -0,0 +1,85 @@
+#include "SendQueue.hpp"
+#include "Logger.hpp"
+
+#include <algorithm>
+
+using namespace std;
+
+
+bool SendQueue::push ( const shared_ptr<const string>& bytes, uint64_t now, size_t offset )
+{
+    ASSERT ( bytes.get() != 0 );
+    ASSERT ( offset <= bytes->size() );
+
+    const size_t size = bytes->size() - offset;
+
+    if ( size == 0 )
+        return true;
+
+    if ( _bytes + size > limit )
+    {
+        ++_stats.overflows;
+        return false;
+    }
+
+    _buffers.push_back ( { bytes, offset, now } );
+    _bytes += size;
+
+    _stats.queuedBytes += size;
+    _stats.maxBytes = max ( _stats.maxBytes, _bytes );
+    return true;
+}
+
+void SendQueue::gather ( vector<span<const char>>& buffers, size_t maxBuffers ) const
+{
+    buffers.clear();
+
+    for ( const Buffer& buffer : _buffers )
+    {
+        if ( buffers.size() >= maxBuffers )
+            break;
+
+        buffers.emplace_back ( buffer.bytes->data() + buffer.offset, buffer.bytes->size() - buffer.offset );
+    }
+}
+
+void SendQueue::consume ( size_t bytes, uint64_t now )
+{
+    ASSERT ( bytes <= _bytes );
+
+    _bytes -= bytes;
+    _stats.sentBytes += bytes;
+
+    while ( bytes > 0 )
+    {
+        ASSERT ( _buffers.empty() == false );
+
+        Buffer& front = _buffers.front();
+        const size_t remaining = front.bytes->size() - front.offset;
+
+        if ( bytes < remaining )
+        {
+            front.offset += bytes;
+            return;
+        }
+
+        bytes -= remaining;
+
+        _stats.latencyMs.add ( now >= front.time ? now - front.time : 0 );
+        _buffers.pop_front();
+    }
+}
+
+void SendQueue::clear()
+{
+    _buffers.clear();
+    _bytes = 0;
+}
+
+uint64_t SendQueue::getAge ( uint64_t now ) const
+{
+    if ( _buffers.empty() || now < _buffers.front().time )
+        return 0;
+
+    return now - _buffers.front().time;
+}
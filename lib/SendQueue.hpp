@@ -0,0 +1,88 @@
+#pragma once
+
+#include "Histogram.hpp"
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+#include <span>
+#include <cstdint>
+
+
+// Default maximum number of bytes waiting in a send queue
+#define DEFAULT_SEND_QUEUE_LIMIT    ( 4 * 1024 * 1024 )
+
+// Maximum number of queued buffers gathered into a single send
+#define SEND_QUEUE_MAX_GATHER       ( 64 )
+
+
+// Bounded queue of bytes waiting to be sent over a stream socket, used once the kernel send buffer is full.
+// Queued buffers are shared instead of copied, so the same encoded broadcast can wait in many queues.
+class SendQueue
+{
+public:
+
+    // Per queue accounting, these are always collected
+    struct Stats
+    {
+        // Number of bytes that had to be queued, and number of queued bytes sent so far
+        uint64_t queuedBytes = 0, sentBytes = 0;
+
+        // Most bytes waiting at once
+        size_t maxBytes = 0;
+
+        // Number of pushes rejected because the queue was full
+        size_t overflows = 0;
+
+        // Milliseconds each buffer waited in the queue, from being pushed to being completely sent
+        Histogram<16, true> latencyMs;
+    };
+
+    // Maximum number of bytes that can be waiting
+    size_t limit = DEFAULT_SEND_QUEUE_LIMIT;
+
+    // Queue the bytes starting at the given offset, returns false without queueing anything if over the limit
+    bool push ( const std::shared_ptr<const std::string>& bytes, uint64_t now, size_t offset = 0 );
+
+    // Get the unsent bytes of up to maxBuffers queued buffers in order, for a single gathered send
+    void gather ( std::vector<std::span<const char>>& buffers, size_t maxBuffers = SEND_QUEUE_MAX_GATHER ) const;
+
+    // Remove bytes that have been sent from the front of the queue
+    void consume ( size_t bytes, uint64_t now );
+
+    // Remove all the queued bytes
+    void clear();
+
+    bool empty() const { return _buffers.empty(); }
+
+    // Number of bytes and buffers waiting to be sent
+    size_t getBytes() const { return _bytes; }
+    size_t getCount() const { return _buffers.size(); }
+
+    // Milliseconds the oldest queued bytes have been waiting, 0 if empty
+    uint64_t getAge ( uint64_t now ) const;
+
+    // Get / reset the accounting
+    const Stats& getStats() const { return _stats; }
+    void resetStats() { _stats = Stats(); }
+
+private:
+
+    struct Buffer
+    {
+        std::shared_ptr<const std::string> bytes;
+
+        // Offset of the first unsent byte
+        size_t offset;
+
+        // When this buffer was queued
+        uint64_t time;
+    };
+
+    std::deque<Buffer> _buffers;
+
+    size_t _bytes = 0;
+
+    Stats _stats;
+};
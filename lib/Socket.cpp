@@ -5,6 +5,7 @@
 #include "SmartSocket.hpp"
 #include "Exceptions.hpp"
 #include "ErrorStrings.hpp"
+#include "TimerManager.hpp"
 
 #include <winsock2.h>
 #include <windows.h>
@@ -66,6 +67,8 @@ void Socket::disconnect()
 
     freeBuffer();
 
+    _sendQueue.clear();
+
     _packetLoss = _hashFailRate = 0;
 }
 
@@ -234,53 +237,150 @@ bool Socket::send ( const char *buffer, size_t len )
     ASSERT ( _fd != 0 );
     ASSERT ( address.addr.empty() == false );
 
+    if ( isTCP() )
+        return sendStream ( buffer, len, 0 );
+
     size_t totalBytes = 0;
 
     while ( totalBytes < len || len == 0 )
     {
-        int sentBytes = SOCKET_ERROR;
+        LOG_SOCKET_TRACE ( this, "sendto ( [ %u bytes ], '%s' )", len, address );
+        const int sentBytes = ::sendto ( _fd, buffer, len, 0,
+                                         address.getAddrInfo()->ai_addr, address.getAddrInfo()->ai_addrlen );
 
-        if ( isTCP() )
-        {
-            LOG_SOCKET ( this, "send ( [ %u bytes ] )", len );
-            sentBytes = ::send ( _fd, buffer, len, 0 );
-        }
-        else
+        if ( sentBytes == SOCKET_ERROR )
         {
-            LOG_SOCKET ( this, "sendto ( [ %u bytes ], '%s' )", len, address );
-            sentBytes = ::sendto ( _fd, buffer, len, 0,
-                                   address.getAddrInfo()->ai_addr, address.getAddrInfo()->ai_addrlen );
+            LOG_SOCKET ( this, "%s; sendto failed", WinException::getLastSocketError() );
+            disconnect();
+            return false;
         }
 
-        if ( sentBytes == SOCKET_ERROR )
+        if ( len == 0 )
+            break;
+
+        totalBytes += sentBytes;
+    }
+
+    return true;
+}
+
+bool Socket::sendStream ( const char *buffer, size_t len, const shared_ptr<const string>& shared )
+{
+    ASSERT ( isTCP() == true );
+
+    if ( _fd == 0 || isDisconnected() )
+    {
+        LOG_SOCKET ( this, "Cannot send over disconnected socket" );
+        return false;
+    }
+
+    // Send whatever is already waiting first, so the bytes stay in order
+    if ( ! flushSendQueue() )
+        return false;
+
+    size_t sentBytes = 0;
+
+    if ( _sendQueue.empty() )
+    {
+        LOG_SOCKET_TRACE ( this, "send ( [ %u bytes ] )", len );
+        const int result = ::send ( _fd, buffer, len, 0 );
+
+        if ( result == SOCKET_ERROR )
         {
-            const string err = WinException::getLastSocketError();
+            const int error = WSAGetLastError();
 
-            // Disconnect the socket if an error occurred during send
-            if ( isTCP() )
+            // Disconnect the socket if an error occurred during send, a full send buffer just means queue the bytes
+            if ( error != WSAEWOULDBLOCK )
             {
-                LOG_SOCKET ( this, "%s; send failed", err );
+                LOG_SOCKET ( this, "[%d] %s; send failed", error, WinException::getAsString ( error ) );
                 LOG_SOCKET ( this, "disconnect due to send error" );
                 socketDisconnected();
+                return false;
             }
-            else
-            {
-                LOG_SOCKET ( this, "%s; sendto failed", err );
-                disconnect();
-            }
+        }
+        else
+        {
+            sentBytes = result;
+        }
+    }
+
+    if ( sentBytes == len )
+        return true;
+
+    const uint64_t now = TimerManager::get().getNow();
+
+    const bool queued = ( shared && shared->data() == buffer && shared->size() == len )
+                        ? _sendQueue.push ( shared, now, sentBytes )
+                        : _sendQueue.push ( make_shared<const string> ( buffer + sentBytes, len - sentBytes ), now );
+
+    if ( ! queued )
+    {
+        LOG_SOCKET ( this, "send queue full; queued=%u; limit=%u", _sendQueue.getBytes(), _sendQueue.limit );
+        LOG_SOCKET ( this, "disconnect due to send queue overflow" );
+        socketDisconnected();
+        return false;
+    }
+
+    LOG_SOCKET_TRACE ( this, "queued [ %u bytes ]; total=%u", len - sentBytes, _sendQueue.getBytes() );
+    return true;
+}
+
+bool Socket::flushSendQueue()
+{
+    if ( _sendQueue.empty() )
+        return true;
 
+    vector<span<const char>> buffers;
+    vector<WSABUF> wsaBuffers;
+
+    while ( ! _sendQueue.empty() )
+    {
+        _sendQueue.gather ( buffers );
+
+        wsaBuffers.resize ( buffers.size() );
+
+        size_t totalBytes = 0;
+
+        for ( size_t i = 0; i < buffers.size(); ++i )
+        {
+            wsaBuffers[i].buf = const_cast<char *> ( buffers[i].data() );
+            wsaBuffers[i].len = buffers[i].size();
+            totalBytes += buffers[i].size();
+        }
+
+        DWORD sentBytes = 0;
+
+        if ( WSASend ( _fd, &wsaBuffers[0], wsaBuffers.size(), &sentBytes, 0, 0, 0 ) == SOCKET_ERROR )
+        {
+            const int error = WSAGetLastError();
+
+            // Still no room, try again on the next write event
+            if ( error == WSAEWOULDBLOCK )
+                return true;
+
+            LOG_SOCKET ( this, "[%d] %s; WSASend failed", error, WinException::getAsString ( error ) );
+            LOG_SOCKET ( this, "disconnect due to send error" );
+            socketDisconnected();
             return false;
         }
 
-        if ( len == 0 )
-            break;
+        _sendQueue.consume ( sentBytes, TimerManager::get().getNow() );
 
-        totalBytes += sentBytes;
+        LOG_SOCKET_TRACE ( this, "sent [ %u bytes ] from send queue; remaining=%u", sentBytes, _sendQueue.getBytes() );
+
+        // The kernel send buffer is full again
+        if ( sentBytes < totalBytes )
+            break;
     }
 
     return true;
 }
 
+void Socket::socketWritable()
+{
+    flushSendQueue();
+}
+
 bool Socket::send ( const char *buffer, size_t len, const IpAddrPort& address )
 {
     if ( _fd == 0 || isDisconnected() )
@@ -297,7 +397,7 @@ bool Socket::send ( const char *buffer, size_t len, const IpAddrPort& address )
 
     while ( totalBytes < len || len == 0 )
     {
-        LOG_SOCKET ( this, "sendto ( [ %u bytes ], '%s' )", len, address );
+        LOG_SOCKET_TRACE ( this, "sendto ( [ %u bytes ], '%s' )", len, address );
         int sentBytes = ::sendto ( _fd, buffer, len, 0,
                                    address.getAddrInfo()->ai_addr, address.getAddrInfo()->ai_addrlen );
 
@@ -433,7 +533,7 @@ void Socket::socketRead()
     // Simulated packet loss
     if ( rand() % 100 < _packetLoss )
     {
-        LOG ( "Discarding [ %u bytes ] from '%s'", bufferLen, address );
+        LOG_AT ( LOG_LEVEL_TRACE, LOG_CAT_SOCKET, "Discarding [ %u bytes ] from '%s'", bufferLen, address );
         return;
     }
 #endif
@@ -441,7 +541,7 @@ void Socket::socketRead()
     // Raw read mode
     if ( _isRaw )
     {
-        LOG ( "Read [ %u bytes ] from '%s'", bufferLen, address );
+        LOG_AT ( LOG_LEVEL_TRACE, LOG_CAT_SOCKET, "Read [ %u bytes ] from '%s'", bufferLen, address );
 
         if ( owner )
             owner->socketRead ( this, bufferStart, bufferLen, address );
@@ -450,23 +550,24 @@ void Socket::socketRead()
 
     // Increment the buffer position
     _readPos += bufferLen;
-    LOG ( "Read [ %u bytes ] from '%s'; %u bytes remaining in buffer", bufferLen, address, _readPos );
+    LOG_AT ( LOG_LEVEL_TRACE, LOG_CAT_SOCKET, "Read [ %u bytes ] from '%s'; %u bytes remaining in buffer",
+             bufferLen, address, _readPos );
 
     // Handle zero byte packets
     if ( bufferLen == 0 )
     {
-        LOG ( "Decoded 'NullMsg' using [ 0 bytes ]" );
+        LOG_AT ( LOG_LEVEL_TRACE, LOG_CAT_SOCKET, "Decoded 'NullMsg' using [ 0 bytes ]" );
         socketRead ( NullMsg, address );
         return;
     }
 
     if ( bufferLen <= 256 )
-        LOG ( "Hex: %s", formatAsHex ( bufferStart, bufferLen ) );
+        LOG_AT ( LOG_LEVEL_TRACE, LOG_CAT_SOCKET, "Hex: %s", formatAsHex ( bufferStart, bufferLen ) );
 
     // Check if the first byte is a valid message type
     if ( _readPos >= sizeof ( MsgType ) && ! ::Protocol::checkMsgType ( * ( MsgType * ) &_readBuffer[0] ) )
     {
-        LOG ( "Clearing invalid buffer!" );
+        LOG_AT ( LOG_LEVEL_DEBUG, LOG_CAT_SOCKET, "Clearing invalid buffer!" );
         resetBuffer();
         return;
     }
@@ -484,7 +585,8 @@ void Socket::socketRead()
         if ( ! msg.get() )
             return;
 
-        LOG ( "Decoded '%s' using [ %u bytes ]; %u bytes remaining in buffer", msg, consumedBytes, _readPos );
+        LOG_AT ( LOG_LEVEL_TRACE, LOG_CAT_SOCKET, "Decoded '%s' using [ %u bytes ]; %u bytes remaining in buffer",
+                 msg, consumedBytes, _readPos );
         socketRead ( msg, address );
 
         // Abort if the socket is de-allocated
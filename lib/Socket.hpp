@@ -3,6 +3,7 @@
 #include "IpAddrPort.hpp"
 #include "GoBackN.hpp"
 #include "Enum.hpp"
+#include "SendQueue.hpp"
 
 #include <vector>
 #include <memory>
@@ -13,9 +14,14 @@
 #define DEFAULT_CONNECT_TIMEOUT ( 5000 )
 
 
-#define LOG_SOCKET(SOCKET, FORMAT, ...)                                                                             \
-    LOG ( "%s socket=%08x; fd=%08x; state=%s; address='%s'; isRaw=%u; " FORMAT,                                     \
-          SOCKET->protocol, SOCKET, SOCKET->_fd, SOCKET->_state, SOCKET->address, SOCKET->_isRaw, ## __VA_ARGS__ )
+#define LOG_SOCKET_AT(LEVEL, SOCKET, FORMAT, ...)                                                                   \
+    LOG_AT ( LEVEL, LOG_CAT_SOCKET, "%s socket=%08x; fd=%08x; state=%s; address='%s'; isRaw=%u; " FORMAT,           \
+             SOCKET->protocol, SOCKET, SOCKET->_fd, SOCKET->_state, SOCKET->address, SOCKET->_isRaw, ## __VA_ARGS__ )
+
+#define LOG_SOCKET(SOCKET, FORMAT, ...)         LOG_SOCKET_AT ( LOG_LEVEL_DEBUG, SOCKET, FORMAT, ## __VA_ARGS__ )
+
+// Logged for every packet sent or received
+#define LOG_SOCKET_TRACE(SOCKET, FORMAT, ...)   LOG_SOCKET_AT ( LOG_LEVEL_TRACE, SOCKET, FORMAT, ## __VA_ARGS__ )
 
 
 // Forward declarations
@@ -172,6 +178,12 @@ public:
         return send ( MsgPtr ( const_cast<Serializable *> ( &message ), ignoreMsgPtr ), address );
     }
 
+    // Get the bytes waiting to be sent, only TCP sockets queue bytes
+    const SendQueue& getSendQueue() const { return _sendQueue; }
+
+    // Set the maximum number of bytes waiting to be sent, the socket is disconnected if it goes over this limit
+    void setSendQueueLimit ( size_t limit ) { _sendQueue.limit = limit; }
+
     // Set the packet loss for testing purposes
     void setPacketLoss ( uint8_t percentage );
 
@@ -239,6 +251,9 @@ protected:
     // Hash failure percentage for testing purposes
     uint8_t _hashFailRate = 0;
 
+    // Bytes waiting for room in the kernel send buffer, so TCP sends never block or fail on a slow connection
+    SendQueue _sendQueue;
+
     // Reset the read buffer to its initial size
     void resetBuffer();
 
@@ -256,6 +271,9 @@ protected:
     // Read event callback, calls the function below if NOT isRaw
     virtual void socketRead();
 
+    // Write event callback, only called while there are bytes waiting to be sent
+    virtual void socketWritable();
+
     // Read protocol message callback, must be implemented, only called if NOT isRaw
     virtual void socketRead ( const MsgPtr& msg, const IpAddrPort& address ) = 0;
     
@@ -268,6 +286,13 @@ protected:
     // Initialize the socket fd with the provided address and protocol
     void init();
 
+    // Send bytes in order over a TCP socket, queueing whatever doesn't fit in the kernel send buffer.
+    // If the bytes are shared, the queue keeps a reference instead of a copy.
+    bool sendStream ( const char *buffer, size_t len, const std::shared_ptr<const std::string>& shared );
+
+    // Send as much of the send queue as possible in gathered sends, a return value of false indicates disconnected
+    bool flushSendQueue();
+
     // Read raw bytes directly, 0 on success, otherwise returns the socket error code
     int recv ( char *buffer, size_t& len );
     int recvfrom ( char *buffer, size_t& len, IpAddrPort& address );
@@ -51,9 +51,16 @@ void SocketManager::check ( uint64_t timeout )
     for ( Socket *socket : _activeSockets )
     {
         if ( socket->isConnecting() && socket->isTCP() )
+        {
+            FD_SET ( socket->_fd, &writeFds );
+            continue;
+        }
+
+        FD_SET ( socket->_fd, &readFds );
+
+        // Wait for room in the kernel send buffer if there are bytes waiting to be sent
+        if ( ! socket->_sendQueue.empty() )
             FD_SET ( socket->_fd, &writeFds );
-        else
-            FD_SET ( socket->_fd, &readFds );
     }
 
     ASSERT ( timeout > 0 );
@@ -89,6 +96,16 @@ void SocketManager::check ( uint64_t timeout )
         }
         else
         {
+            if ( ! socket->_sendQueue.empty() && FD_ISSET ( socket->_fd, &writeFds ) )
+            {
+                LOG_SOCKET ( socket, "socketWritable" );
+                socket->socketWritable();
+
+                // The socket may have been disconnected and freed
+                if ( _allocatedSockets.find ( socket ) == _allocatedSockets.end() )
+                    continue;
+            }
+
             if ( ! FD_ISSET ( socket->_fd, &readFds ) )
                 continue;
 
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+
+// Lock-free ring buffer for exactly one producer thread and one consumer thread, N must be a power of 2.
+//
+// The producer only writes _tail and the consumer only writes _head, so neither side ever waits on the other. A push
+// fails instead of blocking when the buffer is full; the caller decides whether to retry later or drop the element.
+template<typename T, size_t N>
+class SpscQueue
+{
+    static_assert ( N > 0 && ( N & ( N - 1 ) ) == 0, "N must be a power of 2" );
+
+public:
+
+    // Push an element, returns false if the queue is full. Producer thread only.
+    bool push ( const T& t )
+    {
+        const size_t tail = _tail.load ( std::memory_order_relaxed );
+
+        if ( tail - _head.load ( std::memory_order_acquire ) == N )
+            return false;
+
+        _buffer[tail & ( N - 1 )] = t;
+        _tail.store ( tail + 1, std::memory_order_release );
+        return true;
+    }
+
+    // Pop an element, returns false if the queue is empty. Consumer thread only.
+    bool pop ( T& t )
+    {
+        const size_t head = _head.load ( std::memory_order_relaxed );
+
+        if ( head == _tail.load ( std::memory_order_acquire ) )
+            return false;
+
+        t = _buffer[head & ( N - 1 )];
+        _head.store ( head + 1, std::memory_order_release );
+        return true;
+    }
+
+    // Total number of elements pushed, the producer can use this to order other messages with the elements.
+    size_t getPushed() const { return _tail.load ( std::memory_order_acquire ); }
+
+    // Total number of elements popped
+    size_t getPopped() const { return _head.load ( std::memory_order_acquire ); }
+
+    bool empty() const { return getPushed() == getPopped(); }
+
+    static constexpr size_t capacity() { return N; }
+
+private:
+
+    // Keep the indexes on separate cache lines so the two threads don't contend
+    alignas ( 64 ) std::atomic<size_t> _head { 0 };
+    alignas ( 64 ) std::atomic<size_t> _tail { 0 };
+
+    std::array<T, N> _buffer;
+};
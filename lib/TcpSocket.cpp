@@ -190,6 +190,15 @@ bool TcpSocket::send ( SerializableSequence *message, const IpAddrPort& address
 
 bool TcpSocket::send ( const MsgPtr& msg, const IpAddrPort& address )
 {
+    // Broadcast messages are only encoded once, the same bytes are sent to every socket
+    const shared_ptr<const string>& shared = ::Protocol::getShared ( msg );
+
+    if ( shared )
+    {
+        LOG ( "Sending shared '%s' [ %u bytes ]", msg, shared->size() );
+        return sendStream ( shared->data(), shared->size(), shared );
+    }
+
     const string buffer = ::Protocol::encode ( msg );
 
     LOG ( "Encoded '%s' to [ %u bytes ]", msg, buffer.size() );
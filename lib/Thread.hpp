@@ -46,6 +46,12 @@ public:
         pthread_mutex_unlock ( &_mutex );
     }
 
+    // Lock if no other thread has the mutex, returns false without waiting otherwise
+    bool tryLock()
+    {
+        return ( pthread_mutex_trylock ( &_mutex ) == 0 );
+    }
+
     friend class CondVar;
 
 private:
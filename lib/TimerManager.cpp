@@ -25,6 +25,21 @@ void TimerManager::updateNow()
     }
 }
 
+uint64_t TimerManager::getNowMicroseconds() const
+{
+    if ( ! _initialized )
+        return 0;
+
+    if ( ! _useHiResTimer )
+        return 1000 * uint64_t ( timeGetTime() );
+
+    uint64_t ticks;
+    QueryPerformanceCounter ( ( LARGE_INTEGER * ) &ticks );
+
+    // Split the conversion to avoid overflowing
+    return ( ticks / _ticksPerSecond ) * 1000000 + ( ( ticks % _ticksPerSecond ) * 1000000 ) / _ticksPerSecond;
+}
+
 void TimerManager::check()
 {
     if ( ! _initialized )
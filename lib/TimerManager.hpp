@@ -34,6 +34,9 @@ public:
     uint64_t getNow() const { return _now; }
     uint64_t getNow ( bool update ) { if ( update ) updateNow(); return _now; }
 
+    // Get the current time in microseconds, this always reads the timer and doesn't update the cached time
+    uint64_t getNowMicroseconds() const;
+
     // Get the next time when a timer will expire
     uint64_t getNextExpiry() const { return _nextExpiry; }
 
@@ -335,10 +335,10 @@ bool UdpSocket::sendRaw ( const MsgPtr& msg, const IpAddrPort& address )
 
     const string buffer = ::Protocol::encode ( msg );
 
-    LOG ( "Encoded '%s' to [ %u bytes ]", msg, buffer.size() );
+    LOG_AT ( LOG_LEVEL_TRACE, LOG_CAT_SOCKET, "Encoded '%s' to [ %u bytes ]", msg, buffer.size() );
 
     if ( !buffer.empty() && buffer.size() <= 256 )
-        LOG ( "Hex: %s", formatAsHex ( buffer ) );
+        LOG_AT ( LOG_LEVEL_TRACE, LOG_CAT_SOCKET, "Hex: %s", formatAsHex ( buffer ) );
 
     // Real UDP sockets send directly
     if ( isReal()  )
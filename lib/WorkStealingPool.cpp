@@ -0,0 +1,85 @@
+#include "WorkStealingPool.hpp"
+
+#include <algorithm>
+
+using namespace std;
+
+
+size_t WorkStealingPool::run ( size_t count, size_t numThreads, const Job& job )
+{
+    if ( numThreads == 0 )
+        numThreads = 1;
+
+    if ( numThreads > count )
+        numThreads = max<size_t> ( count, 1 );
+
+    vector<shared_ptr<Queue>> queues;
+
+    for ( size_t i = 0; i < numThreads; ++i )
+        queues.push_back ( make_shared<Queue>() );
+
+    // Deal out the jobs in contiguous blocks, so neighbouring jobs tend to run on the same worker
+    for ( size_t i = 0; i < count; ++i )
+        queues[ ( i * numThreads ) / count ]->jobs.push_back ( i );
+
+    vector<shared_ptr<Worker>> workers;
+
+    for ( size_t i = 0; i < numThreads; ++i )
+        workers.push_back ( make_shared<Worker> ( queues, i, job ) );
+
+    for ( size_t i = 1; i < numThreads; ++i )
+        workers[i]->start();
+
+    // The calling thread is the first worker
+    workers[0]->run();
+
+    size_t stolen = workers[0]->getStolen();
+
+    for ( size_t i = 1; i < numThreads; ++i )
+    {
+        workers[i]->join();
+        stolen += workers[i]->getStolen();
+    }
+
+    return stolen;
+}
+
+void WorkStealingPool::Worker::run()
+{
+    size_t job;
+
+    while ( next ( job ) )
+        _job ( job, _id );
+}
+
+bool WorkStealingPool::Worker::next ( size_t& job )
+{
+    {
+        Queue& queue = *_queues[_id];
+        Lock lock ( queue.mutex );
+
+        if ( ! queue.jobs.empty() )
+        {
+            job = queue.jobs.back();
+            queue.jobs.pop_back();
+            return true;
+        }
+    }
+
+    // No jobs are added after starting, so once every queue is empty we are done
+    for ( size_t i = 1; i < _queues.size(); ++i )
+    {
+        Queue& queue = *_queues[ ( _id + i ) % _queues.size() ];
+        Lock lock ( queue.mutex );
+
+        if ( ! queue.jobs.empty() )
+        {
+            job = queue.jobs.front();
+            queue.jobs.pop_front();
+            ++_stolen;
+            return true;
+        }
+    }
+
+    return false;
+}
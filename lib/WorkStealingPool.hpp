@@ -0,0 +1,59 @@
+#pragma once
+
+#include "Thread.hpp"
+
+#include <deque>
+#include <memory>
+#include <vector>
+#include <functional>
+
+
+// Runs a fixed batch of independent jobs on a set of worker threads.
+//
+// Each worker starts with an even share of the jobs and takes them from the back of its own queue. Once its queue is
+// empty it steals from the front of the other queues, so a few slow jobs can't leave the other workers idle. Each queue
+// has its own mutex, so workers only contend when stealing.
+class WorkStealingPool
+{
+public:
+
+    // Called with the job index and the index of the worker thread running it
+    typedef std::function<void ( size_t job, size_t worker )> Job;
+
+    // Run job for every index in [0, count) on the given number of threads, returns when every job is done.
+    // Returns the number of jobs that were stolen from another worker.
+    static size_t run ( size_t count, size_t numThreads, const Job& job );
+
+private:
+
+    struct Queue
+    {
+        Mutex mutex;
+        std::deque<size_t> jobs;
+    };
+
+    class Worker : public Thread
+    {
+    public:
+
+        Worker ( std::vector<std::shared_ptr<Queue>>& queues, size_t id, const Job& job )
+            : _queues ( queues ), _id ( id ), _job ( job ) {}
+
+        size_t getStolen() const { return _stolen; }
+
+        void run() override;
+
+    private:
+
+        std::vector<std::shared_ptr<Queue>>& _queues;
+
+        const size_t _id;
+
+        const Job& _job;
+
+        size_t _stolen = 0;
+
+        // Take the next job from our own queue, or steal one from another queue, returns false if there are none left
+        bool next ( size_t& job );
+    };
+};
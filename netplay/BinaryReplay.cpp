@@ -0,0 +1,271 @@
+#include "BinaryReplay.hpp"
+#include "Logger.hpp"
+
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+
+static_assert ( sizeof ( BinaryReplay::Header ) % 4 == 0, "Sections must stay 4-byte aligned" );
+static_assert ( sizeof ( BinaryReplay::Index ) % 4 == 0, "Sections must stay 4-byte aligned" );
+static_assert ( sizeof ( BinaryReplay::RngState ) % 4 == 0, "Sections must stay 4-byte aligned" );
+static_assert ( sizeof ( BinaryReplay::Rollback ) % 4 == 0, "Sections must stay 4-byte aligned" );
+static_assert ( sizeof ( BinaryReplay::Reinput ) % 4 == 0, "Sections must stay 4-byte aligned" );
+static_assert ( sizeof ( BinaryReplay::InitialState ) % 4 == 0, "Sections must stay 4-byte aligned" );
+
+
+static uint64_t align4 ( uint64_t offset )
+{
+    return ( offset + 3 ) & ~uint64_t ( 3 );
+}
+
+// Check that a section of count rows fits in the file
+static bool checkSection ( uint32_t offset, uint32_t count, size_t rowSize, size_t fileSize )
+{
+    return ( offset % 4 == 0 ) && ( uint64_t ( offset ) + uint64_t ( count ) * rowSize <= fileSize );
+}
+
+// Check that the rows [first, first + count) are in a section of total rows
+static bool checkRange ( uint32_t first, uint32_t count, uint32_t total )
+{
+    return ( uint64_t ( first ) + count <= total );
+}
+
+
+bool BinaryReplay::write ( const string& file, const Sections& sections )
+{
+    ASSERT ( sections.p1.size() == sections.p2.size() );
+
+    Header header;
+    header.numIndexes = sections.indexes.size();
+    header.numFrames = sections.p1.size();
+    header.numRngStates = sections.rngStates.size();
+    header.numRollbacks = sections.rollbacks.size();
+    header.numReinputs = sections.reinputs.size();
+    header.numInitialStates = sections.initialStates.size();
+
+    uint64_t offset = sizeof ( Header );
+
+    const auto place = [&] ( uint32_t& sectionOffset, size_t bytes )
+    {
+        sectionOffset = offset;
+        offset = align4 ( offset + bytes );
+    };
+
+    place ( header.indexesOffset, sections.indexes.size() * sizeof ( Index ) );
+    place ( header.p1Offset, sections.p1.size() * sizeof ( uint16_t ) );
+    place ( header.p2Offset, sections.p2.size() * sizeof ( uint16_t ) );
+    place ( header.rngStatesOffset, sections.rngStates.size() * sizeof ( RngState ) );
+    place ( header.rollbacksOffset, sections.rollbacks.size() * sizeof ( Rollback ) );
+    place ( header.reinputsOffset, sections.reinputs.size() * sizeof ( Reinput ) );
+    place ( header.initialStatesOffset, sections.initialStates.size() * sizeof ( InitialState ) );
+
+    if ( offset > UINT32_MAX )
+    {
+        LOG ( "Binary replay too large: %llu bytes", offset );
+        return false;
+    }
+
+    header.fileSize = offset;
+
+    ofstream fout ( file.c_str(), ios::out | ios::binary );
+
+    if ( ! fout.good() )
+    {
+        LOG ( "Failed to open '%s'", file );
+        return false;
+    }
+
+    const auto writeSection = [&] ( uint32_t sectionOffset, const void *data, size_t bytes )
+    {
+        static const char zeros[4] = { 0, 0, 0, 0 };
+
+        ASSERT ( uint64_t ( fout.tellp() ) <= sectionOffset );
+        fout.write ( zeros, sectionOffset - uint64_t ( fout.tellp() ) );
+        fout.write ( ( const char * ) data, bytes );
+    };
+
+    fout.write ( ( const char * ) &header, sizeof ( header ) );
+
+    writeSection ( header.indexesOffset, sections.indexes.data(), sections.indexes.size() * sizeof ( Index ) );
+    writeSection ( header.p1Offset, sections.p1.data(), sections.p1.size() * sizeof ( uint16_t ) );
+    writeSection ( header.p2Offset, sections.p2.data(), sections.p2.size() * sizeof ( uint16_t ) );
+    writeSection ( header.rngStatesOffset, sections.rngStates.data(), sections.rngStates.size() * sizeof ( RngState ) );
+    writeSection ( header.rollbacksOffset, sections.rollbacks.data(), sections.rollbacks.size() * sizeof ( Rollback ) );
+    writeSection ( header.reinputsOffset, sections.reinputs.data(), sections.reinputs.size() * sizeof ( Reinput ) );
+    writeSection ( header.initialStatesOffset, sections.initialStates.data(),
+                   sections.initialStates.size() * sizeof ( InitialState ) );
+    writeSection ( header.fileSize, 0, 0 );
+
+    const bool good = fout.good();
+    fout.close();
+    return good;
+}
+
+bool BinaryReplay::isBinaryReplay ( const string& file )
+{
+    ifstream fin ( file.c_str(), ios::in | ios::binary );
+
+    uint32_t magic = 0;
+    fin.read ( ( char * ) &magic, sizeof ( magic ) );
+
+    return ( fin.good() && magic == BINARY_REPLAY_MAGIC );
+}
+
+bool BinaryReplay::open ( const string& file )
+{
+    close();
+
+    if ( ! _file.open ( file ) )
+        return false;
+
+    const size_t size = _file.size();
+
+    if ( size < sizeof ( Header ) )
+    {
+        LOG ( "'%s' is too small for a binary replay", file );
+        close();
+        return false;
+    }
+
+    memcpy ( &_header, _file.data(), sizeof ( Header ) );
+
+    if ( _header.magic != BINARY_REPLAY_MAGIC || _header.version != BINARY_REPLAY_VERSION || _header.fileSize != size )
+    {
+        LOG ( "'%s' is not a version %u binary replay", file, BINARY_REPLAY_VERSION );
+        close();
+        return false;
+    }
+
+    bool good = checkSection ( _header.indexesOffset, _header.numIndexes, sizeof ( Index ), size )
+                && checkSection ( _header.p1Offset, _header.numFrames, sizeof ( uint16_t ), size )
+                && checkSection ( _header.p2Offset, _header.numFrames, sizeof ( uint16_t ), size )
+                && checkSection ( _header.rngStatesOffset, _header.numRngStates, sizeof ( RngState ), size )
+                && checkSection ( _header.rollbacksOffset, _header.numRollbacks, sizeof ( Rollback ), size )
+                && checkSection ( _header.reinputsOffset, _header.numReinputs, sizeof ( Reinput ), size )
+                && checkSection ( _header.initialStatesOffset, _header.numInitialStates,
+                                  sizeof ( InitialState ), size );
+
+    // The index table is small, so check every index once here instead of on each lookup
+    for ( uint32_t i = 0; good && i < _header.numIndexes; ++i )
+    {
+        const Index& index = getSection<Index> ( _header.indexesOffset ) [i];
+
+        good = checkRange ( index.firstFrame, index.numFrames, _header.numFrames )
+               && checkRange ( index.firstRollback, index.numRollbacks, _header.numRollbacks )
+               && ( index.rngState == BINARY_REPLAY_NONE || index.rngState < _header.numRngStates );
+    }
+
+    if ( ! good )
+    {
+        LOG ( "'%s' has invalid sections", file );
+        close();
+        return false;
+    }
+
+    LOG ( "Mapped '%s': %u indexes; %u frames; %u rollback frames; %u reinputs",
+          file, _header.numIndexes, _header.numFrames, _header.numRollbacks, _header.numReinputs );
+    return true;
+}
+
+void BinaryReplay::close()
+{
+    _file.close();
+    _header = Header();
+}
+
+const BinaryReplay::Index *BinaryReplay::getIndex ( uint32_t index ) const
+{
+    if ( index >= _header.numIndexes )
+        return 0;
+
+    return &getSection<Index> ( _header.indexesOffset ) [index];
+}
+
+bool BinaryReplay::getInputs ( IndexedFrame indexedFrame, uint16_t& p1, uint16_t& p2 ) const
+{
+    const Index *index = getIndex ( indexedFrame.parts.index );
+
+    if ( ! index || indexedFrame.parts.frame >= index->numFrames )
+        return false;
+
+    const uint32_t row = index->firstFrame + indexedFrame.parts.frame;
+
+    p1 = getSection<uint16_t> ( _header.p1Offset ) [row];
+    p2 = getSection<uint16_t> ( _header.p2Offset ) [row];
+    return true;
+}
+
+span<const BinaryReplay::Rollback> BinaryReplay::getRollbacks ( uint32_t index ) const
+{
+    const Index *row = getIndex ( index );
+
+    if ( ! row )
+        return {};
+
+    return { getSection<Rollback> ( _header.rollbacksOffset ) + row->firstRollback, row->numRollbacks };
+}
+
+const BinaryReplay::Rollback *BinaryReplay::findRollback ( IndexedFrame indexedFrame ) const
+{
+    const span<const Rollback> rollbacks = getRollbacks ( indexedFrame.parts.index );
+
+    const auto it = lower_bound ( rollbacks.begin(), rollbacks.end(), indexedFrame.parts.frame,
+                                  [] ( const Rollback& rollback, uint32_t frame ) { return rollback.frame < frame; } );
+
+    if ( it == rollbacks.end() || it->frame != indexedFrame.parts.frame )
+        return 0;
+
+    return &*it;
+}
+
+IndexedFrame BinaryReplay::getRollbackTarget ( IndexedFrame indexedFrame ) const
+{
+    const Rollback *rollback = findRollback ( indexedFrame );
+
+    if ( ! rollback )
+        return MaxIndexedFrame;
+
+    return {{ rollback->targetFrame, rollback->targetIndex }};
+}
+
+span<const BinaryReplay::Reinput> BinaryReplay::getReinputs ( IndexedFrame indexedFrame ) const
+{
+    const Rollback *rollback = findRollback ( indexedFrame );
+
+    if ( ! rollback )
+        return {};
+
+    return getReinputs ( *rollback );
+}
+
+span<const BinaryReplay::Reinput> BinaryReplay::getReinputs ( const Rollback& rollback ) const
+{
+    if ( ! checkRange ( rollback.firstReinput, rollback.numReinputs, _header.numReinputs ) )
+    {
+        LOG ( "Invalid reinputs for frame %u", rollback.frame );
+        return {};
+    }
+
+    return { getSection<Reinput> ( _header.reinputsOffset ) + rollback.firstReinput, rollback.numReinputs };
+}
+
+const BinaryReplay::RngState *BinaryReplay::getRngState ( uint32_t index ) const
+{
+    const Index *row = getIndex ( index );
+
+    if ( ! row || row->rngState == BINARY_REPLAY_NONE )
+        return 0;
+
+    return &getSection<RngState> ( _header.rngStatesOffset ) [row->rngState];
+}
+
+span<const BinaryReplay::InitialState> BinaryReplay::getInitialStates() const
+{
+    if ( ! isOpen() )
+        return {};
+
+    return { getSection<InitialState> ( _header.initialStatesOffset ), _header.numInitialStates };
+}
@@ -0,0 +1,163 @@
+#pragma once
+
+#include "Constants.hpp"
+#include "MappedFile.hpp"
+
+#include <array>
+#include <string>
+#include <vector>
+#include <span>
+#include <cstdint>
+
+
+// Magic number at the start of a binary replay file
+#define BINARY_REPLAY_MAGIC     ( 0x52434343 ) // "CCCR"
+
+// Current binary replay format version
+#define BINARY_REPLAY_VERSION   ( 1 )
+
+// Value of an unset field in a binary replay file
+#define BINARY_REPLAY_NONE      ( 0xFFFFFFFF )
+
+
+// Compact binary form of a replay sync log, loaded by memory-mapping the whole file.
+//
+// The file is a header followed by fixed-width sections, each 4-byte aligned:
+//   - one Index row per index, pointing into the other sections;
+//   - the p1 and p2 input columns, one uint16_t per frame, the frames of each index are contiguous;
+//   - one raw RngState per index that has one;
+//   - one Rollback row per frame that rolled back, sorted by frame and pointing into the Reinput table;
+//   - the Reinput table, the re-run inputs of each rollback are contiguous;
+//   - one InitialState row per loading screen.
+//
+// Lookups by IndexedFrame only touch the Index row and the rows of that index, so only the pages that are used are
+// read from disk.
+class BinaryReplay
+{
+public:
+
+    struct Header
+    {
+        uint32_t magic = BINARY_REPLAY_MAGIC, version = BINARY_REPLAY_VERSION;
+
+        // Number of rows in each section
+        uint32_t numIndexes = 0, numFrames = 0, numRngStates = 0, numRollbacks = 0, numReinputs = 0;
+        uint32_t numInitialStates = 0;
+
+        // Byte offset of each section from the start of the file
+        uint32_t indexesOffset = 0, p1Offset = 0, p2Offset = 0, rngStatesOffset = 0, rollbacksOffset = 0;
+        uint32_t reinputsOffset = 0, initialStatesOffset = 0;
+
+        // Total size of the file
+        uint32_t fileSize = 0;
+    };
+
+    struct Index
+    {
+        uint32_t gameMode = 0;
+
+        // NetplayState value, BINARY_REPLAY_NONE if no state was logged for this index
+        uint32_t netplayState = BINARY_REPLAY_NONE;
+
+        // First row and number of rows in the input columns, row firstFrame + i is frame i
+        uint32_t firstFrame = 0, numFrames = 0;
+
+        // First row and number of rows in the rollback table
+        uint32_t firstRollback = 0, numRollbacks = 0;
+
+        // Row in the RNG state table, BINARY_REPLAY_NONE if this index has no RngState
+        uint32_t rngState = BINARY_REPLAY_NONE;
+    };
+
+    struct RngState
+    {
+        uint32_t rngState0 = 0, rngState1 = 0, rngState2 = 0;
+        std::array<char, CC_RNG_STATE3_SIZE> rngState3 = {};
+    };
+
+    struct Rollback
+    {
+        // Frame that rolled back
+        uint32_t frame = 0;
+
+        // Frame rolled back to
+        uint32_t targetFrame = BINARY_REPLAY_NONE, targetIndex = BINARY_REPLAY_NONE;
+
+        // First row and number of rows in the reinput table
+        uint32_t firstReinput = 0, numReinputs = 0;
+    };
+
+    struct Reinput
+    {
+        uint32_t frame, index;
+        uint16_t p1, p2;
+    };
+
+    struct InitialState
+    {
+        uint32_t index = 0;
+        std::array<uint8_t, 2> chara = {{ 0, 0 }}, moon = {{ 0, 0 }}, color = {{ 0, 0 }};
+        std::array<uint8_t, 2> padding = {{ 0, 0 }};
+    };
+
+    // The contents of each section, used to write a binary replay file
+    struct Sections
+    {
+        std::vector<Index> indexes;
+        std::vector<uint16_t> p1, p2;
+        std::vector<RngState> rngStates;
+        std::vector<Rollback> rollbacks;
+        std::vector<Reinput> reinputs;
+        std::vector<InitialState> initialStates;
+    };
+
+    // Write the sections to a binary replay file
+    static bool write ( const std::string& file, const Sections& sections );
+
+    // Check if the file starts with the binary replay magic number
+    static bool isBinaryReplay ( const std::string& file );
+
+    // Map a binary replay file, returns false if the file can't be mapped or the sections are invalid
+    bool open ( const std::string& file );
+
+    void close();
+
+    bool isOpen() const { return _file.isOpen(); }
+
+    uint32_t getNumIndexes() const { return _header.numIndexes; }
+
+    // Get the row of the given index, 0 if out of range
+    const Index *getIndex ( uint32_t index ) const;
+
+    // Get the inputs of the given frame, returns false if the frame is not in the replay
+    bool getInputs ( IndexedFrame indexedFrame, uint16_t& p1, uint16_t& p2 ) const;
+
+    // Get the rollback rows of the given index, sorted by frame
+    std::span<const Rollback> getRollbacks ( uint32_t index ) const;
+
+    // Get the frame rolled back to on the given frame, MaxIndexedFrame if it didn't roll back
+    IndexedFrame getRollbackTarget ( IndexedFrame indexedFrame ) const;
+
+    // Get the re-run inputs of the rollback on the given frame
+    std::span<const Reinput> getReinputs ( IndexedFrame indexedFrame ) const;
+
+    // Get the re-run inputs of the given rollback row
+    std::span<const Reinput> getReinputs ( const Rollback& rollback ) const;
+
+    // Get the RngState of the given index, 0 if it doesn't have one
+    const RngState *getRngState ( uint32_t index ) const;
+
+    std::span<const InitialState> getInitialStates() const;
+
+private:
+
+    MappedFile _file;
+
+    Header _header;
+
+    // Find the rollback row of the given frame, 0 if it didn't roll back
+    const Rollback *findRollback ( IndexedFrame indexedFrame ) const;
+
+    template<typename T>
+    const T *getSection ( uint32_t offset ) const { return ( const T * ) ( _file.data() + offset ); }
+};
@@ -0,0 +1,39 @@
+#include "BroadcastCache.hpp"
+#include "Logger.hpp"
+
+using namespace std;
+
+
+const MsgPtr& BroadcastCache::get ( const MsgPtr& msg, IndexedFrame key )
+{
+    if ( ! msg )
+        return msg;
+
+    MsgPtr& cached = _messages[make_pair ( key.value, msg->getMsgType() )];
+
+    if ( cached )
+    {
+#ifndef RELEASE
+        ++_hits;
+#endif // NOT RELEASE
+        return cached;
+    }
+
+#ifndef RELEASE
+    ++_misses;
+#endif // NOT RELEASE
+
+    cached = msg;
+    ::Protocol::encodeShared ( cached );
+    return cached;
+}
+
+void BroadcastCache::eraseBefore ( IndexedFrame key )
+{
+    _messages.erase ( _messages.begin(), _messages.lower_bound ( make_pair ( key.value, MsgType::FirstType ) ) );
+}
+
+void BroadcastCache::clear()
+{
+    _messages.clear();
+}
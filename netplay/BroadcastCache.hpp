@@ -0,0 +1,50 @@
+#pragma once
+
+#include "Protocol.hpp"
+#include "Constants.hpp"
+
+#include <map>
+#include <utility>
+#include <cstdint>
+
+
+// Cache of the messages broadcast to every spectator, keyed by message type and IndexedFrame.
+//
+// Spectators at the same position are sent byte-identical messages, so each message is only encoded and hashed once,
+// the first time it is needed. Every spectator after that is sent the same cached message, which carries its encoded
+// bytes (see Protocol::encodeShared), so each socket just sends a reference to the same buffer.
+class BroadcastCache
+{
+public:
+
+    // Get the cached message of the same type for the given key, otherwise encode and cache the given message.
+    // Returns the message that should be sent, which is not necessarily the given message.
+    const MsgPtr& get ( const MsgPtr& msg, IndexedFrame key );
+
+    // Erase cached messages with keys before the given IndexedFrame
+    void eraseBefore ( IndexedFrame key );
+
+    // Erase all cached messages
+    void clear();
+
+    // Number of cached messages
+    size_t size() const { return _messages.size(); }
+
+#ifndef RELEASE
+    // Number of times a cached message was reused, and number of messages encoded
+    size_t getHits() const { return _hits; }
+    size_t getMisses() const { return _misses; }
+
+    // Reset the hit and miss counts
+    void resetStats() { _hits = _misses = 0; }
+#endif // NOT RELEASE
+
+private:
+
+    // Mapping: { IndexedFrame, MsgType } -> message with cached encoded bytes
+    std::map<std::pair<uint64_t, MsgType>, MsgPtr> _messages;
+
+#ifndef RELEASE
+    size_t _hits = 0, _misses = 0;
+#endif // NOT RELEASE
+};
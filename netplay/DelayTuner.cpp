@@ -0,0 +1,167 @@
+#include "DelayTuner.hpp"
+
+#include <cmath>
+#include <algorithm>
+
+using namespace std;
+
+
+// Number of samples that would stall with the given settings
+static uint32_t getStalled ( const vector<uint32_t>& latency, uint8_t delay, uint8_t rollback )
+{
+    uint32_t stalled = 0;
+
+    for ( size_t i = delay + rollback + 1; i < latency.size(); ++i )
+        stalled += latency[i];
+
+    return stalled;
+}
+
+
+string DelayTuner::Decision::str() const
+{
+    return format ( "delay=%u; rollback=%u; samples=%u; currentCost=%llu; bestCost=%llu; changed=%d",
+                    delay, rollback, samples, currentCost, bestCost, changed );
+}
+
+void DelayTuner::addRoundTrip ( uint32_t rttMs )
+{
+    _latency.add ( getLatencyFrames ( rttMs ) );
+    _rttSum += rttMs;
+    _rttSumSq += uint64_t ( rttMs ) * rttMs;
+}
+
+vector<uint32_t> DelayTuner::getLatency() const
+{
+    vector<uint32_t> latency ( DELAY_TUNER_BUCKETS );
+
+    for ( size_t i = 0; i < latency.size(); ++i )
+        latency[i] = _latency.bucket ( i );
+
+    return latency;
+}
+
+double DelayTuner::getRttMean() const
+{
+    if ( _latency.count() == 0 )
+        return 0;
+
+    return double ( _rttSum ) / _latency.count();
+}
+
+double DelayTuner::getRttJitter() const
+{
+    if ( _latency.count() == 0 )
+        return 0;
+
+    const double mean = getRttMean();
+
+    return sqrt ( max ( 0.0, double ( _rttSumSq ) / _latency.count() - mean * mean ) );
+}
+
+void DelayTuner::reset()
+{
+    _latency.reset();
+    _rttSum = _rttSumSq = 0;
+}
+
+string DelayTuner::str ( const vector<uint32_t>& latency )
+{
+    string str;
+
+    for ( size_t i = 0; i < latency.size(); ++i )
+    {
+        if ( ! latency[i] )
+            continue;
+
+        if ( ! str.empty() )
+            str += ' ';
+
+        str += format ( "%u:%u", i, latency[i] );
+    }
+
+    return str;
+}
+
+uint32_t DelayTuner::getLatencyFrames ( uint32_t rttMs )
+{
+    // Half the round trip time at 60 fps, rounded up
+    return ( uint64_t ( rttMs ) * 3 + 99 ) / 100;
+}
+
+uint64_t DelayTuner::getCost ( const vector<uint32_t>& latency, uint8_t delay, uint8_t rollback )
+{
+    uint64_t cost = 0;
+
+    for ( size_t i = 0; i < latency.size(); ++i )
+    {
+        const uint32_t depth = ( i > delay ? i - delay : 0 );
+        const uint32_t rolledBack = min<uint32_t> ( depth, rollback );
+        const uint32_t stalled = depth - rolledBack;
+
+        cost += uint64_t ( latency[i] ) * ( DELAY_TUNER_DELAY_COST * delay
+                                            + DELAY_TUNER_ROLLBACK_COST * rolledBack
+                                            + DELAY_TUNER_STALL_COST * stalled );
+    }
+
+    return cost;
+}
+
+DelayTuner::Decision DelayTuner::decide ( const vector<uint32_t>& local, const vector<uint32_t>& remote,
+                                          uint8_t delay, uint8_t rollback, uint8_t maxDelay, uint8_t maxRollback )
+{
+    // Summing is symmetric, so both sides get the same merged samples
+    vector<uint32_t> merged ( max ( local.size(), remote.size() ), 0 );
+
+    for ( size_t i = 0; i < local.size(); ++i )
+        merged[i] += local[i];
+
+    for ( size_t i = 0; i < remote.size(); ++i )
+        merged[i] += remote[i];
+
+    Decision decision;
+    decision.delay = delay;
+    decision.rollback = rollback;
+
+    for ( uint32_t count : merged )
+        decision.samples += count;
+
+    decision.currentCost = decision.bestCost = getCost ( merged, delay, rollback );
+
+    if ( decision.samples < DELAY_TUNER_MIN_SAMPLES )
+        return decision;
+
+    // Find the cheapest delay, preferring the lower delay if tied
+    uint8_t bestDelay = 0;
+    uint64_t bestCost = UINT64_MAX;
+
+    for ( uint8_t d = 0; d <= maxDelay; ++d )
+    {
+        const uint64_t cost = getCost ( merged, d, rollback );
+
+        if ( cost < bestCost )
+        {
+            bestDelay = d;
+            bestCost = cost;
+        }
+    }
+
+    // Hysteresis, only change if the improvement is significant
+    if ( bestCost + uint64_t ( DELAY_TUNER_HYSTERESIS ) * decision.samples <= decision.currentCost )
+        decision.delay = bestDelay;
+
+    // Widen the rollback window if too many samples would still stall, but never narrow it
+    if ( rollback )
+    {
+        while ( decision.rollback < maxRollback
+                && 100 * getStalled ( merged, decision.delay, decision.rollback )
+                > DELAY_TUNER_MAX_STALL_PCT * decision.samples )
+        {
+            ++decision.rollback;
+        }
+    }
+
+    decision.bestCost = getCost ( merged, decision.delay, decision.rollback );
+    decision.changed = ( decision.delay != delay || decision.rollback != rollback );
+    return decision;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "Histogram.hpp"
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+
+// Number of one way latency buckets, in frames
+#define DELAY_TUNER_BUCKETS         ( 16 )
+
+// Minimum number of latency samples from both sides combined, before changing anything
+#define DELAY_TUNER_MIN_SAMPLES     ( 20 )
+
+// Cost of each frame of input delay, rolled back frame, and stalled frame, in quarter frames.
+// A rolled back frame costs slightly more than a delayed frame, so a constant latency is covered with delay.
+// A stalled frame is much worse, since the game visibly stops.
+#define DELAY_TUNER_DELAY_COST      ( 4 )
+#define DELAY_TUNER_ROLLBACK_COST   ( 5 )
+#define DELAY_TUNER_STALL_COST      ( 16 )
+
+// The average cost per sample must improve by at least this much to change the delay (half a frame)
+#define DELAY_TUNER_HYSTERESIS      ( 2 )
+
+// The rollback window is widened if more than this percent of samples would stall
+#define DELAY_TUNER_MAX_STALL_PCT   ( 2 )
+
+
+// Chooses the input delay and rollback window from the measured network latency.
+//
+// Round trip times are sampled during the match, and collected into a histogram of one way latency in frames.
+// At a safe point (between rounds), both sides exchange their histograms and call decide with the same merged
+// samples and current settings, so both sides deterministically agree on the new settings.
+class DelayTuner
+{
+public:
+
+    // The result of decide, with the metrics that drove it
+    struct Decision
+    {
+        // New delay and rollback
+        uint8_t delay = 0, rollback = 0;
+
+        // Number of samples from both sides
+        uint32_t samples = 0;
+
+        // Total cost of the current and new settings
+        uint64_t currentCost = 0, bestCost = 0;
+
+        // Indicates if the settings should be changed
+        bool changed = false;
+
+        std::string str() const;
+    };
+
+    // Add a round trip time sample in milliseconds
+    void addRoundTrip ( uint32_t rttMs );
+
+    // Get the one way latency histogram to send to the remote side
+    std::vector<uint32_t> getLatency() const;
+
+    // Get the number of samples
+    size_t count() const { return _latency.count(); }
+
+    // Get the mean and standard deviation of the round trip time in milliseconds
+    double getRttMean() const;
+    double getRttJitter() const;
+
+    // Clear all samples
+    void reset();
+
+    // Format the non-empty buckets of a latency histogram, eg. "2:40 3:25 9:3"
+    static std::string str ( const std::vector<uint32_t>& latency );
+
+    // Get the one way latency in frames for a round trip time, rounded up
+    static uint32_t getLatencyFrames ( uint32_t rttMs );
+
+    // Get the total cost of the given settings over a latency histogram
+    static uint64_t getCost ( const std::vector<uint32_t>& latency, uint8_t delay, uint8_t rollback );
+
+    // Choose new settings from the local and remote latency histograms, the result is the same if they are swapped.
+    // A rollback of 0 means delay based netplay, which is never changed to rollback.
+    static Decision decide ( const std::vector<uint32_t>& local, const std::vector<uint32_t>& remote,
+                             uint8_t delay, uint8_t rollback, uint8_t maxDelay, uint8_t maxRollback );
+
+private:
+
+    // One way latency in frames
+    Histogram<DELAY_TUNER_BUCKETS> _latency;
+
+    // Sum and sum of squares of the round trip times
+    uint64_t _rttSum = 0, _rttSumSq = 0;
+};
@@ -0,0 +1,205 @@
+#include "InputHistory.hpp"
+#include "Logger.hpp"
+
+#include <algorithm>
+
+using namespace std;
+
+
+// Shift the plane towards older frames and set the bit for the latest frame
+template<typename Plane>
+static void shiftIn ( Plane& plane, bool bit )
+{
+    for ( size_t w = plane.size() - 1; w > 0; --w )
+        plane[w] = ( plane[w] << 1 ) | ( plane[w - 1] >> 63 );
+
+    plane[0] = ( plane[0] << 1 ) | ( bit ? 1 : 0 );
+}
+
+// Shift the plane towards newer frames by n frames, discarding the latest n frames
+template<typename Plane>
+static void shiftOut ( Plane& plane, uint32_t n )
+{
+    const size_t words = n / 64, bits = n % 64;
+
+    for ( size_t w = 0; w < plane.size(); ++w )
+    {
+        const uint64_t lo = ( w + words < plane.size() ? plane[w + words] : 0 );
+        const uint64_t hi = ( w + words + 1 < plane.size() ? plane[w + words + 1] : 0 );
+
+        plane[w] = ( bits ? ( lo >> bits ) | ( hi << ( 64 - bits ) ) : lo );
+    }
+}
+
+
+void InputHistory::push ( uint16_t input )
+{
+    const uint16_t buttons = ( input >> 4 );
+    const uint16_t direction = ( input & 0xF );
+
+    for ( size_t i = 0; i < _buttons.size(); ++i )
+        shiftIn ( _buttons[i], ( buttons >> i ) & 1 );
+
+    for ( size_t i = 0; i < _directions.size(); ++i )
+        shiftIn ( _directions[i], i == direction );
+
+    ++_end;
+    _size = min<uint32_t> ( _size + 1, INPUT_HISTORY_FRAMES );
+}
+
+void InputHistory::erase ( uint32_t frame )
+{
+    if ( frame >= _end )
+        return;
+
+    const uint32_t n = _end - frame;
+
+    if ( n >= _size )
+    {
+        clear ( frame );
+        return;
+    }
+
+    for ( Plane& plane : _buttons )
+        shiftOut ( plane, n );
+
+    for ( Plane& plane : _directions )
+        shiftOut ( plane, n );
+
+    _end = frame;
+    _size -= n;
+}
+
+void InputHistory::clear ( uint32_t frame )
+{
+    _buttons.fill ( Plane() );
+    _directions.fill ( Plane() );
+    _end = frame;
+    _size = 0;
+}
+
+bool InputHistory::contains ( uint32_t start, uint32_t end ) const
+{
+    end = min ( end, _end );
+
+    return ( start >= end || end <= _size );
+}
+
+bool InputHistory::hasButton ( uint16_t buttons, uint32_t start, uint32_t end ) const
+{
+    ASSERT ( contains ( start, end ) );
+
+    const Plane plane = getButtons ( buttons );
+
+    for ( size_t w = 0; w < Words; ++w )
+    {
+        if ( plane[w] & getMask ( w, start, end ) )
+            return true;
+    }
+
+    return false;
+}
+
+bool InputHistory::heldButton ( uint16_t buttons, uint32_t start, uint32_t end ) const
+{
+    if ( start >= end )
+        return true;
+
+    if ( end > _end )
+        return false;
+
+    ASSERT ( contains ( start, end ) );
+
+    const Plane plane = getButtons ( buttons );
+
+    for ( size_t w = 0; w < Words; ++w )
+    {
+        const uint64_t mask = getMask ( w, start, end );
+
+        if ( ( plane[w] & mask ) != mask )
+            return false;
+    }
+
+    return true;
+}
+
+bool InputHistory::hasDirection ( uint16_t directions, uint32_t start, uint32_t end ) const
+{
+    ASSERT ( contains ( start, end ) );
+
+    Plane plane = Plane();
+
+    for ( size_t i = 0; i < _directions.size(); ++i )
+    {
+        if ( ! ( directions & ( 1u << i ) ) )
+            continue;
+
+        for ( size_t w = 0; w < Words; ++w )
+            plane[w] |= _directions[i][w];
+    }
+
+    for ( size_t w = 0; w < Words; ++w )
+    {
+        if ( plane[w] & getMask ( w, start, end ) )
+            return true;
+    }
+
+    return false;
+}
+
+bool InputHistory::pressedWithin ( uint16_t buttons, uint32_t n ) const
+{
+    n = min ( n, _end );
+
+    // The frame before the oldest frame in the history is unknown, unless it would be before frame 0
+    if ( _size < _end )
+        n = min ( n, _size ? _size - 1 : 0 );
+
+    for ( size_t i = 0; i < _buttons.size(); ++i )
+    {
+        if ( ! ( buttons & ( 1u << i ) ) )
+            continue;
+
+        const Plane& plane = _buttons[i];
+
+        for ( size_t w = 0; w < Words; ++w )
+        {
+            // Bit j of previous is the button one frame before bit j of plane
+            const uint64_t previous = ( plane[w] >> 1 ) | ( w + 1 < Words ? plane[w + 1] << 63 : 0 );
+
+            if ( plane[w] & ~previous & getMask ( w, 0, n ) )
+                return true;
+        }
+    }
+
+    return false;
+}
+
+InputHistory::Plane InputHistory::getButtons ( uint16_t buttons ) const
+{
+    Plane plane = Plane();
+
+    for ( size_t i = 0; i < _buttons.size(); ++i )
+    {
+        if ( ! ( buttons & ( 1u << i ) ) )
+            continue;
+
+        for ( size_t w = 0; w < Words; ++w )
+            plane[w] |= _buttons[i][w];
+    }
+
+    return plane;
+}
+
+uint64_t InputHistory::getMask ( size_t word, uint32_t start, uint32_t end )
+{
+    const uint32_t first = max<uint32_t> ( start, word * 64 );
+    const uint32_t last = min<uint32_t> ( end, ( word + 1 ) * 64 );
+
+    if ( first >= last )
+        return 0;
+
+    const uint32_t bits = last - first;
+
+    return ( bits == 64 ? ~0ull : ( ( 1ull << bits ) - 1 ) ) << ( first - word * 64 );
+}
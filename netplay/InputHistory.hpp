@@ -0,0 +1,72 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+
+// Number of frames of history kept, must be a multiple of 64
+#define INPUT_HISTORY_FRAMES ( 256 )
+
+
+// Rolling history of a single player's inputs, stored as one bit-plane per button and one per direction.
+// Bit i of each plane is the input i frames before the latest frame, so each query over a window of frames is a few
+// mask operations regardless of the window length.
+//
+// Queries take the window of frames [start, end) counting backwards from the latest frame, ie 0 is the latest frame.
+// Frames before frame 0 don't exist, so they are never pressed.
+class InputHistory
+{
+public:
+
+    // Add the input for the next frame
+    void push ( uint16_t input );
+
+    // Erase the inputs from the given frame onwards, so they can be pushed again
+    void erase ( uint32_t frame );
+
+    // Clear the history, the next pushed input is for the given frame
+    void clear ( uint32_t frame = 0 );
+
+    // Get the frame after the latest frame
+    uint32_t getEndFrame() const { return _end; }
+
+    // Check if the frames in the given window are in the history, older frames are forgotten
+    bool contains ( uint32_t start, uint32_t end ) const;
+
+    // Check if any of the buttons were pressed on any frame
+    bool hasButton ( uint16_t buttons, uint32_t start, uint32_t end ) const;
+
+    // Check if any of the buttons were pressed on every frame, false if the window goes back before frame 0
+    bool heldButton ( uint16_t buttons, uint32_t start, uint32_t end ) const;
+
+    // Check if any of the directions were held on any frame, each direction d is given as the bit ( 1 << d )
+    bool hasDirection ( uint16_t directions, uint32_t start, uint32_t end ) const;
+
+    // Check if any of the buttons went from released to pressed within the last n frames
+    bool pressedWithin ( uint16_t buttons, uint32_t n ) const;
+
+private:
+
+    static const size_t Words = INPUT_HISTORY_FRAMES / 64;
+
+    typedef std::array<uint64_t, Words> Plane;
+
+    // One plane per button bit, ie input >> 4
+    std::array<Plane, 12> _buttons = {};
+
+    // One plane per direction value, ie input & 0xF
+    std::array<Plane, 16> _directions = {};
+
+    // The frame after the latest frame
+    uint32_t _end = 0;
+
+    // Number of frames in the history, at most INPUT_HISTORY_FRAMES
+    uint32_t _size = 0;
+
+    // OR together the planes of the given buttons
+    Plane getButtons ( uint16_t buttons ) const;
+
+    // Get the bits of the given word that are in the window [start, end)
+    static uint64_t getMask ( size_t word, uint32_t start, uint32_t end );
+};
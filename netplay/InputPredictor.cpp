@@ -0,0 +1,111 @@
+#include "InputPredictor.hpp"
+#include "Logger.hpp"
+
+using namespace std;
+
+
+static uint32_t getContext ( uint16_t previous, uint16_t last )
+{
+    return ( uint32_t ( previous ) << 16 ) | last;
+}
+
+
+InputPredictor *InputPredictor::create ( InputPredictorType type )
+{
+    switch ( type.value )
+    {
+        case InputPredictorType::HoldLast:
+            return new HoldLastPredictor();
+
+        case InputPredictorType::HoldDirection:
+            return new HoldDirectionPredictor();
+
+        case InputPredictorType::Frequency:
+            return new FrequencyPredictor();
+
+        default:
+            ASSERT_IMPOSSIBLE;
+            return 0;
+    }
+}
+
+void FrequencyPredictor::add ( uint16_t input )
+{
+    if ( _count == 2 )
+    {
+        auto& candidates = _model[getContext ( _previous, _last )];
+
+        Candidate *replace = &candidates[0];
+
+        for ( Candidate& c : candidates )
+        {
+            if ( c.count && c.input == input )
+            {
+                replace = 0;
+
+                // Halve all the counts before overflowing, so the relative frequencies are kept
+                if ( c.count == UINT16_MAX )
+                {
+                    for ( Candidate& d : candidates )
+                        d.count /= 2;
+                }
+
+                ++c.count;
+                break;
+            }
+
+            if ( c.count < replace->count )
+                replace = &c;
+        }
+
+        // Replace the least frequent input
+        if ( replace )
+        {
+            replace->input = input;
+            replace->count = 1;
+        }
+    }
+    else
+    {
+        ++_count;
+    }
+
+    _previous = _last;
+    _last = input;
+}
+
+uint16_t FrequencyPredictor::predict ( uint16_t last ) const
+{
+    // The model only knows what comes after the last added input
+    if ( _count < 2 || last != _last )
+        return last;
+
+    const auto it = _model.find ( getContext ( _previous, _last ) );
+
+    if ( it == _model.end() )
+        return last;
+
+    const Candidate *best = 0;
+    uint16_t holdCount = 0;
+
+    for ( const Candidate& c : it->second )
+    {
+        if ( c.input == last )
+            holdCount = c.count;
+        else if ( ! best || c.count > best->count )
+            best = &c;
+    }
+
+    // Only predict a different input if it has been more frequent than holding the last input
+    if ( best && best->count >= FREQUENCY_PREDICTOR_MIN_COUNT && best->count > holdCount )
+        return best->input;
+
+    return last;
+}
+
+void FrequencyPredictor::reset()
+{
+    _model.clear();
+    _previous = _last = 0;
+    _count = 0;
+}
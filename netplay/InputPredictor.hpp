@@ -0,0 +1,88 @@
+#pragma once
+
+#include "Enum.hpp"
+#include "Controller.hpp"
+
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+
+
+// Max number of different next inputs counted after each context
+#define FREQUENCY_PREDICTOR_CANDIDATES  ( 4 )
+
+// Min number of times a next input must have been seen, to predict it instead of holding the last input
+#define FREQUENCY_PREDICTOR_MIN_COUNT   ( 3 )
+
+
+ENUM ( InputPredictorType, HoldLast, HoldDirection, Frequency );
+
+
+// Predicts the remote input after the last known input, when it hasn't arrived yet.
+// Every wrong prediction costs a rollback.
+class InputPredictor
+{
+public:
+
+    virtual ~InputPredictor() {}
+
+    // Add the next known input, in order
+    virtual void add ( uint16_t input ) {}
+
+    // Predict the input after the given last known input
+    virtual uint16_t predict ( uint16_t last ) const = 0;
+
+    // Forget everything, eg. at the start of each match
+    virtual void reset() {}
+
+    static InputPredictor *create ( InputPredictorType type );
+};
+
+
+// Repeat the last input
+class HoldLastPredictor : public InputPredictor
+{
+public:
+
+    uint16_t predict ( uint16_t last ) const override { return last; }
+};
+
+
+// Repeat the last direction and release all buttons, since buttons are usually pressed for a single frame
+class HoldDirectionPredictor : public InputPredictor
+{
+public:
+
+    uint16_t predict ( uint16_t last ) const override { return ( MASK_DIRS & last ); }
+};
+
+
+// Predict the most frequent input after the previous two inputs, learned during the match
+class FrequencyPredictor : public InputPredictor
+{
+public:
+
+    void add ( uint16_t input ) override;
+
+    uint16_t predict ( uint16_t last ) const override;
+
+    void reset() override;
+
+private:
+
+    // Number of times an input was seen after a context
+    struct Candidate
+    {
+        uint16_t input = 0;
+        uint16_t count = 0;
+    };
+
+    // Mapping: previous two inputs -> next inputs seen
+    std::unordered_map<uint32_t, std::array<Candidate, FREQUENCY_PREDICTOR_CANDIDATES>> _model;
+
+    // The last two added inputs
+    uint16_t _previous = 0, _last = 0;
+
+    // Number of added inputs, up to 2
+    uint8_t _count = 0;
+};
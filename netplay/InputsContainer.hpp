@@ -2,88 +2,189 @@
 
 #include "Constants.hpp"
 #include "Logger.hpp"
+#include "InputPredictor.hpp"
 
+#include <emmintrin.h>
+
+#include <deque>
+#include <memory>
 #include <vector>
 #include <algorithm>
+#include <type_traits>
+
+
+// Number of frames per block of inputs, must be a power of 2
+#define INPUTS_BLOCK_FRAMES ( 256 )
 
+// Number of blocks to allocate at once
+#define INPUTS_SLAB_BLOCKS  ( 32 )
 
+
+// Inputs stored by index:frame.
+//
+// Each index maps to a table of fixed size blocks of frames. Blocks are allocated from slabs and recycled through a
+// free list, so growing an index never reallocates or moves existing inputs, and evicting old indexes only returns
+// their blocks to the free list.
+//
+// Inputs past the end of an index are predicted from the last known input. A prediction doesn't change once it has
+// been read, until an input that differs from it arrives, so it is always what the game simulated with.
 template<typename T>
 class InputsContainer
 {
+    static_assert ( std::is_integral<T>::value, "Inputs are compared bytewise" );
+
 public:
 
     // Get a single input for the given index:frame, returns 0 if none.
     T get ( uint32_t index, uint32_t frame ) const
     {
-        if ( index >= _inputs.size() || _inputs[index].empty() )
+        if ( index >= _indexes.size() || _indexes[index].size == 0 )
             return lastInputBefore ( index );
 
-        if ( frame >= _inputs[index].size() )
-            return _inputs[index].back();
+        const Index& inputs = _indexes[index];
 
-        return _inputs[index][frame];
+        if ( frame >= inputs.size )
+        {
+            inputs.predictionUsed = true;
+            return inputs.predicted;
+        }
+
+        return inputs.at ( frame );
     }
 
     // Get n inputs starting from the given index:frame, ASSERTS if not enough.
     void get ( uint32_t index, uint32_t frame, T *t, size_t n ) const
     {
-        ASSERT ( index < _inputs.size() );
-        ASSERT ( frame + n <= _inputs[index].size() );
+        ASSERT ( index < _indexes.size() );
+        ASSERT ( frame + n <= _indexes[index].size );
+
+        const Index& inputs = _indexes[index];
+
+        for ( size_t i = 0, len; i < n; i += len )
+        {
+            len = inputs.contiguous ( frame + i, n - i );
 
-        std::copy ( _inputs[index].begin() + frame,
-                    _inputs[index].begin() + frame + n, t );
+            std::copy ( &inputs.at ( frame + i ), &inputs.at ( frame + i ) + len, t + i );
+        }
     }
 
     // Set a single input for the given index:frame, CANNOT change existing inputs.
     void set ( uint32_t index, uint32_t frame, T t )
     {
-        if ( _inputs.size() > index && _inputs[index].size() > frame )
+        if ( _indexes.size() > index && _indexes[index].size > frame )
             return;
 
         resize ( index, frame );
 
-        _inputs[index][frame] = t;
+        _indexes[index].write ( frame, t );
+
+        updatePrediction ( _indexes[index] );
     }
 
     // Assign a single input for the given index:frame, CAN change existing inputs
     void assign ( uint32_t index, uint32_t frame, T t )
     {
+        unconfirm ( index, frame );
         resize ( index, frame );
 
-        _inputs[index][frame] = t;
+        _indexes[index].write ( frame, t );
+
+        updatePrediction ( _indexes[index] );
     }
 
     // Fill n inputs with the same given value starting from the given index:frame, CAN change existing inputs.
     void set ( uint32_t index, uint32_t frame, T t, size_t n )
     {
+        unconfirm ( index, frame );
         resize ( index, frame, n );
 
-        std::fill ( _inputs[index].begin() + frame,
-                    _inputs[index].begin() + frame + n, t );
+        Index& inputs = _indexes[index];
+
+        for ( size_t i = 0, len; i < n; i += len )
+        {
+            len = inputs.contiguous ( frame + i, n - i );
+
+            std::fill ( &inputs.at ( frame + i ), &inputs.at ( frame + i ) + len, t );
+        }
+
+        if ( n > 0 && frame + n == inputs.size )
+            inputs.last = t;
+
+        updatePrediction ( inputs );
     }
 
     // Set n inputs starting from the given index:frame, CAN change existing inputs.
+    // Inputs that were already set this way can't change, so they are skipped without comparing or copying them.
     void set ( uint32_t index, uint32_t frame, const T *t, size_t n, uint32_t checkStartingFromIndex = UINT_MAX )
     {
+        const size_t confirmed = getConfirmed ( index, frame, n );
+
+#ifndef RELEASE
+        const size_t mismatch = ( confirmed ? findFirstStoredDifference ( _indexes[index], frame, t, confirmed ) : 0 );
+
+        if ( mismatch < confirmed )
+        {
+            LOG_AT ( LOG_LEVEL_WARN, LOG_CAT_NET, "Confirmed input changed: [%u:%u] 0x%X -> 0x%X",
+                     index, frame + mismatch, _indexes[index].at ( frame + mismatch ), t[mismatch] );
+        }
+#endif // NOT RELEASE
+
+        // The incoming inputs are all older than the confirmed inputs
+        if ( confirmed == n )
+            return;
+
+        frame += confirmed;
+        t += confirmed;
+        n -= confirmed;
+
+        bool changed = true;
+
         if ( index >= checkStartingFromIndex )
         {
-            IndexedFrame f;
-            size_t i;
+            const size_t i = findFirstChanged ( index, frame, t, n );
 
-            for ( i = 0, f = {{ frame, index }}; i < n; ++i, ++f.parts.frame )
-            {
-                if ( get ( f.parts.index, f.parts.frame ) == t[i] )
-                    continue;
+            // Indicate changed if the input is different from the last known input
+            changed = ( i < n );
 
-                // Indicate changed if the input is different from the last known input
+            if ( changed )
+            {
+                const IndexedFrame f = {{ uint32_t ( frame + i ), index }};
                 _lastChangedFrame.value = std::min ( _lastChangedFrame.value, f.value );
-                break;
             }
         }
 
+        // Extend the confirmed inputs if there is no gap
+        if ( index == _confirmedEnd.parts.index && frame <= _confirmedEnd.parts.frame )
+            _confirmedEnd.parts.frame = std::max<uint32_t> ( _confirmedEnd.parts.frame, frame + n );
+        else if ( index > _confirmedEnd.parts.index && frame == 0 )
+            _confirmedEnd = {{ uint32_t ( n ), index }};
+
+        const uint32_t oldSize = getEndFrame ( index );
+
         resize ( index, frame, n );
 
-        std::copy ( t, t + n, &_inputs[index][frame] );
+        Index& inputs = _indexes[index];
+
+        // Learn from new inputs in order
+        if ( _predictor && frame <= oldSize )
+        {
+            for ( size_t i = oldSize - frame; i < n; ++i )
+                _predictor->add ( t[i] );
+        }
+
+        for ( size_t i = 0, len; i < n; i += len )
+        {
+            len = inputs.contiguous ( frame + i, n - i );
+
+            std::copy ( t + i, t + i + len, &inputs.at ( frame + i ) );
+        }
+
+        if ( n > 0 && frame + n == inputs.size )
+            inputs.last = t[n - 1];
+
+        // Keep the prediction that was used, since the new inputs match it
+        if ( changed || ! inputs.predictionUsed )
+            updatePrediction ( inputs );
     }
 
     // Resize the container so that it can contain inputs up to index:frame+n.
@@ -91,65 +192,103 @@ public:
     {
         T last = 0;
 
-        if ( index >= _inputs.size() )
+        if ( index >= _indexes.size() )
         {
-            last = lastInputBefore ( _inputs.size() );
-            _inputs.resize ( index + 1 );
+            last = lastInputBefore ( _indexes.size() );
+            _indexes.resize ( index + 1 );
         }
-        else if ( ! _inputs[index].empty() )
+        else if ( _indexes[index].size > 0 )
+        {
+            last = _indexes[index].predicted;
+        }
+
+        Index& inputs = _indexes[index];
+
+        if ( frame + n <= inputs.size )
+            return;
+
+        const uint32_t end = frame + n;
+
+        while ( inputs.blocks.size() * INPUTS_BLOCK_FRAMES < end )
+            inputs.blocks.push_back ( allocateBlock() );
+
+        // New frames repeat the predicted input
+        for ( uint32_t i = inputs.size, len; i < end; i += len )
         {
-            last = _inputs[index].back();
+            len = inputs.contiguous ( i, end - i );
+
+            std::fill ( &inputs.at ( i ), &inputs.at ( i ) + len, last );
         }
 
-        if ( frame + n > _inputs[index].size() )
-            _inputs[index].resize ( frame + n, last );
+        if ( inputs.size == 0 )
+            inputs.predicted = last;
+
+        inputs.size = end;
+        inputs.last = last;
     }
 
     void clear()
     {
-        _inputs.clear();
+        for ( Index& inputs : _indexes )
+            freeBlocks ( inputs );
+
+        _indexes.clear();
+        _confirmedEnd.value = 0;
     }
 
     bool empty() const
     {
-        return _inputs.empty();
+        return _indexes.empty();
     }
 
     bool empty ( size_t index ) const
     {
-        if ( index >= _inputs.size() )
+        if ( index >= _indexes.size() )
             return true;
 
-        return _inputs[index].empty();
+        return ( _indexes[index].size == 0 );
     }
 
     uint32_t getEndIndex() const
     {
-        return _inputs.size();
+        return _indexes.size();
     }
 
     uint32_t getEndFrame() const
     {
-        if ( _inputs.empty() )
+        if ( _indexes.empty() )
             return 0;
 
-        return _inputs.back().size();
+        return _indexes.back().size;
     }
 
     uint32_t getEndFrame ( size_t index ) const
     {
-        if ( index >= _inputs.size() )
+        if ( index >= _indexes.size() )
             return 0;
 
-        return _inputs[index].size();
+        return _indexes[index].size;
     }
 
+    // Erase the given number of indexes from the front, so the remaining indexes shift down.
     void eraseIndexOlderThan ( size_t index )
     {
-        if ( index + 1 >= _inputs.size() )
-            _inputs.clear();
+        if ( index + 1 >= _indexes.size() )
+        {
+            clear();
+            return;
+        }
+
+        for ( size_t i = 0; i < index; ++i )
+        {
+            freeBlocks ( _indexes.front() );
+            _indexes.pop_front();
+        }
+
+        if ( _confirmedEnd.parts.index >= index )
+            _confirmedEnd.parts.index -= index;
         else
-            _inputs.erase ( _inputs.begin(), _inputs.begin() + index );
+            _confirmedEnd.value = 0;
     }
 
     IndexedFrame getLastChangedFrame() const
@@ -162,28 +301,242 @@ public:
         _lastChangedFrame = MaxIndexedFrame;
     }
 
+    // Set the predictor for inputs past the end, or 0 to repeat the last known input. Not owned by the container.
+    void setPredictor ( InputPredictor *predictor )
+    {
+        _predictor = predictor;
+    }
+
 private:
 
+    // Fixed size block of frames
+    struct Block
+    {
+        T inputs[INPUTS_BLOCK_FRAMES];
+    };
+
+    // Inputs of a single index
+    struct Index
+    {
+        // Table of blocks, block i contains frames [i * INPUTS_BLOCK_FRAMES, (i + 1) * INPUTS_BLOCK_FRAMES)
+        std::vector<Block *> blocks;
+
+        // Number of frames
+        uint32_t size = 0;
+
+        // The input at the last frame, only valid if size > 0
+        T last = 0;
+
+        // The input for frames past the end, only valid if size > 0
+        T predicted = 0;
+
+        // If the predicted input was read since it was last updated
+        mutable bool predictionUsed = false;
+
+        T& at ( uint32_t frame )
+        {
+            return blocks[frame / INPUTS_BLOCK_FRAMES]->inputs[frame % INPUTS_BLOCK_FRAMES];
+        }
+
+        const T& at ( uint32_t frame ) const
+        {
+            return blocks[frame / INPUTS_BLOCK_FRAMES]->inputs[frame % INPUTS_BLOCK_FRAMES];
+        }
+
+        // Get the number of frames up to n that are contiguous in memory, starting from the given frame
+        size_t contiguous ( uint32_t frame, size_t n ) const
+        {
+            return std::min<size_t> ( n, INPUTS_BLOCK_FRAMES - frame % INPUTS_BLOCK_FRAMES );
+        }
+
+        void write ( uint32_t frame, T t )
+        {
+            at ( frame ) = t;
+
+            if ( frame + 1 == size )
+                last = t;
+        }
+    };
+
+    static_assert ( ( INPUTS_BLOCK_FRAMES & ( INPUTS_BLOCK_FRAMES - 1 ) ) == 0,
+                    "INPUTS_BLOCK_FRAMES must be a power of 2" );
+
     // Mapping: index -> frame -> input
-    std::vector<std::vector<T>> _inputs;
+    std::deque<Index> _indexes;
+
+    // Memory for all the blocks
+    std::vector<std::unique_ptr<Block[]>> _slabs;
+
+    // Blocks that are not in use
+    std::vector<Block *> _freeBlocks;
 
     // Last frame of input that changed
     IndexedFrame _lastChangedFrame = MaxIndexedFrame;
 
+    // End of the inputs that were contiguously set from an array, only tracked for the latest index
+    IndexedFrame _confirmedEnd = {{ 0, 0 }};
+
+    // Predictor for inputs past the end
+    InputPredictor *_predictor = 0;
+
+    void updatePrediction ( Index& inputs )
+    {
+        if ( inputs.size == 0 )
+            return;
+
+        inputs.predicted = ( _predictor ? T ( _predictor->predict ( inputs.last ) ) : inputs.last );
+        inputs.predictionUsed = false;
+    }
+
+    // Get the number of confirmed inputs out of the n inputs starting from index:frame
+    size_t getConfirmed ( uint32_t index, uint32_t frame, size_t n ) const
+    {
+        if ( index != _confirmedEnd.parts.index || frame >= _confirmedEnd.parts.frame )
+            return 0;
+
+        return std::min<size_t> ( n, _confirmedEnd.parts.frame - frame );
+    }
+
+    // Inputs at index:frame and after may be changed, so they are no longer confirmed
+    void unconfirm ( uint32_t index, uint32_t frame )
+    {
+        if ( index == _confirmedEnd.parts.index && frame < _confirmedEnd.parts.frame )
+            _confirmedEnd.parts.frame = frame;
+    }
+
+    // Get the offset of the first input in t that differs from the known or predicted input at index:frame, or n
+    size_t findFirstChanged ( uint32_t index, uint32_t frame, const T *t, size_t n ) const
+    {
+        if ( index >= _indexes.size() || _indexes[index].size == 0 )
+            return findFirstNotEqual ( t, lastInputBefore ( index ), n );
+
+        const Index& inputs = _indexes[index];
+
+        const size_t stored = ( frame < inputs.size ? std::min<size_t> ( n, inputs.size - frame ) : 0 );
+
+        const size_t i = findFirstStoredDifference ( inputs, frame, t, stored );
+
+        if ( i < stored )
+            return i;
+
+        // Inputs past the end are compared against the predicted input
+        return i + findFirstNotEqual ( t + i, inputs.predicted, n - i );
+    }
+
+    // Get the offset of the first input in t that differs from the n stored inputs starting from frame, or n
+    static size_t findFirstStoredDifference ( const Index& inputs, uint32_t frame, const T *t, size_t n )
+    {
+        for ( size_t i = 0, len; i < n; i += len )
+        {
+            len = inputs.contiguous ( frame + i, n - i );
+
+            const size_t j = findFirstDifference ( &inputs.at ( frame + i ), t + i, len );
+
+            if ( j < len )
+                return i + j;
+        }
+
+        return n;
+    }
+
+    // Get the index of the first element where a and b differ, or n if none. Compares 16 bytes at a time.
+    static size_t findFirstDifference ( const T *a, const T *b, size_t n )
+    {
+        const char *x = ( const char * ) a;
+        const char *y = ( const char * ) b;
+        const size_t len = n * sizeof ( T );
+
+        size_t i = 0;
+
+        for ( ; i + 16 <= len; i += 16 )
+        {
+            const __m128i p = _mm_loadu_si128 ( ( const __m128i * ) ( x + i ) );
+            const __m128i q = _mm_loadu_si128 ( ( const __m128i * ) ( y + i ) );
+
+            // Bit N is set if byte N is equal
+            const uint32_t equal = _mm_movemask_epi8 ( _mm_cmpeq_epi8 ( p, q ) );
+
+            if ( equal != 0xFFFF )
+                return ( i + __builtin_ctz ( ~equal ) ) / sizeof ( T );
+        }
+
+        for ( ; i < len; ++i )
+        {
+            if ( x[i] != y[i] )
+                return i / sizeof ( T );
+        }
+
+        return n;
+    }
+
+    // Get the index of the first element that is not equal to t, or n if none. Compares 16 bytes at a time.
+    static size_t findFirstNotEqual ( const T *a, T t, size_t n )
+    {
+        size_t i = 0;
+
+        if ( 16 % sizeof ( T ) == 0 )
+        {
+            T pattern[16 / sizeof ( T )];
+            std::fill ( pattern, pattern + 16 / sizeof ( T ), t );
+
+            const __m128i q = _mm_loadu_si128 ( ( const __m128i * ) pattern );
+
+            for ( ; i + 16 / sizeof ( T ) <= n; i += 16 / sizeof ( T ) )
+            {
+                const __m128i p = _mm_loadu_si128 ( ( const __m128i * ) ( a + i ) );
+
+                const uint32_t equal = _mm_movemask_epi8 ( _mm_cmpeq_epi8 ( p, q ) );
+
+                if ( equal != 0xFFFF )
+                    return i + __builtin_ctz ( ~equal ) / sizeof ( T );
+            }
+        }
+
+        for ( ; i < n; ++i )
+        {
+            if ( a[i] != t )
+                return i;
+        }
+
+        return n;
+    }
+
+    Block *allocateBlock()
+    {
+        if ( _freeBlocks.empty() )
+        {
+            _slabs.emplace_back ( new Block[INPUTS_SLAB_BLOCKS] );
+
+            for ( size_t i = INPUTS_SLAB_BLOCKS; i > 0; --i )
+                _freeBlocks.push_back ( &_slabs.back()[i - 1] );
+        }
+
+        Block *block = _freeBlocks.back();
+        _freeBlocks.pop_back();
+        return block;
+    }
+
+    void freeBlocks ( Index& inputs )
+    {
+        _freeBlocks.insert ( _freeBlocks.end(), inputs.blocks.begin(), inputs.blocks.end() );
+        inputs.blocks.clear();
+        inputs.size = 0;
+    }
+
     // Get the last known input BEFORE the given index. Defaults to 0 if unknown.
     T lastInputBefore ( uint32_t index ) const
     {
-        if ( _inputs.empty() || index == 0 )
+        if ( _indexes.empty() || index == 0 )
             return 0;
 
-        if ( index > _inputs.size() )
-            index = _inputs.size();
+        if ( index > _indexes.size() )
+            index = _indexes.size();
 
         do
         {
             --index;
-            if ( ! _inputs[index].empty() )
-                return _inputs[index].back();
+            if ( _indexes[index].size > 0 )
+                return _indexes[index].last;
         }
         while ( index > 0 );
 
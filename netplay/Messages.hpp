@@ -7,6 +7,7 @@
 #include "Version.hpp"
 #include "Compression.hpp"
 #include "CharacterSelect.hpp"
+#include "IpAddrPort.hpp"
 
 #include <cereal/types/array.hpp>
 #include <cereal/types/vector.hpp>
@@ -279,6 +280,53 @@ struct SpectateConfig : public SerializableSequence
 };
 
 
+// Spectator relay tree update, sent towards the root of the spectator tree.
+// A spectator sends its own capacity and RTT to its parent with empty addresses. Each relay fills in the addresses
+// it knows, ie the server address of the spectator socket it was received from, then forwards it to its parent.
+struct RelayUpdate : public SerializableSequence
+{
+    // Server address of the spectator, as seen by its parent
+    IpAddrPort node;
+
+    // Server address of the spectator's parent, empty if the parent is the relay that received this
+    IpAddrPort parent;
+
+    // Number of spectators it can relay to
+    uint32_t capacity = 0;
+
+    // Round trip time to its parent, in milliseconds
+    uint32_t rtt = 0;
+
+    // If the spectator has left
+    bool left = false;
+
+    RelayUpdate ( uint32_t capacity, uint32_t rtt ) : capacity ( capacity ), rtt ( rtt ) {}
+
+    std::string str() const override
+    {
+        return format ( "RelayUpdate[%s,%s,%u,%u,%u]", node, parent, capacity, rtt, left );
+    }
+
+    PROTOCOL_MESSAGE_BOILERPLATE ( RelayUpdate, node, parent, capacity, rtt, left )
+};
+
+
+struct SpectateResume : public SerializableSequence
+{
+    // Server port of the spectator
+    uint16_t port = 0;
+
+    // Position of the next inputs the spectator needs, same as the relay's Spectator::pos
+    IndexedFrame pos = {{ 0, 0 }};
+
+    SpectateResume ( uint16_t port, IndexedFrame pos ) : port ( port ), pos ( pos ) {}
+
+    std::string str() const override { return format ( "SpectateResume[%u,%s]", port, pos ); }
+
+    PROTOCOL_MESSAGE_BOILERPLATE ( SpectateResume, port, pos.value )
+};
+
+
 struct ConfirmConfig : public SerializableSequence
 {
     EMPTY_MESSAGE_BOILERPLATE ( ConfirmConfig )
@@ -415,6 +463,98 @@ struct SyncHash : public SerializableSequence
 };
 
 
+struct FrameHashes : public SerializableSequence
+{
+    // Hashes of the full game state for consecutive frames, starting from indexedFrame
+    IndexedFrame indexedFrame = {{ 0, 0 }};
+
+    std::vector<uint32_t> hashes;
+
+    FrameHashes ( IndexedFrame indexedFrame ) : indexedFrame ( indexedFrame ) {}
+
+    uint32_t getEndFrame() const { return indexedFrame.parts.frame + hashes.size(); }
+
+    std::string str() const override { return format ( "FrameHashes[%s,%u]", indexedFrame, hashes.size() ); }
+
+    PROTOCOL_MESSAGE_BOILERPLATE ( FrameHashes, indexedFrame.value, hashes )
+};
+
+
+struct RegionHashes : public SerializableSequence
+{
+    // Hashes of each slice of the game state at indexedFrame, see MemDumpList::hashSlices
+    IndexedFrame indexedFrame = {{ 0, 0 }};
+
+    std::vector<uint32_t> hashes;
+
+    RegionHashes ( IndexedFrame indexedFrame ) : indexedFrame ( indexedFrame ) {}
+
+    std::string str() const override { return format ( "RegionHashes[%s,%u]", indexedFrame, hashes.size() ); }
+
+    PROTOCOL_MESSAGE_BOILERPLATE ( RegionHashes, indexedFrame.value, hashes )
+};
+
+
+struct FrameAdvantage : public SerializableSequence
+{
+    // Average frame advantage of the sender at indexedFrame, see TimeSync
+    IndexedFrame indexedFrame = {{ 0, 0 }};
+
+    float advantage = 0.0f;
+
+    FrameAdvantage ( IndexedFrame indexedFrame, float advantage )
+        : indexedFrame ( indexedFrame ), advantage ( advantage ) {}
+
+    std::string str() const override { return format ( "FrameAdvantage[%s,%.2f]", indexedFrame, advantage ); }
+
+    PROTOCOL_MESSAGE_BOILERPLATE ( FrameAdvantage, indexedFrame.value, advantage )
+};
+
+
+struct LatencyProbe : public SerializableSequence
+{
+    // Timestamp of the sender in milliseconds, echoed back unchanged
+    uint64_t timestamp = 0;
+
+    // Indicates if this is the echo
+    bool echo = false;
+
+    LatencyProbe ( uint64_t timestamp, bool echo ) : timestamp ( timestamp ), echo ( echo ) {}
+
+    std::string str() const override { return format ( "LatencyProbe[%llu,%d]", timestamp, echo ); }
+
+    PROTOCOL_MESSAGE_BOILERPLATE ( LatencyProbe, timestamp, echo )
+};
+
+
+struct DelayTuning : public SerializableSequence
+{
+    // Number of safe points reached by the sender, so both sides decide with the same samples
+    uint32_t round = 0;
+
+    // One way latency histogram of the sender, see DelayTuner
+    std::vector<uint32_t> latency;
+
+    // Current delay and rollback of the sender, since each side can set its own
+    uint8_t delay = 0, rollback = 0;
+
+    // Round trip time mean and jitter in milliseconds, only for logging
+    float rttMean = 0.0f, rttJitter = 0.0f;
+
+    DelayTuning ( uint32_t round, const std::vector<uint32_t>& latency, uint8_t delay, uint8_t rollback,
+                  float rttMean, float rttJitter )
+        : round ( round ), latency ( latency ), delay ( delay ), rollback ( rollback )
+        , rttMean ( rttMean ), rttJitter ( rttJitter ) {}
+
+    std::string str() const override
+    {
+        return format ( "DelayTuning[%u,%u,%u,%u]", round, latency.size(), delay, rollback );
+    }
+
+    PROTOCOL_MESSAGE_BOILERPLATE ( DelayTuning, round, latency, delay, rollback, rttMean, rttJitter )
+};
+
+
 struct MenuIndex : public SerializableSequence
 {
     uint32_t index = 0;
@@ -505,3 +645,80 @@ struct BothInputs : public SerializableSequence, public BaseInputs
 
     PROTOCOL_MESSAGE_BOILERPLATE ( BothInputs, indexedFrame.value, inputs )
 };
+
+
+struct SpectateHistory : public SerializableSequence
+{
+    uint32_t index = 0, startFrame = 0;
+
+    // Represents the input range [startFrame, startFrame + size()) of both players
+    std::array<std::vector<uint16_t>, 2> inputs;
+
+    SpectateHistory ( uint32_t index, uint32_t startFrame ) : index ( index ), startFrame ( startFrame ) {}
+
+    size_t size() const { return inputs[0].size(); }
+
+    uint32_t getEndFrame() const { return startFrame + size(); }
+
+    std::string str() const override
+    {
+        return format ( "SpectateHistory[%u,%u-%u]", index, startFrame, getEndFrame() );
+    }
+
+    // Get the input range [start, end) of the next chunk of at most maxFrames inputs after the given pos, out of the
+    // first numFrames inputs of that index. The pos is the last frame of the next inputs to send, see
+    // BaseInputs::getStartFrame. Returns false if there are no inputs ready, otherwise this increments the pos past
+    // the chunk. Once a final index has been fully returned, the pos moves to the start of the next index.
+    static bool getNextChunk ( IndexedFrame& pos, uint32_t numFrames, bool isFinal, uint32_t maxFrames,
+                               uint32_t& start, uint32_t& end )
+    {
+        start = ( pos.parts.frame + 1 < NUM_INPUTS ? 0 : pos.parts.frame + 1 - NUM_INPUTS );
+
+        if ( start >= numFrames )
+        {
+            // Wait for more inputs during the same index, otherwise increment to the next one
+            if ( isFinal )
+            {
+                pos.parts.frame = NUM_INPUTS - 1;
+                ++pos.parts.index;
+            }
+            return false;
+        }
+
+        end = std::min ( numFrames, start + maxFrames );
+
+        if ( isFinal && end == numFrames )
+        {
+            pos.parts.frame = NUM_INPUTS - 1;
+            ++pos.parts.index;
+        }
+        else
+        {
+            pos.parts.frame = end - 1 + NUM_INPUTS;
+        }
+
+        return true;
+    }
+
+    PROTOCOL_MESSAGE_BOILERPLATE ( SpectateHistory, index, startFrame, inputs )
+};
+
+
+struct SpectateState : public SerializableSequence
+{
+    uint8_t netplayState = 0;
+
+    uint32_t startWorldTime = 0;
+
+    IndexedFrame indexedFrame = {{ 0, 0 }};
+
+    // Raw bytes of the floating point environment and of the saved game state
+    std::string fpEnv, dump;
+
+    SpectateState ( uint8_t netplayState, uint32_t startWorldTime, IndexedFrame indexedFrame )
+        : netplayState ( netplayState ), startWorldTime ( startWorldTime ), indexedFrame ( indexedFrame ) {}
+
+    std::string str() const override { return format ( "SpectateState[%s,%u]", indexedFrame, dump.size() ); }
+
+    PROTOCOL_MESSAGE_BOILERPLATE ( SpectateState, netplayState, startWorldTime, indexedFrame.value, fpEnv, dump )
+};
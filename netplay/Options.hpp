@@ -24,6 +24,9 @@ ENUM ( Options,
        DefaultRollback,
        Fullscreen,
        AutoReplaySave,
+       AutoDelay,
+       InputPredictor,
+       SpectateSavestate,
        // Debug options
        FrameLimiter,
        Tests,
@@ -34,6 +37,7 @@ ENUM ( Options,
        PidLog,
        SyncTest,
        Replay,
+       LogCategories,
        // Special options
        NoFork,
        AppDir,
@@ -165,9 +165,9 @@ void ProcessManager::openGame ( bool highPriority, bool isTraining )
     if ( highPriority )
         stringArgs.push_back ( "--high" );
 
-#ifndef DISABLE_LOGGING
+#if !defined(DISABLE_LOGGING) && !defined(RELEASE)
     stringArgs.push_back ( "--popup_errors" );
-#endif
+#endif // NOT DISABLE_LOGGING && NOT RELEASE
 
     unique_ptr<const char *> argsPtr ( new const char *[stringArgs.size() + 1] );
     auto *args = argsPtr.get();
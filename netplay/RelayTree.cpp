@@ -0,0 +1,268 @@
+#include "RelayTree.hpp"
+#include "Logger.hpp"
+
+#include <algorithm>
+
+using namespace std;
+
+
+RelayTree::RelayTree ( uint32_t rootCapacity )
+{
+    _nodes[Root].capacity = rootCapacity;
+}
+
+uint32_t RelayTree::findParent ( uint64_t now ) const
+{
+    uint32_t best = None;
+
+    for ( const auto& kv : _nodes )
+    {
+        const Node& node = kv.second;
+
+        if ( getFreeSlots ( node, now ) == 0 || ! isAttached ( kv.first ) )
+            continue;
+
+        if ( best == None )
+        {
+            best = kv.first;
+            continue;
+        }
+
+        const Node& bestNode = _nodes.at ( best );
+
+        // Closest to the root, then lowest latency, then lowest id so the choice is deterministic
+        if ( node.depth != bestNode.depth )
+        {
+            if ( node.depth < bestNode.depth )
+                best = kv.first;
+        }
+        else if ( node.latency != bestNode.latency )
+        {
+            if ( node.latency < bestNode.latency )
+                best = kv.first;
+        }
+        else if ( kv.first < best )
+        {
+            best = kv.first;
+        }
+    }
+
+    return best;
+}
+
+void RelayTree::reserve ( uint32_t parent, uint64_t now )
+{
+    const auto it = _nodes.find ( parent );
+
+    if ( it == _nodes.end() )
+        return;
+
+    vector<uint64_t>& reserved = it->second.reserved;
+
+    // Forget reservations for spectators that never joined
+    reserved.erase ( remove_if ( reserved.begin(), reserved.end(),
+                                 [&] ( uint64_t time ) { return ( now >= time + RELAY_RESERVE_TIMEOUT ); } ),
+                     reserved.end() );
+
+    reserved.push_back ( now );
+}
+
+uint32_t RelayTree::add ( uint32_t parent, uint32_t capacity, uint32_t rtt )
+{
+    ASSERT ( contains ( parent ) );
+
+    Node& parentNode = _nodes[parent];
+
+    if ( ! parentNode.reserved.empty() )
+        parentNode.reserved.erase ( parentNode.reserved.begin() );
+
+    const uint32_t id = _nextId++;
+
+    Node& node = _nodes[id];
+    node.capacity = capacity;
+    node.rtt = rtt;
+
+    attach ( id, parent );
+
+    LOG ( "id=%u; parent=%u; capacity=%u; rtt=%u; depth=%u", id, parent, capacity, rtt, node.depth );
+    return id;
+}
+
+void RelayTree::update ( uint32_t id, uint32_t capacity, uint32_t rtt )
+{
+    const auto it = _nodes.find ( id );
+
+    if ( it == _nodes.end() )
+        return;
+
+    it->second.capacity = capacity;
+    it->second.rtt = rtt;
+
+    if ( id != Root && it->second.parent != None )
+        updateDepth ( id );
+}
+
+vector<RelayTree::Move> RelayTree::remove ( uint32_t id, uint64_t now )
+{
+    ASSERT ( id != Root );
+
+    vector<Move> moves;
+
+    const auto it = _nodes.find ( id );
+
+    if ( it == _nodes.end() )
+        return moves;
+
+    const uint32_t parent = it->second.parent;
+    vector<uint32_t> orphans = it->second.children;
+
+    for ( uint32_t orphan : orphans )
+        _nodes[orphan].parent = None;
+
+    if ( parent != None )
+        detach ( id );
+
+    _nodes.erase ( id );
+
+    // Place the children that can relay to more spectators first, so they stay closer to the root
+    stable_sort ( orphans.begin(), orphans.end(),
+                  [&] ( uint32_t a, uint32_t b ) { return ( _nodes[a].capacity > _nodes[b].capacity ); } );
+
+    for ( size_t i = 0; i < orphans.size(); ++i )
+    {
+        uint32_t newParent;
+
+        // The first child takes the place of the removed node
+        if ( i == 0 && parent != None && isAttached ( parent ) )
+            newParent = parent;
+        else
+            newParent = findParent ( now );
+
+        if ( newParent == None )
+            removeSubtree ( orphans[i] );
+        else
+            attach ( orphans[i], newParent );
+
+        LOG ( "id=%u; orphan=%u; newParent=%u", id, orphans[i], newParent );
+
+        moves.push_back ( { orphans[i], newParent } );
+    }
+
+    return moves;
+}
+
+vector<uint32_t> RelayTree::removeSubtree ( uint32_t id )
+{
+    ASSERT ( id != Root );
+
+    vector<uint32_t> removed;
+
+    if ( ! contains ( id ) )
+        return removed;
+
+    if ( _nodes[id].parent != None )
+        detach ( id );
+
+    removed.push_back ( id );
+
+    // Breadth first, so the removed nodes are ordered from the top of the subtree
+    for ( size_t i = 0; i < removed.size(); ++i )
+    {
+        const Node& node = _nodes[removed[i]];
+        removed.insert ( removed.end(), node.children.begin(), node.children.end() );
+    }
+
+    for ( uint32_t node : removed )
+        _nodes.erase ( node );
+
+    return removed;
+}
+
+void RelayTree::clear()
+{
+    const uint32_t rootCapacity = _nodes[Root].capacity;
+
+    _nodes.clear();
+    _nodes[Root].capacity = rootCapacity;
+}
+
+uint32_t RelayTree::getMaxDepth() const
+{
+    uint32_t maxDepth = 0;
+
+    for ( const auto& kv : _nodes )
+    {
+        if ( kv.second.depth > maxDepth && isAttached ( kv.first ) )
+            maxDepth = kv.second.depth;
+    }
+
+    return maxDepth;
+}
+
+uint32_t RelayTree::getCapacity ( uint32_t uploadKbps, uint32_t maxCapacity )
+{
+    // Unknown upload bandwidth
+    if ( uploadKbps == 0 )
+        return maxCapacity;
+
+    return min ( maxCapacity, uploadKbps / RELAY_KBPS_PER_SPECTATOR );
+}
+
+uint32_t RelayTree::getFreeSlots ( const Node& node, uint64_t now ) const
+{
+    uint32_t used = node.children.size();
+
+    for ( uint64_t time : node.reserved )
+    {
+        if ( now < time + RELAY_RESERVE_TIMEOUT )
+            ++used;
+    }
+
+    return ( node.capacity > used ? node.capacity - used : 0 );
+}
+
+bool RelayTree::isAttached ( uint32_t id ) const
+{
+    while ( id != Root )
+    {
+        const auto it = _nodes.find ( id );
+
+        if ( it == _nodes.end() || it->second.parent == None )
+            return false;
+
+        id = it->second.parent;
+    }
+
+    return true;
+}
+
+void RelayTree::attach ( uint32_t id, uint32_t parent )
+{
+    ASSERT ( _nodes[id].parent == None );
+
+    _nodes[id].parent = parent;
+    _nodes[parent].children.push_back ( id );
+
+    updateDepth ( id );
+}
+
+void RelayTree::detach ( uint32_t id )
+{
+    Node& node = _nodes[id];
+    vector<uint32_t>& siblings = _nodes[node.parent].children;
+
+    siblings.erase ( std::remove ( siblings.begin(), siblings.end(), id ), siblings.end() );
+    node.parent = None;
+}
+
+void RelayTree::updateDepth ( uint32_t id )
+{
+    Node& node = _nodes[id];
+    const Node& parent = _nodes[node.parent];
+
+    node.depth = parent.depth + 1;
+    node.latency = parent.latency + node.rtt / 2;
+
+    for ( uint32_t child : node.children )
+        updateDepth ( child );
+}
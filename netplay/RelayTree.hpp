@@ -0,0 +1,122 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+
+
+// Number of milliseconds a slot is reserved for a spectator that was redirected to a relay, but hasn't joined yet
+#define RELAY_RESERVE_TIMEOUT       ( 20000 )
+
+// Upload bandwidth needed to relay the inputs to one spectator, in kbps
+#define RELAY_KBPS_PER_SPECTATOR    ( 16 )
+
+
+// Placement scheduler for the tree of spectators relaying inputs to each other.
+//
+// The root of the tree is the broadcasting client, every other node is a spectator that advertised how many
+// spectators it can relay to (from its upload capacity), and its round trip time to its parent.
+// New spectators are placed in the free slot closest to the root, so the tree is filled breadth first and the depth
+// stays logarithmic in the number of spectators. Ties are broken by the lowest estimated latency from the root.
+// When a relay leaves, its child with the most capacity takes its place, and the other children are placed again.
+class RelayTree
+{
+public:
+
+    // Id of the root node
+    static constexpr uint32_t Root = 0;
+
+    // Invalid node id
+    static constexpr uint32_t None = UINT32_MAX;
+
+    struct Node
+    {
+        // Parent node, None if detached
+        uint32_t parent = None;
+
+        // Maximum number of children
+        uint32_t capacity = 0;
+
+        // Round trip time to the parent, in milliseconds
+        uint32_t rtt = 0;
+
+        // Number of hops from the root
+        uint32_t depth = 0;
+
+        // Estimated one way latency from the root, in milliseconds
+        uint32_t latency = 0;
+
+        // Child nodes
+        std::vector<uint32_t> children;
+
+        // Times that slots were reserved for spectators being redirected here
+        std::vector<uint64_t> reserved;
+    };
+
+    // A child that was moved when its parent was removed, the new parent is None if there was no room for it
+    struct Move
+    {
+        uint32_t node, parent;
+    };
+
+    // Construct a tree with just the root
+    RelayTree ( uint32_t rootCapacity = 1 );
+
+    // Find the parent for a new spectator, None if every node is full
+    uint32_t findParent ( uint64_t now = 0 ) const;
+
+    // Reserve a slot for a spectator that is being redirected to the given parent
+    void reserve ( uint32_t parent, uint64_t now );
+
+    // Add a node under the given parent, this uses up a reserved slot if there is one. Returns the new node id.
+    uint32_t add ( uint32_t parent, uint32_t capacity, uint32_t rtt );
+
+    // Update the advertised capacity and round trip time of a node
+    void update ( uint32_t id, uint32_t capacity, uint32_t rtt );
+
+    // Remove a node and re-parent its children, returns where each child was moved
+    std::vector<Move> remove ( uint32_t id, uint64_t now = 0 );
+
+    // Remove a node and all of its descendants, returns the removed nodes
+    std::vector<uint32_t> removeSubtree ( uint32_t id );
+
+    // Clear the tree, leaving just the root
+    void clear();
+
+    bool contains ( uint32_t id ) const { return ( _nodes.find ( id ) != _nodes.end() ); }
+
+    const Node& get ( uint32_t id ) const { return _nodes.at ( id ); }
+
+    // Number of nodes, excluding the root
+    size_t size() const { return _nodes.size() - 1; }
+
+    // Depth of the deepest node
+    uint32_t getMaxDepth() const;
+
+    // Number of spectators that can be relayed to with the given upload bandwidth
+    static uint32_t getCapacity ( uint32_t uploadKbps, uint32_t maxCapacity );
+
+private:
+
+    // Mapping: node id -> node
+    std::unordered_map<uint32_t, Node> _nodes;
+
+    // Next node id
+    uint32_t _nextId = Root + 1;
+
+    // Number of free slots, excluding reserved slots
+    uint32_t getFreeSlots ( const Node& node, uint64_t now ) const;
+
+    // Check if a node is connected to the root
+    bool isAttached ( uint32_t id ) const;
+
+    // Attach a detached node to a parent
+    void attach ( uint32_t id, uint32_t parent );
+
+    // Detach a node from its parent
+    void detach ( uint32_t id );
+
+    // Recalculate the depth and latency of a node and its descendants
+    void updateDepth ( uint32_t id );
+};
@@ -1,5 +1,6 @@
 #include "ReplayCreator.hpp"
 #include "StringUtils.hpp"
+#include "MappedFile.hpp"
 
 #include <iostream>
 #include <iomanip>
@@ -10,6 +11,7 @@
 #include <string.h>
 #include <sstream>
 #include <map>
+#include <algorithm>
 using namespace std;
 
 void ReplayCreator::dump(ReplayCreator::ReplayFile rf, char* fname) {
@@ -48,81 +50,66 @@ void ReplayCreator::dump(ReplayCreator::ReplayFile rf, char* fname) {
     outfile.close();
 }
 
-void ReplayCreator::load(ReplayCreator::ReplayFile* rf, char* fname) {
-    ifstream infile;
-    infile.open(fname, ios::binary | ios::in);
-    infile.read((char*)rf, 0x60);
-    //cout << formatAsHex((void*) rf, 0x60) << endl;
-    //cout << endl;
-    for (int j=0; j < rf->numRounds; ++j) {
-      ReplayCreator::Round roundObj;
-      ReplayCreator::Round* round = &roundObj;
-      infile.read((char*)round, 0x8C);
-      //cout << formatAsHex((void*) round, 0x8c) << endl;
-      infile.read((char*)&(round->lenp1Inputs), 4);
-      //printf("Player1\n");
-      //printf("%d %d\n", round->lenp1Inputs, round->lenp2Inputs);
-      ReplayCreator::Input in;
-      for (int i = 0; i < round->lenp1Inputs; ++i) {
-        infile.read((char*)&in, 6);
-        round->p1Inputs.push_back(in);
-      }
-      infile.read((char*)&(round->lenp2Inputs), 4);
-      //printf("Player2\n");
-      //printf("%d %d\n", round->lenp1Inputs, round->lenp2Inputs);
-      for (int i = 0; i < round->lenp2Inputs; ++i) {
-        infile.read((char*)&in, 6);
-        //cout << formatAsHex((void*) &in, 6) << endl;
-        //cout << "preprint" << endl;
-        //printInput2(in);
-        //cout << "postprint" << endl;
-        round->p2Inputs.push_back(in);
-      }
-      // A copy of p1/p2's inputs, with some directions changed. May or not appear.
-      // Don't know why this exists either, doesn't seem to do anything
-      // Probably something to do with controllers
-      infile.read((char*)&(round->lenp3Inputs), 4);
-      //cout << formatAsHex((void*) &(round->lenp3Inputs), 4) << endl;
-      //printf("Player3\n");
-      //printf("%d\n", round->lenp3Inputs);
-      for (int i = 0; i < round->lenp3Inputs; ++i) {
-          infile.read((char*)&in, 6);
-          //cout << formatAsHex((void*) &in, 6) << endl;
-          //cout << "preprint" << endl;
-          //printInput2(in);
-          //cout << "postprint" << endl;
-          round->p3Inputs.push_back(in);
-      }
-      infile.read((char*)&(round->lenp4Inputs), 4);
-      //printf("Player4\n");
-      //printf("%d\n", round->lenp4Inputs);
-      for (int i = 0; i < round->lenp4Inputs; ++i) {
-          infile.read((char*)&in, 6);
-          //cout << formatAsHex((void*) &in, 6) << endl;
-          //cout << "preprint" << endl;
-          //printInput2(in);
-          //cout << "postprint" << endl;
-          round->p4Inputs.push_back(in);
-      }
+bool ReplayCreator::load(ReplayCreator::ReplayFile* rf, char* fname) {
+    MappedFile file;
+    if (!file.open(fname))
+        return false;
+    return parse(rf, file.data(), file.size());
+}
 
-      infile.read((char*)&(round->lenRng), 4);
-      int tmp;
-      for (int i = 0; i < round->lenRng; ++i) {
-        infile.read((char*)&tmp, 4);
-        //cout << formatAsHex((void*) &tmp, 4) << endl;
-        round->rngstates.push_back(tmp);
-      }
-      infile.read((char*)&(round->nine), 144);
-      //cout << formatAsHex((void*) round->nine, 144) << endl;
-      //cout << "aa" << endl;
-      rf->rounds.push_back(roundObj);
+bool ReplayCreator::parse(ReplayCreator::ReplayFile* rf, const char* data, size_t size) {
+    size_t pos = 0;
+    auto read = [&](void* dst, size_t len) {
+        if (len > size - pos)
+            return false;
+        memcpy(dst, data + pos, len);
+        pos += len;
+        return true;
+    };
+    // Inputs are 6 bytes each on disk
+    auto readInputs = [&](int* len, vector<Input>& inputs) {
+        if (!read(len, 4) || *len < 0 || size_t(*len) > (size - pos) / 6)
+            return false;
+        inputs.resize(*len);
+        for (int i = 0; i < *len; ++i) {
+            memcpy(&inputs[i], data + pos, 6);
+            pos += 6;
+        }
+        return true;
+    };
+    rf->rounds.clear();
+    if (!read(rf, 0x60) || rf->numRounds < 0)
+        return false;
+    for (int j=0; j < rf->numRounds; ++j) {
+      ReplayCreator::Round round;
+      if (!read(&round, 0x8C) ||
+          !readInputs(&round.lenp1Inputs, round.p1Inputs) ||
+          !readInputs(&round.lenp2Inputs, round.p2Inputs) ||
+          // A copy of p1/p2's inputs, with some directions changed. May or not appear.
+          // Don't know why this exists either, doesn't seem to do anything
+          // Probably something to do with controllers
+          !readInputs(&round.lenp3Inputs, round.p3Inputs) ||
+          !readInputs(&round.lenp4Inputs, round.p4Inputs) ||
+          !read(&round.lenRng, 4) || round.lenRng < 0 || size_t(round.lenRng) > (size - pos) / 4)
+        return false;
+      round.rngstates.resize(round.lenRng);
+      if (round.lenRng > 0)
+        read(&round.rngstates[0], 4 * round.lenRng);
+      if (!read(&round.nine, 144))
+        return false;
+      rf->rounds.push_back(round);
     }
+    return true;
 }
+
 void ReplayCreator::fixReplay(ReplayCreator::ReplayFile* rf, char* fname, MoveData* prior) {
     //cout << "fix replay" << endl;
-    LOG( "asdf" );
     ifstream infile;
     infile.open(fname);
+    fixReplay(rf, infile, prior);
+}
+
+bool ReplayCreator::fixReplay(ReplayCreator::ReplayFile* rf, istream& infile, MoveData* prior) {
     string line;
     getline(infile,line);
     //cout << line << endl;
@@ -130,6 +117,8 @@ void ReplayCreator::fixReplay(ReplayCreator::ReplayFile* rf, char* fname, MoveDa
     LOG( "line: %s", line);
     //cout << "rounds " << rounds << endl;
     LOG( "rounds: %d", rounds );
+    if (rounds < 0 || size_t(rounds) > rf->rounds.size())
+        return false;
     for (int i = 0; i < rounds; ++i) {
         rf->rounds[i].p1Inputs.clear();
         rf->rounds[i].p2Inputs.clear();
@@ -199,12 +188,8 @@ void ReplayCreator::fixReplay(ReplayCreator::ReplayFile* rf, char* fname, MoveDa
 
     }
 
-    for (Input in : rf->rounds[0].p1Inputs ) {
-      //printInput2(in);
-    }
-
     //cout << "endfix" << endl;
-
+    return true;
 }
 
 uint8_t ReplayCreator::getDirection(unsigned int x) {
@@ -407,6 +392,26 @@ void ReplayCreator::findrngdiff( ReplayCreator::ReplayFile* rf1,
   }
 }
 
+int ReplayCreator::findInputDiff( const vector<ReplayCreator::Input>& in1,
+                                  const vector<ReplayCreator::Input>& in2 ) {
+  size_t len = min(in1.size(), in2.size());
+  for (size_t i = 0; i < len; ++i) {
+    if (in1[i] != in2[i])
+      return i;
+  }
+  return (in1.size() == in2.size() ? -1 : len);
+}
+
+int ReplayCreator::findRngDiff( const vector<uint32_t>& rng1,
+                                const vector<uint32_t>& rng2 ) {
+  size_t len = min(rng1.size(), rng2.size());
+  for (size_t i = 0; i < len; ++i) {
+    if (rng1[i] != rng2[i])
+      return i;
+  }
+  return (rng1.size() == rng2.size() ? -1 : len);
+}
+
 void ReplayCreator::printInput3( ReplayCreator::Input input ) {
     string t = getButtonIcon( input.buttonHold );
     int l = strlen(t.c_str());
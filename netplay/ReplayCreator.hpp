@@ -130,8 +130,15 @@ public:
     };
 
     void dump( ReplayFile rf, char* fname );
-    void load( ReplayFile* rf, char* fname );
+    bool load( ReplayFile* rf, char* fname );
+    // Parse a replay from memory, returns false if it is truncated or has invalid lengths
+    bool parse( ReplayFile* rf, const char* data, size_t size );
     void fixReplay( ReplayFile* rf, char* fname, MoveData* prior );
+    // Replace the p1/p2 inputs with the ones from a .repraw stream, returns false if it has more rounds than rf
+    bool fixReplay( ReplayFile* rf, std::istream& infile, MoveData* prior );
+    // Index of the first different input / rng state, or -1 if they are the same
+    int findInputDiff( const std::vector<Input>& in1, const std::vector<Input>& in2 );
+    int findRngDiff( const std::vector<uint32_t>& rng1, const std::vector<uint32_t>& rng2 );
     uint8_t getButton( unsigned int x );
     uint8_t getDirection( unsigned int x );
     std::string getDirIcon( uint8_t x );
@@ -0,0 +1,584 @@
+#include "ReplayIndex.hpp"
+#include "ReplayCreator.hpp"
+#include "CharacterSelect.hpp"
+#include "MappedFile.hpp"
+#include "WorkStealingPool.hpp"
+#include "StringUtils.hpp"
+#include "Logger.hpp"
+
+#include <filesystem>
+#include <algorithm>
+#include <fstream>
+#include <cstring>
+#include <ctime>
+
+using namespace std;
+
+namespace fs = std::filesystem;
+
+
+// Header at the start of a replay index file, followed by the entries, then the string table
+struct FileHeader
+{
+    uint32_t magic, version, numEntries, stringsSize;
+
+    uint64_t resultsSize;
+    int64_t resultsTime;
+};
+
+static_assert ( sizeof ( ReplayIndex::Entry ) == 56, "Entry is written to disk as is" );
+
+// Size of the header of a .rep file, see ReplayCreator::load
+#define REPLAY_HEADER_SIZE ( 0x60 )
+
+// Columns of the first side of a results.csv row, the second side is 3 columns later
+#define RESULTS_NAME    ( 0 )
+#define RESULTS_CHARA   ( 1 )
+#define RESULTS_WINS    ( 2 )
+#define RESULTS_TIME    ( 6 )
+
+
+// A row of results.csv, see NetplayManager::exportResults
+struct ResultsRow
+{
+    int64_t time = 0;
+
+    std::string names[2];
+
+    uint8_t chara[2] = { 0, 0 }, moon[2] = { 0, 0 }, wins[2] = { 0, 0 };
+};
+
+
+static const char moonNames[] = { 'C', 'F', 'H' };
+
+// The same key for the characters and moons of a match, no matter which side each one is on
+static uint32_t getMatchKey ( const uint8_t chara[2], const uint8_t moon[2] )
+{
+    const uint32_t a = ( chara[0] << 8 ) | moon[0], b = ( chara[1] << 8 ) | moon[1];
+    return ( min ( a, b ) << 16 ) | max ( a, b );
+}
+
+// Read the header of a .rep file into an entry, returns false if it isn't a replay
+static bool readReplay ( const string& file, ReplayIndex::Entry& entry )
+{
+    MappedFile mapped;
+
+    if ( ! mapped.open ( file ) || mapped.size() < REPLAY_HEADER_SIZE )
+        return false;
+
+    ReplayCreator::ReplayFile rf;
+    memcpy ( ( char * ) &rf, mapped.data(), REPLAY_HEADER_SIZE );
+
+    if ( memcmp ( rf.headername, FILE_HEADER, sizeof ( rf.headername ) ) != 0 )
+        return false;
+
+    // The replay date is in local time
+    tm date = {};
+    date.tm_year = rf.year - 1900;
+    date.tm_mon = rf.month - 1;
+    date.tm_mday = rf.day;
+    date.tm_hour = rf.hour;
+    date.tm_min = rf.minute;
+    date.tm_sec = rf.second;
+    date.tm_isdst = -1;
+
+    entry.date = mktime ( &date );
+    entry.stage = rf.stage;
+    entry.chara[0] = rf.p1.character;
+    entry.chara[1] = rf.p2.character;
+    entry.moon[0] = rf.p1.moon;
+    entry.moon[1] = rf.p2.moon;
+    entry.numRounds = min ( rf.numRounds, 0xFF );
+    return true;
+}
+
+
+bool ReplayIndex::parseChara ( const string& str, int& chara, int& moon )
+{
+    string name = str;
+    moon = -1;
+
+    if ( name.size() > 2 && name[1] == '-' )
+    {
+        const char *it = find ( moonNames, moonNames + 3, toupper ( name[0] ) );
+
+        if ( it == moonNames + 3 )
+            return false;
+
+        moon = it - moonNames;
+        name = name.substr ( 2 );
+    }
+
+    // Lower case short names of every selectable character
+    static const unordered_map<string, int> charas = []()
+    {
+        unordered_map<string, int> charas;
+
+        for ( uint32_t i = 0; i < 0x100; ++i )
+        {
+            if ( charaToSelector ( i ) != UNKNOWN_POSITION )
+                charas[lowerCase ( getShortCharaName ( i ) )] = i;
+        }
+
+        return charas;
+    }();
+
+    const auto it = charas.find ( lowerCase ( name ) );
+
+    if ( it == charas.end() )
+        return false;
+
+    chara = it->second;
+    return true;
+}
+
+string ReplayIndex::formatChara ( uint8_t chara, uint8_t moon )
+{
+    return format ( "%c-%s", ( moon < 3 ? moonNames[moon] : '?' ), getShortCharaName ( chara ) );
+}
+
+uint32_t ReplayIndex::addString ( const string& str )
+{
+    if ( str.empty() )
+        return 0;
+
+    const uint32_t offset = _strings.size();
+    _strings.append ( str.c_str(), str.size() + 1 );
+    return offset;
+}
+
+void ReplayIndex::rebuild()
+{
+    stable_sort ( _entries.begin(), _entries.end(), [&] ( const Entry& a, const Entry& b )
+    {
+        return ( a.date != b.date ? a.date < b.date : strcmp ( getString ( a.path ), getString ( b.path ) ) < 0 );
+    } );
+
+    // Compact the string table, dropping strings that are no longer used and duplicates
+    string strings ( 1, '\0' );
+    unordered_map<string, uint32_t> offsets;
+
+    const auto compact = [&] ( uint32_t& offset )
+    {
+        if ( offset == 0 )
+            return;
+
+        const string str = getString ( offset );
+        const auto it = offsets.find ( str );
+
+        if ( it != offsets.end() )
+        {
+            offset = it->second;
+            return;
+        }
+
+        offset = offsets[str] = strings.size();
+        strings.append ( str.c_str(), str.size() + 1 );
+    };
+
+    for ( Entry& entry : _entries )
+    {
+        compact ( entry.path );
+        compact ( entry.names[0] );
+        compact ( entry.names[1] );
+    }
+
+    _strings.swap ( strings );
+
+    buildLists();
+}
+
+void ReplayIndex::buildLists()
+{
+    _byPlayer.clear();
+    _byChara.clear();
+    _byStage.clear();
+
+    for ( uint32_t i = 0; i < _entries.size(); ++i )
+    {
+        const Entry& entry = _entries[i];
+
+        for ( uint32_t side = 0; side < 2; ++side )
+        {
+            if ( entry.names[side] && ( side == 0 || entry.names[1] != entry.names[0] ) )
+                _byPlayer[lowerCase ( getString ( entry.names[side] ) )].push_back ( i );
+
+            if ( side == 0 || entry.chara[1] != entry.chara[0] )
+                _byChara[entry.chara[side]].push_back ( i );
+        }
+
+        _byStage[entry.stage].push_back ( i );
+    }
+}
+
+bool ReplayIndex::load ( const string& file )
+{
+    *this = ReplayIndex();
+
+    MappedFile mapped;
+
+    if ( ! mapped.open ( file ) )
+        return false;
+
+    FileHeader header;
+
+    if ( mapped.size() < sizeof ( header ) )
+        return false;
+
+    memcpy ( &header, mapped.data(), sizeof ( header ) );
+
+    const uint64_t entriesSize = uint64_t ( header.numEntries ) * sizeof ( Entry );
+
+    if ( header.magic != REPLAY_INDEX_MAGIC || header.version != REPLAY_INDEX_VERSION || header.stringsSize == 0
+            || mapped.size() != sizeof ( header ) + entriesSize + header.stringsSize )
+    {
+        LOG ( "'%s' is not a version %u replay index", file, REPLAY_INDEX_VERSION );
+        return false;
+    }
+
+    _entries.resize ( header.numEntries );
+
+    if ( header.numEntries )
+        memcpy ( &_entries[0], mapped.data() + sizeof ( header ), entriesSize );
+
+    _strings.assign ( mapped.data() + sizeof ( header ) + entriesSize, header.stringsSize );
+
+    for ( size_t i = 0; i < _entries.size(); ++i )
+    {
+        const Entry& entry = _entries[i];
+
+        if ( entry.path >= _strings.size() || entry.names[0] >= _strings.size() || entry.names[1] >= _strings.size()
+                || _strings.back() != '\0' || _strings[0] != '\0' || ( i && entry.date < _entries[i - 1].date ) )
+        {
+            LOG ( "'%s' has invalid entries", file );
+            *this = ReplayIndex();
+            return false;
+        }
+    }
+
+    _resultsSize = header.resultsSize;
+    _resultsTime = header.resultsTime;
+
+    // The saved entries are already sorted and compacted
+    buildLists();
+    return true;
+}
+
+bool ReplayIndex::save ( const string& file ) const
+{
+    ofstream fout ( file.c_str(), ios::out | ios::binary );
+
+    if ( ! fout.good() )
+    {
+        LOG ( "Failed to open '%s'", file );
+        return false;
+    }
+
+    const FileHeader header = { REPLAY_INDEX_MAGIC, REPLAY_INDEX_VERSION, ( uint32_t ) _entries.size(),
+                                ( uint32_t ) _strings.size(), _resultsSize, _resultsTime };
+
+    fout.write ( ( const char * ) &header, sizeof ( header ) );
+    fout.write ( ( const char * ) _entries.data(), _entries.size() * sizeof ( Entry ) );
+    fout.write ( _strings.data(), _strings.size() );
+
+    const bool good = fout.good();
+    fout.close();
+    return good;
+}
+
+ReplayIndex::UpdateStats ReplayIndex::update ( const string& folder, const string& resultsFile, size_t numThreads )
+{
+    UpdateStats stats;
+
+    unordered_map<string, size_t> existing;
+
+    for ( size_t i = 0; i < _entries.size(); ++i )
+        existing[getString ( _entries[i].path )] = i;
+
+    struct Pending
+    {
+        string path;
+        uint64_t fileSize;
+        int64_t fileTime;
+    };
+
+    vector<Entry> entries;
+    vector<Pending> pending;
+    error_code error;
+
+    for ( fs::recursive_directory_iterator it ( folder, error ), end; ! error && it != end; it.increment ( error ) )
+    {
+        error_code ec;
+
+        if ( ! it->is_regular_file ( ec ) || it->path().extension() != ".rep" )
+            continue;
+
+        const string path = fs::relative ( it->path(), folder ).generic_string();
+        const uint64_t fileSize = it->file_size ( ec );
+        const int64_t fileTime = it->last_write_time ( ec ).time_since_epoch().count();
+
+        const auto jt = existing.find ( path );
+
+        if ( jt == existing.end() )
+        {
+            ++stats.added;
+        }
+        else if ( _entries[jt->second].fileSize == fileSize && _entries[jt->second].fileTime == fileTime )
+        {
+            entries.push_back ( _entries[jt->second] );
+            ++stats.unchanged;
+            continue;
+        }
+        else
+        {
+            ++stats.changed;
+        }
+
+        pending.push_back ( { path, fileSize, fileTime } );
+    }
+
+    if ( error )
+        LOG ( "Failed to scan '%s': %s", folder, error.message() );
+
+    stats.removed = _entries.size() - stats.unchanged - stats.changed;
+
+    // Only the new and changed replays are read
+    vector<Entry> parsed ( pending.size() );
+    vector<uint8_t> valid ( pending.size() );
+
+    WorkStealingPool::run ( pending.size(), numThreads, [&] ( size_t i, size_t )
+    {
+        valid[i] = readReplay ( folder + "/" + pending[i].path, parsed[i] );
+    } );
+
+    for ( size_t i = 0; i < pending.size(); ++i )
+    {
+        if ( ! valid[i] )
+        {
+            ++stats.invalid;
+            continue;
+        }
+
+        parsed[i].path = addString ( pending[i].path );
+        parsed[i].fileSize = pending[i].fileSize;
+        parsed[i].fileTime = pending[i].fileTime;
+        entries.push_back ( parsed[i] );
+    }
+
+    _entries.swap ( entries );
+    rebuild();
+
+    // Only read results.csv again if it changed or there are new replays to match
+    if ( ! resultsFile.empty() )
+    {
+        error_code ec;
+        const uint64_t resultsSize = fs::file_size ( resultsFile, ec );
+        const int64_t resultsTime = ( ec ? 0 : fs::last_write_time ( resultsFile, ec ).time_since_epoch().count() );
+
+        if ( ! ec && ( resultsSize != _resultsSize || resultsTime != _resultsTime || ! pending.empty() ) )
+        {
+            stats.matched = matchResults ( resultsFile );
+            _resultsSize = resultsSize;
+            _resultsTime = resultsTime;
+            rebuild();
+        }
+    }
+
+    return stats;
+}
+
+size_t ReplayIndex::matchResults ( const string& resultsFile )
+{
+    MappedFile mapped;
+
+    if ( ! mapped.open ( resultsFile ) )
+        return 0;
+
+    vector<ResultsRow> rows;
+    unordered_multimap<uint32_t, size_t> byMatch;
+
+    const char *end = mapped.data() + mapped.size();
+
+    for ( const char *line = mapped.data(), *eol; line < end; line = ( eol == end ? end : eol + 1 ) )
+    {
+        eol = find ( line, end, '\n' );
+
+        const vector<string> fields = split ( trimmed ( string ( line, eol ) ), "," );
+
+        if ( fields.size() != 7 )
+            continue;
+
+        ResultsRow row;
+        bool ok = true;
+
+        for ( uint32_t side = 0; side < 2; ++side )
+        {
+            int chara = 0, moon = 0;
+
+            ok = ok && parseChara ( fields[3 * side + RESULTS_CHARA], chara, moon ) && moon >= 0;
+
+            row.names[side] = fields[3 * side + RESULTS_NAME];
+            row.chara[side] = chara;
+            row.moon[side] = moon;
+            row.wins[side] = atoi ( fields[3 * side + RESULTS_WINS].c_str() );
+        }
+
+        row.time = atoll ( fields[RESULTS_TIME].c_str() );
+
+        if ( ! ok || row.time == 0 )
+            continue;
+
+        byMatch.insert ( { getMatchKey ( row.chara, row.moon ), rows.size() } );
+        rows.push_back ( row );
+    }
+
+    // Rows already matched to a replay can't be used again
+    vector<uint8_t> used ( rows.size() );
+
+    for ( const Entry& entry : _entries )
+    {
+        if ( ! entry.hasResult() )
+            continue;
+
+        const auto range = byMatch.equal_range ( getMatchKey ( entry.chara, entry.moon ) );
+
+        for ( auto it = range.first; it != range.second; ++it )
+        {
+            if ( rows[it->second].time == entry.resultTime )
+                used[it->second] = true;
+        }
+    }
+
+    size_t matched = 0;
+
+    for ( Entry& entry : _entries )
+    {
+        if ( entry.hasResult() )
+            continue;
+
+        const auto range = byMatch.equal_range ( getMatchKey ( entry.chara, entry.moon ) );
+
+        size_t best = rows.size();
+        int64_t bestDelta = REPLAY_INDEX_MATCH_WINDOW + 1;
+
+        for ( auto it = range.first; it != range.second; ++it )
+        {
+            const int64_t delta = llabs ( rows[it->second].time - entry.date );
+
+            if ( ! used[it->second] && delta < bestDelta )
+            {
+                best = it->second;
+                bestDelta = delta;
+            }
+        }
+
+        if ( best == rows.size() )
+            continue;
+
+        // The local player is first in results.csv, so it may be either side of the replay
+        const ResultsRow& row = rows[best];
+        const uint32_t first = ( row.chara[0] == entry.chara[0] && row.moon[0] == entry.moon[0] ? 0 : 1 );
+
+        for ( uint32_t side = 0; side < 2; ++side )
+        {
+            entry.names[side] = addString ( row.names[side ^ first] );
+            entry.wins[side] = row.wins[side ^ first];
+        }
+
+        entry.resultTime = row.time;
+        used[best] = true;
+        ++matched;
+    }
+
+    return matched;
+}
+
+bool ReplayIndex::matches ( const Entry& entry, const Query& query ) const
+{
+    if ( entry.date < query.from || entry.date >= query.to )
+        return false;
+
+    if ( query.stage >= 0 && entry.stage != query.stage )
+        return false;
+
+    for ( uint32_t side = 0; side < 2; ++side )
+    {
+        if ( ! query.player.empty() && lowerCase ( getString ( entry.names[side] ) ) != query.player )
+            continue;
+
+        if ( ( query.chara >= 0 && entry.chara[side] != query.chara )
+                || ( query.moon >= 0 && entry.moon[side] != query.moon ) )
+        {
+            continue;
+        }
+
+        if ( query.result == Result::Any || ( query.player.empty() && query.chara < 0 ) )
+            return true;
+
+        if ( entry.hasResult() && entry.wins[side] != entry.wins[side ^ 1]
+                && ( query.result == Result::Win ) == ( entry.wins[side] > entry.wins[side ^ 1] ) )
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+vector<size_t> ReplayIndex::query ( const Query& original ) const
+{
+    vector<size_t> results;
+
+    // Player names are compared in lower case
+    Query query = original;
+    query.player = lowerCase ( query.player );
+
+    // Entries in the date range
+    const auto byDate = [] ( const Entry& entry, int64_t date ) { return entry.date < date; };
+    const size_t lo = lower_bound ( _entries.begin(), _entries.end(), query.from, byDate ) - _entries.begin();
+    const size_t hi = lower_bound ( _entries.begin(), _entries.end(), query.to, byDate ) - _entries.begin();
+
+    // Find the shortest list of entries that can match
+    const vector<uint32_t> *list = 0;
+
+    const auto consider = [&] ( const auto& lists, const auto& key )
+    {
+        const auto it = lists.find ( key );
+
+        if ( it == lists.end() )
+            return false;
+
+        if ( ! list || it->second.size() < list->size() )
+            list = &it->second;
+
+        return true;
+    };
+
+    if ( ! query.player.empty() && ! consider ( _byPlayer, query.player ) )
+        return results;
+
+    if ( query.chara >= 0 && ! consider ( _byChara, uint32_t ( query.chara ) ) )
+        return results;
+
+    if ( query.stage >= 0 && ! consider ( _byStage, uint32_t ( query.stage ) ) )
+        return results;
+
+    if ( list && list->size() < hi - lo )
+    {
+        for ( auto it = list->rbegin(); it != list->rend() && results.size() < query.limit; ++it )
+        {
+            if ( matches ( _entries[*it], query ) )
+                results.push_back ( *it );
+        }
+
+        return results;
+    }
+
+    for ( size_t i = hi; i > lo && results.size() < query.limit; --i )
+    {
+        if ( matches ( _entries[i - 1], query ) )
+            results.push_back ( i - 1 );
+    }
+
+    return results;
+}
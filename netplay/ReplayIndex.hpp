@@ -0,0 +1,135 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+
+// Magic number at the start of a replay index file
+#define REPLAY_INDEX_MAGIC          ( 0x49434343 ) // "CCCI"
+
+// Current replay index file version
+#define REPLAY_INDEX_VERSION        ( 1 )
+
+// Most seconds between the date in a replay and the time of a results.csv row for them to be the same match
+#define REPLAY_INDEX_MATCH_WINDOW   ( 300 )
+
+
+// Index of the metadata of every replay in a folder, so queries don't need to read any replays.
+//
+// Each replay is a fixed size Entry, sorted by date. The characters, moons, and stage come from the .rep header.
+// The player names and wins come from the results.csv row with the same characters and moons, closest in time.
+//
+// The index file has the header, the entries, then a table of the strings they refer to. Loading it builds lists of
+// entries per player name, character, and stage, and queries only check the entries in the shortest list that applies.
+class ReplayIndex
+{
+public:
+
+    struct Entry
+    {
+        // Size and modification time of the replay file, so updates only read new or changed replays
+        uint64_t fileSize = 0;
+        int64_t fileTime = 0;
+
+        // Date in the replay header, in seconds since the epoch
+        int64_t date = 0;
+
+        // Time of the matching results.csv row, 0 if there is none
+        int64_t resultTime = 0;
+
+        // Offset of the path relative to the indexed folder, and of the player names, in the string table
+        uint32_t path = 0, names[2] = { 0, 0 };
+
+        uint16_t stage = 0;
+
+        uint8_t chara[2] = { 0, 0 }, moon[2] = { 0, 0 }, wins[2] = { 0, 0 };
+
+        uint8_t numRounds = 0;
+
+        uint8_t reserved[3] = { 0, 0, 0 };
+
+        bool hasResult() const { return resultTime != 0; }
+    };
+
+    enum class Result : uint8_t { Any, Win, Loss };
+
+    // Every field is optional. Player and character match either side, and they must be the same side if both are
+    // given. The result is for that side, and is ignored if neither is given.
+    struct Query
+    {
+        std::string player;
+
+        int chara = -1, moon = -1, stage = -1;
+
+        // Dates in [from, to)
+        int64_t from = 0, to = INT64_MAX;
+
+        Result result = Result::Any;
+
+        // Most matches to return, newest first
+        size_t limit = SIZE_MAX;
+    };
+
+    struct UpdateStats
+    {
+        size_t added = 0, changed = 0, removed = 0, unchanged = 0, invalid = 0, matched = 0;
+    };
+
+    size_t size() const { return _entries.size(); }
+
+    const Entry& get ( size_t i ) const { return _entries[i]; }
+
+    const char *getString ( uint32_t offset ) const { return &_strings[offset]; }
+
+    // Load an index file, returns false if it doesn't exist or is invalid, leaving the index empty
+    bool load ( const std::string& file );
+
+    // Save to an index file
+    bool save ( const std::string& file ) const;
+
+    // Bring the index up to date with the .rep files in a folder and the rows of a results.csv (optional).
+    // Only replays that are new or changed since the last update are read, using the given number of threads.
+    UpdateStats update ( const std::string& folder, const std::string& resultsFile, size_t numThreads );
+
+    // Get the indexes of the matching entries, newest first
+    std::vector<size_t> query ( const Query& query ) const;
+
+    // Parse a character name as written in results.csv, either "Name" or "M-Name", returns false if unknown
+    static bool parseChara ( const std::string& str, int& chara, int& moon );
+
+    // Format a character the way results.csv does
+    static std::string formatChara ( uint8_t chara, uint8_t moon );
+
+private:
+
+    // Entries sorted by date
+    std::vector<Entry> _entries;
+
+    // NUL terminated strings, offset 0 is the empty string
+    std::string _strings = std::string ( 1, '\0' );
+
+    // Lists of entries sorted by date, for each lower case player name, character, and stage
+    std::unordered_map<std::string, std::vector<uint32_t>> _byPlayer;
+    std::unordered_map<uint32_t, std::vector<uint32_t>> _byChara, _byStage;
+
+    // Size and modification time of the results.csv at the last update
+    uint64_t _resultsSize = 0;
+    int64_t _resultsTime = 0;
+
+    // Add a string to the table, returns its offset
+    uint32_t addString ( const std::string& str );
+
+    // Sort the entries, compact the string table, and rebuild the lists
+    void rebuild();
+
+    // Build the lists of entries per player name, character, and stage
+    void buildLists();
+
+    // Check if an entry matches a query, with the player name in lower case
+    bool matches ( const Entry& entry, const Query& query ) const;
+
+    // Fill in the names and wins of entries without a result from the rows of a results.csv
+    size_t matchResults ( const std::string& resultsFile );
+};
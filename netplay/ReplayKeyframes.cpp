@@ -0,0 +1,277 @@
+#include "ReplayKeyframes.hpp"
+#include "Compression.hpp"
+#include "Logger.hpp"
+
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+
+// Header at the start of a replay keyframes file
+struct FileHeader
+{
+    uint32_t magic, version, stateSize, numKeyframes;
+};
+
+// Header of each keyframe in a replay keyframes file, followed by the fpEnv bytes then the data bytes
+struct KeyframeHeader
+{
+    uint32_t netplayState, startWorldTime, index, frame, baseFrame, fpEnvSize, dataSize;
+};
+
+
+static bool byFrame ( const ReplayKeyframes::Keyframe& keyframe, uint64_t value )
+{
+    return keyframe.indexedFrame.value < value;
+}
+
+
+void ReplayKeyframes::reset ( size_t stateSize )
+{
+    _stateSize = stateSize;
+    _keyframes.clear();
+    _cachedBase = MaxIndexedFrame;
+    _cachedBaseState.clear();
+}
+
+size_t ReplayKeyframes::getCompressedSize() const
+{
+    size_t total = 0;
+
+    for ( const Keyframe& keyframe : _keyframes )
+        total += keyframe.data.size();
+
+    return total;
+}
+
+bool ReplayKeyframes::has ( IndexedFrame indexedFrame ) const
+{
+    const auto it = lower_bound ( _keyframes.begin(), _keyframes.end(), indexedFrame.value, byFrame );
+
+    return ( it != _keyframes.end() && it->indexedFrame.value == indexedFrame.value );
+}
+
+bool ReplayKeyframes::add ( uint32_t netplayState, uint32_t startWorldTime, IndexedFrame indexedFrame,
+                            const string& fpEnv, const char *state )
+{
+    ASSERT ( _stateSize > 0 );
+
+    const auto it = lower_bound ( _keyframes.begin(), _keyframes.end(), indexedFrame.value, byFrame );
+
+    if ( it != _keyframes.end() && it->indexedFrame.value == indexedFrame.value )
+        return false;
+
+    Keyframe keyframe;
+    keyframe.netplayState = netplayState;
+    keyframe.startWorldTime = startWorldTime;
+    keyframe.indexedFrame = indexedFrame;
+    keyframe.fpEnv = fpEnv;
+    keyframe.baseFrame = indexedFrame.parts.frame;
+
+    // The first keyframe of the index is the base, unless this one comes before it
+    const IndexedFrame indexStart = {{ 0, indexedFrame.parts.index }};
+    const auto base = lower_bound ( _keyframes.begin(), _keyframes.end(), indexStart.value, byFrame );
+
+    const char *src = state;
+
+    if ( base != it && decodeBase ( base->indexedFrame ) )
+    {
+        keyframe.baseFrame = base->indexedFrame.parts.frame;
+
+        _delta.resize ( _stateSize );
+
+        for ( size_t i = 0; i < _stateSize; ++i )
+            _delta[i] = state[i] ^ _cachedBaseState[i];
+
+        src = _delta.data();
+    }
+
+    keyframe.data.resize ( compressBound ( _stateSize ) );
+
+    const size_t size = compress ( src, _stateSize, &keyframe.data[0], keyframe.data.size(),
+                                   REPLAY_KEYFRAME_COMPRESSION );
+
+    if ( size == 0 )
+    {
+        LOG ( "Failed to compress keyframe [%s]", indexedFrame );
+        return false;
+    }
+
+    keyframe.data.resize ( size );
+    keyframe.data.shrink_to_fit();
+
+    _keyframes.insert ( it, keyframe );
+    return true;
+}
+
+size_t ReplayKeyframes::find ( IndexedFrame indexedFrame ) const
+{
+    auto it = lower_bound ( _keyframes.begin(), _keyframes.end(), indexedFrame.value + 1, byFrame );
+
+    if ( it == _keyframes.begin() )
+        return _keyframes.size();
+
+    --it;
+
+    if ( it->indexedFrame.parts.index != indexedFrame.parts.index )
+        return _keyframes.size();
+
+    return it - _keyframes.begin();
+}
+
+bool ReplayKeyframes::decodeBase ( IndexedFrame indexedFrame ) const
+{
+    if ( _cachedBase.value == indexedFrame.value )
+        return true;
+
+    const auto it = lower_bound ( _keyframes.begin(), _keyframes.end(), indexedFrame.value, byFrame );
+
+    if ( it == _keyframes.end() || it->indexedFrame.value != indexedFrame.value || ! it->isFull() )
+    {
+        LOG ( "Missing base keyframe [%s]", indexedFrame );
+        return false;
+    }
+
+    _cachedBaseState.resize ( _stateSize );
+    _cachedBase = MaxIndexedFrame;
+
+    if ( uncompress ( it->data.data(), it->data.size(), &_cachedBaseState[0], _stateSize ) != _stateSize )
+    {
+        LOG ( "Failed to uncompress keyframe [%s]", indexedFrame );
+        return false;
+    }
+
+    _cachedBase = indexedFrame;
+    return true;
+}
+
+bool ReplayKeyframes::decode ( size_t i, char *state ) const
+{
+    if ( i >= _keyframes.size() )
+        return false;
+
+    const Keyframe& keyframe = _keyframes[i];
+
+    if ( keyframe.isFull() )
+    {
+        if ( ! decodeBase ( keyframe.indexedFrame ) )
+            return false;
+
+        memcpy ( state, _cachedBaseState.data(), _stateSize );
+        return true;
+    }
+
+    if ( ! decodeBase ( {{ keyframe.baseFrame, keyframe.indexedFrame.parts.index }} ) )
+        return false;
+
+    if ( uncompress ( keyframe.data.data(), keyframe.data.size(), state, _stateSize ) != _stateSize )
+    {
+        LOG ( "Failed to uncompress keyframe [%s]", keyframe.indexedFrame );
+        return false;
+    }
+
+    for ( size_t j = 0; j < _stateSize; ++j )
+        state[j] ^= _cachedBaseState[j];
+
+    return true;
+}
+
+bool ReplayKeyframes::save ( const string& file ) const
+{
+    ofstream fout ( file.c_str(), ios::out | ios::binary );
+
+    if ( ! fout.good() )
+    {
+        LOG ( "Failed to open '%s'", file );
+        return false;
+    }
+
+    const FileHeader header = { REPLAY_KEYFRAMES_MAGIC, REPLAY_KEYFRAMES_VERSION, ( uint32_t ) _stateSize,
+                                ( uint32_t ) _keyframes.size() };
+
+    fout.write ( ( const char * ) &header, sizeof ( header ) );
+
+    for ( const Keyframe& keyframe : _keyframes )
+    {
+        const KeyframeHeader keyframeHeader =
+        {
+            keyframe.netplayState, keyframe.startWorldTime,
+            keyframe.indexedFrame.parts.index, keyframe.indexedFrame.parts.frame, keyframe.baseFrame,
+            ( uint32_t ) keyframe.fpEnv.size(), ( uint32_t ) keyframe.data.size()
+        };
+
+        fout.write ( ( const char * ) &keyframeHeader, sizeof ( keyframeHeader ) );
+        fout.write ( keyframe.fpEnv.data(), keyframe.fpEnv.size() );
+        fout.write ( keyframe.data.data(), keyframe.data.size() );
+    }
+
+    const bool good = fout.good();
+    fout.close();
+    return good;
+}
+
+bool ReplayKeyframes::load ( const string& file )
+{
+    ifstream fin ( file.c_str(), ios::in | ios::binary );
+
+    if ( ! fin.good() )
+        return false;
+
+    FileHeader header;
+
+    if ( ! fin.read ( ( char * ) &header, sizeof ( header ) )
+            || header.magic != REPLAY_KEYFRAMES_MAGIC || header.version != REPLAY_KEYFRAMES_VERSION )
+    {
+        LOG ( "'%s' is not a version %u replay keyframes file", file, REPLAY_KEYFRAMES_VERSION );
+        return false;
+    }
+
+    reset ( header.stateSize );
+
+    for ( uint32_t i = 0; i < header.numKeyframes; ++i )
+    {
+        KeyframeHeader keyframeHeader;
+
+        // The floating point environment is only a few dozen bytes
+        if ( ! fin.read ( ( char * ) &keyframeHeader, sizeof ( keyframeHeader ) )
+                || keyframeHeader.dataSize > compressBound ( _stateSize ) || keyframeHeader.fpEnvSize > 1024 )
+        {
+            break;
+        }
+
+        Keyframe keyframe;
+        keyframe.netplayState = keyframeHeader.netplayState;
+        keyframe.startWorldTime = keyframeHeader.startWorldTime;
+        keyframe.indexedFrame = {{ keyframeHeader.frame, keyframeHeader.index }};
+        keyframe.baseFrame = keyframeHeader.baseFrame;
+        keyframe.fpEnv.resize ( keyframeHeader.fpEnvSize );
+        keyframe.data.resize ( keyframeHeader.dataSize );
+
+        fin.read ( &keyframe.fpEnv[0], keyframe.fpEnv.size() );
+        fin.read ( &keyframe.data[0], keyframe.data.size() );
+
+        // Keyframes must be sorted, and each delta must come after its base in the same index
+        const bool sorted = _keyframes.empty() || _keyframes.back().indexedFrame.value < keyframe.indexedFrame.value;
+        const bool hasBase = keyframe.isFull()
+                             || ( keyframe.baseFrame < keyframe.indexedFrame.parts.frame
+                                  && has ( {{ keyframe.baseFrame, keyframe.indexedFrame.parts.index }} ) );
+
+        if ( ! fin || ! sorted || ! hasBase )
+            break;
+
+        _keyframes.push_back ( keyframe );
+    }
+
+    if ( _keyframes.size() != header.numKeyframes )
+    {
+        LOG ( "'%s' has invalid keyframes", file );
+        reset ( header.stateSize );
+        return false;
+    }
+
+    LOG ( "Loaded '%s': %u keyframes; stateSize=%u; compressedSize=%u",
+          file, _keyframes.size(), _stateSize, getCompressedSize() );
+    return true;
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "Constants.hpp"
+
+#include <string>
+#include <vector>
+
+
+// Magic number at the start of a replay keyframes file
+#define REPLAY_KEYFRAMES_MAGIC          ( 0x4B434343 ) // "CCCK"
+
+// Current replay keyframes file version
+#define REPLAY_KEYFRAMES_VERSION        ( 1 )
+
+// Number of frames between keyframes, which is the most frames a seek has to re-simulate
+#define REPLAY_KEYFRAME_INTERVAL        ( 300 )
+
+// Keyframes are captured during a frame, so trade some size for speed
+#define REPLAY_KEYFRAME_COMPRESSION     ( 1 )
+
+
+// Game states captured periodically during replay playback, so seeking only has to re-simulate from the nearest
+// keyframe instead of from the start of the replay.
+//
+// The first keyframe of each index is stored in full. The others are stored as the XOR of their state with that
+// base keyframe, since most of the game state is the same throughout a round, and the mostly zero result compresses
+// very well. Decoding any keyframe takes at most two decompressions, and the base of the last decoded keyframe is
+// cached, so seeks within the same round only decompress the delta.
+class ReplayKeyframes
+{
+public:
+
+    struct Keyframe
+    {
+        // Identifies the game state, the same way as a saved rollback state
+        uint32_t netplayState = 0;
+        uint32_t startWorldTime = 0;
+        IndexedFrame indexedFrame = MaxIndexedFrame;
+
+        // Raw bytes of the floating point environment
+        std::string fpEnv;
+
+        // Frame of the full keyframe in the same index that this is a delta of, equal to its own frame if full
+        uint32_t baseFrame = 0;
+
+        // Compressed game state, or compressed XOR with the base keyframe state
+        std::string data;
+
+        bool isFull() const { return baseFrame == indexedFrame.parts.frame; }
+    };
+
+    // Discard all the keyframes, and set the size of every game state
+    void reset ( size_t stateSize );
+
+    size_t getStateSize() const { return _stateSize; }
+
+    size_t size() const { return _keyframes.size(); }
+
+    bool empty() const { return _keyframes.empty(); }
+
+    const Keyframe& get ( size_t i ) const { return _keyframes[i]; }
+
+    // Get the total compressed size of every keyframe
+    size_t getCompressedSize() const;
+
+    // Check if there is a keyframe for the given frame
+    bool has ( IndexedFrame indexedFrame ) const;
+
+    // Add a game state of getStateSize() bytes, returns false if there is already a keyframe for the same frame
+    bool add ( uint32_t netplayState, uint32_t startWorldTime, IndexedFrame indexedFrame,
+               const std::string& fpEnv, const char *state );
+
+    // Find the newest keyframe at or before the given frame in the same index, returns size() if there is none
+    size_t find ( IndexedFrame indexedFrame ) const;
+
+    // Decode the game state of a keyframe into getStateSize() bytes
+    bool decode ( size_t i, char *state ) const;
+
+    // Save / load the keyframes to / from a file
+    bool save ( const std::string& file ) const;
+    bool load ( const std::string& file );
+
+private:
+
+    // Size of every game state
+    size_t _stateSize = 0;
+
+    // Keyframes sorted by frame
+    std::vector<Keyframe> _keyframes;
+
+    // The decompressed state of the last decoded base keyframe
+    mutable IndexedFrame _cachedBase = MaxIndexedFrame;
+    mutable std::string _cachedBaseState;
+
+    // Scratch buffer for decompressing deltas
+    mutable std::string _delta;
+
+    // Decompress the state of a full keyframe into the cache
+    bool decodeBase ( IndexedFrame indexedFrame ) const;
+};
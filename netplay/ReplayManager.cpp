@@ -2,15 +2,33 @@
 #include "Exceptions.hpp"
 #include "Logger.hpp"
 #include "Messages.hpp"
+#include "NetplayStates.hpp"
 
 #include <iostream>
 #include <fstream>
+#include <algorithm>
 
 using namespace std;
 
 
+// Get the NetplayState value of a logged state string, BINARY_REPLAY_NONE if it isn't one
+static uint32_t getNetplayStateValue ( const string& str )
+{
+    for ( uint32_t i = 0; i <= UINT8_MAX; ++i )
+    {
+        if ( NetplayState ( NetplayState::Enum ( i ) ).str() == str )
+            return i;
+    }
+
+    return BINARY_REPLAY_NONE;
+}
+
+
 bool ReplayManager::load ( const string& replayFile, bool real )
 {
+    if ( BinaryReplay::isBinaryReplay ( replayFile ) )
+        return loadBinary ( replayFile, real );
+
     ifstream fin ( replayFile.c_str() );
     bool good = fin.good();
 
@@ -61,20 +79,12 @@ bool ReplayManager::load ( const string& replayFile, bool real )
 
             if ( tag == "Inputs" || ( real && tag == "Reinputs" ) )
             {
-                if ( index >= _inputs.size() )
-                    _inputs.resize ( index + 1 );
-
-                ASSERT ( index + 1 == _inputs.size() );
+                const uint32_t row = addRow ( {{ frame, index }} );
 
-                if ( frame >= _inputs[index].size() )
-                    _inputs[index].resize ( frame + 1 );
+                ss >> hex >> _p1[row] >> _p2[row];
 
-                Inputs i;
-                i.indexedFrame.parts.index = index;
-                i.indexedFrame.parts.frame = frame;
-                ss >> hex >> i.p1 >> i.p2;
-
-                _inputs[index][frame] = i;
+                _numFrames[index] = max ( _numFrames[index], frame + 1 );
+                _lastIndex = index;
             }
             else if ( tag == "RngState" )
             {
@@ -133,40 +143,39 @@ bool ReplayManager::load ( const string& replayFile, bool real )
                 if ( real )
                     continue;
 
-                if ( index >= _rollbacks.size() )
-                    _rollbacks.resize ( index + 1 );
-
-                ASSERT ( index + 1 == _rollbacks.size() );
-
-                if ( frame >= _rollbacks[index].size() )
-                    _rollbacks[index].resize ( frame + 1, MaxIndexedFrame );
+                const uint32_t row = addRow ( {{ frame, index }} );
 
                 IndexedFrame i;
                 ss >> i.parts.index >> i.parts.frame;
 
-                _rollbacks[index][frame] = i;
+                // The same frame can roll back again right after, then its reinputs are added to the same rollback
+                if ( _rollbackOfRow[row] == REPLAY_NONE || _rollbackOfRow[row] + 1 != _rollbackTargets.size() )
+                {
+                    if ( _reinputOffsets.empty() )
+                        _reinputOffsets.push_back ( 0 );
+
+                    _rollbackOfRow[row] = _rollbackTargets.size();
+                    _rollbackTargets.push_back ( i );
+                    _reinputOffsets.push_back ( _reinputs.size() );
+                }
+
+                _rollbackTargets[_rollbackOfRow[row]] = i;
             }
             else if ( tag == "Reinputs" )
             {
                 if ( real )
                     continue;
 
-                if ( _rollbacks.size() > _reinputs.size() )
-                    _reinputs.resize ( _rollbacks.size() );
-
-                ASSERT ( _rollbacks.size() == _reinputs.size() );
-
-                if ( _rollbacks.back().size() > _reinputs.back().size() )
-                    _reinputs.back().resize ( _rollbacks.back().size() );
-
-                ASSERT ( _rollbacks.back().size() == _reinputs.back().size() );
+                // Reinputs belong to the latest rollback, which is always the last one in the CSR table
+                ASSERT ( _rollbackTargets.empty() == false );
 
                 Inputs i;
                 i.indexedFrame.parts.index = index;
                 i.indexedFrame.parts.frame = frame;
                 ss >> hex >> i.p1 >> i.p2;
 
-                _reinputs.back().back().push_back ( i );
+                _reinputs.push_back ( i );
+                _reinputOffsets.back() = _reinputs.size();
             }
             else if ( tag == "P1" )
             {
@@ -202,13 +211,174 @@ bool ReplayManager::load ( const string& replayFile, bool real )
             }
         }
 
-        LOG ( "Processed up to [%u:%u]", _inputs.size() - 1, _inputs.back().size() - 1 );
+        LOG ( "Processed up to [%u:%u]", getLastIndex(), getLastFrame() );
     }
 
     fin.close();
     return good;
 }
 
+bool ReplayManager::loadBinary ( const string& replayFile, bool real )
+{
+    if ( ! _binary.open ( replayFile ) )
+        return false;
+
+    _real = real;
+
+    const uint32_t numIndexes = _binary.getNumIndexes();
+
+    _modes.resize ( numIndexes );
+    _states.resize ( numIndexes );
+    _numFrames.resize ( numIndexes );
+
+    // Only the per index data is copied, the per frame data stays in the mapped file
+    for ( uint32_t i = 0; i < numIndexes; ++i )
+    {
+        const BinaryReplay::Index& index = *_binary.getIndex ( i );
+
+        _modes[i] = index.gameMode;
+
+        if ( index.netplayState != BINARY_REPLAY_NONE )
+            _states[i] = NetplayState ( NetplayState::Enum ( index.netplayState ) ).str();
+
+        _numFrames[i] = index.numFrames;
+
+        if ( index.numFrames )
+            _lastIndex = i;
+
+        // Real replays use the last reinputs of each frame instead of the original inputs
+        if ( ! real )
+            continue;
+
+        for ( const BinaryReplay::Rollback& rollback : _binary.getRollbacks ( i ) )
+        {
+            for ( const BinaryReplay::Reinput& reinput : _binary.getReinputs ( rollback ) )
+                _realInputs.push_back ( { {{ reinput.frame, reinput.index }}, reinput.p1, reinput.p2 } );
+        }
+    }
+
+    if ( real )
+    {
+        stable_sort ( _realInputs.begin(), _realInputs.end(), [] ( const Inputs& a, const Inputs& b )
+        {
+            return a.indexedFrame.value < b.indexedFrame.value;
+        } );
+
+        // Keep only the last reinputs of each frame
+        const auto end = unique ( _realInputs.rbegin(), _realInputs.rend(), [] ( const Inputs& a, const Inputs& b )
+        {
+            return a.indexedFrame.value == b.indexedFrame.value;
+        } );
+
+        _realInputs.erase ( _realInputs.begin(), end.base() );
+    }
+
+    for ( const BinaryReplay::InitialState& initial : _binary.getInitialStates() )
+    {
+        _initialStates.push_back ( MsgPtr ( new InitialGameState ( { 0, initial.index } ) ) );
+
+        InitialGameState& initialState = _initialStates.back()->getAs<InitialGameState>();
+        initialState.chara = initial.chara;
+        initialState.moon = initial.moon;
+        initialState.color = initial.color;
+    }
+
+    LOG ( "Processed up to [%u:%u]", getLastIndex(), getLastFrame() );
+    return true;
+}
+
+bool ReplayManager::save ( const string& replayFile ) const
+{
+    if ( _binary.isOpen() )
+    {
+        LOG ( "Already a binary replay" );
+        return false;
+    }
+
+    BinaryReplay::Sections sections;
+
+    const size_t numIndexes = max ( { _modes.size(), _states.size(), _numFrames.size(), _rngStates.size() } );
+
+    sections.indexes.resize ( numIndexes );
+
+    for ( uint32_t i = 0; i < numIndexes; ++i )
+    {
+        BinaryReplay::Index& index = sections.indexes[i];
+
+        if ( i < _modes.size() )
+            index.gameMode = _modes[i];
+
+        if ( i < _states.size() && ! _states[i].empty() )
+            index.netplayState = getNetplayStateValue ( _states[i] );
+
+        index.firstFrame = sections.p1.size();
+        index.numFrames = getNumFrames ( i );
+
+        index.firstRollback = sections.rollbacks.size();
+
+        if ( index.numFrames )
+        {
+            sections.p1.insert ( sections.p1.end(), _p1.begin() + _rowOffsets[i],
+                                 _p1.begin() + _rowOffsets[i] + index.numFrames );
+            sections.p2.insert ( sections.p2.end(), _p2.begin() + _rowOffsets[i],
+                                 _p2.begin() + _rowOffsets[i] + index.numFrames );
+        }
+
+        for ( uint32_t row = getRow ( {{ 0, i }} ); row != REPLAY_NONE && row < _rowOffsets[i + 1]; ++row )
+        {
+            const uint32_t j = _rollbackOfRow[row];
+
+            if ( j == REPLAY_NONE )
+                continue;
+
+            BinaryReplay::Rollback rollback;
+            rollback.frame = row - _rowOffsets[i];
+            rollback.targetFrame = _rollbackTargets[j].parts.frame;
+            rollback.targetIndex = _rollbackTargets[j].parts.index;
+            rollback.firstReinput = sections.reinputs.size();
+            rollback.numReinputs = _reinputOffsets[j + 1] - _reinputOffsets[j];
+
+            for ( uint32_t k = _reinputOffsets[j]; k < _reinputOffsets[j + 1]; ++k )
+            {
+                const IndexedFrame& at = _reinputs[k].indexedFrame;
+                sections.reinputs.push_back ( { at.parts.frame, at.parts.index, _reinputs[k].p1, _reinputs[k].p2 } );
+            }
+
+            sections.rollbacks.push_back ( rollback );
+        }
+
+        index.numRollbacks = sections.rollbacks.size() - index.firstRollback;
+
+        if ( i < _rngStates.size() && _rngStates[i] )
+        {
+            const RngState& rngState = _rngStates[i]->getAs<RngState>();
+
+            index.rngState = sections.rngStates.size();
+
+            sections.rngStates.emplace_back();
+            sections.rngStates.back().rngState0 = rngState.rngState0;
+            sections.rngStates.back().rngState1 = rngState.rngState1;
+            sections.rngStates.back().rngState2 = rngState.rngState2;
+            sections.rngStates.back().rngState3 = rngState.rngState3;
+        }
+    }
+
+    for ( const MsgPtr& msg : _initialStates )
+    {
+        ASSERT ( msg.get() != 0 );
+
+        const InitialGameState& initialState = msg->getAs<InitialGameState>();
+
+        sections.initialStates.emplace_back();
+        sections.initialStates.back().index = initialState.indexedFrame.parts.index;
+        sections.initialStates.back().chara = initialState.chara;
+        sections.initialStates.back().moon = initialState.moon;
+        sections.initialStates.back().color = initialState.color;
+    }
+
+    return BinaryReplay::write ( replayFile, sections );
+}
+
 uint32_t ReplayManager::getGameMode ( IndexedFrame indexedFrame )
 {
     if ( indexedFrame.parts.index >= _modes.size() )
@@ -228,7 +398,48 @@ const string& ReplayManager::getStateStr ( IndexedFrame indexedFrame )
     return _states[indexedFrame.parts.index];
 }
 
-const ReplayManager::Inputs& ReplayManager::getInputs ( IndexedFrame indexedFrame )
+uint32_t ReplayManager::addRow ( IndexedFrame indexedFrame )
+{
+    const uint32_t index = indexedFrame.parts.index;
+
+    if ( index >= _numFrames.size() )
+    {
+        if ( _rowOffsets.empty() )
+            _rowOffsets.push_back ( 0 );
+
+        _rowOffsets.resize ( index + 2, _p1.size() );
+        _numFrames.resize ( index + 1, 0 );
+    }
+
+    // Only the rows of the last index can grow
+    ASSERT ( index + 1 == _numFrames.size() );
+
+    const uint32_t row = _rowOffsets[index] + indexedFrame.parts.frame;
+
+    if ( row >= _p1.size() )
+    {
+        _p1.resize ( row + 1, 0 );
+        _p2.resize ( row + 1, 0 );
+        _rollbackOfRow.resize ( row + 1, REPLAY_NONE );
+        _rowOffsets.back() = row + 1;
+    }
+
+    return row;
+}
+
+uint32_t ReplayManager::getRow ( IndexedFrame indexedFrame ) const
+{
+    if ( indexedFrame.parts.index >= _numFrames.size()
+            || indexedFrame.parts.frame >= _rowOffsets[indexedFrame.parts.index + 1]
+            - _rowOffsets[indexedFrame.parts.index] )
+    {
+        return REPLAY_NONE;
+    }
+
+    return _rowOffsets[indexedFrame.parts.index] + indexedFrame.parts.frame;
+}
+
+ReplayManager::Inputs ReplayManager::getInputs ( IndexedFrame indexedFrame ) const
 {
     static const Inputs confirm = { MaxIndexedFrame, CC_BUTTON_CONFIRM << 4, CC_BUTTON_CONFIRM << 4 };
     static const Inputs down = { MaxIndexedFrame, 2, 2 };
@@ -254,40 +465,88 @@ const ReplayManager::Inputs& ReplayManager::getInputs ( IndexedFrame indexedFram
         return empty;
     }
 
-    if ( indexedFrame.parts.index >= _inputs.size()
-            || indexedFrame.parts.frame >= _inputs[indexedFrame.parts.index].size() )
+    if ( indexedFrame.parts.index >= _numFrames.size()
+            || indexedFrame.parts.frame >= _numFrames[indexedFrame.parts.index] )
     {
         return empty;
     }
 
-    return _inputs[indexedFrame.parts.index][indexedFrame.parts.frame];
+    Inputs inputs = { indexedFrame, 0, 0 };
+
+    if ( _binary.isOpen() )
+    {
+        const auto it = lower_bound ( _realInputs.begin(), _realInputs.end(), indexedFrame.value,
+                                      [] ( const Inputs& a, uint64_t value ) { return a.indexedFrame.value < value; } );
+
+        if ( it != _realInputs.end() && it->indexedFrame.value == indexedFrame.value )
+            return *it;
+
+        _binary.getInputs ( indexedFrame, inputs.p1, inputs.p2 );
+        return inputs;
+    }
+
+    const uint32_t row = _rowOffsets[indexedFrame.parts.index] + indexedFrame.parts.frame;
+
+    inputs.p1 = _p1[row];
+    inputs.p2 = _p2[row];
+    return inputs;
 }
 
-IndexedFrame ReplayManager::getRollbackTarget ( IndexedFrame indexedFrame )
+IndexedFrame ReplayManager::getRollbackTarget ( IndexedFrame indexedFrame ) const
 {
-    if ( indexedFrame.parts.index >= _rollbacks.size()
-            || indexedFrame.parts.frame >= _rollbacks[indexedFrame.parts.index].size() )
-    {
+    if ( _binary.isOpen() )
+        return ( _real ? MaxIndexedFrame : _binary.getRollbackTarget ( indexedFrame ) );
+
+    const uint32_t row = getRow ( indexedFrame );
+
+    if ( row == REPLAY_NONE || _rollbackOfRow[row] == REPLAY_NONE )
         return MaxIndexedFrame;
-    }
 
-    return _rollbacks[indexedFrame.parts.index][indexedFrame.parts.frame];
+    return _rollbackTargets[_rollbackOfRow[row]];
 }
 
-const vector<ReplayManager::Inputs>& ReplayManager::getReinputs ( IndexedFrame indexedFrame )
+span<const ReplayManager::Inputs> ReplayManager::getReinputs ( IndexedFrame indexedFrame )
 {
-    if ( indexedFrame.parts.index >= _reinputs.size()
-            || indexedFrame.parts.frame >= _reinputs[indexedFrame.parts.index].size() )
+    if ( _binary.isOpen() )
     {
-        static const vector<ReplayManager::Inputs> empty;
-        return empty;
+        _binaryReinputs.clear();
+
+        if ( _real )
+            return {};
+
+        for ( const BinaryReplay::Reinput& reinput : _binary.getReinputs ( indexedFrame ) )
+            _binaryReinputs.push_back ( { {{ reinput.frame, reinput.index }}, reinput.p1, reinput.p2 } );
+
+        return _binaryReinputs;
     }
 
-    return _reinputs[indexedFrame.parts.index][indexedFrame.parts.frame];
+    const uint32_t row = getRow ( indexedFrame );
+
+    if ( row == REPLAY_NONE || _rollbackOfRow[row] == REPLAY_NONE )
+        return {};
+
+    const uint32_t rollback = _rollbackOfRow[row];
+
+    return { _reinputs.data() + _reinputOffsets[rollback], _reinputOffsets[rollback + 1] - _reinputOffsets[rollback] };
 }
 
 MsgPtr ReplayManager::getRngState ( IndexedFrame indexedFrame )
 {
+    if ( _binary.isOpen() )
+    {
+        const BinaryReplay::RngState *blob = _binary.getRngState ( indexedFrame.parts.index );
+
+        if ( ! blob )
+            return 0;
+
+        RngState *rngState = new RngState ( 0 );
+        rngState->rngState0 = blob->rngState0;
+        rngState->rngState1 = blob->rngState1;
+        rngState->rngState2 = blob->rngState2;
+        rngState->rngState3 = blob->rngState3;
+        return MsgPtr ( rngState );
+    }
+
     if ( indexedFrame.parts.index >= _rngStates.size() )
         return 0;
 
@@ -296,21 +555,23 @@ MsgPtr ReplayManager::getRngState ( IndexedFrame indexedFrame )
 
 uint32_t ReplayManager::getLastIndex() const
 {
-    if ( _inputs.empty() )
+    return _lastIndex;
+}
+
+uint32_t ReplayManager::getNumFrames ( uint32_t index ) const
+{
+    if ( index >= _numFrames.size() )
         return 0;
 
-    return _inputs.size() - 1;
+    return _numFrames[index];
 }
 
 uint32_t ReplayManager::getLastFrame() const
 {
-    if ( _inputs.empty() )
-        return 0;
-
-    if ( _inputs.back().empty() )
+    if ( _lastIndex >= _numFrames.size() || _numFrames[_lastIndex] == 0 )
         return 0;
 
-    return _inputs.back().size() - 1;
+    return _numFrames[_lastIndex] - 1;
 }
 
 MsgPtr ReplayManager::getInitialStateBefore ( uint32_t index ) const
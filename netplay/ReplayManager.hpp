@@ -2,9 +2,15 @@
 
 #include "Constants.hpp"
 #include "Protocol.hpp"
+#include "BinaryReplay.hpp"
 
 #include <string>
 #include <vector>
+#include <span>
+
+
+// Value of a missing row or rollback
+#define REPLAY_NONE ( 0xFFFFFFFF )
 
 
 class ReplayManager
@@ -17,39 +23,89 @@ public:
         uint16_t p1, p2;
     };
 
+    // Load a text sync log, or map a binary replay file written by save
     bool load ( const std::string& replayFile, bool real );
 
+    // Save a loaded text sync log as a binary replay file
+    bool save ( const std::string& replayFile ) const;
+
+    bool isBinary() const { return _binary.isOpen(); }
+
     uint32_t getGameMode ( IndexedFrame indexedFrame );
 
     const std::string& getStateStr ( IndexedFrame indexedFrame );
 
-    const Inputs& getInputs ( IndexedFrame indexedFrame );
+    Inputs getInputs ( IndexedFrame indexedFrame ) const;
 
-    IndexedFrame getRollbackTarget ( IndexedFrame indexedFrame );
+    IndexedFrame getRollbackTarget ( IndexedFrame indexedFrame ) const;
 
-    const std::vector<Inputs>& getReinputs ( IndexedFrame indexedFrame );
+    // The returned reinputs are valid until the next call
+    std::span<const Inputs> getReinputs ( IndexedFrame indexedFrame );
 
     MsgPtr getRngState ( IndexedFrame indexedFrame );
 
     uint32_t getLastIndex() const;
 
+    // Number of frames with logged inputs in the given index
+    uint32_t getNumFrames ( uint32_t index ) const;
+
     uint32_t getLastFrame() const;
 
     MsgPtr getInitialStateBefore ( uint32_t index ) const;
 
 private:
 
+    // Per index data
+
     std::vector<uint32_t> _modes;
 
     std::vector<std::string> _states;
 
-    std::vector<std::vector<Inputs>> _inputs;
-
     std::vector<MsgPtr> _rngStates;
 
-    std::vector<std::vector<IndexedFrame>> _rollbacks;
+    std::vector<MsgPtr> _initialStates;
 
-    std::vector<std::vector<std::vector<Inputs>>> _reinputs;
+    // Number of frames with logged inputs in each index
+    std::vector<uint32_t> _numFrames;
 
-    std::vector<MsgPtr> _initialStates;
+    // Last index with logged inputs
+    uint32_t _lastIndex = 0;
+
+    // Per frame data of a text sync log, stored as columns with one row per frame.
+    // The rows of index i are [_rowOffsets[i], _rowOffsets[i + 1]), and row _rowOffsets[i] + j is frame j.
+    // Indexes are logged in order, so only the rows of the last index ever grow.
+
+    std::vector<uint32_t> _rowOffsets;
+
+    std::vector<uint16_t> _p1, _p2;
+
+    // Rollback of each row, REPLAY_NONE if that frame didn't roll back
+    std::vector<uint32_t> _rollbackOfRow;
+
+    // Target of each rollback
+    std::vector<IndexedFrame> _rollbackTargets;
+
+    // The reinputs of rollback i are [_reinputOffsets[i], _reinputOffsets[i + 1]) in _reinputs
+    std::vector<uint32_t> _reinputOffsets;
+
+    std::vector<Inputs> _reinputs;
+
+    // The mapped binary replay, the per frame data is read from it instead of the columns above
+    BinaryReplay _binary;
+
+    // Last reinputs read from the binary replay
+    std::vector<Inputs> _binaryReinputs;
+
+    // The last reinputs of each frame for a real binary replay, sorted by IndexedFrame::value
+    std::vector<Inputs> _realInputs;
+
+    bool _real = false;
+
+    bool loadBinary ( const std::string& replayFile, bool real );
+
+    // Get the row of the given frame, growing the columns if needed
+    uint32_t addRow ( IndexedFrame indexedFrame );
+
+    // Get the row of the given frame, REPLAY_NONE if it doesn't exist
+    uint32_t getRow ( IndexedFrame indexedFrame ) const;
 };
@@ -0,0 +1,295 @@
+#include "ReplayWriter.hpp"
+#include "Logger.hpp"
+
+#include <chrono>
+#include <fstream>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+
+static_assert ( sizeof ( ReplayWriter::ChunkHeader ) % 4 == 0, "Chunks must stay 4-byte aligned" );
+
+
+ReplayWriter::~ReplayWriter()
+{
+    stop();
+    closeFile();
+}
+
+bool ReplayWriter::push ( IndexedFrame indexedFrame, uint16_t p1, uint16_t p2 )
+{
+    return _queue.push ( { indexedFrame, p1, p2 } );
+}
+
+void ReplayWriter::open ( const string& file )
+{
+    start();
+    postCommand ( Command::Open, file, nullptr );
+}
+
+void ReplayWriter::close()
+{
+    postCommand ( Command::Close, "", nullptr );
+}
+
+void ReplayWriter::post ( const function<void()>& job )
+{
+    postCommand ( Command::Job, "", job );
+}
+
+void ReplayWriter::stop()
+{
+    if ( ! isRunning() )
+        return;
+
+    postCommand ( Command::Stop, "", nullptr );
+    join();
+}
+
+void ReplayWriter::postCommand ( Command::Type type, const string& file, const function<void()>& job )
+{
+    LOCK ( _mutex );
+    _commands.push_back ( { type, _queue.getPushed(), file, job } );
+    _cond.signal();
+}
+
+void ReplayWriter::run()
+{
+    auto lastSync = chrono::steady_clock::now();
+
+    for ( ;; )
+    {
+        deque<Command> commands;
+        size_t pushed;
+
+        {
+            LOCK ( _mutex );
+
+            if ( _commands.empty() )
+                _cond.wait ( _mutex, REPLAY_WRITER_POLL_MS );
+
+            commands.swap ( _commands );
+
+            // Commands posted after this point have a sequence of at least pushed
+            pushed = _queue.getPushed();
+        }
+
+        bool stop = false;
+
+        for ( const Command& command : commands )
+        {
+            writeFrames ( command.sequence );
+
+            switch ( command.type )
+            {
+                case Command::Open:
+                    closeFile();
+
+                    _fd = fopen ( command.file.c_str(), "wb" );
+
+                    if ( ! _fd )
+                        LOG ( "Failed to open '%s'", command.file );
+                    break;
+
+                case Command::Close:
+                    closeFile();
+                    break;
+
+                case Command::Job:
+                    command.job();
+                    break;
+
+                case Command::Stop:
+                    stop = true;
+                    break;
+            }
+        }
+
+        writeFrames ( pushed );
+
+        if ( stop )
+            break;
+
+        if ( chrono::steady_clock::now() - lastSync >= chrono::milliseconds ( REPLAY_WRITER_SYNC_MS ) )
+        {
+            sync();
+            lastSync = chrono::steady_clock::now();
+        }
+    }
+
+    closeFile();
+}
+
+void ReplayWriter::writeFrames ( size_t sequence )
+{
+    Frame frame;
+
+    while ( _queue.getPopped() < sequence && _queue.pop ( frame ) )
+    {
+        if ( ! _fd )
+        {
+            ++_dropped;
+            continue;
+        }
+
+        // Start a new chunk unless this frame follows the buffered ones
+        if ( _chunk.numFrames == REPLAY_WRITER_CHUNK_FRAMES
+                || ( _chunk.numFrames && ( frame.indexedFrame.parts.index != _chunk.index
+                        || frame.indexedFrame.parts.frame != _chunk.firstFrame + _chunk.numFrames ) ) )
+        {
+            writeChunk();
+        }
+
+        if ( _chunk.numFrames == 0 )
+        {
+            _chunk.index = frame.indexedFrame.parts.index;
+            _chunk.firstFrame = frame.indexedFrame.parts.frame;
+        }
+
+        _p1.push_back ( frame.p1 );
+        _p2.push_back ( frame.p2 );
+        ++_chunk.numFrames;
+    }
+}
+
+void ReplayWriter::writeChunk()
+{
+    if ( _fd && _chunk.numFrames )
+    {
+        fwrite ( &_chunk, sizeof ( _chunk ), 1, _fd );
+        fwrite ( _p1.data(), sizeof ( uint16_t ), _p1.size(), _fd );
+        fwrite ( _p2.data(), sizeof ( uint16_t ), _p2.size(), _fd );
+    }
+
+    _chunk = ChunkHeader();
+    _p1.clear();
+    _p2.clear();
+}
+
+void ReplayWriter::sync()
+{
+    writeChunk();
+
+    if ( ! _fd )
+        return;
+
+    fflush ( _fd );
+
+#ifdef _WIN32
+    _commit ( _fileno ( _fd ) );
+#else
+    fsync ( fileno ( _fd ) );
+#endif
+}
+
+void ReplayWriter::closeFile()
+{
+    sync();
+
+    if ( _fd )
+    {
+        fclose ( _fd );
+        _fd = 0;
+    }
+
+    if ( _dropped )
+    {
+        LOG ( "Dropped %u frames pushed while no file was open", _dropped );
+        _dropped = 0;
+    }
+}
+
+bool ReplayWriter::read ( const string& file, vector<Round>& rounds )
+{
+    rounds.clear();
+
+    ifstream fin ( file.c_str(), ios::in | ios::binary );
+
+    if ( ! fin.good() )
+    {
+        LOG ( "Failed to open '%s'", file );
+        return false;
+    }
+
+    ChunkHeader chunk;
+
+    while ( fin.read ( ( char * ) &chunk, sizeof ( chunk ) ) )
+    {
+        if ( chunk.magic != REPLAY_STREAM_MAGIC || chunk.numFrames > REPLAY_WRITER_CHUNK_FRAMES )
+        {
+            LOG ( "Invalid chunk in '%s', ignoring the rest of the file", file );
+            break;
+        }
+
+        if ( rounds.empty() || rounds.back().index != chunk.index )
+        {
+            rounds.push_back ( Round() );
+            rounds.back().index = chunk.index;
+        }
+
+        Round& round = rounds.back();
+
+        if ( chunk.firstFrame != round.p1.size() )
+        {
+            LOG ( "Missing frames [%u:%u] to [%u:%u] in '%s'",
+                  chunk.index, round.p1.size(), chunk.index, chunk.firstFrame, file );
+            return false;
+        }
+
+        round.p1.resize ( chunk.firstFrame + chunk.numFrames );
+        round.p2.resize ( chunk.firstFrame + chunk.numFrames );
+
+        fin.read ( ( char * ) ( round.p1.data() + chunk.firstFrame ), chunk.numFrames * sizeof ( uint16_t ) );
+        fin.read ( ( char * ) ( round.p2.data() + chunk.firstFrame ), chunk.numFrames * sizeof ( uint16_t ) );
+
+        // The last chunk was cut short, drop it
+        if ( ! fin )
+        {
+            LOG ( "Incomplete chunk at [%u:%u] in '%s'", chunk.index, chunk.firstFrame, file );
+            round.p1.resize ( chunk.firstFrame );
+            round.p2.resize ( chunk.firstFrame );
+
+            if ( round.p1.empty() )
+                rounds.pop_back();
+            break;
+        }
+    }
+
+    return true;
+}
+
+bool ReplayWriter::exportRaw ( const string& file, const string& rawFile )
+{
+    vector<Round> rounds;
+
+    if ( ! read ( file, rounds ) )
+        return false;
+
+    FILE *fd = fopen ( rawFile.c_str(), "w" );
+
+    if ( ! fd )
+    {
+        LOG ( "Failed to open '%s'", rawFile );
+        return false;
+    }
+
+    fprintf ( fd, "%u\n", uint32_t ( rounds.size() ) );
+
+    for ( const Round& round : rounds )
+    {
+        fprintf ( fd, "%u\n", uint32_t ( round.p1.size() ) );
+
+        for ( size_t i = 0; i < round.p1.size(); ++i )
+            fprintf ( fd, "%04x %04x\n", round.p1[i], round.p2[i] );
+    }
+
+    const bool good = ( ferror ( fd ) == 0 );
+    fclose ( fd );
+    return good;
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include "Constants.hpp"
+#include "SpscQueue.hpp"
+#include "Thread.hpp"
+
+#include <deque>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <functional>
+
+
+// Magic number at the start of each chunk of a replay stream file
+#define REPLAY_STREAM_MAGIC         ( 0x57434343 ) // "CCCW"
+
+// Number of frames that can be queued for the writer thread, must be a power of 2
+#define REPLAY_WRITER_QUEUE_FRAMES  ( 4096 )
+
+// Maximum number of frames in a single chunk
+#define REPLAY_WRITER_CHUNK_FRAMES  ( 600 )
+
+// How often the writer thread wakes up to drain the queue
+#define REPLAY_WRITER_POLL_MS       ( 100 )
+
+// How often the buffered frames are written out and synced to disk
+#define REPLAY_WRITER_SYNC_MS       ( 1000 )
+
+
+// Append-only writer that streams the final inputs of a match to disk from a background thread.
+//
+// The game thread pushes frames through a lock-free queue, so it never waits on the disk. The writer thread appends
+// them as chunks of contiguous frames: a ChunkHeader, then the p1 inputs, then the p2 inputs. The file is synced
+// periodically, so a crash loses at most the last REPLAY_WRITER_SYNC_MS of the match, and a chunk cut short by a crash
+// is simply ignored when reading the file back.
+//
+// open, close, and post are ordered with the frames pushed before them, and they may briefly lock a mutex, so they
+// should only be called on state transitions, not every frame.
+class ReplayWriter : public Thread
+{
+public:
+
+    struct ChunkHeader
+    {
+        uint32_t magic = REPLAY_STREAM_MAGIC;
+
+        // The frames [firstFrame, firstFrame + numFrames) of the given index
+        uint32_t index = 0, firstFrame = 0, numFrames = 0;
+    };
+
+    // The inputs of one index read back from a stream file
+    struct Round
+    {
+        uint32_t index = 0;
+        std::vector<uint16_t> p1, p2;
+    };
+
+    ~ReplayWriter();
+
+    // Queue the final inputs of a frame, returns false if the queue is full. Never blocks, producer thread only.
+    bool push ( IndexedFrame indexedFrame, uint16_t p1, uint16_t p2 );
+
+    // Start writing to a new stream file, closing the current one, starts the writer thread if needed
+    void open ( const std::string& file );
+
+    // Write out the frames pushed so far, then sync and close the stream file
+    void close();
+
+    // Run a job on the writer thread, after the frames pushed so far have been written
+    void post ( const std::function<void()>& job );
+
+    // Finish everything pushed and posted so far, then stop the writer thread
+    void stop();
+
+    // Read back a stream file, stopping at the first incomplete or invalid chunk.
+    // Returns false if the file can't be opened or the frames of an index are not contiguous.
+    static bool read ( const std::string& file, std::vector<Round>& rounds );
+
+    // Convert a stream file to the text format read by ReplayCreator::fixReplay
+    static bool exportRaw ( const std::string& file, const std::string& rawFile );
+
+    void run() override;
+
+private:
+
+    struct Frame
+    {
+        IndexedFrame indexedFrame;
+        uint16_t p1, p2;
+    };
+
+    struct Command
+    {
+        enum Type { Open, Close, Job, Stop } type;
+
+        // Number of frames pushed before this command
+        size_t sequence;
+
+        std::string file;
+
+        std::function<void()> job;
+    };
+
+    // Frames from the producer thread
+    SpscQueue<Frame, REPLAY_WRITER_QUEUE_FRAMES> _queue;
+
+    // Commands from the producer thread, protected by _mutex
+    std::deque<Command> _commands;
+
+    Mutex _mutex;
+
+    CondVar _cond;
+
+    // The rest is only used by the writer thread
+
+    // Current stream file, null if closed
+    FILE *_fd = 0;
+
+    // Chunk being buffered
+    ChunkHeader _chunk;
+    std::vector<uint16_t> _p1, _p2;
+
+    // Number of frames dropped because no file was open
+    size_t _dropped = 0;
+
+    void postCommand ( Command::Type type, const std::string& file, const std::function<void()>& job );
+
+    // Pop and buffer frames until the given number of frames have been popped
+    void writeFrames ( size_t sequence );
+
+    // Append the buffered chunk to the file
+    void writeChunk();
+
+    // Write the buffered chunk and sync the file to disk
+    void sync();
+
+    void closeFile();
+};
@@ -3,17 +3,40 @@
 #include "Timer.hpp"
 #include "Socket.hpp"
 #include "Constants.hpp"
+#include "BroadcastCache.hpp"
+#include "RelayTree.hpp"
+#include "Histogram.hpp"
 
 #include <unordered_map>
+#include <vector>
 #include <list>
 
 
 // Default pending socket timeout
 #define DEFAULT_PENDING_TIMEOUT ( 20000 )
 
+// The maximum number of spectators allowed for ClientMode::Spectate
+#define MAX_SPECTATORS          ( 15 )
+
+// Number of spectator broadcasts between each log of the broadcast stats
+#define SPECTATOR_STATS_SAMPLES ( 1000 )
+
+// Maximum number of frames of inputs sent each frame to a spectator that is catching up
+#define SPECTATE_HISTORY_FRAMES ( 1800 )
+
+// Bytes waiting to be sent to a spectator before it is downgraded to catching up, ie fewer, larger sends
+#define SPECTATOR_QUEUE_DOWNGRADE_BYTES ( 64 * 1024 )
+
+// Milliseconds the oldest bytes can wait to be sent to a spectator before it is dropped
+#define SPECTATOR_QUEUE_DROP_AGE        ( 10000 )
+
+// Bytes waiting to be sent to a spectator before it is dropped
+#define SPECTATOR_QUEUE_DROP_BYTES      ( 1024 * 1024 )
+
 
 // Forward declarations
 struct RngState;
+struct RelayUpdate;
 struct NetplayManager;
 struct ProcessManager;
 
@@ -26,6 +49,15 @@ struct Spectator
 
     bool sentRngState = false, sentRetryMenuIndex = false;
 
+    // Late-joining spectators are sent the history in bulk until they reach the live inputs
+    bool catchingUp = true;
+
+    // When catching up started, and the number of bytes sent since then
+    uint64_t catchUpStartTime = 0, catchUpBytes = 0;
+
+    // Number of times this spectator's send queue got too long
+    uint32_t numDowngrades = 0;
+
     IpAddrPort serverAddr;
 
     std::list<Socket *>::iterator it;
@@ -59,15 +91,50 @@ public:
 
     void pushSpectator ( Socket *socket, const IpAddrPort& serverAddr );
 
+    // Add a spectator that was already watching under another relay, it is sent the inputs from the given pos
+    void resumeSpectator ( Socket *socket, const IpAddrPort& serverAddr, IndexedFrame pos );
+
     void popSpectator ( Socket *socket );
 
     const IpAddrPort& getRandomSpectatorAddress() const;
 
 
+    // Make this the root of the spectator relay tree, which places every spectator that joins the tree
+    void setRelayRoot ( uint32_t capacity );
+
+    bool isRelayRoot() const { return _isRelayRoot; }
+
+    // Get the address of the relay chosen by the relay tree for a new spectator, or a random spectator if it is full
+    const IpAddrPort& getRelayRedirectAddress();
+
+    // Check if a spectator was moved when its relay left, and get the address of its new relay, which is NullAddress
+    // for the root. This forgets the move.
+    bool popRelayMove ( const IpAddrPort& serverAddr, IpAddrPort& parent );
+
+    // Check if any spectators are waiting to be redirected under their new relay
+    bool hasRelayMoves() const { return !_relayMoves.empty(); }
+
+    // Handle a relay update from a spectator, returns the update to forward to the parent if this isn't the root
+    MsgPtr relayUpdated ( Socket *socket, const RelayUpdate& relayUpdate );
+
+    // Handle a spectator leaving, returns the update to forward to the parent if this isn't the root
+    MsgPtr relayLeft ( Socket *socket );
+
+    // Send new inputs to the spectators that are waiting for them, so inputs are relayed without waiting for the
+    // next broadcast interval. Only sends inputs within each spectator's current transition index.
+    void forwardToSpectators();
+
+
     void newRngState ( const RngState& rngState );
 
     void frameStepSpectators();
 
+    // Get the number of bytes waiting to be sent to each spectator
+    std::unordered_map<Socket *, size_t> getSendQueueDepths() const;
+
+    // Get the spectators that stopped receiving, these should be disconnected by the caller
+    std::vector<Socket *> popDroppedSpectators();
+
 private:
 
     std::unordered_map<Socket *, SocketPtr> _pendingSockets;
@@ -86,6 +153,54 @@ private:
 
     uint32_t _currentMinIndex = UINT_MAX;
 
+    BroadcastCache _broadcastCache;
+
+#ifndef RELEASE
+    // Microseconds spent sending each broadcast to a spectator
+    Histogram<20, true> _broadcastUs;
+#endif // NOT RELEASE
+
+    bool _isRelayRoot = false;
+
+    RelayTree _relayTree;
+
+    std::unordered_map<IpAddrPort, uint32_t> _relayNodes;
+
+    std::unordered_map<uint32_t, IpAddrPort> _relayAddresses;
+
+    struct RelayMove
+    {
+        // Server address of the new parent, NullAddress for the root
+        IpAddrPort parent;
+
+        // When the spectator was moved
+        uint64_t time = 0;
+    };
+
+    // Mapping: server address of a spectator whose relay left -> where it was moved in the relay tree
+    std::unordered_map<IpAddrPort, RelayMove> _relayMoves;
+
+    void updateRelayTree ( const RelayUpdate& relayUpdate );
+
+    // Remove the spectators that were moved, but haven't rejoined under their new relay in time
+    void expireRelayMoves ( uint64_t now );
+
+    // Add a spectator at the given pos, returns false if the socket isn't pending
+    bool addSpectator ( Socket *socket, const IpAddrPort& serverAddr, IndexedFrame pos );
+
+    // Send the next chunk of history to a spectator that is catching up
+    void catchUpSpectator ( Socket *socket, Spectator& spectator );
+
+    // Send the RngState and retry menu index of the given index once each
+    void sendIndexState ( Socket *socket, Spectator& spectator, uint32_t oldIndex );
+
+    // Spectators that stopped receiving, waiting to be disconnected
+    std::vector<Socket *> _droppedSpectators;
+
+    // Check the spectator's send queue, downgrading or dropping it if it is too slow.
+    // Returns false if nothing should be sent to the spectator right now.
+    bool checkSendQueue ( Socket *socket, Spectator& spectator );
+
     NetplayManager *_netManPtr = 0;
 
     const ProcessManager *_procManPtr = 0;
@@ -0,0 +1,319 @@
+#include "SyncTrace.hpp"
+#include "NetplayStates.hpp"
+#include "StringUtils.hpp"
+
+#include <algorithm>
+#include <unordered_map>
+#include <cstring>
+
+using namespace std;
+
+
+static_assert ( sizeof ( SyncTrace::Header ) == 16, "Headers must not have padding" );
+static_assert ( sizeof ( SyncTrace::Character ) == 15 * 4, "Payloads must not have padding" );
+static_assert ( sizeof ( SyncTrace::Rollback ) == 16, "Payloads must not have padding" );
+
+
+SyncTrace::~SyncTrace()
+{
+    close();
+}
+
+bool SyncTrace::open ( const string& file )
+{
+    close();
+
+    _fd = fopen ( file.c_str(), "wb" );
+
+    if ( ! _fd )
+        return false;
+
+    const uint32_t header[2] = { SYNC_TRACE_MAGIC, SYNC_TRACE_VERSION };
+    fwrite ( header, sizeof ( header ), 1, _fd );
+
+    _buffer.reserve ( SYNC_TRACE_BUFFER_SIZE );
+    return true;
+}
+
+void SyncTrace::close()
+{
+    if ( ! _fd )
+        return;
+
+    flush();
+    fclose ( _fd );
+    _fd = 0;
+}
+
+void SyncTrace::flush()
+{
+    if ( ! _fd )
+        return;
+
+    if ( ! _buffer.empty() )
+        fwrite ( &_buffer[0], _buffer.size(), 1, _fd );
+
+    fflush ( _fd );
+    _buffer.clear();
+}
+
+size_t SyncTrace::getPayloadSize ( Type type )
+{
+    switch ( type )
+    {
+        case Type::Inputs:
+        case Type::Reinputs:
+        case Type::RollbackingInputs:
+            return sizeof ( Inputs );
+
+        case Type::RngState:
+            return sizeof ( RngState );
+
+        case Type::CharaSelect:
+            return sizeof ( CharaSelect );
+
+        case Type::Character:
+            return sizeof ( Character );
+
+        case Type::Round:
+            return sizeof ( Round );
+
+        case Type::Rollback:
+        case Type::RollbackFailed:
+            return sizeof ( Rollback );
+
+        case Type::RollbackInputsDone:
+            return 1;
+
+        default:
+            return 0;
+    }
+}
+
+// Read a payload, which may not be aligned in the file
+template<typename T>
+static T readPayload ( const char *payload )
+{
+    T t;
+    memcpy ( &t, payload, sizeof ( t ) );
+    return t;
+}
+
+string SyncTrace::decode ( const Header& header, const char *payload )
+{
+    // Same as the LOG_SYNC prefix
+    const string prefix = format ( "%s [%u] %s [%s]", gameModeStr ( header.gameMode ), header.gameMode,
+                                   NetplayState ( ( NetplayState::Enum ) header.netplayState ), header.indexedFrame );
+
+    switch ( header.type )
+    {
+        case Type::Inputs:
+        case Type::Reinputs:
+        case Type::RollbackingInputs:
+        {
+            const Inputs inputs = readPayload<Inputs> ( payload );
+            const char *name = ( header.type == Type::Inputs ? "Inputs:"
+                                 : header.type == Type::Reinputs ? "Reinputs:" : "rollbacking input:" );
+            return format ( "%s %s 0x%04x 0x%04x", prefix, name, inputs.p1, inputs.p2 );
+        }
+
+        case Type::RngState:
+        {
+            const RngState rng = readPayload<RngState> ( payload );
+            return prefix + " RngState: "
+                   + formatAsHex ( &rng.rngState0, sizeof ( rng.rngState0 ) ) + " "
+                   + formatAsHex ( &rng.rngState1, sizeof ( rng.rngState1 ) ) + " "
+                   + formatAsHex ( &rng.rngState2, sizeof ( rng.rngState2 ) ) + " "
+                   + formatAsHex ( rng.rngState3, sizeof ( rng.rngState3 ) );
+        }
+
+        case Type::CharaSelect:
+        {
+            const CharaSelect cs = readPayload<CharaSelect> ( payload );
+            return format ( "%s P1: sel=%u; C=%u; M=%u; c=%u; P2: sel=%u; C=%u; M=%u; c=%u", prefix,
+                            cs.selector[0], cs.chara[0], cs.moon[0], cs.color[0],
+                            cs.selector[1], cs.chara[1], cs.moon[1], cs.color[1] );
+        }
+
+        case Type::Character:
+        {
+            const Character c = readPayload<Character> ( payload );
+            return format ( "%s P%u: C=%u; M=%u; c=%u; seq=%u; st=%u; hp=%u; rh=%u; gb=%.1f; gq=%.1f; mt=%u; ht=%u; "
+                            "x=%d; y=%d; f=%d", prefix, c.player, c.chara, c.moon, c.color, c.sequence, c.seqState,
+                            c.health, c.redHealth, c.guardBar, c.guardQuality, c.meter, c.heat, c.x, c.y, c.facing );
+        }
+
+        case Type::Round:
+        {
+            const Round r = readPayload<Round> ( payload );
+            return format ( "%s roundOverTimer=%d; introState=%u; roundTimer=%u; realTimer=%u; hitsparks=%u; "
+                            "camera={ %d, %d }", prefix, r.roundOverTimer, r.introState, r.roundTimer, r.realTimer,
+                            r.hitSparks, r.cameraX, r.cameraY );
+        }
+
+        case Type::Rollback:
+        {
+            const Rollback r = readPayload<Rollback> ( payload );
+            return format ( "%s Rollback: target=[%s]; actual=[%s]", prefix, r.target, r.actual );
+        }
+
+        case Type::RollbackFailed:
+            return format ( "%s Rollback to target=[%s] failed!", prefix, readPayload<Rollback> ( payload ).target );
+
+        case Type::RollbackInputsDone:
+            return prefix + " rollback inputs done";
+
+        default:
+            return prefix + format ( " Unknown record type %u", ( uint32_t ) header.type );
+    }
+}
+
+
+bool SyncTraceReader::open ( const string& file )
+{
+    _pos = 0;
+
+    if ( ! _file.open ( file ) )
+        return false;
+
+    uint32_t header[2];
+
+    if ( _file.size() < sizeof ( header ) )
+        return false;
+
+    memcpy ( header, _file.data(), sizeof ( header ) );
+
+    if ( header[0] != SYNC_TRACE_MAGIC || header[1] != SYNC_TRACE_VERSION )
+        return false;
+
+    _pos = sizeof ( header );
+    return true;
+}
+
+bool SyncTraceReader::next ( SyncTrace::Header& header, const char *& payload )
+{
+    if ( ! _file.isOpen() || _pos + sizeof ( header ) > _file.size() )
+        return false;
+
+    memcpy ( &header, _file.data() + _pos, sizeof ( header ) );
+
+    const size_t size = SyncTrace::getPayloadSize ( header.type );
+
+    if ( size == 0 || _pos + sizeof ( header ) + size > _file.size() )
+        return false;
+
+    payload = _file.data() + _pos + sizeof ( header );
+    _pos += sizeof ( header ) + size;
+    return true;
+}
+
+
+// Records compared per frame, the last one of each kind is the state after any rollbacks
+enum FrameSlot { InputsSlot, RngStateSlot, CharaSelectSlot, Player1Slot, Player2Slot, RoundSlot, NumSlots };
+
+struct TracedFrame
+{
+    // Offset of the header of each record, 0 if none
+    size_t records[NumSlots] = {};
+};
+
+static int getFrameSlot ( const SyncTrace::Header& header, const char *payload )
+{
+    switch ( header.type )
+    {
+        case SyncTrace::Type::Inputs:
+        case SyncTrace::Type::Reinputs:
+            return InputsSlot;
+
+        case SyncTrace::Type::RngState:
+            return RngStateSlot;
+
+        case SyncTrace::Type::CharaSelect:
+            return CharaSelectSlot;
+
+        case SyncTrace::Type::Character:
+            return ( readPayload<SyncTrace::Character> ( payload ).player == 1 ? Player1Slot : Player2Slot );
+
+        case SyncTrace::Type::Round:
+            return RoundSlot;
+
+        default:
+            return -1;
+    }
+}
+
+static bool readFrames ( const string& file, SyncTraceReader& reader, unordered_map<uint64_t, TracedFrame>& frames )
+{
+    if ( ! reader.open ( file ) )
+        return false;
+
+    SyncTrace::Header header;
+    const char *payload;
+
+    while ( reader.next ( header, payload ) )
+    {
+        const int slot = getFrameSlot ( header, payload );
+
+        if ( slot >= 0 )
+            frames[header.indexedFrame.value].records[slot] = ( payload - sizeof ( header ) ) - reader.data();
+    }
+
+    return true;
+}
+
+bool SyncTrace::diff ( const string& file1, const string& file2, Divergence& divergence )
+{
+    SyncTraceReader reader1, reader2;
+    unordered_map<uint64_t, TracedFrame> frames1, frames2;
+
+    if ( ! readFrames ( file1, reader1, frames1 ) || ! readFrames ( file2, reader2, frames2 ) )
+        return false;
+
+    vector<uint64_t> common;
+    common.reserve ( min ( frames1.size(), frames2.size() ) );
+
+    for ( const auto& kv : frames1 )
+    {
+        if ( frames2.count ( kv.first ) )
+            common.push_back ( kv.first );
+    }
+
+    sort ( common.begin(), common.end() );
+
+    divergence = Divergence();
+    divergence.numFrames = common.size();
+
+    for ( uint64_t frame : common )
+    {
+        const TracedFrame& f1 = frames1[frame];
+        const TracedFrame& f2 = frames2[frame];
+
+        for ( int slot = 0; slot < NumSlots; ++slot )
+        {
+            if ( ! f1.records[slot] || ! f2.records[slot] )
+                continue;
+
+            Header h1, h2;
+            memcpy ( &h1, reader1.data() + f1.records[slot], sizeof ( h1 ) );
+            memcpy ( &h2, reader2.data() + f2.records[slot], sizeof ( h2 ) );
+
+            const char *p1 = reader1.data() + f1.records[slot] + sizeof ( h1 );
+            const char *p2 = reader2.data() + f2.records[slot] + sizeof ( h2 );
+
+            // Inputs and reinputs are the same record, so only compare the prefix fields and the payload
+            if ( h1.gameMode == h2.gameMode && h1.netplayState == h2.netplayState
+                    && memcmp ( p1, p2, getPayloadSize ( h1.type ) ) == 0 )
+            {
+                continue;
+            }
+
+            divergence.diverged = true;
+            divergence.indexedFrame.value = frame;
+            divergence.first = decode ( h1, p1 );
+            divergence.second = decode ( h2, p2 );
+            return true;
+        }
+    }
+
+    return true;
+}
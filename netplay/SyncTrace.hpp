@@ -0,0 +1,169 @@
+#pragma once
+
+#include "Constants.hpp"
+#include "MappedFile.hpp"
+
+#include <string>
+#include <vector>
+#include <cstdio>
+
+
+// Magic number at the start of a sync trace file
+#define SYNC_TRACE_MAGIC            ( 0x54434343 ) // "CCCT"
+
+// Current sync trace file version
+#define SYNC_TRACE_VERSION          ( 1 )
+
+// Bytes of records buffered before they are written to the file
+#define SYNC_TRACE_BUFFER_SIZE      ( 256 * 1024 )
+
+
+// Binary trace of the per-frame game state that used to be logged as text to sync.log.
+//
+// Each record is a fixed size Header, with the same game mode, netplay state, and frame that prefixed every sync.log
+// line, then a fixed size payload for its type. Records are buffered in memory and written in large blocks, so
+// tracing every frame costs a few memcpys. decode turns a record back into the exact text sync.log had.
+class SyncTrace
+{
+public:
+
+    enum class Type : uint8_t
+    {
+        Inputs, Reinputs, RollbackingInputs, RngState, CharaSelect, Character, Round, Rollback, RollbackFailed,
+        RollbackInputsDone, Count
+    };
+
+    // Game mode, netplay state, and frame when a record was added
+    struct Prefix
+    {
+        uint32_t gameMode;
+        uint8_t netplayState;
+        IndexedFrame indexedFrame;
+    };
+
+    struct Header
+    {
+        Type type;
+        uint8_t netplayState;
+        uint16_t reserved;
+        uint32_t gameMode;
+        IndexedFrame indexedFrame;
+    };
+
+    struct Inputs
+    {
+        uint16_t p1, p2;
+    };
+
+    struct RngState
+    {
+        uint32_t rngState0, rngState1, rngState2;
+        char rngState3[CC_RNG_STATE3_SIZE];
+    };
+
+    struct CharaSelect
+    {
+        uint32_t selector[2], chara[2], moon[2], color[2];
+    };
+
+    struct Character
+    {
+        uint32_t player, chara, moon, color, sequence, seqState, health, redHealth;
+        float guardBar, guardQuality;
+        uint32_t meter, heat;
+        int32_t x, y, facing;
+    };
+
+    struct Round
+    {
+        int32_t roundOverTimer;
+        uint32_t introState, roundTimer, realTimer, hitSparks;
+        int32_t cameraX, cameraY;
+    };
+
+    // The header has the state before the rollback
+    struct Rollback
+    {
+        IndexedFrame target, actual;
+    };
+
+    ~SyncTrace();
+
+    // Start a new trace file, closing the current one
+    bool open ( const std::string& file );
+
+    // Write out the buffered records and close the file
+    void close();
+
+    bool isOpen() const { return _fd != 0; }
+
+    // Write out the buffered records
+    void flush();
+
+    // Add a record, the payload type must match the record type
+    template<typename T>
+    void write ( Type type, const Prefix& prefix, const T& payload )
+    {
+        if ( ! _fd )
+            return;
+
+        const Header header = { type, prefix.netplayState, 0, prefix.gameMode, prefix.indexedFrame };
+
+        if ( _buffer.size() + sizeof ( header ) + sizeof ( payload ) > SYNC_TRACE_BUFFER_SIZE )
+            flush();
+
+        _buffer.insert ( _buffer.end(), ( const char * ) &header, ( const char * ) ( &header + 1 ) );
+        _buffer.insert ( _buffer.end(), ( const char * ) &payload, ( const char * ) ( &payload + 1 ) );
+    }
+
+    // First difference between the traces of two peers
+    struct Divergence
+    {
+        // Frames with records in both traces
+        size_t numFrames = 0;
+
+        bool diverged = false;
+
+        // First frame with a different record, and both versions of the record decoded
+        IndexedFrame indexedFrame = {{ 0, 0 }};
+        std::string first, second;
+    };
+
+    // Size of the payload of a record type, 0 if invalid
+    static size_t getPayloadSize ( Type type );
+
+    // Format a record as the line that was logged to sync.log
+    static std::string decode ( const Header& header, const char *payload );
+
+    // Align two traces by frame and find the first frame where the final state differs, after any rollbacks.
+    // Only the records that both traces have for a frame are compared. Returns false if either file can't be read.
+    static bool diff ( const std::string& file1, const std::string& file2, Divergence& divergence );
+
+private:
+
+    FILE *_fd = 0;
+
+    std::vector<char> _buffer;
+};
+
+
+// Reads the records of a sync trace file in order
+class SyncTraceReader
+{
+public:
+
+    // Open a trace file, returns false if it can't be opened or isn't a sync trace
+    bool open ( const std::string& file );
+
+    // Get the next record, returns false at the end of the file or at a truncated record
+    bool next ( SyncTrace::Header& header, const char *& payload );
+
+    // Start of the mapped file, payloads stay valid while the reader is open
+    const char *data() const { return _file.data(); }
+
+private:
+
+    MappedFile _file;
+
+    size_t _pos = 0;
+};
@@ -0,0 +1,53 @@
+#include "TimeSync.hpp"
+
+#include <algorithm>
+
+using namespace std;
+
+
+void TimeSync::addLocalAdvantage ( int frames )
+{
+    _local.set ( frames );
+}
+
+void TimeSync::setRemoteAdvantage ( float frames )
+{
+    _remote = frames;
+    _hasRemote = true;
+}
+
+float TimeSync::getFrameAdvantage() const
+{
+    if ( ! isReady() )
+        return 0.0f;
+
+    return ( getLocalAdvantage() - _remote ) / 2;
+}
+
+uint32_t TimeSync::getSlowdownFrames ( float minFrames, uint32_t maxFrames ) const
+{
+    const float advantage = getFrameAdvantage();
+
+    if ( advantage < minFrames )
+        return 0;
+
+    return min ( uint32_t ( advantage + 0.5f ), maxFrames );
+}
+
+double TimeSync::getRateAdjust ( float minFrames, uint32_t intervalFrames, double maxAdjust ) const
+{
+    const float advantage = getFrameAdvantage();
+
+    if ( advantage <= 0.0f || advantage >= minFrames )
+        return 1.0;
+
+    // Take the time of intervalFrames + advantage to render intervalFrames
+    return max ( 1.0 - maxAdjust, intervalFrames / ( intervalFrames + double ( advantage ) ) );
+}
+
+void TimeSync::reset()
+{
+    _local.reset();
+    _remote = 0.0f;
+    _hasRemote = false;
+}
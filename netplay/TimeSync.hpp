@@ -0,0 +1,61 @@
+#pragma once
+
+#include "RollingAverage.hpp"
+
+#include <cstdint>
+
+
+// Number of frame advantage samples to average
+#define TIME_SYNC_WINDOW ( 40 )
+
+
+// Estimates how many frames the local game is running ahead of the remote game, like GGPO's time sync.
+//
+// Each side samples its frame advantage (local frame - remote frame) whenever remote inputs arrive, and periodically
+// sends its average to the other side. Each sample is offset by the one way network latency, so the latency cancels
+// out when comparing the local and remote averages, and half the difference is how far ahead the local game is.
+class TimeSync
+{
+public:
+
+    // Add a local frame advantage sample, taken when remote inputs arrive
+    void addLocalAdvantage ( int frames );
+
+    // Set the latest average frame advantage sent by the remote side
+    void setRemoteAdvantage ( float frames );
+
+    // Get the average local / remote frame advantage
+    float getLocalAdvantage() const { return _local.get(); }
+    float getRemoteAdvantage() const { return _remote; }
+
+    // True once there are enough local samples to send the local average
+    bool hasLocalAdvantage() const { return _local.full(); }
+
+    // True once there are enough local samples, and a remote average
+    bool isReady() const { return ( _local.full() && _hasRemote ); }
+
+    // Get the estimated number of frames the local game is ahead, negative if behind
+    float getFrameAdvantage() const;
+
+    // Get the number of frames the local game should slow down by, rounded and limited to maxFrames.
+    // Returns 0 if not ready, or if the local game is less than minFrames ahead.
+    uint32_t getSlowdownFrames ( float minFrames, uint32_t maxFrames ) const;
+
+    // Get the frame rate factor to shed less than minFrames of advantage over intervalFrames, limited to
+    // 1 - maxAdjust. Returns 1 if not ready, if not ahead, or if getSlowdownFrames would slow down instead.
+    double getRateAdjust ( float minFrames, uint32_t intervalFrames, double maxAdjust ) const;
+
+    // Clear all samples, eg. after slowing down, since the old samples no longer apply
+    void reset();
+
+private:
+
+    // Rolling average of the local frame advantage samples
+    RollingAverage<float, TIME_SYNC_WINDOW> _local;
+
+    // Latest average frame advantage sent by the remote side
+    float _remote = 0.0f;
+
+    // Indicates if a remote average has been received since the last reset
+    bool _hasRemote = false;
+};
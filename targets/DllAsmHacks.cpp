@@ -159,7 +159,9 @@ static void loadingStateColorCb2 ( uint32_t *singlePaletteData )
 
 extern "C" void saveReplayCb()
 {
-    //netManPtr->exportInputs();
+    // Only hands the replay off to the writer thread, so this doesn't hitch the retry menu
+    if ( netManPtr )
+        netManPtr->exportInputs();
 }
 
 extern "C" void loadingStateColorCb()
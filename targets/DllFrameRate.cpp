@@ -3,9 +3,14 @@
 #include "Constants.hpp"
 #include "ProcessManager.hpp"
 #include "DllAsmHacks.hpp"
+#include "FramePacer.hpp"
 
+#include <windows.h>
+#include <mmsystem.h>
 #include <d3dx9.h>
 
+#include <algorithm>
+
 using namespace std;
 using namespace DllFrameRate;
 
@@ -19,6 +24,25 @@ double actualFps = 60.0;
 
 bool isEnabled = false;
 
+// Lowered FPS used while slowing down, and the number of rendered frames left to slow down for
+static double slowdownFps = 60.0;
+
+static uint32_t slowdownFramesLeft = 0;
+
+static uint64_t getNowUs()
+{
+    return TimerManager::get().getNowMicroseconds();
+}
+
+static void sleepMs ( uint32_t milliseconds )
+{
+    timeBeginPeriod ( 1 ); // for Sleep
+    Sleep ( milliseconds );
+    timeEndPeriod ( 1 ); // for Sleep
+}
+
+static FramePacer pacer ( getNowUs, sleepMs );
+
 
 void enable()
 {
@@ -34,55 +58,75 @@ void enable()
     LOG ( "Enabling FPS control!" );
 }
 
+bool slowDown ( uint32_t frames, uint32_t spreadFrames )
+{
+    if ( ! isEnabled )
+        return false;
+
+    if ( frames == 0 || spreadFrames == 0 )
+    {
+        slowdownFramesLeft = 0;
+        return true;
+    }
+
+    // Take the time of spreadFrames + frames to render spreadFrames
+    slowdownFps = desiredFps * spreadFrames / ( spreadFrames + frames );
+    slowdownFramesLeft = spreadFrames;
+
+    LOG ( "Slowing down %u frames over %u frames: slowdownFps=%.2f", frames, spreadFrames, slowdownFps );
+    return true;
 }
 
+bool isSlowingDown()
+{
+    return ( slowdownFramesLeft > 0 );
+}
 
-void PresentFrameEnd ( IDirect3DDevice9 *device )
+void setRateAdjust ( double factor )
 {
-    if ( !isEnabled || *CC_SKIP_FRAMES_ADDR )
-        return;
+    if ( factor != pacer.getRateAdjust() )
+        LOG ( "rateAdjust=%.4f", factor );
 
-    static uint64_t last1f = 0, last5f = 0, last30f = 0, last60f = 0;
-    static uint8_t counter = 0;
+    pacer.setRateAdjust ( factor );
+}
 
-    ++counter;
+string getStatsSummary()
+{
+    return pacer.getStatsSummary();
+}
 
-    uint64_t now = TimerManager::get().getNow ( true );
+void resetStats()
+{
+    pacer.resetStats();
+}
 
-    /**
-     * The best timer resolution is only in milliseconds, and we need to make
-     * sure the spacing between frames is as close to even as possible.
-     *
-     * What this code does is check every 30f, 5f, and 1f how many milliseconds have
-     * passed since the last check and make sure we are close to or under the desired FPS.
-     */
-    if ( counter % 30 == 0 )
-    {
-        while ( now - last30f < ( 30 * 1000 ) / desiredFps )
-            now = TimerManager::get().getNow ( true );
+}
 
-        last30f = now;
-    }
-    else if ( counter % 5 == 0 )
-    {
-        while ( now - last5f < ( 5 * 1000 ) / desiredFps )
-            now = TimerManager::get().getNow ( true );
 
-        last5f = now;
-    }
-    else
+void PresentFrameEnd ( IDirect3DDevice9 *device )
+{
+    if ( !isEnabled || *CC_SKIP_FRAMES_ADDR || !TimerManager::get().isInitialized() )
+        return;
+
+    double fps = desiredFps;
+
+    if ( slowdownFramesLeft )
     {
-        while ( now - last1f < 1000 / desiredFps )
-            now = TimerManager::get().getNow ( true );
+        fps = min ( desiredFps, slowdownFps );
+        --slowdownFramesLeft;
     }
 
-    last1f = now;
+    pacer.setTargetFps ( fps );
+    pacer.waitForNextFrame();
+
+    static uint64_t last60f = 0;
+    static uint8_t counter = 0;
 
-    if ( counter >= 60 )
+    if ( ++counter >= 60 )
     {
-        now = TimerManager::get().getNow ( true );
+        const uint64_t now = getNowUs();
 
-        actualFps = 1000.0 / ( ( now - last60f ) / 60.0 );
+        actualFps = 1000000.0 / ( ( now - last60f ) / 60.0 );
 
         *CC_FPS_COUNTER_ADDR = uint32_t ( actualFps + 0.5 );
 
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <string>
 #include <cstdint>
 
 
@@ -12,4 +13,19 @@ extern double actualFps;
 
 void enable();
 
+// Slow down by the given number of frames, spread evenly over the next spreadFrames rendered frames.
+// This replaces any slowdown that is still in progress. Returns false if FPS control isn't enabled.
+bool slowDown ( uint32_t frames, uint32_t spreadFrames );
+
+// True if a slowdown is still in progress
+bool isSlowingDown();
+
+// Nudge the frame rate by a factor, limited to 1 +/- FRAME_PACER_MAX_ADJUST, eg. 0.999 for 59.94 fps.
+// This applies on top of desiredFps and any slowdown, until it is set back to 1.
+void setRateAdjust ( double factor );
+
+// Get / reset the frame time statistics
+std::string getStatsSummary();
+void resetStats();
+
 }
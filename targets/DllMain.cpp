@@ -14,10 +14,14 @@
 #include "SpectatorManager.hpp"
 #include "DllControllerManager.hpp"
 #include "DllFrameRate.hpp"
+#include "FramePacer.hpp"
 #include "ReplayManager.hpp"
 #include "DllRollbackManager.hpp"
 #include "DllTrialManager.hpp"
+#include "TimeSync.hpp"
+#include "DelayTuner.hpp"
 #include "ExternalIpAddress.hpp"
+#include "SyncTrace.hpp"
 
 #include <windows.h>
 
@@ -31,6 +35,25 @@ using namespace std;
 // The main log file path
 #define LOG_FILE                    FOLDER "dll.log"
 
+// The number of frames between exchanging frame advantages, this is also how long each slowdown is spread over
+#define TIME_SYNC_INTERVAL          ( 60 )
+
+// The minimum and maximum number of frames to slow down by per TIME_SYNC_INTERVAL
+#define TIME_SYNC_MIN_FRAMES        ( 1.0f )
+#define TIME_SYNC_MAX_FRAMES        ( 6 )
+
+// The number of frames between latency probes, for automatic delay tuning
+#define DELAY_TUNER_PROBE_INTERVAL  ( 30 )
+
+// The max delay chosen by automatic delay tuning
+#define DELAY_TUNER_MAX_DELAY       ( 9 )
+
+// Rollback cost statistics are appended to this file at the end of each match
+#define ROLLBACK_STATS_FILE         FOLDER "rollback_stats.log"
+
+// The number of milliseconds to show the rollback cost statistics on the overlay
+#define ROLLBACK_STATS_TIMEOUT      ( 10000 )
+
 // The number of milliseconds to poll for events each frame
 #define POLL_TIMEOUT                ( 3 )
 
@@ -49,9 +72,6 @@ using namespace std;
 // The maximum number of milliseconds to wait for inputs before timeout
 #define MAX_WAIT_INPUTS_INTERVAL    ( 10000 )
 
-// The maximum number of spectators allowed for ClientMode::Spectate
-#define MAX_SPECTATORS              ( 15 )
-
 // The maximum number of spectators allowed for ClientMode::Host/Client
 #define MAX_ROOT_SPECTATORS         ( 1 )
 
@@ -66,13 +86,28 @@ using namespace std;
              gameModeStr ( *CC_GAME_MODE_ADDR ), *CC_GAME_MODE_ADDR,                                                \
              netMan.getState(), netMan.getIndexedFrame(), ## __VA_ARGS__ )
 
-#define LOG_SYNC_CHARACTER(N)                                                                                       \
-    LOG_SYNC ( "P%u: C=%u; M=%u; c=%u; seq=%u; st=%u; hp=%u; rh=%u; gb=%.1f; gq=%.1f; mt=%u; ht=%u; x=%d; y=%d; f=%d",    \
-               N, *CC_P ## N ## _CHARACTER_ADDR, *CC_P ## N ## _MOON_SELECTOR_ADDR,                                 \
-               *CC_P ## N ## _COLOR_SELECTOR_ADDR, *CC_P ## N ## _SEQUENCE_ADDR, *CC_P ## N ## _SEQ_STATE_ADDR,     \
-               *CC_P ## N ## _HEALTH_ADDR, *CC_P ## N ## _RED_HEALTH_ADDR, *CC_P ## N ## _GUARD_BAR_ADDR,           \
-               *CC_P ## N ## _GUARD_QUALITY_ADDR,  *CC_P ## N ## _METER_ADDR, *CC_P ## N ## _HEAT_ADDR,             \
-               *CC_P ## N ## _X_POSITION_ADDR, *CC_P ## N ## _Y_POSITION_ADDR, *CC_P ## N ## _FACING_FLAG_ADDR)
+// Current game mode, netplay state, and frame for the sync trace
+#define SYNC_TRACE_PREFIX                                                                                           \
+    SyncTrace::Prefix { *CC_GAME_MODE_ADDR, netMan.getState().value, netMan.getIndexedFrame() }
+
+#define SYNC_TRACE(TYPE, ...)                                                                                       \
+    syncTrace.write ( SyncTrace::Type::TYPE, SYNC_TRACE_PREFIX, __VA_ARGS__ )
+
+#define SYNC_TRACE_INPUTS(TYPE)                                                                                     \
+    SYNC_TRACE ( TYPE, SyncTrace::Inputs { netMan.getRawInput ( 1 ), netMan.getRawInput ( 2 ) } )
+
+#define SYNC_TRACE_CHARACTER(N)                                                                                     \
+    SYNC_TRACE ( Character, SyncTrace::Character {                                                                  \
+        N, *CC_P ## N ## _CHARACTER_ADDR, *CC_P ## N ## _MOON_SELECTOR_ADDR,                                        \
+        *CC_P ## N ## _COLOR_SELECTOR_ADDR, *CC_P ## N ## _SEQUENCE_ADDR, *CC_P ## N ## _SEQ_STATE_ADDR,            \
+        *CC_P ## N ## _HEALTH_ADDR, *CC_P ## N ## _RED_HEALTH_ADDR, *CC_P ## N ## _GUARD_BAR_ADDR,                  \
+        *CC_P ## N ## _GUARD_QUALITY_ADDR,  *CC_P ## N ## _METER_ADDR, *CC_P ## N ## _HEAT_ADDR,                    \
+        *CC_P ## N ## _X_POSITION_ADDR, *CC_P ## N ## _Y_POSITION_ADDR, *CC_P ## N ## _FACING_FLAG_ADDR } )
+
+#define SYNC_TRACE_ROUND()                                                                                          \
+    SYNC_TRACE ( Round, SyncTrace::Round { roundOverTimer, *CC_INTRO_STATE_ADDR, *CC_ROUND_TIMER_ADDR,              \
+                                           *CC_REAL_TIMER_ADDR, *CC_HIT_SPARKS_ADDR, *CC_CAMERA_X_ADDR,             \
+                                           *CC_CAMERA_Y_ADDR } )
 
 
 // Main application state
@@ -112,6 +147,9 @@ struct DllMain
     // DllTrialManager instance
     DllTrialManager trialMan;
 
+    // Binary trace of the per-frame state, next to the text sync log
+    SyncTrace syncTrace;
+
     // If remote has loaded up to character select
     bool remoteCharaSelectLoaded = false;
 
@@ -165,15 +203,53 @@ struct DllMain
     bool spectateFastFwd = true;
     bool spectateHardSync = false;
 
+    // If new spectators are sent the current game state, so they don't have to re-simulate the round up to it
+    bool spectateSavestate = false;
+
+    // Game state sent by the host, which is loaded once the spectator reaches the same index
+    MsgPtr spectateState;
+
+    // When the spectator received the InitialGameState, to measure the time it takes to join
+    uint64_t spectateJoinTime = 0;
+
     // The minimum number of frames that must run normally, before we're allowed to do another rollback
     uint8_t minRollbackSpacing = 2;
 
+    // Frame advantage estimation, to slow down when running ahead of the remote game
+    TimeSync timeSync;
+
+    // Total number of frames slowed down by this match
+    uint32_t timeSyncFrames = 0;
+
+    // If we should automatically tune the delay and rollback between rounds
+    bool autoDelay = false;
+
+    // Round trip time samples for automatic delay tuning
+    DelayTuner delayTuner;
+
+    // The latest local and remote DelayTuning
+    MsgPtr localDelayTuning, remoteDelayTuning;
+
+    // Delay tuning decision waiting for the next safe point
+    DelayTuner::Decision delayTuning;
+    bool shouldApplyDelayTuning = false;
+
     ExternalIpAddress externalIpAddress;
 
 #ifndef RELEASE
     // Local and remote SyncHashes
     list<MsgPtr> localSync, remoteSync;
 
+    // Remote per-frame state hashes waiting to be compared
+    list<MsgPtr> remoteFrameHashes;
+
+    // The next frame to send / compare per-frame state hashes
+    IndexedFrame nextFrameHashSend = {{ 0, 0 }}, nextFrameHashCheck = {{ 0, 0 }};
+
+    // The first frame where the per-frame state hashes diverged
+    IndexedFrame stateDesyncFrame = MaxIndexedFrame;
+    bool sentRegionHashes = false;
+
     // Debug testing flags
     bool randomInputs = false;
     bool randomDelay = false;
@@ -187,6 +263,154 @@ struct DllMain
     IndexedFrame replayStop = MaxIndexedFrame;
     IndexedFrame replayCheck = MaxIndexedFrame;
     string replayCheckRngHexStr;
+
+    // Keyframes for seeking in the replay, saved next to the replay file so later seeks are instant
+    ReplayKeyframes replayKeyframes;
+    string replayKeyframesFile;
+    bool replayKeyframesChanged = false;
+
+    // The frame being seeked to, MaxIndexedFrame if not seeking
+    IndexedFrame replaySeek = MaxIndexedFrame;
+
+    // When the current seek started, and how long it took to load the keyframe
+    uint64_t replaySeekStartUs = 0, replaySeekLoadUs = 0;
+
+    // Number of frames re-simulated after loading the keyframe
+    uint32_t replaySeekResimFrames = 0;
+
+    // Get the index of the Loading state that started the match containing the given index
+    uint32_t getReplayMatchStart ( uint32_t index )
+    {
+        const string loading = NetplayState ( NetplayState::Loading ).str();
+
+        while ( index > 0 && repMan.getStateStr ( {{ 0, index }} ) != loading )
+            --index;
+
+        return index;
+    }
+
+    // Get the next in-game index before or after the given index, returns the given index if there is none
+    uint32_t getReplayRound ( uint32_t index, int direction )
+    {
+        const string inGame = NetplayState ( NetplayState::InGame ).str();
+
+        for ( int i = int ( index ) + direction; i >= 0 && i <= int ( repMan.getLastIndex() ); i += direction )
+        {
+            if ( repMan.getStateStr ( {{ 0, uint32_t ( i ) }} ) == inGame )
+                return i;
+        }
+
+        return index;
+    }
+
+    void startReplaySeek ( IndexedFrame target )
+    {
+        LOG ( "Seeking from [%s] to [%s]", netMan.getIndexedFrame(), target );
+
+        replaySeek = target;
+        replaySeekStartUs = TimerManager::get().getNowMicroseconds();
+        replaySeekLoadUs = 0;
+        replaySeekResimFrames = 0;
+    }
+
+    void finishReplaySeek()
+    {
+        const double totalMs = ( TimerManager::get().getNowMicroseconds() - replaySeekStartUs ) / 1000.0;
+
+        LOG ( "Seek to [%s] done: total=%.1f ms; keyframeLoad=%.1f ms; resimFrames=%u",
+              replaySeek, totalMs, replaySeekLoadUs / 1000.0, replaySeekResimFrames );
+
+        DllOverlayUi::showMessage ( format ( "Seek to [%s] took %.1f ms", replaySeek, totalMs ) );
+
+        replaySeek = MaxIndexedFrame;
+
+        if ( replaySpeed != 1 )
+            DllFrameRate::desiredFps = 60.0;
+    }
+
+    // Jump to the keyframe nearest to the seek target if it helps, returns true if the game state was overwritten.
+    // Otherwise the replay keeps playing, fast-forwarded, until the target or a keyframe closer to it is reached.
+    bool seekReplay()
+    {
+        const IndexedFrame current = netMan.getIndexedFrame();
+
+        if ( current.value == replaySeek.value )
+        {
+            finishReplaySeek();
+            return false;
+        }
+
+        const size_t keyframe = replayKeyframes.find ( replaySeek );
+
+        // The game only loads the characters and stage at the start of each match,
+        // so keyframes can only be loaded in-game, within the same match.
+        const bool canJump = ( keyframe < replayKeyframes.size() && netMan.isInGame()
+                               && getReplayMatchStart ( replaySeek.parts.index )
+                               == getReplayMatchStart ( current.parts.index ) );
+
+        const IndexedFrame target = ( canJump ? replayKeyframes.get ( keyframe ).indexedFrame : MaxIndexedFrame );
+
+        // Jump backwards, or forwards past the current frame
+        if ( canJump && ( current.value > replaySeek.value || target.value > current.value ) )
+        {
+            const uint64_t startUs = TimerManager::get().getNowMicroseconds();
+
+            if ( ! rollMan.loadKeyframe ( replayKeyframes, keyframe, netMan ) )
+            {
+                LOG ( "Failed to load keyframe [%s]", target );
+                replaySeek = MaxIndexedFrame;
+                return false;
+            }
+
+            replaySeekLoadUs += TimerManager::get().getNowMicroseconds() - startUs;
+
+            // Re-run from the keyframe to the target with the replay inputs
+            for ( uint32_t frame = target.parts.frame; frame <= replaySeek.parts.frame; ++frame )
+            {
+                const ReplayManager::Inputs inputs = repMan.getInputs ( {{ frame, target.parts.index }} );
+
+                netMan.assignInput ( 1, inputs.p1, inputs.indexedFrame );
+                netMan.assignInput ( 2, inputs.p2, inputs.indexedFrame );
+            }
+
+            netMan.clearLastChangedFrame();
+
+            replaySeekResimFrames = replaySeek.parts.frame - target.parts.frame;
+
+            if ( replaySeekResimFrames )
+            {
+                fastFwdStopFrame = replaySeek;
+                *CC_SKIP_FRAMES_ADDR = 1;
+            }
+            else
+            {
+                finishReplaySeek();
+            }
+
+            return true;
+        }
+
+        if ( current.value > replaySeek.value )
+        {
+            LOG ( "No keyframe to seek back to [%s]", replaySeek );
+            DllOverlayUi::showMessage ( format ( "Can't seek back to [%s]", replaySeek ) );
+            replaySeek = MaxIndexedFrame;
+        }
+
+        return false;
+    }
+
+    // Save the keyframes captured so far, if there are new ones
+    void saveReplayKeyframes()
+    {
+        if ( ! replayKeyframesChanged || replayKeyframesFile.empty() )
+            return;
+
+        if ( replayKeyframes.save ( replayKeyframesFile ) )
+            LOG ( "Saved %u keyframes to '%s'", replayKeyframes.size(), replayKeyframesFile );
+
+        replayKeyframesChanged = false;
+    }
 #endif // NOT RELEASE
 
     void frameStepNormal()
@@ -300,6 +524,16 @@ struct DllMain
                                 break;
                             }
                         }
+
+                        // Ctrl + R
+                        if ( KeyboardState::isPressed ( 'R' ) && netMan.getRollback() )
+                        {
+                            DllOverlayUi::showMessage ( rollMan.getStatsSummary()
+                                                        + format ( "\nTime sync: %+.1f frames; slowed down %u frames",
+                                                                   timeSync.getFrameAdvantage(), timeSyncFrames )
+                                                        + "\n" + DllFrameRate::getStatsSummary(),
+                                                        ROLLBACK_STATS_TIMEOUT );
+                        }
                     }
 
                     if ( KeyboardState::isDown ( VK_MENU ) && netMan.getRollback() )        // Only if already rollback
@@ -364,6 +598,23 @@ struct DllMain
                 // Replay inputs and rollback
                 if ( replayInputs )
                 {
+                    // Capture a keyframe periodically, for later seeks
+                    if ( netMan.isInGame() && netMan.getFrame() % REPLAY_KEYFRAME_INTERVAL == 0 )
+                        replayKeyframesChanged |= rollMan.saveKeyframe ( netMan, replayKeyframes );
+
+                    // Seek to the start of the previous / next round
+                    if ( KeyboardState::isPressed ( VK_PRIOR ) || KeyboardState::isPressed ( VK_NEXT ) )
+                    {
+                        const uint32_t index = getReplayRound ( netMan.getIndex(),
+                                                                KeyboardState::isPressed ( VK_PRIOR ) ? -1 : 1 );
+
+                        if ( index != netMan.getIndex() )
+                            startReplaySeek ( {{ 0, index }} );
+                    }
+
+                    if ( replaySeek.value != MaxIndexedFrame.value && seekReplay() )
+                        return;
+
                     if ( repMan.getGameMode ( netMan.getIndexedFrame() ) )
                         ASSERT ( repMan.getGameMode ( netMan.getIndexedFrame() ) == *CC_GAME_MODE_ADDR );
 
@@ -388,9 +639,7 @@ struct DllMain
                             netMan.assignInput ( 2, inputs.p2, inputs.indexedFrame );
                         }
 
-                        const string before = format ( "%s [%u] %s [%s]",
-                                                       gameModeStr ( *CC_GAME_MODE_ADDR ), *CC_GAME_MODE_ADDR,
-                                                       netMan.getState(), netMan.getIndexedFrame() );
+                        const SyncTrace::Prefix before = SYNC_TRACE_PREFIX;
 
                         // Indicate we're re-running to the current frame
                         fastFwdStopFrame = netMan.getIndexedFrame();
@@ -401,14 +650,15 @@ struct DllMain
                             // Start fast-forwarding now
                             *CC_SKIP_FRAMES_ADDR = 1;
 
-                            LOG_TO ( syncLog, "%s Rollback: target=[%s]; actual=[%s]",
-                                     before, target, netMan.getIndexedFrame() );
+                            syncTrace.write ( SyncTrace::Type::Rollback, before,
+                                              SyncTrace::Rollback { target, netMan.getIndexedFrame() } );
 
-                            LOG_SYNC ( "Reinputs: 0x%04x 0x%04x", netMan.getRawInput ( 1 ), netMan.getRawInput ( 2 ) );
+                            SYNC_TRACE_INPUTS ( Reinputs );
                             return;
                         }
 
-                        LOG_TO ( syncLog, "%s Rollback to target=[%s] failed!", before, target );
+                        syncTrace.write ( SyncTrace::Type::RollbackFailed, before,
+                                          SyncTrace::Rollback { target, {{ 0, 0 }} } );
 
                         ASSERT_IMPOSSIBLE;
                     }
@@ -580,6 +830,17 @@ struct DllMain
             }
         }
 
+        // Keep both games running at the same pace, so the rollbacks are shared evenly
+        if ( netMan.isInRollback() && dataSocket && dataSocket->isConnected() )
+            updateTimeSync();
+
+        // Measure the round trip time for automatic delay tuning
+        if ( autoDelay && netMan.isInGame() && clientMode.isNetplay() && dataSocket && dataSocket->isConnected()
+                && netMan.getFrame() % DELAY_TUNER_PROBE_INTERVAL == 0 )
+        {
+            dataSocket->send ( new LatencyProbe ( TimerManager::get().getNow ( true ), false ) );
+        }
+
         if ( rollbackTimer < minRollbackSpacing )
         {
             --rollbackTimer;
@@ -588,36 +849,67 @@ struct DllMain
                 rollbackTimer = minRollbackSpacing;
         }
 
+        // Jump to the game state sent by the host, instead of re-simulating the round up to it
+        if ( spectateState && netMan.isInGame() )
+        {
+            const SpectateState& state = spectateState->getAs<SpectateState>();
+
+            if ( netMan.getIndexedFrame().value >= state.indexedFrame.value )
+            {
+                LOG_AT ( LOG_LEVEL_INFO, LOG_CAT_SPECTATE, "Already past %s: indexedFrame=[%s]",
+                         state, netMan.getIndexedFrame() );
+                spectateState.reset();
+            }
+            else if ( netMan.getIndex() == state.indexedFrame.parts.index )
+            {
+                const bool loaded = rollMan.loadSpectateState ( state, netMan );
+
+                if ( loaded )
+                {
+                    LOG_AT ( LOG_LEVEL_INFO, LOG_CAT_SPECTATE, "Joined at [%s] after %llu ms",
+                             netMan.getIndexedFrame(), TimerManager::get().getNow ( true ) - spectateJoinTime );
+                }
+
+                spectateState.reset();
+
+                if ( loaded )
+                {
+                    // Skip rendering the frame that was interrupted
+                    *CC_SKIP_FRAMES_ADDR = 1;
+                    return;
+                }
+            }
+        }
+
         // Only rollback when necessary
         if ( netMan.isInRollback()
                 && rollbackTimer == minRollbackSpacing
                 && netMan.getLastChangedFrame().value < netMan.getIndexedFrame().value )
         {
-            const string before = format ( "%s [%u] %s [%s]",
-                                           gameModeStr ( *CC_GAME_MODE_ADDR ), *CC_GAME_MODE_ADDR,
-                                           netMan.getState(), netMan.getIndexedFrame() );
+            const SyncTrace::Prefix before = SYNC_TRACE_PREFIX;
 
             // Indicate we're re-running to the current frame
             fastFwdStopFrame = netMan.getIndexedFrame();
 
-            LOG_SYNC ( "rollbacking input: 0x%04x 0x%04x", netMan.getRawInput ( 1 ), netMan.getRawInput ( 2 ) );
+            SYNC_TRACE_INPUTS ( RollbackingInputs );
             // Reset the game state (this resets game state AND netMan state)
             if ( rollMan.loadState ( netMan.getLastChangedFrame(), netMan ) )
             {
                 // Start fast-forwarding now
                 *CC_SKIP_FRAMES_ADDR = 1;
 
-                LOG_TO ( syncLog, "%s Rollback: target=[%s]; actual=[%s]",
-                         before, netMan.getLastChangedFrame(), netMan.getIndexedFrame() );
+                syncTrace.write ( SyncTrace::Type::Rollback, before,
+                                  SyncTrace::Rollback { netMan.getLastChangedFrame(), netMan.getIndexedFrame() } );
 
-                LOG_SYNC ( "Reinputs: 0x%04x 0x%04x", netMan.getRawInput ( 1 ), netMan.getRawInput ( 2 ) );
+                SYNC_TRACE_INPUTS ( Reinputs );
 
                 netMan.clearLastChangedFrame();
                 --rollbackTimer;
                 return;
             }
 
-            LOG_TO ( syncLog, "%s Rollback to target=[%s] failed!", before, netMan.getLastChangedFrame() );
+            syncTrace.write ( SyncTrace::Type::RollbackFailed, before,
+                              SyncTrace::Rollback { netMan.getLastChangedFrame(), {{ 0, 0 }} } );
         }
 
         // Update the RngState if necessary
@@ -652,7 +944,8 @@ struct DllMain
 
             if ( changeConfig.delay < 0xFF && changeConfig.delay != netMan.getDelay() )
             {
-                LOG ( "Input delay was changed %u -> %u", netMan.getDelay(), changeConfig.delay );
+                LOG_AT ( LOG_LEVEL_INFO, LOG_CAT_NET, "Input delay was changed %u -> %u",
+                         netMan.getDelay(), changeConfig.delay );
                 DllOverlayUi::showMessage ( format ( "Input delay was changed to %u", changeConfig.delay ) );
                 netMan.setDelay ( changeConfig.delay );
                 procMan.ipcSend ( changeConfig );
@@ -660,7 +953,8 @@ struct DllMain
 
             if ( changeConfig.rollbackDelay < 0xFF && changeConfig.rollbackDelay != netMan.getRollbackDelay() && netMan.config.mode.isOffline() )
             {
-                LOG ( "P2 Input delay was changed %u -> %u", netMan.getRollbackDelay(), changeConfig.rollbackDelay );
+                LOG_AT ( LOG_LEVEL_INFO, LOG_CAT_NET, "P2 Input delay was changed %u -> %u",
+                         netMan.getRollbackDelay(), changeConfig.rollbackDelay );
                 DllOverlayUi::showMessage ( format ( "P2 Input delay was changed to %u", changeConfig.rollbackDelay ) );
                 netMan.setRollbackDelay ( changeConfig.rollbackDelay );
                 procMan.ipcSend ( changeConfig );
@@ -685,6 +979,21 @@ struct DllMain
         //            CC_SFX_ARRAY_ADDR[SFX_NUM], AsmHacks::sfxFilterArray[SFX_NUM], AsmHacks::sfxMuteArray[SFX_NUM] );
 
 #ifndef RELEASE
+        // Toggle capturing game states for tools/StateProfiler.cpp
+        if ( KeyboardState::isPressed ( VK_F8 ) )
+        {
+            if ( rollMan.isCapturing() )
+            {
+                rollMan.stopCapture();
+                DllOverlayUi::showMessage ( "Stopped capturing states" );
+            }
+            else if ( rollMan.startCapture ( ProcessManager::appDir + FOLDER
+                                             + format ( "states_%u.cap", netMan.getIndex() ) ) )
+            {
+                DllOverlayUi::showMessage ( "Capturing states" );
+            }
+        }
+
         if ( ! replayInputs )
         {
             // Test one time rollback
@@ -699,9 +1008,7 @@ struct DllMain
 
                 if ( KeyboardState::isDown ( VK_CONTROL ) )
                 {
-                    const string before = format ( "%s [%u] %s [%s]",
-                                                   gameModeStr ( *CC_GAME_MODE_ADDR ), *CC_GAME_MODE_ADDR,
-                                                   netMan.getState(), netMan.getIndexedFrame() );
+                    const SyncTrace::Prefix before = SYNC_TRACE_PREFIX;
 
                     // Indicate we're re-running to the current frame
                     fastFwdStopFrame = netMan.getIndexedFrame();
@@ -712,10 +1019,10 @@ struct DllMain
                         // Start fast-forwarding now
                         *CC_SKIP_FRAMES_ADDR = 1;
 
-                        LOG_TO ( syncLog, "%s Rollback: target=[%s]; actual=[%s]",
-                                 before, netMan.getLastChangedFrame(), netMan.getIndexedFrame() );
+                        syncTrace.write ( SyncTrace::Type::Rollback, before, SyncTrace::Rollback {
+                                              netMan.getLastChangedFrame(), netMan.getIndexedFrame() } );
 
-                        LOG_SYNC ( "Reinputs: 0x%04x 0x%04x", netMan.getRawInput ( 1 ), netMan.getRawInput ( 2 ) );
+                        SYNC_TRACE_INPUTS ( Reinputs );
                         return;
                     }
                 }
@@ -746,15 +1053,13 @@ struct DllMain
                 else
                     target.parts.frame -= distance;
 
-                const string before = format ( "%s [%u] %s [%s]",
-                                               gameModeStr ( *CC_GAME_MODE_ADDR ), *CC_GAME_MODE_ADDR,
-                                               netMan.getState(), netMan.getIndexedFrame() );
+                const SyncTrace::Prefix before = SYNC_TRACE_PREFIX;
 
                 // Indicate we're re-running to the current frame
                 fastFwdStopFrame = netMan.getIndexedFrame();
 
-                LOG_TO ( syncLog, "%s Rollback: target=[%s]; actual=[%s]",
-                         before, target, netMan.getIndexedFrame() );
+                syncTrace.write ( SyncTrace::Type::Rollback, before,
+                                  SyncTrace::Rollback { target, netMan.getIndexedFrame() } );
 
                 // Reset the game state (this resets game state AND netMan state)
                 if ( rollMan.loadState ( target, netMan ) )
@@ -762,16 +1067,24 @@ struct DllMain
                     // Start fast-forwarding now
                     *CC_SKIP_FRAMES_ADDR = 1;
 
-                    LOG_SYNC ( "Reinputs: 0x%04x 0x%04x", netMan.getRawInput ( 1 ), netMan.getRawInput ( 2 ) );
+                    SYNC_TRACE_INPUTS ( Reinputs );
 
                     --rollbackTimer;
                     return;
                 }
 
-                LOG_TO ( syncLog, "%s Rollback to target=[%s] failed!", before, target );
+                syncTrace.write ( SyncTrace::Type::RollbackFailed, before,
+                                  SyncTrace::Rollback { target, {{ 0, 0 }} } );
             }
         }
 
+        // Exchange and compare per-frame state hashes
+        if ( dataSocket && dataSocket->isConnected() && netMan.isInGame() && netMan.getRollback()
+                && stateDesyncFrame.value == MaxIndexedFrame.value )
+        {
+            checkStateHashes();
+        }
+
         if ( dataSocket && dataSocket->isConnected()
                 && ( ( netMan.getFrame() % ( 5 * 60 ) == 0 ) || ( netMan.getFrame() % 150 == 149 ) )
                 && netMan.getState().value >= NetplayState::CharaSelect && netMan.getState() != NetplayState::Loading
@@ -823,6 +1136,7 @@ struct DllMain
 #undef R
 
             syncLog.deinitialize();
+            syncTrace.close();
             delayedStop ( "Desync!" );
 
             randomInputs = false;
@@ -833,6 +1147,7 @@ struct DllMain
         if ( replayInputs && netMan.getIndex() >= repMan.getLastIndex() && netMan.getFrame() >= repMan.getLastFrame() )
         {
             replayInputs = false;
+            saveReplayKeyframes();
             SetForegroundWindow ( ( HWND ) DllHacks::windowHandle );
         }
 
@@ -851,6 +1166,7 @@ struct DllMain
                 LOG_SYNC ( "RngState: %s", msgRngState->getAs<RngState>().dump() );
                 LOG_TO ( syncLog, "Desync!" );
                 syncLog.deinitialize();
+                syncTrace.close();
 
                 delayedStop ( ERROR_INTERNAL );
                 return;
@@ -867,8 +1183,8 @@ struct DllMain
         //     if ( *CC_P1_HEALTH_ADDR != 11400 || *CC_P1_METER_ADDR != 0
         //             || *CC_P2_HEALTH_ADDR != 10121 || *CC_P2_METER_ADDR != 10638 )
         //     {
-        //         LOG_SYNC_CHARACTER ( 1 );
-        //         LOG_SYNC_CHARACTER ( 2 );
+        //         SYNC_TRACE_CHARACTER ( 1 );
+        //         SYNC_TRACE_CHARACTER ( 2 );
         //         LOG_TO ( syncLog, "Desync!" );
         //         syncLog.deinitialize();
 
@@ -886,42 +1202,349 @@ struct DllMain
         // Cleared last played and muted sound effects
         memset ( AsmHacks::sfxFilterArray, 0, CC_SFX_ARRAY_LEN );
         memset ( AsmHacks::sfxMuteArray, 0, CC_SFX_ARRAY_LEN );
-#ifndef DISABLE_LOGGING
+#if !defined(DISABLE_LOGGING) && !defined(RELEASE)
         MsgPtr msgRngState = procMan.getRngState ( 0 );
         ASSERT ( msgRngState.get() != 0 );
 
         // Log state every frame
-        LOG_SYNC ( "RngState: %s", msgRngState->getAs<RngState>().dump() );
-        LOG_SYNC ( "Inputs: 0x%04x 0x%04x", netMan.getRawInput ( 1 ), netMan.getRawInput ( 2 ) );
+        const RngState& rngState = msgRngState->getAs<RngState>();
+
+        SyncTrace::RngState traceRngState = { rngState.rngState0, rngState.rngState1, rngState.rngState2 };
+        memcpy ( traceRngState.rngState3, &rngState.rngState3[0], sizeof ( traceRngState.rngState3 ) );
+
+        SYNC_TRACE ( RngState, traceRngState );
+        SYNC_TRACE_INPUTS ( Inputs );
 
         // Log extra state during chara select
         if ( netMan.getState() == NetplayState::CharaSelect )
         {
-            LOG_SYNC ( "P1: sel=%u; C=%u; M=%u; c=%u; P2: sel=%u; C=%u; M=%u; c=%u",
-                       *CC_P1_SELECTOR_MODE_ADDR, *CC_P1_CHARACTER_ADDR,
-                       *CC_P1_MOON_SELECTOR_ADDR, *CC_P1_COLOR_SELECTOR_ADDR,
-                       *CC_P2_SELECTOR_MODE_ADDR, *CC_P2_CHARACTER_ADDR,
-                       *CC_P2_MOON_SELECTOR_ADDR, *CC_P2_COLOR_SELECTOR_ADDR );
+            SYNC_TRACE ( CharaSelect, SyncTrace::CharaSelect {
+                { *CC_P1_SELECTOR_MODE_ADDR, *CC_P2_SELECTOR_MODE_ADDR },
+                { *CC_P1_CHARACTER_ADDR, *CC_P2_CHARACTER_ADDR },
+                { *CC_P1_MOON_SELECTOR_ADDR, *CC_P2_MOON_SELECTOR_ADDR },
+                { *CC_P1_COLOR_SELECTOR_ADDR, *CC_P2_COLOR_SELECTOR_ADDR } } );
             return;
         }
 
         // Log extra state while in-game
         if ( netMan.isInGame() )
         {
-            LOG_SYNC_CHARACTER ( 1 );
-            LOG_SYNC_CHARACTER ( 2 );
-            LOG_SYNC ( "roundOverTimer=%d; introState=%u; roundTimer=%u; realTimer=%u; hitsparks=%u; camera={ %d, %d }",
-                       roundOverTimer, *CC_INTRO_STATE_ADDR, *CC_ROUND_TIMER_ADDR, *CC_REAL_TIMER_ADDR,
-                       *CC_HIT_SPARKS_ADDR, *CC_CAMERA_X_ADDR, *CC_CAMERA_Y_ADDR );
+            SYNC_TRACE_CHARACTER ( 1 );
+            SYNC_TRACE_CHARACTER ( 2 );
+            SYNC_TRACE_ROUND();
+            return;
+        }
+#endif // NOT DISABLE_LOGGING && NOT RELEASE
+    }
+
+    void updateTimeSync()
+    {
+        if ( netMan.getFrame() % TIME_SYNC_INTERVAL != 0 )
+            return;
+
+        if ( timeSync.hasLocalAdvantage() )
+            dataSocket->send ( new FrameAdvantage ( netMan.getIndexedFrame(), timeSync.getLocalAdvantage() ) );
+
+        // Let the previous slowdown finish before estimating again
+        if ( DllFrameRate::isSlowingDown() )
+            return;
+
+        const uint32_t frames = timeSync.getSlowdownFrames ( TIME_SYNC_MIN_FRAMES, TIME_SYNC_MAX_FRAMES );
+
+        if ( ! frames )
+        {
+            // Too small to slow down whole frames, so nudge the frame rate for the next interval instead
+            DllFrameRate::setRateAdjust ( timeSync.getRateAdjust ( TIME_SYNC_MIN_FRAMES, TIME_SYNC_INTERVAL,
+                                                                   FRAME_PACER_MAX_ADJUST ) );
+            return;
+        }
+
+        DllFrameRate::setRateAdjust ( 1.0 );
+
+        LOG ( "[%s] Time sync: local=%.2f; remote=%.2f; slowing down %u frames",
+              netMan.getIndexedFrame(), timeSync.getLocalAdvantage(), timeSync.getRemoteAdvantage(), frames );
+
+        if ( DllFrameRate::slowDown ( frames, TIME_SYNC_INTERVAL ) )
+            timeSyncFrames += frames;
+
+        // The old samples are from before slowing down
+        timeSync.reset();
+    }
+
+    void gotLatencyProbe ( const LatencyProbe& probe )
+    {
+        if ( ! probe.echo )
+        {
+            dataSocket->send ( new LatencyProbe ( probe.timestamp, true ) );
+            return;
+        }
+
+        const uint64_t now = TimerManager::get().getNow();
+
+        if ( autoDelay && now >= probe.timestamp )
+            delayTuner.addRoundTrip ( now - probe.timestamp );
+    }
+
+    // Send the current game state to a new spectator, so it can start from the same frame
+    void sendSpectateState ( Socket *socket )
+    {
+        const uint64_t startUs = TimerManager::get().getNowMicroseconds();
+
+        // Only send a state that doesn't depend on predicted inputs
+        MsgPtr msgState = rollMan.getSpectateState ( netMan.getBothInputsEndFrame() );
+
+        if ( ! msgState )
+        {
+            LOG_AT ( LOG_LEVEL_INFO, LOG_CAT_SPECTATE, "No game state to send at [%s]", netMan.getIndexedFrame() );
+            return;
+        }
+
+        const size_t bytes = ::Protocol::encodeShared ( msgState )->size();
+
+        socket->send ( msgState );
+
+        LOG_AT ( LOG_LEVEL_INFO, LOG_CAT_SPECTATE, "Sent %s: %u bytes; took %llu us",
+                 msgState, bytes, TimerManager::get().getNowMicroseconds() - startUs );
+    }
+
+    // Send the local latency samples at the end of each round, which is a safe point to change the delay
+    void sendDelayTuning()
+    {
+        const uint8_t rollback = netMan.getRollback();
+        const uint8_t delay = ( rollback ? netMan.getRollbackDelay() : netMan.config.delay );
+
+        localDelayTuning.reset ( new DelayTuning ( netMan.getIndex(), delayTuner.getLatency(), delay, rollback,
+                                                   delayTuner.getRttMean(), delayTuner.getRttJitter() ) );
+
+        dataSocket->send ( localDelayTuning );
+
+        // Each round is decided with its own samples
+        delayTuner.reset();
+
+        decideDelayTuning();
+    }
+
+    // Decide once both sides have sent their samples for the same round
+    void decideDelayTuning()
+    {
+        if ( ! localDelayTuning || ! remoteDelayTuning )
+            return;
+
+        const DelayTuning& local = localDelayTuning->getAs<DelayTuning>();
+        const DelayTuning& remote = remoteDelayTuning->getAs<DelayTuning>();
+
+        // Wait for the other side to reach the same round
+        if ( local.round != remote.round )
+        {
+            if ( local.round < remote.round )
+                localDelayTuning.reset();
+            else
+                remoteDelayTuning.reset();
+            return;
+        }
+
+        // Each side can set its own delay, so decide from the larger settings, so both sides agree
+        const DelayTuner::Decision decision = DelayTuner::decide (
+                local.latency, remote.latency, max ( local.delay, remote.delay ),
+                max ( local.rollback, remote.rollback ), DELAY_TUNER_MAX_DELAY, MAX_ROLLBACK );
+
+        LOG ( "[%s] Delay tuning round %u: local rtt=%.1f jitter=%.1f latency={ %s }; "
+              "remote rtt=%.1f jitter=%.1f latency={ %s }; frameDelta=%.2f; %s",
+              netMan.getIndexedFrame(), local.round, local.rttMean, local.rttJitter, DelayTuner::str ( local.latency ),
+              remote.rttMean, remote.rttJitter, DelayTuner::str ( remote.latency ), timeSync.getLocalAdvantage(),
+              decision.str() );
+
+        localDelayTuning.reset();
+        remoteDelayTuning.reset();
+
+        if ( ! decision.changed )
+            return;
+
+        delayTuning = decision;
+        shouldApplyDelayTuning = true;
+
+        if ( ! netMan.isInGame() )
+            applyDelayTuning();
+    }
+
+    void applyDelayTuning()
+    {
+        shouldApplyDelayTuning = false;
+
+        changeConfig.indexedFrame = netMan.getIndexedFrame();
+        changeConfig.delay = delayTuning.delay;
+        changeConfig.rollback = delayTuning.rollback;
+
+        // The delay used during rollback is separate from the delay used for the menus
+        const uint8_t delay = ( netMan.getRollback() ? netMan.getRollbackDelay() : netMan.config.delay );
+
+        if ( delayTuning.delay != delay )
+        {
+            LOG_AT ( LOG_LEVEL_INFO, LOG_CAT_NET, "Input delay was tuned %u -> %u", delay, delayTuning.delay );
+            DllOverlayUi::showMessage ( format ( "Input delay was tuned to %u", delayTuning.delay ) );
+
+            if ( netMan.getRollback() )
+                netMan.setRollbackDelay ( delayTuning.delay );
+            else
+                netMan.setDelay ( delayTuning.delay );
+
+            changeConfig.value = ChangeConfig::Delay;
+            changeConfig.invalidate();
+            procMan.ipcSend ( changeConfig );
+        }
+
+        if ( delayTuning.rollback != netMan.getRollback() )
+        {
+            LOG_AT ( LOG_LEVEL_INFO, LOG_CAT_NET, "Rollback was tuned %u -> %u",
+                     netMan.getRollback(), delayTuning.rollback );
+            DllOverlayUi::showMessage ( format ( "Rollback was tuned to %u", delayTuning.rollback ) );
+            netMan.setRollback ( delayTuning.rollback );
+            minRollbackSpacing = clamped<uint8_t> ( netMan.getRollback(), 2, 4 );
+
+            changeConfig.value = ChangeConfig::Rollback;
+            changeConfig.invalidate();
+            procMan.ipcSend ( changeConfig );
+        }
+    }
+
+#ifndef RELEASE
+    void checkStateHashes()
+    {
+        // The state at frame F only depends on the inputs before F, so it is final once we have the remote input
+        // for F - 1 and there is no pending rollback. Hashes are compared up to, but excluding, this frame.
+        IndexedFrame confirmed = netMan.getIndexedFrame();
+        confirmed.parts.frame = min ( netMan.getFrame() + 1, netMan.getRemoteFrame() + 2 );
+
+        if ( netMan.getLastChangedFrame().value < confirmed.value )
+        {
+            confirmed.parts.frame = ( netMan.getLastChangedFrame().parts.index == confirmed.parts.index
+                                      ? netMan.getLastChangedFrame().parts.frame + 1 : 0 );
+        }
+
+        if ( nextFrameHashSend.parts.index != confirmed.parts.index )
+            nextFrameHashSend = nextFrameHashCheck = {{ confirmed.parts.index, 0 }};
+
+        // Send the confirmed hashes periodically, the per-frame hashes are compact so they are sent in bulk
+        if ( netMan.getFrame() % 30 == 0 && nextFrameHashSend.parts.frame < confirmed.parts.frame )
+        {
+            MsgPtr msgFrameHashes = rollMan.getFrameHashes ( nextFrameHashSend, confirmed.parts.frame );
+
+            if ( msgFrameHashes )
+            {
+                dataSocket->send ( msgFrameHashes );
+                nextFrameHashSend.parts.frame = msgFrameHashes->getAs<FrameHashes>().getEndFrame();
+            }
+        }
+
+        // Compare the remote hashes for frames that are also confirmed locally
+        while ( ! remoteFrameHashes.empty() )
+        {
+            const FrameHashes& remote = remoteFrameHashes.front()->getAs<FrameHashes>();
+
+            if ( remote.indexedFrame.parts.index != confirmed.parts.index )
+            {
+                if ( remote.indexedFrame.parts.index < confirmed.parts.index )
+                {
+                    remoteFrameHashes.pop_front();
+                    continue;
+                }
+                break;
+            }
+
+            IndexedFrame indexedFrame = remote.indexedFrame;
+
+            if ( indexedFrame.parts.frame < nextFrameHashCheck.parts.frame )
+                indexedFrame.parts.frame = nextFrameHashCheck.parts.frame;
+
+            for ( ; indexedFrame.parts.frame < min ( remote.getEndFrame(), confirmed.parts.frame );
+                    ++indexedFrame.parts.frame )
+            {
+                const uint32_t remoteHash = remote.hashes [ indexedFrame.parts.frame - remote.indexedFrame.parts.frame ];
+                uint32_t localHash;
+
+                if ( ! rollMan.getFrameHash ( indexedFrame, localHash ) || localHash == remoteHash )
+                    continue;
+
+                LOG_TO ( syncLog, "State desync: first divergent frame [%s]; local=%08x; remote=%08x",
+                         indexedFrame, localHash, remoteHash );
+
+                stateDesyncFrame = indexedFrame;
+                sendRegionHashes();
+                return;
+            }
+
+            nextFrameHashCheck = indexedFrame;
+
+            if ( indexedFrame.parts.frame < remote.getEndFrame() )
+                break;
+
+            remoteFrameHashes.pop_front();
+        }
+    }
+
+    void sendRegionHashes()
+    {
+        if ( sentRegionHashes )
+            return;
+
+        sentRegionHashes = true;
+
+        MsgPtr msgRegionHashes = rollMan.getRegionHashes ( stateDesyncFrame );
+
+        if ( msgRegionHashes )
+        {
+            dataSocket->send ( msgRegionHashes );
             return;
         }
-#endif // NOT DISABLE_LOGGING
+
+        LOG_TO ( syncLog, "Region hashes for [%s] are no longer available", stateDesyncFrame );
+    }
+
+    void gotRegionHashes ( const RegionHashes& remote )
+    {
+        // The remote detected the state desync first, so reply with our region hashes for the same frame
+        if ( ! sentRegionHashes )
+        {
+            LOG_TO ( syncLog, "State desync: first divergent frame [%s] (reported by remote)", remote.indexedFrame );
+
+            stateDesyncFrame = remote.indexedFrame;
+            sendRegionHashes();
+        }
+
+        const vector<string> diffs = rollMan.diffRegionHashes ( remote );
+
+        LOG_TO ( syncLog, "State desync at [%s]: %u differences", remote.indexedFrame, diffs.size() );
+
+        for ( const string& diff : diffs )
+            LOG_TO ( syncLog, "  %s", diff );
+
+        // Keep the raw state so it can be compared with tools/StateDiff.cpp
+        const string stateFile = ProcessManager::appDir + FOLDER
+                                 + format ( "state_%u_%u.bin", remote.indexedFrame.parts.index,
+                                            remote.indexedFrame.parts.frame );
+
+        if ( rollMan.saveStateFile ( remote.indexedFrame, stateFile ) )
+            LOG_TO ( syncLog, "Saved state to '%s'", stateFile );
+
+        LOG_TO ( syncLog, "Desync!" );
+        syncLog.deinitialize();
+        syncTrace.close();
+        delayedStop ( "Desync!" );
+
+        randomInputs = false;
+        localInputs [ clientMode.isLocal() ? 1 : 0 ] = 0;
     }
+#endif // NOT RELEASE
 
     void frameStepRerun()
     {
         // Here we don't save any game states while re-running because the inputs are faked
 
+#ifndef RELEASE
+        // But we still hash them, so every frame has a state hash
+        rollMan.hashRerunState ( netMan.getIndexedFrame() );
+#endif // NOT RELEASE
+
         // Save sound state during rollback re-run
         rollMan.saveRerunSounds ( netMan.getFrame() );
 
@@ -935,6 +1558,11 @@ struct DllMain
 
             // Finalize rollback sound effects
             rollMan.finishedRerunSounds();
+
+#ifndef RELEASE
+            if ( replaySeek.value != MaxIndexedFrame.value && netMan.getIndexedFrame().value >= replaySeek.value )
+                finishReplaySeek();
+#endif // NOT RELEASE
         }
         else
         {
@@ -942,15 +1570,13 @@ struct DllMain
             *CC_SKIP_FRAMES_ADDR = 1;
         }
 
-        LOG_SYNC ( "Reinputs: 0x%04x 0x%04x", netMan.getRawInput ( 1 ), netMan.getRawInput ( 2 ) );
-        LOG_SYNC ( "roundOverTimer=%d; introState=%u; roundTimer=%u; realTimer=%u; hitsparks=%u; camera={ %d, %d }",
-                   roundOverTimer, *CC_INTRO_STATE_ADDR, *CC_ROUND_TIMER_ADDR, *CC_REAL_TIMER_ADDR,
-                   *CC_HIT_SPARKS_ADDR, *CC_CAMERA_X_ADDR, *CC_CAMERA_Y_ADDR );
+        SYNC_TRACE_INPUTS ( Reinputs );
+        SYNC_TRACE_ROUND();
 
         // LOG_SYNC ( "ReSFX 0x%X: CC_SFX_ARRAY=%u; sfxFilterArray=%u; sfxMuteArray=%u", SFX_NUM,
         //            CC_SFX_ARRAY_ADDR[SFX_NUM], AsmHacks::sfxFilterArray[SFX_NUM], AsmHacks::sfxMuteArray[SFX_NUM] );
         if ( ! *CC_SKIP_FRAMES_ADDR ) {
-            LOG_SYNC ( "rollback inputs done" );
+            SYNC_TRACE ( RollbackInputsDone, uint8_t ( 0 ) );
         }
     }
 
@@ -981,9 +1607,16 @@ struct DllMain
         else
             frameStepNormal();
 
+        // Stream the final inputs of this match to disk
+        netMan.streamInputs();
+
         // Update spectators
         frameStepSpectators();
 
+        // Spectators that stopped receiving are disconnected, so they can't hold up the netplay peers
+        for ( Socket *socket : popDroppedSpectators() )
+            socketDisconnected ( socket );
+
         // Write game inputs
         procMan.writeGameInput ( localPlayer, netMan.getInput ( localPlayer ) );
         procMan.writeGameInput ( remotePlayer, netMan.getInput ( remotePlayer ) );
@@ -993,7 +1626,19 @@ struct DllMain
             DllFrameRate::desiredFps = numeric_limits<double>::max();
         else if ( replayInputs && replaySpeed == 2 )
             *CC_SKIP_FRAMES_ADDR = 1;
+
+        // Fast-forward without rendering until the seek target is reached
+        if ( replayInputs && replaySeek.value != MaxIndexedFrame.value )
+        {
+            DllFrameRate::desiredFps = numeric_limits<double>::max();
+            *CC_SKIP_FRAMES_ADDR = 1;
+        }
+
+        rollMan.setFrameRendered ( *CC_SKIP_FRAMES_ADDR == 0 );
 #endif
+
+        // Rollback cost per rendered frame
+        rollMan.finishFrame ( *CC_SKIP_FRAMES_ADDR == 0 );
     }
 
     void netplayStateChanged ( NetplayState state )
@@ -1001,9 +1646,11 @@ struct DllMain
         // Catch invalid transitions
         if ( ! netMan.isValidNext ( state ) )
         {
-            LOG_TO ( syncLog, "Desync!" );
-            LOG_TO ( syncLog, "Invalid transition: %s -> %s", netMan.getState(), state );
+            LOG_TO_AT ( syncLog, LOG_LEVEL_ERROR, LOG_CAT_GENERAL, "Desync!" );
+            LOG_TO_AT ( syncLog, LOG_LEVEL_ERROR, LOG_CAT_GENERAL, "Invalid transition: %s -> %s",
+                        netMan.getState(), state );
             syncLog.deinitialize();
+            syncTrace.close();
 
             delayedStop ( ERROR_INTERNAL );
             return;
@@ -1040,6 +1687,16 @@ struct DllMain
             lazyDisconnect = false;
         }
 
+        // Entering Loading
+        if ( state == NetplayState::Loading )
+        {
+            // Collect rollback cost statistics per match
+            rollMan.resetStats();
+            DllFrameRate::resetStats();
+            DllFrameRate::setRateAdjust ( 1.0 );
+            timeSyncFrames = 0;
+        }
+
         // Leaving Loading
         if ( netMan.getState() == NetplayState::Loading )
         {
@@ -1050,6 +1707,10 @@ struct DllMain
         // Entering InGame
         if ( state == NetplayState::InGame )
         {
+            // Frame advantage samples from the previous round don't apply
+            timeSync.reset();
+            DllFrameRate::setRateAdjust ( 1.0 );
+
             if ( netMan.getRollback() )
                 rollMan.allocateStates();
             if ( netMan.config.mode.isTrial() ) {
@@ -1063,8 +1724,25 @@ struct DllMain
         // Leaving InGame
         if ( netMan.getState() == NetplayState::InGame )
         {
+            // Time sync only runs in-game, so don't keep nudging the frame rate outside of it
+            DllFrameRate::setRateAdjust ( 1.0 );
+
+            // Tune the delay between rounds
+            if ( autoDelay && clientMode.isNetplay() && dataSocket && dataSocket->isConnected() )
+                sendDelayTuning();
+
+            if ( shouldApplyDelayTuning )
+                applyDelayTuning();
+
             if ( netMan.getRollback() )
                 rollMan.deallocateStates();
+
+#ifndef RELEASE
+            // Keep the keyframes of each round, even if the replay is closed early
+            if ( replayInputs )
+                saveReplayKeyframes();
+#endif // NOT RELEASE
+
             if ( netMan.config.mode.isTrial() ) {
                 trialMan.initialized = false;
                 trialMan.clear();
@@ -1083,6 +1761,19 @@ struct DllMain
         // Entering RetryMenu
         if ( state == NetplayState::RetryMenu )
         {
+            // Dump the rollback cost statistics of this match
+            if ( netMan.getRollback() && rollMan.getStats().saveUs.count() )
+            {
+                const string title = format ( "Match ended [%s] delay=%u rollback=%u time_sync_frames=%u",
+                                              netMan.getIndexedFrame(), netMan.getDelay(), netMan.getRollback(),
+                                              timeSyncFrames );
+
+                if ( ! rollMan.saveStats ( ProcessManager::appDir + ROLLBACK_STATS_FILE, title ) )
+                    LOG_AT ( LOG_LEVEL_WARN, LOG_CAT_ROLLBACK, "Failed to save rollback stats" );
+            }
+
+            LOG ( "%s", DllFrameRate::getStatsSummary() );
+
             // Lazy disconnect now during netplay
             lazyDisconnect = clientMode.isNetplay();
 
@@ -1293,18 +1984,15 @@ struct DllMain
 
             IpAddrPort redirectAddr;
 
-            if ( SHOULD_REDIRECT_SPECTATORS )
+            // Spectators whose relay left are redirected under their new relay, but they can only be told apart
+            // from new spectators once they say who they are
+            if ( SHOULD_REDIRECT_SPECTATORS && !hasRelayMoves() )
                 redirectAddr = getRandomRedirectAddress();
 
             if ( redirectAddr.port == 0 )
-            {
                 newSocket->send ( new VersionConfig ( clientMode ) );
-            }
             else
-            {
-                redirectedSockets.insert ( newSocket.get() );
-                newSocket->send ( new IpAddrPort ( redirectAddr ) );
-            }
+                redirectSpectator ( newSocket.get(), redirectAddr );
 
             pushPendingSocket ( this, newSocket );
         }
@@ -1347,7 +2035,7 @@ struct DllMain
 
     void socketDisconnected ( Socket *socket ) override
     {
-        LOG ( "socketDisconnected ( %08x )", socket );
+        LOG_AT ( LOG_LEVEL_INFO, LOG_CAT_NET, "socketDisconnected ( %08x )", socket );
 
         if ( socket == dataSocket.get() )
         {
@@ -1367,6 +2055,12 @@ struct DllMain
 
         redirectedSockets.erase ( socket );
         popPendingSocket ( socket );
+
+        MsgPtr relayUpdate = relayLeft ( socket );
+
+        if ( relayUpdate )
+            procMan.ipcSend ( relayUpdate );
+
         popSpectator ( socket );
     }
 
@@ -1403,12 +2097,25 @@ struct DllMain
                         remote += " " + RemoteVersion.buildTime;
                     }
 
-                    LOG ( "Incompatible versions:\nLocal version: %s\nRemote version: %s", local, remote );
+                    LOG_AT ( LOG_LEVEL_WARN, LOG_CAT_NET,
+                             "Incompatible versions:\nLocal version: %s\nRemote version: %s", local, remote );
 
                     socket->disconnect();
                     return;
                 }
 
+                // New spectators that weren't redirected when they connected
+                if ( isPendingSocket ( socket ) && SHOULD_REDIRECT_SPECTATORS )
+                {
+                    const IpAddrPort& redirectAddr = getRandomRedirectAddress();
+
+                    if ( redirectAddr.port != 0 )
+                    {
+                        redirectSpectator ( socket, redirectAddr );
+                        return;
+                    }
+                }
+
                 socket->send ( new SpectateConfig ( netMan.config, netMan.getState().value ) );
                 return;
             }
@@ -1422,7 +2129,47 @@ struct DllMain
                     break;
 
                 pushSpectator ( socket, { socket->address.addr, msg->getAs<IpAddrPort>().port } );
+
+                // The spectator still receives every input, but can skip re-simulating the round up to this state
+                if ( spectateSavestate && netMan.isInGame() && netMan.getRollback() )
+                    sendSpectateState ( socket );
+                return;
+
+            case MsgType::SpectateResume:
+            {
+                if ( socket == dataSocket.get() || !isPendingSocket ( socket ) )
+                    break;
+
+                const IpAddrPort serverAddr ( socket->address.addr, msg->getAs<SpectateResume>().port );
+
+                IpAddrPort redirectAddr;
+
+                // The relay tree moved this spectator under another relay, or this one, when its relay left
+                if ( ! popRelayMove ( serverAddr, redirectAddr ) && SHOULD_REDIRECT_SPECTATORS )
+                    redirectAddr = getRandomRedirectAddress();
+
+                if ( redirectAddr.port != 0 )
+                {
+                    redirectSpectator ( socket, redirectAddr );
+                    return;
+                }
+
+                resumeSpectator ( socket, serverAddr, msg->getAs<SpectateResume>().pos );
                 return;
+            }
+
+            case MsgType::RelayUpdate:
+            {
+                if ( socket == dataSocket.get() )
+                    break;
+
+                // Relays forward updates towards the root via MainApp
+                MsgPtr relayUpdate = relayUpdated ( socket, msg->getAs<RelayUpdate>() );
+
+                if ( relayUpdate )
+                    procMan.ipcSend ( relayUpdate );
+                return;
+            }
 
             case MsgType::RngState:
                 LOG( "Got RNG from remote" );
@@ -1433,6 +2180,14 @@ struct DllMain
             case MsgType::SyncHash:
                 remoteSync.push_back ( msg );
                 return;
+
+            case MsgType::FrameHashes:
+                remoteFrameHashes.push_back ( msg );
+                return;
+
+            case MsgType::RegionHashes:
+                gotRegionHashes ( msg->getAs<RegionHashes>() );
+                return;
 #endif // NOT RELEASE
 
             default:
@@ -1455,6 +2210,30 @@ struct DllMain
                 {
                     case MsgType::PlayerInputs:
                         netMan.setInputs ( remotePlayer, msg->getAs<PlayerInputs>() );
+
+                        // Sample the frame advantage as remote inputs arrive
+                        if ( netMan.isInRollback() && netMan.getIndex() == netMan.getRemoteIndex() )
+                            timeSync.addLocalAdvantage ( netMan.getRemoteFrameDelta() );
+                        return;
+
+                    case MsgType::FrameAdvantage:
+                        if ( msg->getAs<FrameAdvantage>().indexedFrame.parts.index == netMan.getIndex() )
+                            timeSync.setRemoteAdvantage ( msg->getAs<FrameAdvantage>().advantage );
+                        return;
+
+                    case MsgType::LatencyProbe:
+                        gotLatencyProbe ( msg->getAs<LatencyProbe>() );
+                        return;
+
+                    case MsgType::DelayTuning:
+                        if ( ! autoDelay )
+                            return;
+
+                        remoteDelayTuning = msg;
+                        decideDelayTuning();
+
+                        if ( shouldApplyDelayTuning && ! netMan.isInGame() )
+                            applyDelayTuning();
                         return;
 
                     case MsgType::MenuIndex:
@@ -1515,11 +2294,26 @@ struct DllMain
                               netMan.initial.formatCharaName ( 1, getFullCharaName ),
                               netMan.initial.formatCharaName ( 2, getFullCharaName ) );
 
+                        spectateJoinTime = TimerManager::get().getNow ( true );
+
                         netplayStateChanged ( NetplayState::Initial );
                         return;
 
                     case MsgType::BothInputs:
                         netMan.setBothInputs ( msg->getAs<BothInputs>() );
+
+                        // Relay the new inputs immediately
+                        forwardToSpectators();
+                        return;
+
+                    case MsgType::SpectateHistory:
+                        netMan.setSpectateHistory ( msg->getAs<SpectateHistory>() );
+                        return;
+
+                    case MsgType::SpectateState:
+                        LOG_AT ( LOG_LEVEL_INFO, LOG_CAT_SPECTATE, "%s after %llu ms",
+                                 msg, TimerManager::get().getNow ( true ) - spectateJoinTime );
+                        spectateState = msg;
                         return;
 
                     case MsgType::MenuIndex:
@@ -1570,6 +2364,18 @@ struct DllMain
                 if ( options[Options::HeldStartDuration] )
                     netMan.heldStartDuration = lexical_cast<uint32_t> ( options.arg ( Options::HeldStartDuration ) );
 
+                autoDelay = options[Options::AutoDelay];
+
+                spectateSavestate = options[Options::SpectateSavestate];
+
+                if ( options[Options::InputPredictor] )
+                {
+                    const uint32_t type = lexical_cast<uint32_t> ( options.arg ( Options::InputPredictor ) );
+
+                    if ( type > InputPredictorType::Unknown && type <= InputPredictorType::Frequency )
+                        netMan.setInputPredictor ( InputPredictorType::Enum ( type ) );
+                }
+
                 if ( options[Options::AutoReplaySave] ) {
                     netMan.autoReplaySave = true;
                 } else {
@@ -1585,16 +2391,23 @@ struct DllMain
                 LOG ( "appDir='%s'", ProcessManager::appDir );
 
                 Logger::get().sessionId = options.arg ( Options::SessionId );
-                Logger::get().initialize ( ProcessManager::appDir + LOG_FILE );
+                Logger::get().initialize ( ProcessManager::appDir + LOG_FILE, LOG_DEFAULT_OPTIONS | LOG_ASYNC );
                 Logger::get().logVersion();
 
+                if ( options[Options::LogCategories] )
+                    Logger::get().setCategories ( Logger::parseCategories ( options.arg ( Options::LogCategories ) ) );
+
                 LOG ( "gameDir='%s'", ProcessManager::gameDir );
                 LOG ( "appDir='%s'", ProcessManager::appDir );
 
                 syncLog.sessionId = options.arg ( Options::SessionId );
-                syncLog.initialize ( ProcessManager::appDir + SYNC_LOG_FILE, 0 );
+                syncLog.initialize ( ProcessManager::appDir + SYNC_LOG_FILE, LOG_ASYNC );
                 syncLog.logVersion();
 
+#if !defined(DISABLE_LOGGING) && !defined(RELEASE)
+                syncTrace.open ( ProcessManager::appDir + SYNC_TRACE_FILE );
+#endif // NOT DISABLE_LOGGING && NOT RELEASE
+
                 // Manually hit Alt+Enter to enable fullscreen
                 if ( options[Options::Fullscreen] && DllHacks::windowHandle == GetForegroundWindow() )
                 {
@@ -1669,6 +2482,22 @@ struct DllMain
                     const bool good = repMan.load ( replayFile, real );
                     ASSERT ( good == true );
 
+                    // Keyframes from previous runs make seeks instant
+                    replayKeyframesFile = replayFile + ".keyframes";
+                    replayKeyframes.load ( replayKeyframesFile );
+
+                    // Parse seek index and frame
+                    it = find ( args.begin(), args.end(), "seek" );
+                    if ( it != args.end() )
+                        ++it;
+                    if ( it != args.end() && ( args.end() - it ) >= 2 )
+                    {
+                        IndexedFrame target;
+                        target.parts.index = lexical_cast<uint32_t> ( *it++ );
+                        target.parts.frame = lexical_cast<uint32_t> ( *it++ );
+                        startReplaySeek ( target );
+                    }
+
                     // Parse start index
                     it = find ( args.begin(), args.end(), "start" );
                     if ( it != args.end() )
@@ -1723,6 +2552,10 @@ struct DllMain
 
                 isSinglePlayer = clientMode.isSinglePlayer();
 
+                // Spectators that join through this client are placed by its relay tree
+                if ( ! clientMode.isSpectate() )
+                    setRelayRoot ( MAX_ROOT_SPECTATORS );
+
                 LOG ( "%s: flags={ %s }", clientMode, clientMode.flagString() );
                 break;
 
@@ -1767,10 +2600,11 @@ struct DllMain
                 if ( netMan.initial.moon[1] == UNKNOWN_POSITION )
                     THROW_EXCEPTION ( "moon[1]=Unknown", ERROR_INVALID_HOST_CONFIG );
 
-                LOG ( "SpectateConfig: %s; flags={ %s }; delay=%d; rollback=%d; winCount=%d; hostPlayer=%u; "
-                      "names={ '%s', '%s' }", netMan.config.mode, netMan.config.mode.flagString(), netMan.config.delay,
-                      netMan.config.rollback, netMan.config.winCount, netMan.config.hostPlayer,
-                      netMan.config.names[0], netMan.config.names[1] );
+                LOG_AT ( LOG_LEVEL_INFO, LOG_CAT_GENERAL,
+                         "SpectateConfig: %s; flags={ %s }; delay=%d; rollback=%d; winCount=%d; hostPlayer=%u; "
+                         "names={ '%s', '%s' }", netMan.config.mode, netMan.config.mode.flagString(),
+                         netMan.config.delay, netMan.config.rollback, netMan.config.winCount, netMan.config.hostPlayer,
+                         netMan.config.names[0], netMan.config.names[1] );
 
                 LOG ( "InitialGameState: %s; stage=%u; isTraining=%u; %s vs %s",
                       NetplayState ( ( NetplayState::Enum ) netMan.initial.netplayState ),
@@ -1908,13 +2742,15 @@ struct DllMain
                     *CC_AUTO_REPLAY_SAVE_ADDR = 1;
                 }
 
-                LOG ( "SessionId '%s'", netMan.config.sessionId );
+                LOG_AT ( LOG_LEVEL_INFO, LOG_CAT_GENERAL, "SessionId '%s'", netMan.config.sessionId );
 
-                LOG ( "NetplayConfig: %s; flags={ %s }; delay=%d; rollback=%d; rollbackDelay=%d; winCount=%d; "
-                      "hostPlayer=%d; localPlayer=%d; remotePlayer=%d; names={ '%s', '%s' }",
-                      netMan.config.mode, netMan.config.mode.flagString(), netMan.config.delay, netMan.config.rollback,
-                      netMan.config.rollbackDelay, netMan.config.winCount, netMan.config.hostPlayer,
-                      localPlayer, remotePlayer, netMan.config.names[0], netMan.config.names[1] );
+                LOG_AT ( LOG_LEVEL_INFO, LOG_CAT_GENERAL,
+                         "NetplayConfig: %s; flags={ %s }; delay=%d; rollback=%d; rollbackDelay=%d; winCount=%d; "
+                         "hostPlayer=%d; localPlayer=%d; remotePlayer=%d; names={ '%s', '%s' }",
+                         netMan.config.mode, netMan.config.mode.flagString(), netMan.config.delay,
+                         netMan.config.rollback, netMan.config.rollbackDelay, netMan.config.winCount,
+                         netMan.config.hostPlayer, localPlayer, remotePlayer, netMan.config.names[0],
+                         netMan.config.names[1] );
                 break;
 
             default:
@@ -2033,9 +2869,14 @@ struct DllMain
     {
         rollMan.deallocateStates();
 
+#ifndef RELEASE
+        rollMan.stopCapture();
+#endif
+
         KeyboardManager::get().unhook();
 
         syncLog.deinitialize();
+        syncTrace.close();
 
         procMan.disconnectPipe();
 
@@ -2058,15 +2899,25 @@ private:
         if ( controller->saveMappings ( file ) )
             return;
 
-        LOG ( "Failed to save: %s", file );
+        LOG_AT ( LOG_LEVEL_WARN, LOG_CAT_GENERAL, "Failed to save: %s", file );
+    }
+
+    void redirectSpectator ( Socket *socket, const IpAddrPort& address )
+    {
+        LOG ( "socket=%08x; address='%s'", socket, address );
+
+        redirectedSockets.insert ( socket );
+        socket->send ( new IpAddrPort ( address ) );
     }
 
-    const IpAddrPort& getRandomRedirectAddress() const
+    const IpAddrPort& getRandomRedirectAddress()
     {
         size_t r = rand() % ( 1 + numSpectators() );
 
         if ( r == 0 && !clientServerAddr.empty() )
             return clientServerAddr;
+        else if ( isRelayRoot() )
+            return getRelayRedirectAddress();
         else
             return getRandomSpectatorAddress();
     }
@@ -2232,7 +3083,7 @@ extern "C" void callback()
 
     if ( appState == AppState::Stopping )
     {
-        LOG ( "Exiting" );
+        LOG_AT ( LOG_LEVEL_INFO, LOG_CAT_GENERAL, "Exiting" );
 
         // Joystick must be deinitialized on the main thread it was initialized
         ControllerManager::get().deinitialize();
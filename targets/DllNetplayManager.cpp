@@ -77,6 +77,12 @@ using namespace std;
 #define PRESERVE_START_INDEX_BUFFER ( 5 )
 
 
+#define LOG_NET(FORMAT, ...)        LOG_AT ( LOG_LEVEL_DEBUG, LOG_CAT_NET, FORMAT, ## __VA_ARGS__ )
+
+// Logged every frame while waiting for remote inputs and RngStates
+#define LOG_NET_TRACE(FORMAT, ...)  LOG_AT ( LOG_LEVEL_TRACE, LOG_CAT_NET, FORMAT, ## __VA_ARGS__ )
+
+
 #define RETURN_MASH_INPUT(DIRECTION, BUTTONS)                       \
     do {                                                            \
         if ( getFrame() % 2 )                                       \
@@ -577,29 +583,26 @@ uint16_t NetplayManager::getMenuNavInput()
 
 bool NetplayManager::hasUpDownInHistory ( uint8_t player, uint32_t start, uint32_t end ) const
 {
+    if ( player == 0 )
+        return hasUpDownInHistory ( 1, start, end ) || hasUpDownInHistory ( 2, start, end );
+
+    ASSERT ( player == 1 || player == 2 );
+
+    const InputHistory& history = getInputHistory ( player );
+
+    if ( history.contains ( start, end ) )
+        return history.hasDirection ( ( 1 << 2 ) | ( 1 << 8 ), start, end );
+
+    // Fall back to checking one frame at a time for windows longer than the history
     for ( size_t i = start; i < end; ++i )
     {
         if ( i > getFrame() )
             break;
 
-        if ( player == 0 )
-        {
-            const uint16_t p1dir = 0xF & getRawInput ( 1, getFrame() - i );
-
-            const uint16_t p2dir = 0xF & getRawInput ( 2, getFrame() - i );
-
-            if ( ( p1dir == 2 ) || ( p1dir == 8 ) || ( p2dir == 2 ) || ( p2dir == 8 ) )
-                return true;
-        }
-        else
-        {
-            ASSERT ( player == 1 || player == 2 );
-
-            const uint16_t dir = 0xF & getRawInput ( player, getFrame() - i );
+        const uint16_t dir = 0xF & getRawInput ( player, getFrame() - i );
 
-            if ( ( dir == 2 ) || ( dir == 8 ) )
-                return true;
-        }
+        if ( ( dir == 2 ) || ( dir == 8 ) )
+            return true;
     }
 
     return false;
@@ -609,6 +612,11 @@ bool NetplayManager::hasButtonInHistory ( uint8_t player, uint16_t button, uint3
 {
     ASSERT ( player == 1 || player == 2 );
 
+    const InputHistory& history = getInputHistory ( player );
+
+    if ( history.contains ( start, end ) )
+        return history.hasButton ( button, start, end );
+
     for ( size_t i = start; i < end; ++i )
     {
         if ( i > getFrame() )
@@ -627,6 +635,11 @@ bool NetplayManager::heldButtonInHistory ( uint8_t player, uint16_t button, uint
 {
     ASSERT ( player == 1 || player == 2 );
 
+    const InputHistory& history = getInputHistory ( player );
+
+    if ( history.contains ( start, end ) )
+        return history.heldButton ( button, start, end );
+
     for ( size_t i = start; i < end; ++i )
     {
         if ( i > getFrame() )
@@ -647,6 +660,17 @@ void NetplayManager::setRemotePlayer ( uint8_t player )
 
     _localPlayer = 3 - player;
     _remotePlayer = player;
+
+    _inputs[_localPlayer - 1].setPredictor ( 0 );
+    _inputs[_remotePlayer - 1].setPredictor ( _inputPredictor.get() );
+}
+
+void NetplayManager::setInputPredictor ( InputPredictorType type )
+{
+    _inputPredictor.reset ( InputPredictor::create ( type ) );
+
+    _inputs[_localPlayer - 1].setPredictor ( 0 );
+    _inputs[_remotePlayer - 1].setPredictor ( _inputPredictor.get() );
 }
 
 void NetplayManager::updateFrame()
@@ -670,11 +694,15 @@ void NetplayManager::setState ( NetplayState state )
 
     if ( ! isValidNext ( state ) )
     {
-        LOG ( "Invalid transition: %s -> %s", _state, state );
+        LOG_NET ( "Invalid transition: %s -> %s", _state, state );
         return;
     }
 
-    LOG ( "indexedFrame=[%s]; previous=%s; current=%s", _indexedFrame, _state, state );
+    LOG_NET ( "indexedFrame=[%s]; previous=%s; current=%s", _indexedFrame, _state, state );
+
+    // Push the remaining frames of the in-game index before it changes
+    if ( isInGame() )
+        streamInputs();
 
     if ( state.value >= NetplayState::CharaSelect )
     {
@@ -728,6 +756,28 @@ void NetplayManager::setState ( NetplayState state )
 
             _localRetryMenuIndex = -1;
             _remoteRetryMenuIndex = -1;
+
+            // Learn each match from scratch
+            if ( _inputPredictor )
+                _inputPredictor->reset();
+
+            _replayStreamFile.clear();
+            _replayRawFile.clear();
+
+            // Stream the inputs of each match, only when the game is going to save a replay of it
+            if ( autoReplaySave && config.mode.isNetplay() && !config.mode.isTraining() )
+            {
+                char timebuf[200];
+                std::time_t now = time( NULL );
+                strftime( timebuf, 20, "%y%m%d-%H%M%S", localtime( &now ) );
+
+                _replayStreamFile = format ( "ReplayVS/%sx%s_%s.repstream",
+                                             getShortCharaName( *CC_P1_CHARACTER_ADDR ),
+                                             getShortCharaName( *CC_P2_CHARACTER_ADDR ),
+                                             timebuf );
+                _replayStreamPos = {{ 0, getIndex() }};
+                _replayWriter.open ( _replayStreamFile );
+            }
         }
 
         // Entering Game
@@ -749,6 +799,25 @@ void NetplayManager::setState ( NetplayState state )
             _retryMenuStateCounter = *CC_MENU_STATE_COUNTER_ADDR + 1;
             if ( !config.mode.isSpectate() )
                 exportResults();
+
+            // The match is over, sync and close the replay stream, then convert it in the background
+            if ( !_replayStreamFile.empty() )
+            {
+                _replayWriter.close();
+
+                const string streamFile = _replayStreamFile;
+                const string rawFile = streamFile.substr ( 0, streamFile.rfind ( '.' ) ) + ".repraw";
+
+                _replayWriter.post ( [streamFile, rawFile]()
+                {
+                    if ( ReplayWriter::exportRaw ( streamFile, rawFile ) )
+                        LOG ( "Exported '%s'", rawFile );
+                    else
+                        LOG ( "Failed to export '%s'", rawFile );
+                } );
+
+                _replayRawFile = rawFile;
+            }
         }
 
         // Exiting RetryMenu
@@ -827,17 +896,21 @@ void NetplayManager::setInput ( uint8_t player, uint16_t input )
     ASSERT ( player == 1 || player == 2 );
     ASSERT ( getIndex() >= _startIndex );
 
+    uint32_t frame;
+
     if ( isInRollback() ) {
-        _inputs[player - 1].set ( getIndex() - _startIndex, getFrame() + config.rollbackDelay, input );
+        frame = getFrame() + config.rollbackDelay;
     } else if ( _state == NetplayState::RetryMenu ) {
-        _inputs[player - 1].set ( getIndex() - _startIndex, getFrame(), input );
+        frame = getFrame();
     } else if ( config.mode.isOffline() && splitDelay ) {
-        _inputs[player - 1].set ( getIndex() - _startIndex,
-                                  getFrame() + (player == 1 ? config.delay : config.rollbackDelay),
-                                  input );
+        frame = getFrame() + ( player == 1 ? config.delay : config.rollbackDelay );
     } else {
-        _inputs[player - 1].set ( getIndex() - _startIndex, getFrame() + config.delay, input );
+        frame = getFrame() + config.delay;
     }
+
+    _inputs[player - 1].set ( getIndex() - _startIndex, frame, input );
+
+    eraseInputHistory ( player, { frame, getIndex() } );
 }
 
 void NetplayManager::assignInput ( uint8_t player, uint16_t input, uint32_t frame )
@@ -852,6 +925,41 @@ void NetplayManager::assignInput ( uint8_t player, uint16_t input, IndexedFrame
     ASSERT ( _indexedFrame.parts.index >= _startIndex );
 
     _inputs[player - 1].assign ( _indexedFrame.parts.index - _startIndex, _indexedFrame.parts.frame, input );
+
+    eraseInputHistory ( player, _indexedFrame );
+}
+
+const InputHistory& NetplayManager::getInputHistory ( uint8_t player ) const
+{
+    ASSERT ( player == 1 || player == 2 );
+
+    InputHistory& history = _inputHistory[player - 1];
+
+    if ( _inputHistoryIndex[player - 1] != getIndex() )
+    {
+        _inputHistoryIndex[player - 1] = getIndex();
+        history.clear();
+    }
+
+    const uint32_t end = getFrame() + 1;
+
+    // The frame can go backwards after a rollback
+    history.erase ( end );
+
+    // Only the latest frames can be queried
+    if ( end - history.getEndFrame() > INPUT_HISTORY_FRAMES )
+        history.clear ( end - INPUT_HISTORY_FRAMES );
+
+    while ( history.getEndFrame() < end )
+        history.push ( getRawInput ( player, history.getEndFrame() ) );
+
+    return history;
+}
+
+void NetplayManager::eraseInputHistory ( uint8_t player, IndexedFrame indexedFrame )
+{
+    if ( indexedFrame.parts.index == _inputHistoryIndex[player - 1] )
+        _inputHistory[player - 1].erase ( indexedFrame.parts.frame );
 }
 
 MsgPtr NetplayManager::getInputs ( uint8_t player ) const
@@ -882,8 +990,13 @@ void NetplayManager::setInputs ( uint8_t player, const PlayerInputs& playerInput
 
     const uint32_t checkStartingFromIndex = ( isInRollback() ? getIndex() - _startIndex : UINT_MAX );
 
+    // Inputs that were already received can't change, so only the history of the new inputs is erased
+    const uint32_t endFrame = _inputs[player - 1].getEndFrame ( playerInputs.getIndex() - _startIndex );
+
     _inputs[player - 1].set ( playerInputs.getIndex() - _startIndex, playerInputs.getStartFrame(),
                               &playerInputs.inputs[0], playerInputs.size(), checkStartingFromIndex );
+
+    eraseInputHistory ( player, { max ( endFrame, playerInputs.getStartFrame() ), playerInputs.getIndex() } );
 }
 
 MsgPtr NetplayManager::getBothInputs ( IndexedFrame& pos ) const
@@ -964,11 +1077,77 @@ void NetplayManager::setBothInputs ( const BothInputs& bothInputs )
 
     ASSERT ( bothInputs.getIndex() >= _startIndex );
 
-    _inputs[0].set ( bothInputs.getIndex() - _startIndex, bothInputs.getStartFrame(),
-                     &bothInputs.inputs[0][0], bothInputs.size() );
+    for ( uint8_t i = 0; i < 2; ++i )
+    {
+        // Inputs that were already received can't change, so only the history of the new inputs is erased
+        const uint32_t endFrame = _inputs[i].getEndFrame ( bothInputs.getIndex() - _startIndex );
+
+        _inputs[i].set ( bothInputs.getIndex() - _startIndex, bothInputs.getStartFrame(),
+                         &bothInputs.inputs[i][0], bothInputs.size() );
+
+        eraseInputHistory ( i + 1, { max ( endFrame, bothInputs.getStartFrame() ), bothInputs.getIndex() } );
+    }
+}
+
+MsgPtr NetplayManager::getSpectateHistory ( IndexedFrame& pos, uint32_t maxFrames ) const
+{
+    if ( pos.parts.index > getIndex() )
+        return 0;
+
+    const uint32_t index = pos.parts.index;
+
+    ASSERT ( index >= _startIndex );
+
+    uint32_t commonEndFrame = min ( _inputs[0].getEndFrame ( index - _startIndex ),
+                                    _inputs[1].getEndFrame ( index - _startIndex ) );
+
+    // Same buffer as getBothInputs during rollback
+    if ( index == getIndex() && isInRollback() )
+        commonEndFrame = ( commonEndFrame > 2 * NUM_INPUTS ? commonEndFrame - 2 * NUM_INPUTS : 0 );
+
+    uint32_t startFrame, endFrame;
 
-    _inputs[1].set ( bothInputs.getIndex() - _startIndex, bothInputs.getStartFrame(),
-                     &bothInputs.inputs[1][0], bothInputs.size() );
+    if ( ! SpectateHistory::getNextChunk ( pos, commonEndFrame, index < getIndex(), maxFrames, startFrame, endFrame ) )
+        return 0;
+
+    SpectateHistory *history = new SpectateHistory ( index, startFrame );
+
+    for ( uint8_t i = 0; i < 2; ++i )
+    {
+        history->inputs[i].resize ( endFrame - startFrame );
+        _inputs[i].get ( index - _startIndex, startFrame, &history->inputs[i][0], history->inputs[i].size() );
+    }
+
+    return MsgPtr ( history );
+}
+
+void NetplayManager::setSpectateHistory ( const SpectateHistory& history )
+{
+    // Same as setBothInputs
+    if ( history.index + 1 < getIndex() || history.index < _startIndex )
+        return;
+
+    if ( history.inputs[0].empty() || history.inputs[0].size() != history.inputs[1].size() )
+        return;
+
+    for ( uint8_t i = 0; i < 2; ++i )
+    {
+        const uint32_t endFrame = _inputs[i].getEndFrame ( history.index - _startIndex );
+
+        _inputs[i].set ( history.index - _startIndex, history.startFrame, &history.inputs[i][0], history.size() );
+
+        eraseInputHistory ( i + 1, { max ( endFrame, history.startFrame ), history.index } );
+    }
+}
+
+IndexedFrame NetplayManager::getBothInputsEndFrame() const
+{
+    ASSERT ( getIndex() >= _startIndex );
+
+    const uint32_t endFrame = min ( _inputs[0].getEndFrame ( getIndex() - _startIndex ),
+                                    _inputs[1].getEndFrame ( getIndex() - _startIndex ) );
+
+    return {{ endFrame, getIndex() }};
 }
 
 bool NetplayManager::isRemoteInputReady() const
@@ -982,7 +1161,7 @@ bool NetplayManager::isRemoteInputReady() const
 
     if ( _inputs[_remotePlayer - 1].empty() )
     {
-        LOG ( "[%s] No remote inputs (index)", _indexedFrame );
+        LOG_NET_TRACE ( "[%s] No remote inputs (index)", _indexedFrame );
         return false;
     }
 
@@ -990,8 +1169,8 @@ bool NetplayManager::isRemoteInputReady() const
 
     if ( _startIndex + _inputs[_remotePlayer - 1].getEndIndex() - 1 < getIndex() )
     {
-        LOG ( "[%s] remoteIndex=%u < localIndex=%u",
-              _indexedFrame, _startIndex + _inputs[_remotePlayer - 1].getEndIndex() - 1, getIndex() );
+        LOG_NET_TRACE ( "[%s] remoteIndex=%u < localIndex=%u",
+                        _indexedFrame, _startIndex + _inputs[_remotePlayer - 1].getEndIndex() - 1, getIndex() );
         return false;
     }
 
@@ -1001,7 +1180,7 @@ bool NetplayManager::isRemoteInputReady() const
 
     if ( _inputs[_remotePlayer - 1].getEndFrame() == 0 )
     {
-        LOG ( "[%s] No remote inputs (frame)", _indexedFrame );
+        LOG_NET_TRACE ( "[%s] No remote inputs (frame)", _indexedFrame );
         return false;
     }
 
@@ -1011,9 +1190,9 @@ bool NetplayManager::isRemoteInputReady() const
 
     if ( ( _inputs[_remotePlayer - 1].getEndFrame() - 1 + maxFramesAhead ) < getFrame() )
     {
-        LOG ( "[%s] remoteFrame = %u < localFrame=%u; delay=%u; rollback=%u; rollbackDelay=%u",
-              _indexedFrame, _inputs[_remotePlayer - 1].getEndFrame() - 1, getFrame(),
-              config.delay, config.rollback, config.rollbackDelay );
+        LOG_NET_TRACE ( "[%s] remoteFrame = %u < localFrame=%u; delay=%u; rollback=%u; rollbackDelay=%u",
+                        _indexedFrame, _inputs[_remotePlayer - 1].getEndFrame() - 1, getFrame(),
+                        config.delay, config.rollback, config.rollbackDelay );
 
         return false;
     }
@@ -1026,7 +1205,7 @@ MsgPtr NetplayManager::getRngState ( uint32_t index ) const
     if ( config.mode.isOffline() )
         return 0;
 
-    LOG ( "[%s]", _indexedFrame );
+    LOG_NET_TRACE ( "[%s]", _indexedFrame );
 
     ASSERT ( index >= _startIndex );
 
@@ -1041,7 +1220,7 @@ void NetplayManager::setRngState ( const RngState& rngState )
     if ( config.mode.isOffline() || rngState.index == 0 || rngState.index < _startIndex )
         return;
 
-    LOG ( "[%s] rngState.index=%u", _indexedFrame, rngState.index );
+    LOG_NET_TRACE ( "[%s] rngState.index=%u", _indexedFrame, rngState.index );
 
     ASSERT ( rngState.index >= _startIndex );
 
@@ -1062,13 +1241,14 @@ bool NetplayManager::isRngStateReady ( bool shouldSyncRngState ) const
 
     if ( _rngStates.empty() )
     {
-        LOG ( "[%s] No remote RngStates", _indexedFrame );
+        LOG_NET_TRACE ( "[%s] No remote RngStates", _indexedFrame );
         return false;
     }
 
     if ( ( _startIndex + _rngStates.size() - 1 ) < getIndex() )
     {
-        LOG ( "[%s] remoteIndex=%u < localIndex=%u", _indexedFrame, _startIndex + _rngStates.size() - 1, getIndex() );
+        LOG_NET_TRACE ( "[%s] remoteIndex=%u < localIndex=%u",
+                        _indexedFrame, _startIndex + _rngStates.size() - 1, getIndex() );
         return false;
     }
 
@@ -1132,7 +1312,7 @@ void NetplayManager::setRemoteIndex ( uint32_t remoteIndex )
     if ( remoteIndex < _startIndex )
         return;
 
-    LOG ( "remoteIndex=%u", remoteIndex );
+    LOG_NET ( "remoteIndex=%u", remoteIndex );
 
     _inputs[_remotePlayer - 1].resize ( remoteIndex - _startIndex, 0, 0 );
 }
@@ -1162,44 +1342,57 @@ bool NetplayManager::isValidNext ( NetplayState next )
     return ( it->second.find ( next.value ) != it->second.end() );
 }
 
-void NetplayManager::exportInputs() {
-    char buf[1000];
-    char namebuf[1000];
-    char namebuf2[1000];
-    char timebuf[200];
+void NetplayManager::exportInputs()
+{
+    // The raw inputs are exported when the replay stream closes, this only fixes up the game's replay with them
+    if ( _replayRawFile.empty() || !AsmHacks::replayName )
+        return;
 
-    std::time_t now = time( NULL );
-    strftime( timebuf, 20, "%y%m%d-%H%M%S", localtime( &now ) );
-
-    sprintf( namebuf, "ReplayVS/%sx%s_%s.repraw",
-             getShortCharaName( *CC_P1_CHARACTER_ADDR ),
-             getShortCharaName( *CC_P2_CHARACTER_ADDR) ,
-             timebuf );
-    ofstream repFile2 ( namebuf, ios::out );
-    vector<int> c = getInGameIndexes();
-    repFile2 << c.size() << endl;
-    for ( int q : c ) {
-        sprintf( buf, "%d\n", _inputs[0].getEndFrame( q ) );
-        repFile2 << buf;
-        for ( uint32_t i = 0; i < _inputs[0].getEndFrame( q ); ++i ) {
-            sprintf( buf, "%04x %04x\n",
-                     _inputs[0].get ( q, i ),
-                     _inputs[1].get ( q, i ) );
-            repFile2 << buf;
-        }
-    }
-    repFile2.close();
+    const string rawFile = _replayRawFile;
+    const string replayFile = AsmHacks::replayName;
+
+    // Fix the game's replay on the writer thread, after the raw inputs are exported
+    _replayWriter.post ( [rawFile, replayFile]()
+    {
+        string rawName = rawFile, replayName = replayFile, fixedName = replayFile + "2.rep";
 
-    sprintf( namebuf2, "%s2.rep", ( char* ) AsmHacks::replayName );
-    ReplayCreator::ReplayFile f;
-    ReplayCreator r;
-    r.load( &f, ( char* )AsmHacks::replayName );
-    r.fixReplay( &f, namebuf, NULL );
-    r.dump( f, namebuf2 );
+        ReplayCreator::ReplayFile f;
+        ReplayCreator r;
+        r.load( &f, &replayName[0] );
+        r.fixReplay( &f, &rawName[0], NULL );
+        r.dump( f, &fixedName[0] );
+
+        LOG ( "Exported '%s'", fixedName );
+    } );
 
     exported = true;
 }
 
+void NetplayManager::streamInputs()
+{
+    if ( _replayStreamFile.empty() || !isInGame() )
+        return;
+
+    // Each in-game index is streamed from its first frame
+    if ( _replayStreamPos.parts.index != getIndex() )
+        _replayStreamPos = {{ 0, getIndex() }};
+
+    // Only inputs from both players are final
+    const uint32_t endFrame = getBothInputsEndFrame().parts.frame;
+
+    for ( ; _replayStreamPos.parts.frame < endFrame; ++_replayStreamPos.parts.frame )
+    {
+        const uint32_t frame = _replayStreamPos.parts.frame;
+
+        // The writer has fallen behind, try again next frame
+        if ( ! _replayWriter.push ( _replayStreamPos, _inputs[0].get ( getIndex() - _startIndex, frame ),
+                                    _inputs[1].get ( getIndex() - _startIndex, frame ) ) )
+        {
+            break;
+        }
+    }
+}
+
 void NetplayManager::exportResults()
 {
     ofstream resFile;
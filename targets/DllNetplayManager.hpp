@@ -2,9 +2,12 @@
 
 #include "Messages.hpp"
 #include "InputsContainer.hpp"
+#include "InputHistory.hpp"
 #include "NetplayStates.hpp"
+#include "ReplayWriter.hpp"
 
 #include <vector>
+#include <memory>
 #include <climits>
 
 void __stdcall ___log(const char* msg);
@@ -34,6 +37,9 @@ public:
     // Indicate which player is the remote player
     void setRemotePlayer ( uint8_t player );
 
+    // Set how remote inputs that haven't arrived yet are predicted
+    void setInputPredictor ( InputPredictorType type );
+
     // Update the current netplay frame
     void updateFrame();
 
@@ -69,6 +75,9 @@ public:
     void resetInGameIndexes();
     void exportInputs();
 
+    // Push the final inputs of the current in-game index to the replay writer, called once per frame
+    void streamInputs();
+
     // Log Results
     void exportResults();
 
@@ -86,6 +95,9 @@ public:
     void assignInput ( uint8_t player, uint16_t input, uint32_t frame );
     void assignInput ( uint8_t player, uint16_t input, IndexedFrame indexedFrame );
 
+    // Get the input history of the given player, up to the current frame of the current index
+    const InputHistory& getInputHistory ( uint8_t player ) const;
+
     // Get / set batch inputs for the given player
     MsgPtr getInputs ( uint8_t player ) const;
     void setInputs ( uint8_t player, const PlayerInputs& playerInputs );
@@ -97,6 +109,17 @@ public:
     // Set inputs for both players
     void setBothInputs ( const BothInputs& bothInputs );
 
+    // Get a chunk of at most maxFrames inputs for both players, for spectators that are catching up.
+    // May return null if there are no inputs ready for the given pos, otherwise this increments the given pos past
+    // the returned inputs, moving to the next index once an older index has been fully returned.
+    MsgPtr getSpectateHistory ( IndexedFrame& pos, uint32_t maxFrames ) const;
+
+    // Set a chunk of inputs for both players
+    void setSpectateHistory ( const SpectateHistory& history );
+
+    // Get the frame after the last frame of the current index that has inputs from both players
+    IndexedFrame getBothInputsEndFrame() const;
+
     // True if remote input is ready for the current frame, otherwise the caller should wait for more input
     bool isRemoteInputReady() const;
 
@@ -198,9 +221,33 @@ private:
     // The remote player, ie the one where setInputs gets called for each input message
     uint8_t _remotePlayer = 2;
 
+    // Predictor for the remote player's inputs, null to repeat the last known input
+    std::unique_ptr<InputPredictor> _inputPredictor;
+
+    // Input history of each player, only updated when queried
+    mutable std::array<InputHistory, 2> _inputHistory;
+
+    // The index of each player's input history
+    mutable std::array<uint32_t, 2> _inputHistoryIndex = {{ UINT_MAX, UINT_MAX }};
+
+    // Erase the input history from the given index:frame onwards, since the inputs were changed
+    void eraseInputHistory ( uint8_t player, IndexedFrame indexedFrame );
+
     // Exported
     bool exported = false;
 
+    // Streams the final inputs of each match to disk in the background
+    ReplayWriter _replayWriter;
+
+    // Replay stream file of the current match, empty if not streaming
+    std::string _replayStreamFile;
+
+    // Raw inputs exported from the replay stream of the last match, empty if none
+    std::string _replayRawFile;
+
+    // Next frame to push to the replay writer
+    IndexedFrame _replayStreamPos = {{ 0, 0 }};
+
     // Separate delays for p1/p2
     bool splitDelay = true;
 
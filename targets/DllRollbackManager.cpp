@@ -2,13 +2,23 @@
 #include "MemDump.hpp"
 #include "DllAsmHacks.hpp"
 #include "ErrorStringsExt.hpp"
+#include "Compression.hpp"
+#include "TimerManager.hpp"
 
 #include <utility>
+#include <cstdio>
+#include <fstream>
 #include <algorithm>
 
 using namespace std;
 
 
+#define LOG_ROLLBACK(FORMAT, ...)       LOG_AT ( LOG_LEVEL_DEBUG, LOG_CAT_ROLLBACK, FORMAT, ## __VA_ARGS__ )
+
+// Logged for every frame rolled back
+#define LOG_ROLLBACK_TRACE(FORMAT, ...) LOG_AT ( LOG_LEVEL_TRACE, LOG_CAT_ROLLBACK, FORMAT, ## __VA_ARGS__ )
+
+
 // Linked rollback memory data (binary message format)
 extern const unsigned char binary_res_rollback_bin_start;
 extern const unsigned char binary_res_rollback_bin_end;
@@ -46,7 +56,7 @@ void DllRollbackManager::GameState::load()
     ASSERT ( dump == rawBytes + allAddrs.totalSize );
 }
 
-void DllRollbackManager::allocateStates()
+static void loadAllAddrs()
 {
     if ( allAddrs.empty() )
     {
@@ -56,6 +66,11 @@ void DllRollbackManager::allocateStates()
 
     if ( allAddrs.empty() )
         THROW_EXCEPTION ( "Failed to load rollback data!", ERROR_BAD_ROLLBACK_DATA );
+}
+
+void DllRollbackManager::allocateStates()
+{
+    loadAllAddrs();
 
     if ( ! _memoryPool )
         _memoryPool.reset ( new char[NUM_ROLLBACK_STATES * allAddrs.totalSize], deleteArray<char> );
@@ -67,6 +82,17 @@ void DllRollbackManager::allocateStates()
 
     for ( auto& sfxArray : _sfxHistory )
         memset ( &sfxArray[0], 0, CC_SFX_ARRAY_LEN );
+
+#ifndef RELEASE
+    if ( ! _rerunState )
+        _rerunState.reset ( new char[allAddrs.totalSize], deleteArray<char> );
+
+    for ( StateHash& stateHash : _stateHashes )
+    {
+        stateHash.indexedFrame = MaxIndexedFrame;
+        stateHash.regionHashes.resize ( allAddrs.hashSlices.size() );
+    }
+#endif // NOT RELEASE
 }
 
 void DllRollbackManager::deallocateStates()
@@ -77,10 +103,22 @@ void DllRollbackManager::deallocateStates()
         _freeStack.pop();
 
     _statesList.clear();
+
+#ifndef RELEASE
+    _rerunState.reset();
+
+    for ( StateHash& stateHash : _stateHashes )
+    {
+        stateHash.indexedFrame = MaxIndexedFrame;
+        stateHash.regionHashes.clear();
+    }
+#endif // NOT RELEASE
 }
 
 void DllRollbackManager::saveState ( const NetplayManager& netMan )
 {
+    const uint64_t startUs = TimerManager::get().getNowMicroseconds();
+
     if ( _freeStack.empty() )
     {
         ASSERT ( _statesList.empty() == false );
@@ -116,21 +154,35 @@ void DllRollbackManager::saveState ( const NetplayManager& netMan )
     state.save();
     _statesList.push_back ( state );
 
+#ifndef RELEASE
+    // Hash while the saved state is still hot in the cache
+    hashState ( state.indexedFrame, state.rawBytes );
+    captureState ( state.indexedFrame, state.rawBytes );
+#endif // NOT RELEASE
+
     uint8_t *currentSfxArray = &_sfxHistory [ netMan.getFrame() % NUM_ROLLBACK_STATES ][0];
     memcpy ( currentSfxArray, AsmHacks::sfxFilterArray, CC_SFX_ARRAY_LEN );
+
+    const uint64_t saveUs = TimerManager::get().getNowMicroseconds() - startUs;
+
+    _stats.saveUs.add ( saveUs );
+    _frameUs += saveUs;
 }
 
 bool DllRollbackManager::loadState ( IndexedFrame indexedFrame, NetplayManager& netMan )
 {
     if ( _statesList.empty() )
     {
-        LOG ( "Failed to load state: indexedFrame=%s", indexedFrame );
+        LOG_ROLLBACK ( "Failed to load state: indexedFrame=%s", indexedFrame );
         return false;
     }
 
-    LOG ( "Trying to load state: indexedFrame=%s; _statesList={ %s ... %s }",
-          indexedFrame, _statesList.front().indexedFrame, _statesList.back().indexedFrame );
+    LOG_ROLLBACK ( "Trying to load state: indexedFrame=%s; _statesList={ %s ... %s }",
+                   indexedFrame, _statesList.front().indexedFrame, _statesList.back().indexedFrame );
+
+    const uint64_t startUs = TimerManager::get().getNowMicroseconds();
 
+    const uint32_t origIndex = netMan.getIndex();
     const uint32_t origFrame = netMan.getFrame();
 
     for ( auto it = _statesList.rbegin(); it != _statesList.rend(); ++it )
@@ -141,7 +193,7 @@ bool DllRollbackManager::loadState ( IndexedFrame indexedFrame, NetplayManager&
         if ( it->indexedFrame.value <= indexedFrame.value )
 #endif
         {
-            LOG ( "Loaded state: indexedFrame=%s", it->indexedFrame );
+            LOG_ROLLBACK ( "Loaded state: indexedFrame=%s", it->indexedFrame );
 
             // Overwrite the current game state
             netMan._state = it->netplayState;
@@ -153,7 +205,7 @@ bool DllRollbackManager::loadState ( IndexedFrame indexedFrame, NetplayManager&
             int rbFrames;
             if ( !netMan.config.mode.isTraining() ) {
                 rbFrames = _statesList.back().indexedFrame.value - it->indexedFrame.value;
-                LOG("Rolled back %i frames", rbFrames);
+                LOG_ROLLBACK("Rolled back %i frames", rbFrames);
             }
             // Erase all other states after the current one.
             // Note: it.base() returns 1 after the position of it, but moving forward.
@@ -164,38 +216,38 @@ bool DllRollbackManager::loadState ( IndexedFrame indexedFrame, NetplayManager&
 
             // Disable rollback for input history if in training mode
             if ( !netMan.config.mode.isTraining() ) {
-                LOG( "Fixing input history for rbFrames %d", rbFrames );
+                LOG_ROLLBACK( "Fixing input history for rbFrames %d", rbFrames );
                 // Erase one frame of inputs from the game's replay structs for each frame rolled back.
                 for (; rbFrames > 0; rbFrames--) {
                     if (!*(RepRound**)CC_REPROUND_TBL_ENDPTR_ADDR) {
-                        LOG( "Missing replay table" );
+                        LOG_ROLLBACK_TRACE( "Missing replay table" );
                         break;
                     }
                     RepRound* curRound = (*(RepRound**)CC_REPROUND_TBL_ENDPTR_ADDR - 1);
-                    LOG( "%d", curRound );
+                    LOG_ROLLBACK_TRACE( "%d", curRound );
                     if (!curRound->inputs) {
-                        LOG( "Missing inputs" );
+                        LOG_ROLLBACK_TRACE( "Missing inputs" );
                         break;
                     }
                     // Assumes there are always containers for 4 players in input container table; may not be true
                     for (int i=0; i<4; i++) {
                         RepInputContainer* inputs = &(curRound->inputs[i]);
                         if (!inputs->states) {
-                            LOG( "player %d no states", i );
+                            LOG_ROLLBACK_TRACE( "player %d no states", i );
                             continue;
                         }
                         RepInputState* state = &(inputs->states[inputs->activeIndex]);
                         if (!state->frameCount) {
-                            LOG( "player %d no framecount", i+1 );
+                            LOG_ROLLBACK_TRACE( "player %d no framecount", i+1 );
                             continue;
                         }
                         if (state->frameCount == 1) {
                             memset(state, 0, sizeof(RepInputState));
                             inputs->statesEnd -= sizeof(RepInputState);
-                            LOG("Replay state %i for p%i has frame count 1; decrementing index", inputs->activeIndex, i+1);
+                            LOG_ROLLBACK_TRACE("Replay state %i for p%i has frame count 1; decrementing index", inputs->activeIndex, i+1);
                             inputs->activeIndex--;
                         } else {
-                            LOG("Replay state %i for p%i has frame count %i; decrementing count", inputs->activeIndex, i+1, state->frameCount);
+                            LOG_ROLLBACK_TRACE("Replay state %i for p%i has frame count %i; decrementing count", inputs->activeIndex, i+1, state->frameCount);
                             state->frameCount--;
                         }
                     }
@@ -221,16 +273,103 @@ bool DllRollbackManager::loadState ( IndexedFrame indexedFrame, NetplayManager&
                     AsmHacks::sfxFilterArray[j] = 0x80;
             }
 
+            // Rolling back past the start of the current index is counted in the last bucket
+            if ( netMan.getIndex() == origIndex )
+                _rollbackDepth = origFrame - netMan.getFrame();
+            else
+                _rollbackDepth = NUM_ROLLBACK_STATES;
+
+            _stats.depth.add ( _rollbackDepth );
+
+            // The rollback lasts until the last re-run frame, see finishedRerunSounds
+            _resimStartUs = TimerManager::get().getNowMicroseconds();
+            _rollbackStartUs = startUs;
+            _resimFrames = 0;
+
+            _stats.loadUs.add ( _resimStartUs - startUs );
             return true;
         }
     }
 
-    LOG ( "Failed to load state: indexedFrame=%s", indexedFrame );
+    LOG_ROLLBACK ( "Failed to load state: indexedFrame=%s", indexedFrame );
     return false;
 }
 
+MsgPtr DllRollbackManager::getSpectateState ( IndexedFrame indexedFrame ) const
+{
+    for ( auto it = _statesList.rbegin(); it != _statesList.rend(); ++it )
+    {
+        if ( it->indexedFrame.value > indexedFrame.value )
+            continue;
+
+        // The spectator can only jump to a state in the index it is playing
+        if ( it->indexedFrame.parts.index != indexedFrame.parts.index )
+            break;
+
+        SpectateState *state = new SpectateState ( it->netplayState.value, it->startWorldTime, it->indexedFrame );
+        state->fpEnv.assign ( ( const char * ) &it->fp_env, sizeof ( it->fp_env ) );
+        state->dump.assign ( it->rawBytes, allAddrs.totalSize );
+
+        // This is encoded during a frame, so trade some size for speed
+        state->compressionLevel = 1;
+
+        return MsgPtr ( state );
+    }
+
+    return 0;
+}
+
+bool DllRollbackManager::loadSpectateState ( const SpectateState& spectateState, NetplayManager& netMan )
+{
+    loadAllAddrs();
+
+    if ( spectateState.dump.size() != allAddrs.totalSize || spectateState.fpEnv.size() != sizeof ( std::fenv_t ) )
+    {
+        LOG_AT ( LOG_LEVEL_WARN, LOG_CAT_SPECTATE, "Failed to load %s: totalSize=%u",
+                 spectateState, allAddrs.totalSize );
+        return false;
+    }
+
+    LOG_AT ( LOG_LEVEL_INFO, LOG_CAT_SPECTATE, "Loading %s: indexedFrame=%s", spectateState, netMan.getIndexedFrame() );
+
+    const uint64_t startUs = TimerManager::get().getNowMicroseconds();
+
+    GameState state =
+    {
+        NetplayState ( NetplayState::Enum ( spectateState.netplayState ) ),
+        spectateState.startWorldTime,
+        spectateState.indexedFrame,
+        std::fenv_t(),
+        const_cast<char *> ( &spectateState.dump[0] )
+    };
+
+    memcpy ( &state.fp_env, &spectateState.fpEnv[0], sizeof ( state.fp_env ) );
+
+    overwriteState ( state, netMan );
+
+    _stats.loadUs.add ( TimerManager::get().getNowMicroseconds() - startUs );
+    return true;
+}
+
+void DllRollbackManager::overwriteState ( GameState& state, NetplayManager& netMan )
+{
+    // Saved states from before the jump can't be rolled back to anymore
+    for ( const GameState& saved : _statesList )
+        _freeStack.push ( saved.rawBytes - _memoryPool.get() );
+
+    _statesList.clear();
+
+    // Overwrite the current game state
+    netMan._state = state.netplayState;
+    netMan._startWorldTime = state.startWorldTime;
+    netMan._indexedFrame = state.indexedFrame;
+    state.load();
+}
+
 void DllRollbackManager::saveRerunSounds ( uint32_t frame )
 {
+    const uint64_t startUs = TimerManager::get().getNowMicroseconds();
+
     uint8_t *currentSfxArray = &_sfxHistory [ frame % NUM_ROLLBACK_STATES ][0];
 
     // Rewrite the sound effects history during re-run
@@ -241,6 +380,10 @@ void DllRollbackManager::saveRerunSounds ( uint32_t frame )
         else
             currentSfxArray[j] = 0;
     }
+
+    ++_resimFrames;
+
+    _stats.rerunSoundsUs.add ( TimerManager::get().getNowMicroseconds() - startUs );
 }
 
 void DllRollbackManager::finishedRerunSounds()
@@ -259,4 +402,324 @@ void DllRollbackManager::finishedRerunSounds()
 
     // Cleared last played sound effects
     memset ( AsmHacks::sfxFilterArray, 0, CC_SFX_ARRAY_LEN );
+
+    // This is the last re-run frame of the current rollback
+    if ( _rollbackStartUs )
+    {
+        const uint64_t nowUs = TimerManager::get().getNowMicroseconds();
+
+        _stats.resimFrames.add ( _resimFrames );
+        _stats.resimUs.add ( nowUs - _resimStartUs );
+        _stats.rollbackUs.add ( nowUs - _rollbackStartUs );
+
+        // The whole rollback happens before the next rendered frame
+        _frameUs += nowUs - _rollbackStartUs;
+
+        _rollbackStartUs = 0;
+    }
+}
+
+void DllRollbackManager::resetStats()
+{
+    _stats = Stats();
+
+    _rollbackStartUs = 0;
+    _frameUs = 0;
+}
+
+void DllRollbackManager::finishFrame ( bool rendered )
+{
+    // Re-run frames aren't rendered, so their cost adds up until the frame that is
+    if ( ! rendered || ! _frameUs )
+        return;
+
+    _stats.frameUs.add ( _frameUs );
+
+    if ( _frameUs > ROLLBACK_FRAME_BUDGET_US )
+        ++_stats.blownFrames;
+
+    _frameUs = 0;
+}
+
+string DllRollbackManager::getStatsSummary() const
+{
+    string str = format ( "Rollbacks: %u; over budget: %u frames; frame cost: p99=%u us max=%u us",
+                          _stats.depth.count(), _stats.blownFrames,
+                          _stats.frameUs.percentile ( 99 ), _stats.frameUs.max() );
+
+    str += format ( "\nDepth: mean=%.1f p99=%u max=%u; Re-sim: p99=%u us max=%u us",
+                    _stats.depth.mean(), _stats.depth.percentile ( 99 ), _stats.depth.max(),
+                    _stats.resimUs.percentile ( 99 ), _stats.resimUs.max() );
+
+    str += format ( "\nSave: p99=%u us max=%u us; Load: p99=%u us max=%u us",
+                    _stats.saveUs.percentile ( 99 ), _stats.saveUs.max(),
+                    _stats.loadUs.percentile ( 99 ), _stats.loadUs.max() );
+
+    return str;
+}
+
+bool DllRollbackManager::saveStats ( const string& file, const string& title ) const
+{
+    ofstream fout ( file.c_str(), ofstream::app );
+
+    if ( ! fout.good() )
+        return false;
+
+    const auto write = [&] ( const char *name, const string& summary, const string& buckets )
+    {
+        fout << name << ": " << summary << endl;
+
+        if ( ! buckets.empty() )
+            fout << "    " << buckets << endl;
+    };
+
+    fout << title << endl;
+
+    write ( "depth", _stats.depth.summary(), _stats.depth.str() );
+    write ( "resim_frames", _stats.resimFrames.summary(), _stats.resimFrames.str() );
+    write ( "save_us", _stats.saveUs.summary(), _stats.saveUs.str() );
+    write ( "load_us", _stats.loadUs.summary(), _stats.loadUs.str() );
+    write ( "rerun_sounds_us", _stats.rerunSoundsUs.summary(), _stats.rerunSoundsUs.str() );
+    write ( "resim_us", _stats.resimUs.summary(), _stats.resimUs.str() );
+    write ( "rollback_us", _stats.rollbackUs.summary(), _stats.rollbackUs.str() );
+    write ( "frame_us", _stats.frameUs.summary(), _stats.frameUs.str() );
+    write ( "over_budget_frames", format ( "%u", _stats.blownFrames ), "" );
+
+    fout << endl;
+
+    return fout.good();
 }
+
+#ifndef RELEASE
+
+void DllRollbackManager::hashState ( IndexedFrame indexedFrame, const char *rawBytes )
+{
+    StateHash& stateHash = _stateHashes [ indexedFrame.parts.frame % NUM_ROLLBACK_STATES ];
+
+    ASSERT ( stateHash.regionHashes.size() == allAddrs.hashSlices.size() );
+
+    allAddrs.hashDump ( rawBytes, &stateHash.regionHashes[0] );
+
+    stateHash.indexedFrame = indexedFrame;
+    stateHash.hash = getFastHash ( ( const char * ) &stateHash.regionHashes[0],
+                                   stateHash.regionHashes.size() * sizeof ( uint32_t ) );
+}
+
+void DllRollbackManager::hashRerunState ( IndexedFrame indexedFrame )
+{
+    if ( ! _rerunState )
+        return;
+
+    char *dump = _rerunState.get();
+
+    for ( const MemDump& mem : allAddrs.addrs )
+        mem.saveDump ( dump );
+
+    ASSERT ( dump == _rerunState.get() + allAddrs.totalSize );
+
+    hashState ( indexedFrame, _rerunState.get() );
+    captureState ( indexedFrame, _rerunState.get() );
+}
+
+bool DllRollbackManager::getFrameHash ( IndexedFrame indexedFrame, uint32_t& hash ) const
+{
+    const StateHash& stateHash = _stateHashes [ indexedFrame.parts.frame % NUM_ROLLBACK_STATES ];
+
+    if ( stateHash.indexedFrame.value != indexedFrame.value )
+        return false;
+
+    hash = stateHash.hash;
+    return true;
+}
+
+MsgPtr DllRollbackManager::getFrameHashes ( IndexedFrame indexedFrame, uint32_t endFrame ) const
+{
+    uint32_t hash;
+
+    while ( indexedFrame.parts.frame < endFrame && ! getFrameHash ( indexedFrame, hash ) )
+        ++indexedFrame.parts.frame;
+
+    if ( indexedFrame.parts.frame >= endFrame )
+        return 0;
+
+    MsgPtr msg ( new FrameHashes ( indexedFrame ) );
+
+    for ( ; indexedFrame.parts.frame < endFrame && getFrameHash ( indexedFrame, hash ); ++indexedFrame.parts.frame )
+        msg->getAs<FrameHashes>().hashes.push_back ( hash );
+
+    return msg;
+}
+
+MsgPtr DllRollbackManager::getRegionHashes ( IndexedFrame indexedFrame ) const
+{
+    const StateHash& stateHash = _stateHashes [ indexedFrame.parts.frame % NUM_ROLLBACK_STATES ];
+
+    if ( stateHash.indexedFrame.value != indexedFrame.value )
+        return 0;
+
+    MsgPtr msg ( new RegionHashes ( indexedFrame ) );
+    msg->getAs<RegionHashes>().hashes = stateHash.regionHashes;
+    return msg;
+}
+
+vector<string> DllRollbackManager::diffRegionHashes ( const RegionHashes& remote ) const
+{
+    vector<string> diffs;
+
+    const StateHash& stateHash = _stateHashes [ remote.indexedFrame.parts.frame % NUM_ROLLBACK_STATES ];
+
+    if ( stateHash.indexedFrame.value != remote.indexedFrame.value )
+    {
+        diffs.push_back ( format ( "Local region hashes for [%s] are no longer available", remote.indexedFrame ) );
+        return diffs;
+    }
+
+    if ( stateHash.regionHashes.size() != remote.hashes.size() )
+    {
+        diffs.push_back ( format ( "Mismatched number of region hashes: local=%u; remote=%u",
+                                   stateHash.regionHashes.size(), remote.hashes.size() ) );
+        return diffs;
+    }
+
+    for ( size_t i = 0; i < remote.hashes.size(); ++i )
+    {
+        if ( stateHash.regionHashes[i] != remote.hashes[i] )
+            diffs.push_back ( allAddrs.describeHashSlice ( i ) );
+    }
+
+    return diffs;
+}
+
+bool DllRollbackManager::saveStateFile ( IndexedFrame indexedFrame, const string& file ) const
+{
+    for ( const GameState& state : _statesList )
+    {
+        if ( state.indexedFrame.value != indexedFrame.value )
+            continue;
+
+        FILE *fp = fopen ( file.c_str(), "wb" );
+
+        if ( ! fp )
+            return false;
+
+        const bool good = ( fwrite ( state.rawBytes, 1, allAddrs.totalSize, fp ) == allAddrs.totalSize );
+        fclose ( fp );
+        return good;
+    }
+
+    return false;
+}
+
+bool DllRollbackManager::startCapture ( const string& file )
+{
+    loadAllAddrs();
+
+    stopCapture();
+
+    _captureFile = fopen ( file.c_str(), "wb" );
+
+    if ( ! _captureFile )
+        return false;
+
+    // Game states are large, so buffer a few of them at a time
+    setvbuf ( _captureFile, 0, _IOFBF, 4 * allAddrs.totalSize );
+
+    const uint32_t header[2] = { MEM_DUMP_CAPTURE_MAGIC, ( uint32_t ) allAddrs.totalSize };
+    fwrite ( header, sizeof ( header ), 1, _captureFile );
+
+    LOG ( "Capturing game states to '%s'", file );
+    return true;
+}
+
+void DllRollbackManager::stopCapture()
+{
+    if ( ! _captureFile )
+        return;
+
+    fclose ( _captureFile );
+    _captureFile = 0;
+
+    LOG ( "Stopped capturing game states" );
+}
+
+void DllRollbackManager::captureState ( IndexedFrame indexedFrame, const char *rawBytes )
+{
+    if ( ! _captureFile )
+        return;
+
+    const MemDumpCaptureHeader header = { indexedFrame.parts.index, indexedFrame.parts.frame, _frameRendered };
+
+    if ( fwrite ( &header, sizeof ( header ), 1, _captureFile ) != 1
+            || fwrite ( rawBytes, allAddrs.totalSize, 1, _captureFile ) != 1 )
+    {
+        LOG ( "Failed to capture game state" );
+        stopCapture();
+    }
+}
+
+bool DllRollbackManager::saveKeyframe ( const NetplayManager& netMan, ReplayKeyframes& keyframes )
+{
+    loadAllAddrs();
+
+    if ( keyframes.getStateSize() != allAddrs.totalSize )
+        keyframes.reset ( allAddrs.totalSize );
+
+    if ( keyframes.has ( netMan._indexedFrame ) )
+        return false;
+
+    std::fenv_t fp_env;
+    fegetenv ( &fp_env );
+
+    _keyframeState.resize ( allAddrs.totalSize );
+
+    GameState state =
+    {
+        netMan._state,
+        netMan._startWorldTime,
+        netMan._indexedFrame,
+        fp_env,
+        &_keyframeState[0]
+    };
+
+    state.save();
+
+    return keyframes.add ( state.netplayState.value, state.startWorldTime, state.indexedFrame,
+                           string ( ( const char * ) &fp_env, sizeof ( fp_env ) ), state.rawBytes );
+}
+
+bool DllRollbackManager::loadKeyframe ( const ReplayKeyframes& keyframes, size_t keyframe, NetplayManager& netMan )
+{
+    loadAllAddrs();
+
+    if ( keyframe >= keyframes.size() || keyframes.getStateSize() != allAddrs.totalSize
+            || keyframes.get ( keyframe ).fpEnv.size() != sizeof ( std::fenv_t ) )
+    {
+        LOG ( "Invalid keyframe %u: totalSize=%u", keyframe, allAddrs.totalSize );
+        return false;
+    }
+
+    const ReplayKeyframes::Keyframe& source = keyframes.get ( keyframe );
+
+    _keyframeState.resize ( allAddrs.totalSize );
+
+    if ( ! keyframes.decode ( keyframe, &_keyframeState[0] ) )
+        return false;
+
+    GameState state =
+    {
+        NetplayState ( NetplayState::Enum ( source.netplayState ) ),
+        source.startWorldTime,
+        source.indexedFrame,
+        std::fenv_t(),
+        &_keyframeState[0]
+    };
+
+    memcpy ( &state.fp_env, source.fpEnv.data(), sizeof ( state.fp_env ) );
+
+    LOG ( "Loading keyframe [%s]: indexedFrame=%s", source.indexedFrame, netMan.getIndexedFrame() );
+
+    overwriteState ( state, netMan );
+    return true;
+}
+
+#endif // NOT RELEASE
@@ -2,12 +2,22 @@
 
 #include "DllNetplayManager.hpp"
 #include "Constants.hpp"
+#include "Histogram.hpp"
+#include "ReplayKeyframes.hpp"
 
 #include <memory>
 #include <stack>
 #include <list>
 #include <array>
+#include <vector>
+#include <string>
 #include <cfenv>
+#include <cstdio>
+
+// Frames where saving, loading, and re-simulating states take longer than this many microseconds in total, delay
+// the next rendered frame
+#define ROLLBACK_FRAME_BUDGET_US    ( 1000000 / 60 )
+
 
 struct __attribute__((packed)) RepInputState
 {
@@ -48,12 +58,92 @@ public:
     void saveState ( const NetplayManager& netMan );
     bool loadState ( IndexedFrame indexedFrame, NetplayManager& netMan );
 
+    // Copy the newest saved game state at or before the given frame, in the same index, for a spectator joining
+    // in the middle of a game. Returns a null MsgPtr if there is no such state.
+    MsgPtr getSpectateState ( IndexedFrame indexedFrame ) const;
+
+    // Overwrite the current game state with one copied from the host, this discards all the saved states
+    bool loadSpectateState ( const SpectateState& spectateState, NetplayManager& netMan );
+
     // Save sounds during rollback re-run
     void saveRerunSounds ( uint32_t frame );
 
     // Finalize rollback sound effects
     void finishedRerunSounds();
 
+    // Rollback cost statistics, these are always collected
+    struct Stats
+    {
+        // Number of frames rolled back, per rollback
+        Histogram<NUM_ROLLBACK_STATES + 1> depth;
+
+        // Number of frames re-simulated, per rollback
+        Histogram<NUM_ROLLBACK_STATES + 1> resimFrames;
+
+        // Microseconds spent in saveState, loadState, and saveRerunSounds, per call
+        Histogram<20, true> saveUs, loadUs, rerunSoundsUs;
+
+        // Microseconds spent re-simulating, from the end of loadState to the last re-run frame, per rollback
+        Histogram<20, true> resimUs;
+
+        // Microseconds from the start of loadState to the last re-run frame, per rollback
+        Histogram<20, true> rollbackUs;
+
+        // Microseconds spent saving, loading, and re-simulating, per rendered frame
+        Histogram<20, true> frameUs;
+
+        // Number of rendered frames that went over ROLLBACK_FRAME_BUDGET_US
+        uint32_t blownFrames = 0;
+    };
+
+    // Get / reset the rollback cost statistics
+    const Stats& getStats() const { return _stats; }
+    void resetStats();
+
+    // Record the rollback cost of the frames since the last rendered frame, this should be called every frame
+    void finishFrame ( bool rendered );
+
+    // Get a short summary of the rollback cost statistics, for the overlay
+    std::string getStatsSummary() const;
+
+    // Append the full rollback cost statistics to a file
+    bool saveStats ( const std::string& file, const std::string& title ) const;
+
+#ifndef RELEASE
+    // Hash the game state during rollback re-run, since those states aren't saved
+    void hashRerunState ( IndexedFrame indexedFrame );
+
+    // Get the state hashes of consecutive frames from indexedFrame up to endFrame (exclusive).
+    // Frames before the first available hash are skipped. Returns a null MsgPtr if no hashes are available.
+    MsgPtr getFrameHashes ( IndexedFrame indexedFrame, uint32_t endFrame ) const;
+
+    // Get the state hash of a single frame, returns false if it is no longer available
+    bool getFrameHash ( IndexedFrame indexedFrame, uint32_t& hash ) const;
+
+    // Get the per-region hashes of a single frame, returns a null MsgPtr if they are no longer available
+    MsgPtr getRegionHashes ( IndexedFrame indexedFrame ) const;
+
+    // Describe each hash slice that differs from the remote per-region hashes
+    std::vector<std::string> diffRegionHashes ( const RegionHashes& remote ) const;
+
+    // Write the raw bytes of a saved game state to a file, for use with tools/StateDiff.cpp
+    bool saveStateFile ( IndexedFrame indexedFrame, const std::string& file ) const;
+
+    // Start / stop capturing every game state to a file, for use with tools/StateProfiler.cpp
+    bool startCapture ( const std::string& file );
+    void stopCapture();
+    bool isCapturing() const { return _captureFile != 0; }
+
+    // Indicate if the game will render the current frame, this is recorded with the next captured game state
+    void setFrameRendered ( bool rendered ) { _frameRendered = rendered; }
+
+    // Add the current game state as a replay keyframe, returns false if there already is one for this frame
+    bool saveKeyframe ( const NetplayManager& netMan, ReplayKeyframes& keyframes );
+
+    // Overwrite the current game state with a replay keyframe, this discards all the saved states
+    bool loadKeyframe ( const ReplayKeyframes& keyframes, size_t keyframe, NetplayManager& netMan );
+#endif // NOT RELEASE
+
 private:
 
     struct GameState
@@ -84,4 +174,54 @@ private:
 
     // History of sound effect playbacks
     std::array<std::array<uint8_t, CC_SFX_ARRAY_LEN>, NUM_ROLLBACK_STATES> _sfxHistory;
+
+    // Rollback cost statistics
+    Stats _stats;
+
+    // Overwrite the current game state and netplay state, this discards all the saved states
+    void overwriteState ( GameState& state, NetplayManager& netMan );
+
+    // Timestamps in microseconds of the start of the current rollback, and the start of re-simulating
+    uint64_t _rollbackStartUs = 0, _resimStartUs = 0;
+
+    // Number of frames rolled back, and re-simulated so far, for the current rollback
+    uint32_t _rollbackDepth = 0, _resimFrames = 0;
+
+    // Microseconds spent saving, loading, and re-simulating since the last rendered frame
+    uint64_t _frameUs = 0;
+
+#ifndef RELEASE
+    struct StateHash
+    {
+        // The frame this hash is for, a hash is only valid if this matches the requested frame
+        IndexedFrame indexedFrame = MaxIndexedFrame;
+
+        // Hash of the full game state, which is the hash of all the region hashes
+        uint32_t hash = 0;
+
+        // Hash of each slice of the game state, see MemDumpList::hashSlices
+        std::vector<uint32_t> regionHashes;
+    };
+
+    // History of game state hashes, indexed by frame
+    std::array<StateHash, NUM_ROLLBACK_STATES> _stateHashes;
+
+    // Temporary game state used to hash re-run frames
+    std::shared_ptr<char> _rerunState;
+
+    // Hash a saved game state and record it in the history
+    void hashState ( IndexedFrame indexedFrame, const char *rawBytes );
+
+    // File to capture game states to
+    FILE *_captureFile = 0;
+
+    // If the game rendered the last frame
+    bool _frameRendered = true;
+
+    // Write a game state to the capture file
+    void captureState ( IndexedFrame indexedFrame, const char *rawBytes );
+
+    // Temporary game state used to save and load replay keyframes
+    std::vector<char> _keyframeState;
+#endif // NOT RELEASE
 };
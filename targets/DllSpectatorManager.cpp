@@ -4,6 +4,7 @@
 #include "Logger.hpp"
 #include "Algorithms.hpp"
 #include "Constants.hpp"
+#include "TimerManager.hpp"
 
 using namespace std;
 
@@ -20,10 +21,49 @@ void SpectatorManager::pushSpectator ( Socket *socketPtr, const IpAddrPort& serv
 {
     LOG ( "socket=%08x; serverAddr='%s'", socketPtr, serverAddr );
 
+    const IndexedFrame pos = {{ NUM_INPUTS - 1, _netManPtr->getSpectateStartIndex() }};
+
+    if ( ! addSpectator ( socketPtr, serverAddr, pos ) )
+        return;
+
+    const uint8_t netplayState = _netManPtr->getState().value;
+    const bool isTraining = _netManPtr->config.mode.isTraining();
+
+    switch ( netplayState )
+    {
+        case NetplayState::CharaSelect:
+            socketPtr->send ( _netManPtr->getRngState ( pos.parts.index ) );
+            break;
+
+        case NetplayState::Skippable:
+        case NetplayState::CharaIntro:
+        case NetplayState::InGame:
+        case NetplayState::RetryMenu:
+            socketPtr->send ( _netManPtr->getRngState ( pos.parts.index + ( isTraining ? 1 : 2 ) ) );
+            break;
+    }
+
+    socketPtr->send ( new InitialGameState ( pos, netplayState, isTraining ) );
+}
+
+void SpectatorManager::resumeSpectator ( Socket *socketPtr, const IpAddrPort& serverAddr, IndexedFrame pos )
+{
+    LOG ( "socket=%08x; serverAddr='%s'; pos=[%s]", socketPtr, serverAddr, pos );
+
+    // The game is already running, so only the inputs the spectator doesn't have yet are sent, starting from the
+    // oldest index still kept
+    if ( pos.parts.index < _netManPtr->getSpectateStartIndex() )
+        pos = {{ NUM_INPUTS - 1, _netManPtr->getSpectateStartIndex() }};
+
+    addSpectator ( socketPtr, serverAddr, pos );
+}
+
+bool SpectatorManager::addSpectator ( Socket *socketPtr, const IpAddrPort& serverAddr, IndexedFrame pos )
+{
     SocketPtr newSocket = popPendingSocket ( socketPtr );
 
     if ( ! newSocket )
-        return;
+        return false;
 
     ASSERT ( newSocket.get() == socketPtr );
 
@@ -54,8 +94,8 @@ void SpectatorManager::pushSpectator ( Socket *socketPtr, const IpAddrPort& serv
     spectator.socket = newSocket;
     spectator.serverAddr = serverAddr;
     spectator.it = it;
-    spectator.pos.parts.frame = NUM_INPUTS - 1;
-    spectator.pos.parts.index = _netManPtr->getSpectateStartIndex();
+    spectator.pos = pos;
+    spectator.catchUpStartTime = TimerManager::get().getNow ( true );
 
     _spectatorMap[socketPtr] = spectator;
 
@@ -66,25 +106,7 @@ void SpectatorManager::pushSpectator ( Socket *socketPtr, const IpAddrPort& serv
 
     LOG ( "socket=%08x; spectator.pos=[%s]; preserveStartIndex=%u",
           socketPtr, spectator.pos, _netManPtr->preserveStartIndex );
-
-    const uint8_t netplayState = _netManPtr->getState().value;
-    const bool isTraining = _netManPtr->config.mode.isTraining();
-
-    switch ( netplayState )
-    {
-        case NetplayState::CharaSelect:
-            newSocket->send ( _netManPtr->getRngState ( spectator.pos.parts.index ) );
-            break;
-
-        case NetplayState::Skippable:
-        case NetplayState::CharaIntro:
-        case NetplayState::InGame:
-        case NetplayState::RetryMenu:
-            newSocket->send ( _netManPtr->getRngState ( spectator.pos.parts.index + ( isTraining ? 1 : 2 ) ) );
-            break;
-    }
-
-    newSocket->send ( new InitialGameState ( spectator.pos, netplayState, isTraining ) );
+    return true;
 }
 
 void SpectatorManager::popSpectator ( Socket *socketPtr )
@@ -104,12 +126,22 @@ void SpectatorManager::popSpectator ( Socket *socketPtr )
 
     _spectatorList.erase ( it->second.it );
     _spectatorMap.erase ( socketPtr );
+
+    _droppedSpectators.erase ( remove ( _droppedSpectators.begin(), _droppedSpectators.end(), socketPtr ),
+                               _droppedSpectators.end() );
 }
 
 void SpectatorManager::newRngState ( const RngState& rngState )
 {
+    if ( _spectatorList.empty() )
+        return;
+
+    // Encode once for all spectators
+    MsgPtr msgRngState = rngState.clone();
+    ::Protocol::encodeShared ( msgRngState );
+
     for ( Socket *socket : _spectatorList )
-        socket->send ( rngState );
+        socket->send ( msgRngState );
 }
 
 void SpectatorManager::frameStepSpectators()
@@ -121,6 +153,8 @@ void SpectatorManager::frameStepSpectators()
 
         // Reset the preserve index
         _netManPtr->preserveStartIndex = _currentMinIndex = UINT_MAX;
+
+        _broadcastCache.clear();
         return;
     }
 
@@ -133,6 +167,13 @@ void SpectatorManager::frameStepSpectators()
     if ( _spectatorMapPos == _spectatorMap.cend() )
         _spectatorMapPos = _spectatorMap.cbegin();
 
+    // Spectators that are catching up get a chunk of history every frame, instead of waiting for the interval
+    for ( auto& kv : _spectatorMap )
+    {
+        if ( kv.second.catchingUp && checkSendQueue ( kv.first, kv.second ) )
+            catchUpSpectator ( kv.first, kv.second );
+    }
+
     // Number of times to broadcast per frame
     const uint32_t multiplier = 1 + ( _spectatorList.size() * 2 ) / ( NUM_INPUTS + 1 );
 
@@ -155,6 +196,30 @@ void SpectatorManager::frameStepSpectators()
 
             // Reset the current min index
             _currentMinIndex = UINT_MAX;
+
+            // Every spectator is at or after the preserve index, so older broadcasts won't be sent again
+            if ( _netManPtr->preserveStartIndex != UINT_MAX )
+            {
+                const IndexedFrame preserved = {{ 0, _netManPtr->preserveStartIndex }};
+                _broadcastCache.eraseBefore ( preserved );
+            }
+
+#ifndef RELEASE
+            if ( _broadcastUs.count() >= SPECTATOR_STATS_SAMPLES )
+            {
+                size_t maxQueued = 0;
+
+                for ( Socket *socket : _spectatorList )
+                    maxQueued = max ( maxQueued, socket->getSendQueue().getBytes() );
+
+                LOG ( "spectators=%u; broadcast: %s us; cached=%u; hits=%u; misses=%u; maxQueued=%u",
+                      _spectatorList.size(), _broadcastUs.summary(), _broadcastCache.size(),
+                      _broadcastCache.getHits(), _broadcastCache.getMisses(), maxQueued );
+
+                _broadcastUs.reset();
+                _broadcastCache.resetStats();
+            }
+#endif // NOT RELEASE
         }
 
         const auto it = _spectatorMap.find ( *_spectatorListPos );
@@ -165,44 +230,184 @@ void SpectatorManager::frameStepSpectators()
         Spectator& spectator = it->second;
         const uint32_t oldIndex = spectator.pos.parts.index;
 
+        // Spectators that are catching up have already been sent their inputs this frame.
+        // Spectators that are too slow are downgraded to catching up, or dropped.
+        if ( spectator.catchingUp || ! checkSendQueue ( socket, spectator ) )
+        {
+            ++_spectatorListPos;
+            _currentMinIndex = min ( _currentMinIndex, spectator.pos.parts.index );
+            continue;
+        }
+
         LOG ( "socket=%08x; spectator.pos=[%s]; preserveStartIndex=%u; sentRng=%d; oldIndex=%d",
               socket, spectator.pos, _netManPtr->preserveStartIndex, spectator.sentRngState, oldIndex );
 
+#ifndef RELEASE
+        const uint64_t startUs = TimerManager::get().getNowMicroseconds();
+#endif // NOT RELEASE
+
         MsgPtr msgBothInputs = _netManPtr->getBothInputs ( spectator.pos );
 
-        // Send inputs if available
+        // Send inputs if available, spectators at the same position are sent the same encoded message
         if ( msgBothInputs )
-            socket->send ( msgBothInputs );
+            socket->send ( _broadcastCache.get ( msgBothInputs, msgBothInputs->getAs<BothInputs>().indexedFrame ) );
 
-        MsgPtr msgRngState = _netManPtr->getRngState ( oldIndex );
+        sendIndexState ( socket, spectator, oldIndex );
 
-        // Send RngState ONCE if available
-        if ( msgRngState && !spectator.sentRngState )
-        {
-            socket->send ( msgRngState );
-            spectator.sentRngState = true;
-        }
+#ifndef RELEASE
+        _broadcastUs.add ( TimerManager::get().getNowMicroseconds() - startUs );
+#endif // NOT RELEASE
 
-        // Clear sent flags whenever the index changes
-        if ( spectator.pos.parts.index > oldIndex )
-        {
-            spectator.sentRngState = false;
-            spectator.sentRetryMenuIndex = false;
-        }
+        ++_spectatorListPos;
+
+        // Update the current min index
+        _currentMinIndex = min ( _currentMinIndex, spectator.pos.parts.index );
+    }
+}
+
+void SpectatorManager::forwardToSpectators()
+{
+    for ( auto& kv : _spectatorMap )
+    {
+        Spectator& spectator = kv.second;
+        IndexedFrame pos = spectator.pos;
+
+        // Spectators with bytes still waiting are left to frameStepSpectators
+        if ( spectator.catchingUp || ! kv.first->getSendQueue().empty() )
+            continue;
+
+        MsgPtr msgBothInputs = _netManPtr->getBothInputs ( pos );
+
+        // Moving to the next index is left to frameStepSpectators, which also sends the RngState for each index
+        if ( ! msgBothInputs || pos.parts.index != spectator.pos.parts.index )
+            continue;
+
+        spectator.pos = pos;
+
+        kv.first->send ( _broadcastCache.get ( msgBothInputs, msgBothInputs->getAs<BothInputs>().indexedFrame ) );
+    }
+}
 
-        MsgPtr msgMenuIndex = _netManPtr->getRetryMenuIndex ( oldIndex );
+void SpectatorManager::catchUpSpectator ( Socket *socket, Spectator& spectator )
+{
+    const uint32_t oldIndex = spectator.pos.parts.index;
+    const IndexedFrame key = spectator.pos;
+
+    MsgPtr msgHistory = _netManPtr->getSpectateHistory ( spectator.pos, SPECTATE_HISTORY_FRAMES );
+
+    if ( msgHistory )
+    {
+        // The inputs of an older index are final, so spectators at the same position are sent the same encoded
+        // message. Chunks of the current index end wherever the inputs are, so they are encoded each time.
+        if ( oldIndex < _netManPtr->getIndex() )
+            msgHistory = _broadcastCache.get ( msgHistory, key );
+        else
+            ::Protocol::encodeShared ( msgHistory );
+
+        // Count the bytes before sending, since a GoBackN socket drops them when it sets the sequence
+        spectator.catchUpBytes += ::Protocol::getShared ( msgHistory )->size();
+
+        socket->send ( msgHistory );
+    }
+
+    sendIndexState ( socket, spectator, oldIndex );
+
+    // Caught up once the history for the current index is shorter than a full chunk
+    if ( oldIndex < _netManPtr->getIndex()
+            || ( msgHistory && msgHistory->getAs<SpectateHistory>().size() == SPECTATE_HISTORY_FRAMES ) )
+    {
+        return;
+    }
+
+    spectator.catchingUp = false;
+
+    LOG_AT ( LOG_LEVEL_INFO, LOG_CAT_SPECTATE, "socket=%08x; caught up to [%s] in %llu ms; sent %llu bytes",
+             socket, spectator.pos, TimerManager::get().getNow ( true ) - spectator.catchUpStartTime,
+             spectator.catchUpBytes );
+}
+
+bool SpectatorManager::checkSendQueue ( Socket *socket, Spectator& spectator )
+{
+    const SendQueue& queue = socket->getSendQueue();
+
+    if ( queue.empty() )
+        return true;
 
-        // Send retry menu index ONCE if available
-        if ( msgMenuIndex && !spectator.sentRetryMenuIndex )
+    const uint64_t age = queue.getAge ( TimerManager::get().getNow() );
+
+    if ( age >= SPECTATOR_QUEUE_DROP_AGE || queue.getBytes() >= SPECTATOR_QUEUE_DROP_BYTES )
+    {
+        if ( find ( _droppedSpectators.begin(), _droppedSpectators.end(), socket ) == _droppedSpectators.end() )
         {
-            socket->send ( msgMenuIndex );
-            spectator.sentRetryMenuIndex = true;
+            LOG ( "socket=%08x; dropped; queued=%u; age=%llu ms; downgrades=%u",
+                  socket, queue.getBytes(), age, spectator.numDowngrades );
+
+            _droppedSpectators.push_back ( socket );
         }
+        return false;
+    }
 
-        ++_spectatorListPos;
+    // Stop sending live inputs, the spectator is sent bigger chunks of history whenever its queue is empty
+    if ( ! spectator.catchingUp && queue.getBytes() >= SPECTATOR_QUEUE_DOWNGRADE_BYTES )
+    {
+        ++spectator.numDowngrades;
 
-        // Update the current min index
-        _currentMinIndex = min ( _currentMinIndex, spectator.pos.parts.index );
+        LOG ( "socket=%08x; downgraded; queued=%u; age=%llu ms; downgrades=%u",
+              socket, queue.getBytes(), age, spectator.numDowngrades );
+
+        spectator.catchingUp = true;
+        spectator.catchUpStartTime = TimerManager::get().getNow();
+        spectator.catchUpBytes = 0;
+    }
+
+    return ! spectator.catchingUp;
+}
+
+unordered_map<Socket *, size_t> SpectatorManager::getSendQueueDepths() const
+{
+    unordered_map<Socket *, size_t> depths;
+
+    for ( const auto& kv : _spectatorMap )
+        depths[kv.first] = kv.first->getSendQueue().getBytes();
+
+    return depths;
+}
+
+vector<Socket *> SpectatorManager::popDroppedSpectators()
+{
+    vector<Socket *> dropped;
+    dropped.swap ( _droppedSpectators );
+    return dropped;
+}
+
+void SpectatorManager::sendIndexState ( Socket *socket, Spectator& spectator, uint32_t oldIndex )
+{
+    // RngState and retry menu index are sent once per index
+    const IndexedFrame indexKey = {{ 0, oldIndex }};
+
+    MsgPtr msgRngState = _netManPtr->getRngState ( oldIndex );
+
+    // Send RngState ONCE if available
+    if ( msgRngState && !spectator.sentRngState )
+    {
+        socket->send ( _broadcastCache.get ( msgRngState, indexKey ) );
+        spectator.sentRngState = true;
+    }
+
+    // Clear sent flags whenever the index changes
+    if ( spectator.pos.parts.index > oldIndex )
+    {
+        spectator.sentRngState = false;
+        spectator.sentRetryMenuIndex = false;
+    }
+
+    MsgPtr msgMenuIndex = _netManPtr->getRetryMenuIndex ( oldIndex );
+
+    // Send retry menu index ONCE if available
+    if ( msgMenuIndex && !spectator.sentRetryMenuIndex )
+    {
+        socket->send ( _broadcastCache.get ( msgMenuIndex, indexKey ) );
+        spectator.sentRetryMenuIndex = true;
     }
 }
 
@@ -233,3 +438,200 @@ const IpAddrPort& SpectatorManager::getRandomSpectatorAddress() const
     LOG ( "'%s'", it->second.serverAddr );
     return it->second.serverAddr;
 }
+
+void SpectatorManager::setRelayRoot ( uint32_t capacity )
+{
+    LOG ( "capacity=%u", capacity );
+
+    _isRelayRoot = true;
+    _relayTree = RelayTree ( capacity );
+    _relayNodes.clear();
+    _relayAddresses.clear();
+    _relayMoves.clear();
+}
+
+const IpAddrPort& SpectatorManager::getRelayRedirectAddress()
+{
+    const uint64_t now = TimerManager::get().getNow();
+
+    expireRelayMoves ( now );
+
+    const uint32_t parent = _relayTree.findParent ( now );
+
+    // The tree doesn't know about every spectator until they have sent a RelayUpdate
+    if ( parent == RelayTree::None || parent == RelayTree::Root )
+        return getRandomSpectatorAddress();
+
+    _relayTree.reserve ( parent, now );
+
+    LOG ( "'%s'; depth=%u; latency=%u", _relayAddresses[parent], _relayTree.get ( parent ).depth + 1,
+          _relayTree.get ( parent ).latency );
+    return _relayAddresses[parent];
+}
+
+bool SpectatorManager::popRelayMove ( const IpAddrPort& serverAddr, IpAddrPort& parent )
+{
+    const auto it = _relayMoves.find ( serverAddr );
+
+    if ( it == _relayMoves.end() )
+        return false;
+
+    parent = it->second.parent;
+
+    _relayMoves.erase ( it );
+
+    LOG ( "'%s' -> '%s'", serverAddr, parent );
+    return true;
+}
+
+void SpectatorManager::expireRelayMoves ( uint64_t now )
+{
+    for ( auto it = _relayMoves.begin(); it != _relayMoves.end(); )
+    {
+        if ( now < it->second.time + RELAY_RESERVE_TIMEOUT )
+        {
+            ++it;
+            continue;
+        }
+
+        const auto jt = _relayNodes.find ( it->first );
+
+        if ( jt != _relayNodes.end() )
+        {
+            for ( uint32_t id : _relayTree.removeSubtree ( jt->second ) )
+            {
+                _relayNodes.erase ( _relayAddresses[id] );
+                _relayAddresses.erase ( id );
+            }
+        }
+
+        LOG ( "'%s' didn't rejoin; spectators=%u", it->first, _relayTree.size() );
+
+        it = _relayMoves.erase ( it );
+    }
+}
+
+MsgPtr SpectatorManager::relayUpdated ( Socket *socketPtr, const RelayUpdate& relayUpdate )
+{
+    const auto it = _spectatorMap.find ( socketPtr );
+
+    if ( it == _spectatorMap.end() )
+        return 0;
+
+    MsgPtr msg = relayUpdate.clone();
+    RelayUpdate& update = msg->getAs<RelayUpdate>();
+
+    if ( update.node.empty() )
+    {
+        // The spectator's own update
+        update.node = it->second.serverAddr;
+        update.parent.clear();
+    }
+    else if ( update.parent.empty() )
+    {
+        // Update about one of the spectator's children
+        update.parent = it->second.serverAddr;
+    }
+
+    LOG ( "socket=%08x; %s", socketPtr, update );
+
+    if ( ! _isRelayRoot )
+        return msg;
+
+    updateRelayTree ( update );
+    return 0;
+}
+
+MsgPtr SpectatorManager::relayLeft ( Socket *socketPtr )
+{
+    const auto it = _spectatorMap.find ( socketPtr );
+
+    if ( it == _spectatorMap.end() )
+        return 0;
+
+    MsgPtr msg ( new RelayUpdate ( 0, 0 ) );
+    msg->getAs<RelayUpdate>().node = it->second.serverAddr;
+    msg->getAs<RelayUpdate>().left = true;
+
+    if ( ! _isRelayRoot )
+        return msg;
+
+    updateRelayTree ( msg->getAs<RelayUpdate>() );
+    return 0;
+}
+
+void SpectatorManager::updateRelayTree ( const RelayUpdate& update )
+{
+    const auto it = _relayNodes.find ( update.node );
+
+    if ( update.left )
+    {
+        if ( it == _relayNodes.end() )
+            return;
+
+        const uint64_t now = TimerManager::get().getNow();
+        const vector<RelayTree::Move> moves = _relayTree.remove ( it->second, now );
+
+        _relayAddresses.erase ( it->second );
+        _relayNodes.erase ( it );
+
+        // The children of the relay reconnect to the root, which redirects each one under its new parent
+        for ( const RelayTree::Move& move : moves )
+        {
+            if ( move.parent == RelayTree::None )
+                continue;
+
+            RelayMove& relayMove = _relayMoves[_relayAddresses[move.node]];
+            relayMove.parent = ( move.parent == RelayTree::Root ? NullAddress : _relayAddresses[move.parent] );
+            relayMove.time = now;
+        }
+
+        // Children that didn't fit anywhere were removed along with their descendants
+        for ( auto jt = _relayAddresses.begin(); jt != _relayAddresses.end(); )
+        {
+            if ( _relayTree.contains ( jt->first ) )
+            {
+                ++jt;
+                continue;
+            }
+
+            _relayNodes.erase ( jt->second );
+            jt = _relayAddresses.erase ( jt );
+        }
+
+        LOG ( "'%s' left; moved=%u; spectators=%u; maxDepth=%u",
+              update.node, moves.size(), _relayTree.size(), _relayTree.getMaxDepth() );
+        return;
+    }
+
+    if ( it != _relayNodes.end() )
+    {
+        // The spectator has rejoined under its new relay
+        _relayMoves.erase ( update.node );
+
+        _relayTree.update ( it->second, update.capacity, update.rtt );
+        return;
+    }
+
+    uint32_t parent = RelayTree::Root;
+
+    if ( ! update.parent.empty() )
+    {
+        const auto jt = _relayNodes.find ( update.parent );
+
+        if ( jt == _relayNodes.end() )
+        {
+            LOG ( "Unknown parent '%s'", update.parent );
+            return;
+        }
+
+        parent = jt->second;
+    }
+
+    const uint32_t id = _relayTree.add ( parent, min ( update.capacity, uint32_t ( MAX_SPECTATORS ) ), update.rtt );
+
+    _relayNodes[update.node] = id;
+    _relayAddresses[id] = update.node;
+
+    LOG ( "'%s' joined; spectators=%u; maxDepth=%u", update.node, _relayTree.size(), _relayTree.getMaxDepth() );
+}
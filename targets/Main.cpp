@@ -296,11 +296,18 @@ int main ( int argc, char *argv[] )
             "  --replay, -R args    Replay the given file with options.\n"
             "                         TODO list possible arguments.\n"
         },
+
+        {
+            Options::LogCategories, 0, "", "log", Arg::Required,
+            "  --log C              Only log the comma separated categories C.\n"
+            "                         general, net, socket, gbn, rollback, ui, controller, spectate, or all.\n"
+        },
 #else
         { Options::Tunnel, 0, "", "tunnel", Arg::None, 0 },
         { Options::Dummy, 0, "", "dummy", Arg::None, 0 },
         { Options::PidLog, 0, "", "pidlog", Arg::None, 0 },
         { Options::StrictVersion, 0, "S", "", Arg::None, 0 },
+        { Options::LogCategories, 0, "", "log", Arg::Required, 0 },
 #endif
 
         { Options::NoFork, 0, "", "no-fork", Arg::None, 0 }, // Don't fork when inside Wine, ie when under wineconsole
@@ -403,6 +410,9 @@ int main ( int argc, char *argv[] )
         Logger::get().initialize ( ProcessManager::appDir + LOG_FILE );
     Logger::get().logVersion();
 
+    if ( opt[Options::LogCategories] )
+        Logger::get().setCategories ( Logger::parseCategories ( opt[Options::LogCategories].arg ) );
+
     LOG ( "Running from: %s", ProcessManager::appDir );
 
     // Log parsed command line opt
@@ -20,6 +20,9 @@ void __stdcall log(const char* format, ...);
 // Log file that contains all the data needed to keep games in sync
 #define SYNC_LOG_FILE FOLDER "sync.log"
 
+// Binary trace of the per-frame state that is checked for desyncs, decoded with tools/SyncTraceDecoder.cpp
+#define SYNC_TRACE_FILE FOLDER "sync.trace"
+
 // Controller mappings file extension
 #define MAPPINGS_EXT ".mappings"
 
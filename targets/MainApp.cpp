@@ -1,6 +1,7 @@
 #include "Main.hpp"
 #include "MainUi.hpp"
 #include "Pinger.hpp"
+#include "TimerManager.hpp"
 #include "ExternalIpAddress.hpp"
 #include "SmartSocket.hpp"
 #include "UdpSocket.hpp"
@@ -142,6 +143,19 @@ struct MainApp
 
     SpectateConfig spectateConfig;
 
+    // Time the spectate ctrlSocket started connecting, and the round trip time it took to connect
+    uint64_t spectateConnectTime = 0;
+    uint32_t spectateRtt = 0;
+
+    // Server port of the spectating game, advertised to the relay
+    uint16_t spectateServerPort = 0;
+
+    // Position of the next inputs needed, after the last inputs received from the relay
+    IndexedFrame spectatePos = {{ 0, 0 }};
+
+    // Reconnecting after the relay left, to resume spectating from spectatePos
+    bool isResuming = false;
+
     NetplayConfig netplayConfig;
 
     Pinger pinger;
@@ -310,6 +324,8 @@ struct MainApp
             ui.display ( format ( "Trying %s", address ) );
         }
 
+        spectateConnectTime = TimerManager::get().getNow ( true );
+
         ctrlSocket = SmartSocket::connectTCP ( this, address, options[Options::Tunnel] );
         LOG ( "ctrlSocket=%08x", ctrlSocket.get() );
 
@@ -354,6 +370,38 @@ struct MainApp
         uiCondVar.signal();
     }
 
+    // Advertise how many spectators we can relay to, so the broadcast can place new spectators
+    void sendRelayUpdate()
+    {
+        const int upload = ui.getConfig().getInteger ( "relayUpload" );
+        const uint32_t capacity = RelayTree::getCapacity ( max ( 0, upload ), MAX_SPECTATORS );
+
+        ctrlSocket->send ( new RelayUpdate ( capacity, spectateRtt ) );
+    }
+
+    void updateSpectatePos ( const MsgPtr& msg )
+    {
+        IndexedFrame pos;
+
+        if ( msg->getMsgType() == MsgType::BothInputs )
+        {
+            pos = msg->getAs<BothInputs>().indexedFrame;
+            pos.parts.frame += NUM_INPUTS;
+        }
+        else if ( msg->getMsgType() == MsgType::SpectateHistory && msg->getAs<SpectateHistory>().size() )
+        {
+            pos.parts.index = msg->getAs<SpectateHistory>().index;
+            pos.parts.frame = msg->getAs<SpectateHistory>().getEndFrame() - 1 + NUM_INPUTS;
+        }
+        else
+        {
+            return;
+        }
+
+        if ( pos.value > spectatePos.value )
+            spectatePos = pos;
+    }
+
     void forwardMsgQueue()
     {
         if ( !procMan.isConnected() || msgQueue.empty() )
@@ -1012,6 +1060,18 @@ struct MainApp
             ASSERT ( ctrlSocket.get() != 0 );
             ASSERT ( ctrlSocket->isConnected() == true );
 
+            // Connecting takes one round trip
+            if ( clientMode.isSpectate() )
+                spectateRtt = TimerManager::get().getNow ( true ) - spectateConnectTime;
+
+            // The game is already running, so skip straight to being added as a spectator
+            if ( isResuming )
+            {
+                ctrlSocket->send ( new SpectateResume ( spectateServerPort, spectatePos ) );
+                sendRelayUpdate();
+                return;
+            }
+
             ctrlSocket->send ( new VersionConfig ( clientMode ) );
         }
         else if ( socket == dataSocket.get() )
@@ -1044,7 +1104,17 @@ struct MainApp
 
             LOG ( "%s disconnected!", ( socket == ctrlSocket.get() ? "ctrlSocket" : "dataSocket" ) );
 
-            // TODO auto reconnect to original host address
+            // When the relay leaves, reconnect to the original host address, which redirects us to a new relay
+            if ( socket == ctrlSocket.get() && clientMode.isSpectate() && spectateServerPort && !isResuming )
+            {
+                LOG ( "Resuming from [%s] via '%s'", spectatePos, originalAddress );
+
+                isResuming = true;
+                address = originalAddress;
+                spectateConnectTime = TimerManager::get().getNow ( true );
+                ctrlSocket = SmartSocket::connectTCP ( this, address, options[Options::Tunnel] );
+                return;
+            }
 
             if ( socket == ctrlSocket.get() && clientMode.isSpectate() )
             {
@@ -1090,6 +1160,7 @@ struct MainApp
         if ( msg->getMsgType() == MsgType::IpAddrPort && socket == ctrlSocket.get() )
         {
             this->address = msg->getAs<IpAddrPort>();
+            spectateConnectTime = TimerManager::get().getNow ( true );
             ctrlSocket = SmartSocket::connectTCP ( this, this->address, options[Options::Tunnel] );
             return;
         }
@@ -1108,6 +1179,17 @@ struct MainApp
         {
             if ( isQueueing )
             {
+                if ( isResuming )
+                {
+                    // The relay's handshake is for new spectators, the game only needs the inputs
+                    if ( msg->getMsgType() == MsgType::VersionConfig || msg->getMsgType() == MsgType::SpectateConfig )
+                        return;
+
+                    isResuming = false;
+                }
+
+                updateSpectatePos ( msg );
+
                 msgQueue.push_back ( msg );
                 forwardMsgQueue();
                 return;
@@ -1222,6 +1304,19 @@ struct MainApp
                 return;
 
             case MsgType::IpAddrPort:
+                if ( ctrlSocket && ctrlSocket->isConnected() )
+                {
+                    ctrlSocket->send ( msg );
+
+                    if ( clientMode.isSpectate() )
+                    {
+                        spectateServerPort = msg->getAs<IpAddrPort>().port;
+                        sendRelayUpdate();
+                    }
+                }
+                return;
+
+            case MsgType::RelayUpdate:
                 if ( ctrlSocket && ctrlSocket->isConnected() )
                     ctrlSocket->send ( msg );
                 return;
@@ -1344,6 +1439,19 @@ struct MainApp
         {
             options.set ( Options::AutoReplaySave, 1 );
         }
+        if ( ui.getConfig().getInteger ( "autoDelay" ) > 0 )
+        {
+            options.set ( Options::AutoDelay, 1 );
+        }
+        if ( ui.getConfig().getInteger ( "spectateSavestate" ) > 0 )
+        {
+            options.set ( Options::SpectateSavestate, 1 );
+        }
+        if ( ui.getConfig().getInteger ( "inputPredictor" ) > 0 )
+        {
+            options.set ( Options::InputPredictor, 1,
+                          format ( "%u", uint32_t ( ui.getConfig().getInteger ( "inputPredictor" ) ) ) );
+        }
         if ( ui.getConfig().getInteger ( "frameLimiter" ) > 0 )
         {
             options.set ( Options::FrameLimiter, 1 );
@@ -1395,7 +1395,9 @@ void MainUi::settings()
                 break;
             case 13:
                 _ui->pushInFront ( new ConsoleUi::Menu ( "Experimental Options",
-                                                         { "Disable Caster Frame Limiter" }, "Cancel" ),
+                                                         { "Disable Caster Frame Limiter",
+                                                           "Automatic Delay Tuning",
+                                                           "Remote Input Prediction" }, "Cancel" ),
                                    { 0, 0 }, true ); // Don't expand but DO clear top
                 while ( true ) {
                     _ui->popUntilUserInput();
@@ -1414,6 +1416,40 @@ void MainUi::settings()
                                 saveConfig();
                             }
 
+                        _ui->pop();
+                    } else if ( setting == 1 ) {
+                        _ui->pushInFront ( new ConsoleUi::Menu ( "Turn on automatic delay tuning?",
+                                                                 { "Yes", "No" }, "Cancel" ),
+                                           { 0, 0 }, true ); // Don't expand but DO clear top
+
+                        _ui->top<ConsoleUi::Menu>()->setPosition ( ( _config.getInteger ( "autoDelay" ) + 1 ) % 2 );
+                        _ui->popUntilUserInput();
+
+                        if ( _ui->top()->resultInt >= 0 && _ui->top()->resultInt <= 1 )
+                        {
+                            _config.setInteger ( "autoDelay", ( _ui->top()->resultInt + 1 ) % 2 );
+                            saveConfig();
+                        }
+
+                        _ui->pop();
+                    } else if ( setting == 2 ) {
+                        _ui->pushInFront ( new ConsoleUi::Menu ( "Predict late remote inputs by",
+                                                                 { "Holding the last input",
+                                                                   "Holding the direction, releasing buttons",
+                                                                   "Learning from the current match" }, "Cancel" ),
+                                           { 0, 0 }, true ); // Don't expand but DO clear top
+
+                        // Config values are InputPredictorType values, 0 is the default of holding the last input
+                        _ui->top<ConsoleUi::Menu>()->setPosition (
+                            max ( 1, _config.getInteger ( "inputPredictor" ) ) - 1 );
+                        _ui->popUntilUserInput();
+
+                        if ( _ui->top()->resultInt >= 0 && _ui->top()->resultInt <= 2 )
+                        {
+                            _config.setInteger ( "inputPredictor", _ui->top()->resultInt + 1 );
+                            saveConfig();
+                        }
+
                         _ui->pop();
                     } else {
                         _ui->pop();
@@ -1553,6 +1589,10 @@ void MainUi::initialize()
     _config.setInteger ( "autoCheckUpdates", 1 );
     _config.setInteger ( "autoReplaySave", 1 );
     _config.setInteger ( "frameLimiter", 0 );
+    _config.setInteger ( "autoDelay", 0 );
+    _config.setInteger ( "inputPredictor", 0 );
+    _config.setInteger ( "relayUpload", 0 );
+    _config.setInteger ( "spectateSavestate", 0 );
     _config.setString ( "matchmakingRegion", "NA West" );
     _config.setString ( "ipVersionPreference", "IPv4" );
     _config.setDouble ( "heldStartDuration", 1.5 );
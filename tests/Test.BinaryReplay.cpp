@@ -0,0 +1,109 @@
+#ifndef RELEASE
+
+#include "ReplayManager.hpp"
+#include "Messages.hpp"
+
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <cstdio>
+
+using namespace std;
+
+
+#define TEST_SYNC_LOG       "test_sync.log"
+#define TEST_BINARY_REPLAY  "test_sync.log.bin"
+
+
+TEST ( BinaryReplay, RoundTrip )
+{
+    RngState rngState ( 0 );
+    rngState.rngState0 = 1;
+    rngState.rngState1 = 2;
+    rngState.rngState2 = 3;
+
+    for ( size_t i = 0; i < rngState.rngState3.size(); ++i )
+        rngState.rngState3[i] = i;
+
+    {
+        ofstream fout ( TEST_SYNC_LOG );
+
+        fout << "20 CharaSelect 0 0 RngState " << rngState.dump() << endl;
+        fout << "20 CharaSelect 0 0 Inputs 0x0010 0x0000" << endl;
+        fout << "20 CharaSelect 0 1 Inputs 0x0000 0x0020" << endl;
+        fout << "8 Loading 1 0 Inputs 0x0000 0x0000" << endl;
+        fout << "1 InGame 2 0 P1 3 1 2" << endl;
+        fout << "1 InGame 2 0 P2 4 2 0" << endl;
+        fout << "1 InGame 2 0 Inputs 0x0006 0x0004" << endl;
+        fout << "1 InGame 2 1 Inputs 0x0006 0x0004" << endl;
+        fout << "1 InGame 2 2 Inputs 0x0026 0x0004" << endl;
+        fout << "1 InGame 2 3 Rollback 2 1" << endl;
+        fout << "1 InGame 2 1 Reinputs 0x0006 0x0014" << endl;
+        fout << "1 InGame 2 2 Reinputs 0x0026 0x0014" << endl;
+        fout << "1 InGame 2 3 Inputs 0x0026 0x0014" << endl;
+    }
+
+    ReplayManager text;
+    ASSERT_TRUE ( text.load ( TEST_SYNC_LOG, false ) );
+    ASSERT_TRUE ( text.save ( TEST_BINARY_REPLAY ) );
+    EXPECT_FALSE ( text.isBinary() );
+
+    ReplayManager binary;
+    ASSERT_TRUE ( binary.load ( TEST_BINARY_REPLAY, false ) );
+    EXPECT_TRUE ( binary.isBinary() );
+
+    // Both formats must read back the same
+    for ( ReplayManager *replay : { &text, &binary } )
+    {
+        EXPECT_EQ ( 2, replay->getLastIndex() );
+        EXPECT_EQ ( 3, replay->getLastFrame() );
+        EXPECT_EQ ( 2, replay->getNumFrames ( 0 ) );
+
+        EXPECT_EQ ( CC_GAME_MODE_LOADING, replay->getGameMode ( {{ 0, 1 }} ) );
+        EXPECT_EQ ( "NetplayState::InGame", replay->getStateStr ( {{ 0, 2 }} ) );
+
+        EXPECT_EQ ( 0x20, replay->getInputs ( {{ 1, 0 }} ).p2 );
+        EXPECT_EQ ( 0x26, replay->getInputs ( {{ 2, 2 }} ).p1 );
+        EXPECT_EQ ( 0x04, replay->getInputs ( {{ 2, 2 }} ).p2 );
+
+        // Frames after the end of an index have no inputs
+        EXPECT_EQ ( 0, replay->getInputs ( {{ 5, 2 }} ).p1 );
+
+        EXPECT_EQ ( MaxIndexedFrame.value, replay->getRollbackTarget ( {{ 2, 2 }} ).value );
+        EXPECT_EQ ( 1, replay->getRollbackTarget ( {{ 3, 2 }} ).parts.frame );
+
+        const span<const ReplayManager::Inputs> reinputs = replay->getReinputs ( {{ 3, 2 }} );
+        ASSERT_EQ ( 2, reinputs.size() );
+        EXPECT_EQ ( 2, reinputs[1].indexedFrame.parts.frame );
+        EXPECT_EQ ( 0x14, reinputs[1].p2 );
+
+        EXPECT_TRUE ( replay->getReinputs ( {{ 2, 2 }} ).empty() );
+
+        MsgPtr msgRngState = replay->getRngState ( {{ 0, 0 }} );
+        ASSERT_TRUE ( msgRngState.get() != 0 );
+        EXPECT_EQ ( rngState.dump(), msgRngState->getAs<RngState>().dump() );
+        EXPECT_TRUE ( replay->getRngState ( {{ 0, 2 }} ).get() == 0 );
+
+        MsgPtr msgInitial = replay->getInitialStateBefore ( 3 );
+        ASSERT_TRUE ( msgInitial.get() != 0 );
+        EXPECT_EQ ( 1, msgInitial->getAs<InitialGameState>().indexedFrame.parts.index );
+        EXPECT_EQ ( 4, msgInitial->getAs<InitialGameState>().chara[1] );
+    }
+
+    // Real replays use the reinputs instead of the original inputs
+    ReplayManager realText, realBinary;
+    ASSERT_TRUE ( realText.load ( TEST_SYNC_LOG, true ) );
+    ASSERT_TRUE ( realBinary.load ( TEST_BINARY_REPLAY, true ) );
+
+    for ( ReplayManager *replay : { &realText, &realBinary } )
+    {
+        EXPECT_EQ ( 0x14, replay->getInputs ( {{ 2, 2 }} ).p2 );
+        EXPECT_EQ ( MaxIndexedFrame.value, replay->getRollbackTarget ( {{ 3, 2 }} ).value );
+        EXPECT_TRUE ( replay->getReinputs ( {{ 3, 2 }} ).empty() );
+    }
+
+    remove ( TEST_SYNC_LOG );
+    remove ( TEST_BINARY_REPLAY );
+}
+
+#endif // NOT RELEASE
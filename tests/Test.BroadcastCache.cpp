@@ -0,0 +1,112 @@
+#ifndef RELEASE
+
+#include "BroadcastCache.hpp"
+#include "Messages.hpp"
+
+#include <gtest/gtest.h>
+
+using namespace std;
+
+
+static MsgPtr makeBothInputs ( uint32_t index, uint32_t frame )
+{
+    const IndexedFrame indexedFrame = {{ frame, index }};
+
+    BothInputs *bothInputs = new BothInputs ( indexedFrame );
+
+    for ( uint32_t i = 0; i < NUM_INPUTS; ++i )
+    {
+        bothInputs->inputs[0][i] = ( frame + i ) % 10;
+        bothInputs->inputs[1][i] = ( frame * i ) % 10;
+    }
+
+    return MsgPtr ( bothInputs );
+}
+
+
+TEST ( BroadcastCache, EncodeShared )
+{
+    MsgPtr msg = makeBothInputs ( 1, 100 );
+
+    EXPECT_FALSE ( Protocol::getShared ( msg ).get() );
+
+    const shared_ptr<const string> shared = Protocol::encodeShared ( msg );
+
+    ASSERT_TRUE ( shared.get() );
+    EXPECT_EQ ( shared, Protocol::getShared ( msg ) );
+    EXPECT_EQ ( Protocol::encode ( msg ), *shared );
+
+    // Encoding again reuses the same bytes
+    EXPECT_EQ ( shared, Protocol::encodeShared ( msg ) );
+
+    // The bytes are dropped when the message changes
+    msg->getAs<BothInputs>().setSequence ( 5 );
+
+    EXPECT_FALSE ( Protocol::getShared ( msg ).get() );
+    EXPECT_NE ( *shared, *Protocol::encodeShared ( msg ) );
+
+    // Clones don't share the encoded bytes
+    EXPECT_FALSE ( Protocol::getShared ( msg->clone() ).get() );
+}
+
+TEST ( BroadcastCache, Reuse )
+{
+    BroadcastCache cache;
+
+    MsgPtr first = makeBothInputs ( 1, 100 );
+    const IndexedFrame key = first->getAs<BothInputs>().indexedFrame;
+
+    EXPECT_EQ ( first, cache.get ( first, key ) );
+    EXPECT_TRUE ( Protocol::getShared ( first ).get() );
+
+    // Identical messages for the same key are sent as the first message
+    MsgPtr second = makeBothInputs ( 1, 100 );
+
+    EXPECT_EQ ( first, cache.get ( second, key ) );
+    EXPECT_FALSE ( Protocol::getShared ( second ).get() );
+
+    // Other message types with the same key are cached separately
+    MsgPtr menuIndex ( new MenuIndex ( 1, 2 ) );
+
+    EXPECT_EQ ( menuIndex, cache.get ( menuIndex, key ) );
+
+    EXPECT_EQ ( 2, cache.size() );
+    EXPECT_EQ ( 1, cache.getHits() );
+    EXPECT_EQ ( 2, cache.getMisses() );
+
+    EXPECT_FALSE ( cache.get ( NullMsg, key ).get() );
+}
+
+TEST ( BroadcastCache, EraseBefore )
+{
+    BroadcastCache cache;
+
+    for ( uint32_t index = 0; index < 3; ++index )
+    {
+        for ( uint32_t frame = NUM_INPUTS - 1; frame < 5 * NUM_INPUTS; frame += NUM_INPUTS )
+        {
+            MsgPtr msg = makeBothInputs ( index, frame );
+            cache.get ( msg, msg->getAs<BothInputs>().indexedFrame );
+        }
+    }
+
+    EXPECT_EQ ( 15, cache.size() );
+
+    const IndexedFrame key = {{ 0, 1 }};
+    cache.eraseBefore ( key );
+
+    EXPECT_EQ ( 10, cache.size() );
+
+    // Index 1 is still cached
+    MsgPtr msg = makeBothInputs ( 1, NUM_INPUTS - 1 );
+    cache.resetStats();
+    cache.get ( msg, msg->getAs<BothInputs>().indexedFrame );
+
+    EXPECT_EQ ( 1, cache.getHits() );
+
+    cache.clear();
+
+    EXPECT_EQ ( 0, cache.size() );
+}
+
+#endif // NOT RELEASE
@@ -0,0 +1,112 @@
+#ifndef RELEASE
+
+#include "DelayTuner.hpp"
+
+#include <gtest/gtest.h>
+
+using namespace std;
+
+
+// Latency histogram with all samples in one bucket
+static vector<uint32_t> constantLatency ( uint32_t frames, uint32_t count )
+{
+    vector<uint32_t> latency ( DELAY_TUNER_BUCKETS, 0 );
+    latency[frames] = count;
+    return latency;
+}
+
+
+TEST ( DelayTuner, Samples )
+{
+    EXPECT_EQ ( 0, DelayTuner::getLatencyFrames ( 0 ) );
+    EXPECT_EQ ( 1, DelayTuner::getLatencyFrames ( 33 ) );
+    EXPECT_EQ ( 2, DelayTuner::getLatencyFrames ( 34 ) );
+    EXPECT_EQ ( 3, DelayTuner::getLatencyFrames ( 100 ) );
+
+    DelayTuner tuner;
+
+    tuner.addRoundTrip ( 90 );
+    tuner.addRoundTrip ( 110 );
+    tuner.addRoundTrip ( 1000 );
+
+    EXPECT_EQ ( 3, tuner.count() );
+    EXPECT_DOUBLE_EQ ( 400.0, tuner.getRttMean() );
+    EXPECT_NEAR ( 424.3, tuner.getRttJitter(), 0.1 );
+
+    const vector<uint32_t> latency = tuner.getLatency();
+
+    ASSERT_EQ ( DELAY_TUNER_BUCKETS, latency.size() );
+    EXPECT_EQ ( 1, latency[3] );
+    EXPECT_EQ ( 1, latency[4] );
+    EXPECT_EQ ( 1, latency[DELAY_TUNER_BUCKETS - 1] );
+
+    EXPECT_EQ ( "3:1 4:1 15:1", DelayTuner::str ( latency ) );
+
+    tuner.reset();
+
+    EXPECT_EQ ( 0, tuner.count() );
+    EXPECT_EQ ( 0, tuner.getRttMean() );
+}
+
+TEST ( DelayTuner, Decide )
+{
+    const vector<uint32_t> latency = constantLatency ( 3, 30 );
+
+    // Constant latency is covered with delay
+    DelayTuner::Decision decision = DelayTuner::decide ( latency, latency, 0, 4, 9, 15 );
+
+    EXPECT_TRUE ( decision.changed );
+    EXPECT_EQ ( 3, decision.delay );
+    EXPECT_EQ ( 4, decision.rollback );
+    EXPECT_EQ ( 60, decision.samples );
+    EXPECT_LT ( decision.bestCost, decision.currentCost );
+
+    // Delay based netplay is never changed to rollback
+    decision = DelayTuner::decide ( latency, latency, 0, 0, 9, 15 );
+
+    EXPECT_TRUE ( decision.changed );
+    EXPECT_EQ ( 3, decision.delay );
+    EXPECT_EQ ( 0, decision.rollback );
+
+    // Small improvements are ignored
+    decision = DelayTuner::decide ( latency, latency, 2, 4, 9, 15 );
+
+    EXPECT_FALSE ( decision.changed );
+    EXPECT_EQ ( 2, decision.delay );
+
+    // Too few samples
+    decision = DelayTuner::decide ( constantLatency ( 3, 5 ), constantLatency ( 3, 5 ), 0, 4, 9, 15 );
+
+    EXPECT_FALSE ( decision.changed );
+    EXPECT_EQ ( 0, decision.delay );
+    EXPECT_EQ ( 10, decision.samples );
+
+    // The rollback window is widened when the delay is limited
+    decision = DelayTuner::decide ( constantLatency ( 8, 30 ), constantLatency ( 8, 30 ), 0, 2, 4, 15 );
+
+    EXPECT_TRUE ( decision.changed );
+    EXPECT_EQ ( 4, decision.delay );
+    EXPECT_EQ ( 4, decision.rollback );
+}
+
+TEST ( DelayTuner, Symmetric )
+{
+    vector<uint32_t> local ( DELAY_TUNER_BUCKETS, 0 ), remote ( DELAY_TUNER_BUCKETS, 0 );
+
+    local[2] = 40;
+    local[5] = 10;
+    remote[3] = 25;
+    remote[9] = 3;
+
+    for ( uint8_t delay = 0; delay < 10; ++delay )
+    {
+        const DelayTuner::Decision a = DelayTuner::decide ( local, remote, delay, 4, 9, 15 );
+        const DelayTuner::Decision b = DelayTuner::decide ( remote, local, delay, 4, 9, 15 );
+
+        EXPECT_EQ ( a.delay, b.delay );
+        EXPECT_EQ ( a.rollback, b.rollback );
+        EXPECT_EQ ( a.bestCost, b.bestCost );
+    }
+}
+
+#endif // NOT RELEASE
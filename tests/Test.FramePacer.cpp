@@ -0,0 +1,130 @@
+#ifndef RELEASE
+
+#include "FramePacer.hpp"
+
+#include <gtest/gtest.h>
+
+#include <limits>
+
+using namespace std;
+
+
+// Simulated time, where each clock read takes 1 microsecond, and each sleep oversleeps by fakeOversleepUs
+static uint64_t fakeNowUs = 0;
+static uint64_t fakeSleptUs = 0;
+static uint32_t fakeOversleepUs = 0;
+
+static uint64_t fakeNow()
+{
+    return fakeNowUs++;
+}
+
+static void fakeSleep ( uint32_t milliseconds )
+{
+    fakeNowUs += milliseconds * 1000 + fakeOversleepUs;
+    fakeSleptUs += milliseconds * 1000 + fakeOversleepUs;
+}
+
+static void resetFakeTime ( uint32_t oversleepUs = 0 )
+{
+    fakeNowUs = 1000000;
+    fakeSleptUs = 0;
+    fakeOversleepUs = oversleepUs;
+}
+
+
+TEST ( FramePacer, ExactLongRunRate )
+{
+    resetFakeTime ( 1500 );
+
+    FramePacer pacer ( fakeNow, fakeSleep );
+
+    const uint64_t start = fakeNowUs;
+
+    for ( uint32_t i = 0; i <= 6000; ++i )
+        pacer.waitForNextFrame();
+
+    // 100 seconds for 6000 frames, without drifting from the fractional period
+    EXPECT_NEAR ( 100000000, fakeNowUs - start, 2 );
+
+    EXPECT_EQ ( 6000, pacer.getStats().frameUs.getNumSamples() );
+    EXPECT_NEAR ( 1000000 / 60.0, pacer.getStats().frameUs.getMean(), 0.01 );
+    EXPECT_LE ( pacer.getStats().jitterUs.max(), 2 );
+    EXPECT_EQ ( 0, pacer.getStats().missed );
+
+    // Most of each frame is slept instead of spun, even when oversleeping
+    EXPECT_GT ( fakeSleptUs, 6000 * 12000 );
+}
+
+TEST ( FramePacer, RateAdjustIsClamped )
+{
+    resetFakeTime();
+
+    FramePacer pacer ( fakeNow, fakeSleep );
+
+    pacer.setRateAdjust ( 0.999 );
+    EXPECT_DOUBLE_EQ ( 0.999, pacer.getRateAdjust() );
+    EXPECT_NEAR ( 16683.35, pacer.getPeriodUs(), 0.01 );
+
+    pacer.setRateAdjust ( 0.5 );
+    EXPECT_DOUBLE_EQ ( 1.0 - FRAME_PACER_MAX_ADJUST, pacer.getRateAdjust() );
+
+    pacer.setRateAdjust ( 2.0 );
+    EXPECT_DOUBLE_EQ ( 1.0 + FRAME_PACER_MAX_ADJUST, pacer.getRateAdjust() );
+
+    pacer.setRateAdjust ( 1.0 );
+    pacer.setTargetFps ( 30.0 );
+    EXPECT_NEAR ( 33333.33, pacer.getPeriodUs(), 0.01 );
+}
+
+TEST ( FramePacer, LateFrameIsMadeUp )
+{
+    resetFakeTime();
+
+    FramePacer pacer ( fakeNow, fakeSleep );
+
+    pacer.waitForNextFrame();
+
+    const uint64_t start = fakeNowUs;
+
+    // The game took 20 ms to render the second frame
+    pacer.waitForNextFrame();
+    fakeNowUs += 20000;
+    pacer.waitForNextFrame();
+
+    // So the third frame is shorter, and it still ends on the deadline
+    EXPECT_LE ( pacer.waitForNextFrame(), 1000000 / 60 - 3000 );
+    EXPECT_NEAR ( 3 * 1000000 / 60.0, fakeNowUs - start, 2 );
+    EXPECT_EQ ( 0, pacer.getStats().missed );
+
+    // A frame more than a period late restarts pacing instead of rushing the next frames
+    fakeNowUs += 100000;
+    pacer.waitForNextFrame();
+
+    EXPECT_EQ ( 1, pacer.getStats().missed );
+    EXPECT_NEAR ( 1000000 / 60.0, pacer.waitForNextFrame(), 2 );
+
+    pacer.resetStats();
+
+    EXPECT_EQ ( 0, pacer.getStats().frameUs.getNumSamples() );
+    EXPECT_EQ ( 0, pacer.getStats().missed );
+}
+
+TEST ( FramePacer, Unpaced )
+{
+    resetFakeTime();
+
+    FramePacer pacer ( fakeNow, fakeSleep );
+
+    pacer.setTargetFps ( numeric_limits<double>::max() );
+
+    EXPECT_EQ ( 0, pacer.getPeriodUs() );
+
+    for ( uint32_t i = 0; i < 10; ++i )
+        EXPECT_LE ( pacer.waitForNextFrame(), 1 );
+
+    EXPECT_EQ ( 0, fakeSleptUs );
+    EXPECT_EQ ( 0, pacer.getStats().frameUs.getNumSamples() );
+}
+
+#endif // NOT RELEASE
@@ -0,0 +1,75 @@
+#ifndef RELEASE
+
+#include "Histogram.hpp"
+
+#include <gtest/gtest.h>
+
+using namespace std;
+
+
+TEST ( Histogram, Linear )
+{
+    Histogram<4> hist;
+
+    EXPECT_EQ ( 0, hist.count() );
+    EXPECT_EQ ( 0, hist.percentile ( 50 ) );
+
+    hist.add ( 0 );
+    hist.add ( 1 );
+    hist.add ( 1 );
+    hist.add ( 3 );
+    hist.add ( 10 );
+
+    EXPECT_EQ ( 5, hist.count() );
+    EXPECT_EQ ( 15, hist.total() );
+    EXPECT_EQ ( 10, hist.max() );
+    EXPECT_DOUBLE_EQ ( 3.0, hist.mean() );
+
+    EXPECT_EQ ( 1, hist.bucket ( 0 ) );
+    EXPECT_EQ ( 2, hist.bucket ( 1 ) );
+    EXPECT_EQ ( 0, hist.bucket ( 2 ) );
+    EXPECT_EQ ( 2, hist.bucket ( 3 ) );
+
+    EXPECT_EQ ( 1, hist.percentile ( 50 ) );
+    EXPECT_EQ ( 10, hist.percentile ( 100 ) );
+
+    EXPECT_EQ ( "0:1 1:2 3+:2", hist.str() );
+
+    hist.reset();
+
+    EXPECT_EQ ( 0, hist.count() );
+    EXPECT_EQ ( "", hist.str() );
+}
+
+TEST ( Histogram, Log2 )
+{
+    typedef Histogram<6, true> Log2Histogram;
+
+    EXPECT_EQ ( 0, Log2Histogram::getBucket ( 0 ) );
+    EXPECT_EQ ( 1, Log2Histogram::getBucket ( 1 ) );
+    EXPECT_EQ ( 2, Log2Histogram::getBucket ( 2 ) );
+    EXPECT_EQ ( 2, Log2Histogram::getBucket ( 3 ) );
+    EXPECT_EQ ( 3, Log2Histogram::getBucket ( 4 ) );
+    EXPECT_EQ ( 4, Log2Histogram::getBucket ( 15 ) );
+    EXPECT_EQ ( 5, Log2Histogram::getBucket ( 16 ) );
+    EXPECT_EQ ( 5, Log2Histogram::getBucket ( UINT32_MAX ) );
+
+    EXPECT_EQ ( 4, Log2Histogram::lowerBound ( 3 ) );
+    EXPECT_EQ ( 7, Log2Histogram::upperBound ( 3 ) );
+    EXPECT_EQ ( UINT32_MAX, Log2Histogram::upperBound ( 5 ) );
+
+    Log2Histogram hist;
+
+    for ( uint32_t i = 0; i < 100; ++i )
+        hist.add ( 5 );
+
+    hist.add ( 1000 );
+
+    EXPECT_EQ ( 7, hist.percentile ( 50 ) );
+    EXPECT_EQ ( 7, hist.percentile ( 99 ) );
+    EXPECT_EQ ( 1000, hist.percentile ( 100 ) );
+
+    EXPECT_EQ ( "4-7:100 16+:1", hist.str() );
+}
+
+#endif // NOT RELEASE
@@ -0,0 +1,143 @@
+#ifndef RELEASE
+
+#include "InputHistory.hpp"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+#include <cstdlib>
+
+using namespace std;
+
+
+// Reference implementation that checks one frame at a time
+struct History
+{
+    vector<uint16_t> inputs;
+
+    uint16_t at ( uint32_t i ) const { return inputs[inputs.size() - 1 - i]; }
+
+    bool hasButton ( uint16_t buttons, uint32_t start, uint32_t end ) const
+    {
+        for ( uint32_t i = start; i < end && i < inputs.size(); ++i )
+            if ( ( at ( i ) >> 4 ) & buttons )
+                return true;
+        return false;
+    }
+
+    bool heldButton ( uint16_t buttons, uint32_t start, uint32_t end ) const
+    {
+        for ( uint32_t i = start; i < end; ++i )
+            if ( i >= inputs.size() || ! ( ( at ( i ) >> 4 ) & buttons ) )
+                return false;
+        return true;
+    }
+
+    bool hasDirection ( uint16_t directions, uint32_t start, uint32_t end ) const
+    {
+        for ( uint32_t i = start; i < end && i < inputs.size(); ++i )
+            if ( directions & ( 1u << ( at ( i ) & 0xF ) ) )
+                return true;
+        return false;
+    }
+
+    bool pressedWithin ( uint16_t buttons, uint32_t n ) const
+    {
+        for ( uint32_t i = 0; i < n && i < inputs.size(); ++i )
+        {
+            const uint16_t previous = ( i + 1 < inputs.size() ? at ( i + 1 ) >> 4 : 0 );
+
+            if ( ( at ( i ) >> 4 ) & buttons & ~previous )
+                return true;
+        }
+        return false;
+    }
+};
+
+
+TEST ( InputHistory, Queries )
+{
+    InputHistory history;
+
+    EXPECT_FALSE ( history.hasButton ( 0x1, 0, 3 ) );
+    EXPECT_TRUE ( history.heldButton ( 0x1, 0, 0 ) );
+    EXPECT_FALSE ( history.heldButton ( 0x1, 0, 1 ) );
+
+    history.push ( 0x5 );
+    history.push ( 0x15 );
+    history.push ( 0x16 );
+    history.push ( 0x2 );
+
+    EXPECT_EQ ( 4, history.getEndFrame() );
+
+    EXPECT_TRUE ( history.hasButton ( 0x1, 0, 2 ) );
+    EXPECT_FALSE ( history.hasButton ( 0x1, 0, 1 ) );
+    EXPECT_FALSE ( history.hasButton ( 0x2, 0, 4 ) );
+
+    EXPECT_TRUE ( history.heldButton ( 0x1, 1, 3 ) );
+    EXPECT_FALSE ( history.heldButton ( 0x1, 1, 4 ) );
+
+    // Frames before frame 0 are never held
+    EXPECT_FALSE ( history.heldButton ( 0x2, 4, 5 ) );
+
+    EXPECT_TRUE ( history.hasDirection ( 1 << 2, 0, 1 ) );
+    EXPECT_FALSE ( history.hasDirection ( 1 << 8, 0, 4 ) );
+
+    EXPECT_FALSE ( history.pressedWithin ( 0x1, 2 ) );
+    EXPECT_TRUE ( history.pressedWithin ( 0x1, 3 ) );
+
+    // Erased frames can be pushed again
+    history.erase ( 2 );
+
+    EXPECT_EQ ( 2, history.getEndFrame() );
+    EXPECT_TRUE ( history.pressedWithin ( 0x1, 1 ) );
+
+    history.push ( 0x28 );
+
+    EXPECT_TRUE ( history.hasDirection ( 1 << 8, 0, 1 ) );
+    EXPECT_TRUE ( history.pressedWithin ( 0x2, 1 ) );
+    EXPECT_FALSE ( history.hasButton ( 0x1, 0, 1 ) );
+}
+
+TEST ( InputHistory, Reference )
+{
+    srand ( 1234 );
+
+    InputHistory history;
+    History reference;
+
+    for ( int i = 0; i < 5000; ++i )
+    {
+        uint16_t input = rand() % 10;
+
+        if ( rand() % 3 == 0 )
+            input |= ( rand() % 8 ) << 4;
+
+        // Erase a few frames like a rollback
+        if ( rand() % 100 == 0 && reference.inputs.size() > 8 )
+        {
+            const uint32_t frame = reference.inputs.size() - 1 - rand() % 8;
+
+            history.erase ( frame );
+            reference.inputs.resize ( frame );
+        }
+
+        history.push ( input );
+        reference.inputs.push_back ( input );
+
+        const uint16_t buttons = rand() % 8;
+        const uint32_t start = rand() % ( INPUT_HISTORY_FRAMES / 4 );
+        const uint32_t end = start + rand() % ( INPUT_HISTORY_FRAMES / 4 );
+
+        ASSERT_TRUE ( history.contains ( start, end ) );
+
+        ASSERT_EQ ( reference.hasButton ( buttons, start, end ), history.hasButton ( buttons, start, end ) );
+        ASSERT_EQ ( reference.heldButton ( buttons, start, end ), history.heldButton ( buttons, start, end ) );
+        ASSERT_EQ ( reference.hasDirection ( 0x104, start, end ), history.hasDirection ( 0x104, start, end ) );
+        ASSERT_EQ ( reference.pressedWithin ( buttons, end - start ), history.pressedWithin ( buttons, end - start ) );
+    }
+
+    EXPECT_FALSE ( history.contains ( 0, INPUT_HISTORY_FRAMES + 1 ) );
+}
+
+#endif // NOT RELEASE
@@ -0,0 +1,87 @@
+#ifndef RELEASE
+
+#include "InputPredictor.hpp"
+#include "InputsContainer.hpp"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+
+using namespace std;
+
+
+TEST ( InputPredictor, Hold )
+{
+    unique_ptr<InputPredictor> predictor ( InputPredictor::create ( InputPredictorType::HoldLast ) );
+
+    EXPECT_EQ ( 0x126, predictor->predict ( 0x126 ) );
+
+    predictor.reset ( InputPredictor::create ( InputPredictorType::HoldDirection ) );
+
+    // Buttons are released
+    EXPECT_EQ ( 0x6, predictor->predict ( 0x126 ) );
+    EXPECT_EQ ( 0x2, predictor->predict ( 0x2 ) );
+}
+
+TEST ( InputPredictor, Frequency )
+{
+    FrequencyPredictor predictor;
+
+    // Nothing learned yet
+    EXPECT_EQ ( 0x5, predictor.predict ( 0x5 ) );
+
+    // Tap a button after holding a direction for 2 frames
+    for ( int i = 0; i < FREQUENCY_PREDICTOR_MIN_COUNT + 1; ++i )
+    {
+        predictor.add ( 0x6 );
+        predictor.add ( 0x6 );
+        predictor.add ( 0x106 );
+    }
+
+    predictor.add ( 0x6 );
+
+    EXPECT_EQ ( 0x6, predictor.predict ( 0x6 ) );
+
+    predictor.add ( 0x6 );
+
+    EXPECT_EQ ( 0x106, predictor.predict ( 0x6 ) );
+
+    // Only predicts after the last added input
+    EXPECT_EQ ( 0x4, predictor.predict ( 0x4 ) );
+
+    predictor.reset();
+
+    EXPECT_EQ ( 0x6, predictor.predict ( 0x6 ) );
+}
+
+TEST ( InputPredictor, InputsContainer )
+{
+    HoldDirectionPredictor predictor;
+
+    InputsContainer<uint16_t> inputs;
+    inputs.setPredictor ( &predictor );
+
+    const uint16_t data[] = { 0x6, 0x6, 0x106 };
+
+    inputs.set ( 0, 0, data, 3, 0 );
+    inputs.clearLastChangedFrame();
+
+    // Frames past the end are predicted
+    EXPECT_EQ ( 0x106, inputs.get ( 0, 2 ) );
+    EXPECT_EQ ( 0x6, inputs.get ( 0, 3 ) );
+
+    // Inputs that match the prediction don't change anything
+    const uint16_t more[] = { 0x6, 0x6 };
+
+    inputs.set ( 0, 3, more, 2, 0 );
+    EXPECT_EQ ( MaxIndexedFrame.value, inputs.getLastChangedFrame().value );
+
+    // Holding the button would have been a misprediction
+    const uint16_t held[] = { 0x106, 0x106 };
+
+    inputs.set ( 0, 5, held, 2, 0 );
+    EXPECT_EQ ( 5, inputs.getLastChangedFrame().parts.frame );
+    EXPECT_EQ ( 0x6, inputs.get ( 0, 7 ) );
+}
+
+#endif // NOT RELEASE
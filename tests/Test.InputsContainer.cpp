@@ -0,0 +1,190 @@
+#ifndef RELEASE
+
+#include "InputsContainer.hpp"
+
+#include <gtest/gtest.h>
+
+using namespace std;
+
+
+TEST ( InputsContainer, Resize )
+{
+    InputsContainer<uint16_t> inputs;
+
+    EXPECT_TRUE ( inputs.empty() );
+    EXPECT_EQ ( 0, inputs.get ( 0, 0 ) );
+
+    inputs.set ( 0, 0, 1 );
+    inputs.set ( 0, 4, 2 );
+
+    // Frames in between repeat the last known input
+    EXPECT_EQ ( 5, inputs.getEndFrame ( 0 ) );
+    EXPECT_EQ ( 1, inputs.get ( 0, 3 ) );
+    EXPECT_EQ ( 2, inputs.get ( 0, 4 ) );
+    EXPECT_EQ ( 2, inputs.get ( 0, 100 ) );
+
+    // Existing inputs can only be changed with assign
+    inputs.set ( 0, 4, 3 );
+    EXPECT_EQ ( 2, inputs.get ( 0, 4 ) );
+    inputs.assign ( 0, 4, 3 );
+    EXPECT_EQ ( 3, inputs.get ( 0, 4 ) );
+
+    // New indexes start from the last input of the previous index
+    inputs.resize ( 2, 0, 3 );
+
+    EXPECT_EQ ( 3, inputs.getEndIndex() );
+    EXPECT_TRUE ( inputs.empty ( 1 ) );
+    EXPECT_EQ ( 3, inputs.get ( 1, 0 ) );
+    EXPECT_EQ ( 3, inputs.get ( 2, 2 ) );
+    EXPECT_EQ ( 3, inputs.get ( 5, 0 ) );
+}
+
+TEST ( InputsContainer, Blocks )
+{
+    InputsContainer<uint16_t> inputs;
+
+    vector<uint16_t> data ( 3 * INPUTS_BLOCK_FRAMES );
+
+    for ( size_t i = 0; i < data.size(); ++i )
+        data[i] = i;
+
+    // Write across block boundaries
+    inputs.set ( 0, 10, &data[0], data.size() );
+
+    EXPECT_EQ ( 10 + data.size(), inputs.getEndFrame() );
+    EXPECT_EQ ( 0, inputs.get ( 0, 0 ) );
+
+    vector<uint16_t> read ( data.size() );
+    inputs.get ( 0, 10, &read[0], read.size() );
+
+    EXPECT_EQ ( data, read );
+
+    inputs.set ( 0, INPUTS_BLOCK_FRAMES - 1, 7, 2 );
+
+    EXPECT_EQ ( 7, inputs.get ( 0, INPUTS_BLOCK_FRAMES - 1 ) );
+    EXPECT_EQ ( 7, inputs.get ( 0, INPUTS_BLOCK_FRAMES ) );
+    EXPECT_EQ ( INPUTS_BLOCK_FRAMES + 1 - 10, inputs.get ( 0, INPUTS_BLOCK_FRAMES + 1 ) );
+    EXPECT_EQ ( data.back(), inputs.get ( 0, 10000 ) );
+}
+
+TEST ( InputsContainer, EraseIndexOlderThan )
+{
+    InputsContainer<uint16_t> inputs;
+
+    for ( uint16_t i = 0; i < 4; ++i )
+        inputs.set ( i, 2 * INPUTS_BLOCK_FRAMES, i + 1 );
+
+    inputs.eraseIndexOlderThan ( 2 );
+
+    // The remaining indexes shift down
+    EXPECT_EQ ( 2, inputs.getEndIndex() );
+    EXPECT_EQ ( 3, inputs.get ( 0, 2 * INPUTS_BLOCK_FRAMES ) );
+    EXPECT_EQ ( 4, inputs.get ( 1, 2 * INPUTS_BLOCK_FRAMES ) );
+
+    // Blocks from the erased indexes are reused
+    inputs.set ( 2, 10, 5 );
+    EXPECT_EQ ( 4, inputs.get ( 2, 0 ) );
+    EXPECT_EQ ( 5, inputs.get ( 2, 10 ) );
+
+    inputs.eraseIndexOlderThan ( 2 );
+
+    EXPECT_TRUE ( inputs.empty() );
+}
+
+TEST ( InputsContainer, LastChangedFrame )
+{
+    InputsContainer<uint16_t> inputs;
+
+    const uint16_t data[] = { 1, 1, 2, 2 };
+
+    inputs.set ( 0, 0, 1, 4 );
+
+    // Not checked before the given index
+    inputs.set ( 0, 0, data, 4, 1 );
+    EXPECT_EQ ( MaxIndexedFrame.value, inputs.getLastChangedFrame().value );
+
+    inputs.set ( 0, 0, 1, 4 );
+    inputs.set ( 0, 0, data, 4, 0 );
+
+    EXPECT_EQ ( 0, inputs.getLastChangedFrame().parts.index );
+    EXPECT_EQ ( 2, inputs.getLastChangedFrame().parts.frame );
+
+    // Inputs past the end are compared against the last known input
+    const uint16_t more[] = { 2, 2, 3 };
+
+    inputs.set ( 0, 4, more, 3, 0 );
+    EXPECT_EQ ( 2, inputs.getLastChangedFrame().parts.frame );
+
+    inputs.clearLastChangedFrame();
+    inputs.set ( 0, 4, more, 3, 0 );
+    EXPECT_EQ ( MaxIndexedFrame.value, inputs.getLastChangedFrame().value );
+
+    inputs.set ( 0, 0, data, 4, 0 );
+    EXPECT_EQ ( MaxIndexedFrame.value, inputs.getLastChangedFrame().value );
+}
+
+TEST ( InputsContainer, FindFirstChanged )
+{
+    const vector<uint16_t> data ( 100, 3 );
+
+    // Each offset across a block boundary, and past the end of the stored inputs
+    for ( uint32_t i = 0; i < 150; ++i )
+    {
+        InputsContainer<uint16_t> inputs;
+
+        inputs.set ( 1, INPUTS_BLOCK_FRAMES - 50, &data[0], data.size() );
+
+        vector<uint16_t> changed ( 150, 3 );
+        changed[i] = 4;
+
+        inputs.set ( 1, INPUTS_BLOCK_FRAMES - 50, &changed[0], changed.size(), 0 );
+
+        EXPECT_EQ ( 1, inputs.getLastChangedFrame().parts.index );
+        EXPECT_EQ ( INPUTS_BLOCK_FRAMES - 50 + i, inputs.getLastChangedFrame().parts.frame );
+    }
+}
+
+TEST ( InputsContainer, Confirmed )
+{
+    InputsContainer<uint16_t> inputs;
+
+    vector<uint16_t> data ( 60 );
+
+    for ( size_t i = 0; i < data.size(); ++i )
+        data[i] = i / 10;
+
+    inputs.set ( 0, 0, &data[0], 30, 0 );
+    inputs.set ( 0, 30, &data[30], 30, 0 );
+    inputs.clearLastChangedFrame();
+
+    // The same confirmed inputs again are not a change
+    inputs.set ( 0, 0, &data[0], 60, 0 );
+    EXPECT_EQ ( MaxIndexedFrame.value, inputs.getLastChangedFrame().value );
+
+    // Confirmed inputs are skipped, so a different one is neither stored nor a change
+    vector<uint16_t> changed ( data );
+    changed[5] = 9;
+
+    inputs.set ( 0, 0, &changed[0], 30, 0 );
+    EXPECT_EQ ( MaxIndexedFrame.value, inputs.getLastChangedFrame().value );
+    EXPECT_EQ ( 0, inputs.get ( 0, 5 ) );
+
+    // Only the inputs past the confirmed inputs are compared
+    changed.resize ( 70, 7 );
+
+    inputs.set ( 0, 0, &changed[0], 70, 0 );
+    EXPECT_EQ ( 60, inputs.getLastChangedFrame().parts.frame );
+    EXPECT_EQ ( 0, inputs.get ( 0, 5 ) );
+    EXPECT_EQ ( 7, inputs.get ( 0, 65 ) );
+
+    inputs.clearLastChangedFrame();
+
+    // Inputs that were assigned since are no longer confirmed, so they can change
+    inputs.assign ( 0, 20, 9 );
+    inputs.set ( 0, 10, &data[10], 30, 0 );
+
+    EXPECT_EQ ( 20, inputs.getLastChangedFrame().parts.frame );
+    EXPECT_EQ ( 2, inputs.get ( 0, 20 ) );
+}
+
+#endif // NOT RELEASE
@@ -0,0 +1,189 @@
+#ifndef RELEASE
+
+#include "Logger.hpp"
+
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <cstdio>
+
+using namespace std;
+
+
+#define TEST_SYNC_LOG       "test_logger_sync.log"
+#define TEST_ASYNC_LOG      "test_logger_async.log"
+#define TEST_LOG_THREADS    ( 4 )
+#define TEST_LOG_COUNT      ( 20000 )
+
+
+namespace
+{
+
+enum TestEnum { TestValue = 7 };
+
+struct TestPrintable
+{
+    int value;
+
+    friend ostream& operator<< ( ostream& os, const TestPrintable& p ) { return ( os << "printable=" << p.value ); }
+};
+
+}
+
+static string readFile ( const string& file )
+{
+    ifstream fin ( file );
+    stringstream ss;
+    ss << fin.rdbuf();
+    return ss.str();
+}
+
+THREAD ( TestLogThread, Logger );
+
+void TestLogThread::run()
+{
+    // Long enough that the ring buffer fills up and wraps around
+    const string padding ( 100, '.' );
+
+    for ( uint32_t i = 0; i < TEST_LOG_COUNT; ++i )
+        LOG_TO ( context, "%p %u %s", this, i, padding );
+}
+
+
+TEST ( Logger, AsyncFormatsTheSame )
+{
+    Logger sync, async;
+    sync.initialize ( TEST_SYNC_LOG, 0 );
+    async.initialize ( TEST_ASYNC_LOG, LOG_ASYNC );
+
+    const char *str = "char pointer";
+    const char *null = 0;
+    char array[16] = "char array";
+    const string std = "std::string";
+    const string fmt = "non-literal %u %%";
+
+    for ( Logger *logger : { &sync, &async } )
+    {
+        {
+            // Temporaries are copied, so they can be gone before the message is written
+            const string temp = "temporary";
+            LOG_TO ( ( *logger ), "%s %s %s", temp.c_str(), temp, temp.substr ( 1 ) );
+        }
+
+        LOG_TO ( ( *logger ), "literal without args keeps %%" );
+        LOG_TO ( ( *logger ), "int=%d; negative=%d; hex=%08x; char=%c; bool=%d", 123, -45, 0xBEEFu, 'x', true );
+        LOG_TO ( ( *logger ), "uint64=%llu; int64=%lld", 0x123456789ABCull, -0x123456789ABCll );
+        LOG_TO ( ( *logger ), "double=%.3f; float=%g", 3.14159, 2.5f );
+        LOG_TO ( ( *logger ), "str=%s; null=%s; pointer=%p", str, null, str );
+        LOG_TO ( ( *logger ), "array=%s; std=%s", array, std );
+        LOG_TO ( ( *logger ), "enum=%s; printable=%s", TestValue, TestPrintable { 42 } );
+        LOG_TO ( ( *logger ), "escaped %% then %u %% and %s %%", 1u, "two" );
+        LOG_TO ( ( *logger ), "extra args %u", 1, 2, 3 );
+        LOG_TO ( ( *logger ), "missing args %u %u %s", 1 );
+        LOG_TO ( ( *logger ), fmt, 5u );
+        LOG_TO ( ( *logger ), std );
+        LOG_TO ( ( *logger ), 123 );
+    }
+
+    sync.deinitialize();
+    async.deinitialize();
+
+    const string expected = readFile ( TEST_SYNC_LOG );
+    EXPECT_NE ( string::npos, expected.find ( "literal without args keeps %%\n" ) );
+    EXPECT_EQ ( expected, readFile ( TEST_ASYNC_LOG ) );
+
+    remove ( TEST_SYNC_LOG );
+    remove ( TEST_ASYNC_LOG );
+}
+
+TEST ( Logger, AsyncManyThreads )
+{
+    Logger logger;
+    logger.initialize ( TEST_ASYNC_LOG, LOG_ASYNC );
+
+    vector<ThreadPtr> threads;
+
+    for ( size_t i = 0; i < TEST_LOG_THREADS; ++i )
+    {
+        threads.push_back ( ThreadPtr ( new TestLogThread ( logger ) ) );
+        threads.back()->start();
+    }
+
+    for ( const ThreadPtr& thread : threads )
+        thread->join();
+
+    // Everything queued before this is written
+    Logger::flushAll();
+
+    // Every thread's messages are in order
+    ifstream fin ( TEST_ASYNC_LOG );
+    string line, thread;
+    uint32_t i;
+    vector<pair<string, uint32_t>> next;
+    size_t total = 0;
+
+    while ( fin >> thread >> i )
+    {
+        getline ( fin, line );
+
+        auto it = find_if ( next.begin(), next.end(), [&] ( const pair<string, uint32_t>& p )
+        {
+            return p.first == thread;
+        } );
+
+        if ( it == next.end() )
+        {
+            next.push_back ( { thread, 0 } );
+            it = next.end() - 1;
+        }
+
+        ASSERT_EQ ( it->second, i ) << thread;
+        ++it->second;
+        ++total;
+    }
+
+    EXPECT_EQ ( TEST_LOG_THREADS, next.size() );
+    EXPECT_EQ ( TEST_LOG_THREADS * TEST_LOG_COUNT, total );
+
+    logger.deinitialize();
+    remove ( TEST_ASYNC_LOG );
+}
+
+TEST ( Logger, SkipsDisabledMessages )
+{
+    EXPECT_EQ ( LOG_CAT_NET | LOG_CAT_GBN, Logger::parseCategories ( "net, GBN,unknown" ) );
+    EXPECT_EQ ( LOG_CAT_SPECTATE, Logger::parseCategories ( "spectate" ) );
+    EXPECT_EQ ( LOG_CAT_ALL, Logger::parseCategories ( "all" ) );
+    EXPECT_EQ ( 0, Logger::parseCategories ( "" ) );
+
+    Logger logger;
+    logger.initialize ( TEST_SYNC_LOG, 0 );
+    logger.setCategories ( LOG_CAT_NET | LOG_CAT_GBN );
+
+    // The arguments of skipped messages are never evaluated
+    int evaluated = 0;
+
+    LOG_TO_AT ( logger, LOG_LEVEL_ERROR, LOG_CAT_SOCKET, "socket %d", ++evaluated );
+    LOG_TO_AT ( logger, LOG_MIN_LEVEL - 1, LOG_CAT_NET, "below min level %d", ++evaluated );
+    LOG_TO_AT ( logger, LOG_LEVEL_DEBUG, LOG_CAT_NET, "net %d", ++evaluated );
+    LOG_TO_AT ( logger, LOG_LEVEL_ERROR, LOG_CAT_UI | LOG_CAT_GBN, "gbn %d", ++evaluated );
+
+    logger.deinitialize();
+
+    LOG_TO_AT ( logger, LOG_LEVEL_ERROR, LOG_CAT_ALL, "closed %d", ++evaluated );
+
+    EXPECT_EQ ( 2, evaluated );
+
+    const string log = readFile ( TEST_SYNC_LOG );
+
+    EXPECT_NE ( string::npos, log.find ( "net 1" ) );
+    EXPECT_NE ( string::npos, log.find ( "gbn 2" ) );
+    EXPECT_EQ ( string::npos, log.find ( "socket" ) );
+    EXPECT_EQ ( string::npos, log.find ( "below min level" ) );
+
+    remove ( TEST_SYNC_LOG );
+}
+
+#endif // NOT RELEASE
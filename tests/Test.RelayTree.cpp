@@ -0,0 +1,233 @@
+#ifndef RELEASE
+
+#include "RelayTree.hpp"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+#include <cstdlib>
+
+using namespace std;
+
+
+// Maximum number of spectators per relay
+#define MAX_CAPACITY ( 15 )
+
+
+// Check that every node is within its capacity and connected to the root, returns the number of nodes
+static size_t checkTree ( const RelayTree& tree, uint32_t id = RelayTree::Root )
+{
+    const RelayTree::Node& node = tree.get ( id );
+
+    EXPECT_LE ( node.children.size(), node.capacity );
+
+    size_t count = 1;
+
+    for ( uint32_t child : node.children )
+    {
+        EXPECT_EQ ( id, tree.get ( child ).parent );
+        EXPECT_EQ ( node.depth + 1, tree.get ( child ).depth );
+
+        count += checkTree ( tree, child );
+    }
+
+    return count;
+}
+
+// Simulate forwarding inputs down the tree, returns the time the last spectator gets the inputs, in milliseconds.
+// Each hop adds half the round trip time, plus the time it takes the relay to forward the inputs.
+static uint32_t simulateBroadcast ( const RelayTree& tree, uint32_t hopDelay, uint32_t id = RelayTree::Root,
+                                    uint32_t time = 0 )
+{
+    uint32_t last = time;
+
+    for ( uint32_t child : tree.get ( id ).children )
+    {
+        const uint32_t arrival = time + tree.get ( child ).rtt / 2 + hopDelay;
+
+        last = max ( last, simulateBroadcast ( tree, hopDelay, child, arrival ) );
+    }
+
+    return last;
+}
+
+// Add a spectator that can relay to the given number of spectators
+static uint32_t join ( RelayTree& tree, uint32_t capacity, uint32_t rtt )
+{
+    const uint32_t parent = tree.findParent();
+
+    if ( parent == RelayTree::None )
+        return RelayTree::None;
+
+    return tree.add ( parent, capacity, rtt );
+}
+
+
+TEST ( RelayTree, Placement )
+{
+    RelayTree tree ( 1 );
+
+    const uint32_t a = join ( tree, 2, 50 );
+
+    EXPECT_EQ ( RelayTree::Root, tree.get ( a ).parent );
+
+    // The root is full, so the next spectators go under a
+    const uint32_t b = join ( tree, 2, 100 );
+    const uint32_t c = join ( tree, 2, 20 );
+
+    EXPECT_EQ ( a, tree.get ( b ).parent );
+    EXPECT_EQ ( a, tree.get ( c ).parent );
+
+    // Same depth, so the relay with the lower latency is used first
+    const uint32_t d = join ( tree, 0, 10 );
+
+    EXPECT_EQ ( c, tree.get ( d ).parent );
+    EXPECT_EQ ( 25 + 10 + 5, tree.get ( d ).latency );
+
+    // Reserved slots are skipped until they expire
+    tree.reserve ( c, 1000 );
+
+    EXPECT_EQ ( b, tree.findParent ( 1000 ) );
+    EXPECT_EQ ( c, tree.findParent ( 1000 + RELAY_RESERVE_TIMEOUT ) );
+
+    // Adding under c uses up its reservation
+    tree.add ( c, 0, 10 );
+
+    EXPECT_EQ ( b, tree.findParent ( 1000 ) );
+
+    // Spectators that can't relay are never parents
+    EXPECT_EQ ( 0, tree.get ( d ).capacity );
+    EXPECT_EQ ( 6, checkTree ( tree ) );
+}
+
+TEST ( RelayTree, Reparent )
+{
+    RelayTree tree ( 1 );
+
+    const uint32_t a = join ( tree, 3, 10 );
+    const uint32_t b = join ( tree, 1, 10 );
+    const uint32_t c = join ( tree, 4, 10 );
+    const uint32_t d = join ( tree, 0, 10 );
+    const uint32_t e = join ( tree, 0, 10 );
+
+    EXPECT_EQ ( a, tree.get ( d ).parent );
+    EXPECT_EQ ( b, tree.get ( e ).parent );
+
+    const vector<RelayTree::Move> moves = tree.remove ( a );
+
+    ASSERT_EQ ( 3, moves.size() );
+
+    // c has the most capacity, so it takes the place of a, and the others are placed under it
+    EXPECT_EQ ( c, moves[0].node );
+    EXPECT_EQ ( RelayTree::Root, moves[0].parent );
+    EXPECT_EQ ( c, tree.get ( b ).parent );
+    EXPECT_EQ ( c, tree.get ( d ).parent );
+
+    // b keeps its own child
+    EXPECT_EQ ( b, tree.get ( e ).parent );
+    EXPECT_EQ ( 3, tree.get ( e ).depth );
+
+    EXPECT_FALSE ( tree.contains ( a ) );
+    EXPECT_EQ ( 5, checkTree ( tree ) );
+
+    // Removing a whole subtree
+    EXPECT_EQ ( 2, tree.removeSubtree ( b ).size() );
+    EXPECT_EQ ( 3, checkTree ( tree ) );
+}
+
+TEST ( RelayTree, Binary )
+{
+    RelayTree tree ( 2 );
+
+    for ( uint32_t i = 0; i < 1000; ++i )
+        ASSERT_NE ( RelayTree::None, join ( tree, 2, 10 ) );
+
+    // A complete binary tree of 1001 nodes has 10 levels below the root
+    EXPECT_EQ ( 9, tree.getMaxDepth() );
+    EXPECT_EQ ( 1001, checkTree ( tree ) );
+}
+
+TEST ( RelayTree, Simulate1000Spectators )
+{
+    srand ( 1234 );
+
+    // Upload bandwidth of each spectator in kbps, 0 if unknown
+    const vector<uint32_t> uploads = { 0, 8, 32, 64, 128, 256, 1024 };
+
+    // The broadcasting client relays to a few spectators itself
+    RelayTree tree ( 4 );
+
+    // Placement that just picks a random relay with a free slot, for comparison
+    RelayTree random ( 4 );
+
+    vector<uint32_t> ids;
+
+    for ( uint32_t i = 0; i < 1000; ++i )
+    {
+        const uint32_t capacity = RelayTree::getCapacity ( uploads[rand() % uploads.size()], MAX_CAPACITY );
+        const uint32_t rtt = 10 + rand() % 190;
+
+        const uint32_t id = join ( tree, capacity, rtt );
+
+        ASSERT_NE ( RelayTree::None, id );
+
+        ids.push_back ( id );
+
+        vector<uint32_t> parents;
+
+        for ( uint32_t j = 0; j <= i; ++j )
+        {
+            const uint32_t parent = ( j == 0 ? RelayTree::Root : j );
+
+            if ( random.get ( parent ).children.size() < random.get ( parent ).capacity )
+                parents.push_back ( parent );
+        }
+
+        ASSERT_FALSE ( parents.empty() );
+
+        random.add ( parents[rand() % parents.size()], capacity, rtt );
+    }
+
+    EXPECT_EQ ( 1001, checkTree ( tree ) );
+
+    // Depth is logarithmic in the number of spectators
+    EXPECT_LE ( tree.getMaxDepth(), 5 );
+    EXPECT_LT ( tree.getMaxDepth(), random.getMaxDepth() );
+
+    // Inputs reach every spectator faster than with random placement
+    const uint32_t latency = simulateBroadcast ( tree, 1 );
+
+    EXPECT_LT ( latency, simulateBroadcast ( random, 1 ) );
+
+    // Half of the spectators leave, including relays
+    size_t left = 0, dropped = 0;
+
+    for ( size_t i = 0; i < ids.size(); i += 2 )
+    {
+        if ( ! tree.contains ( ids[i] ) )
+            continue;
+
+        for ( const RelayTree::Move& move : tree.remove ( ids[i] ) )
+        {
+            if ( move.parent == RelayTree::None )
+                ++dropped;
+        }
+
+        ++left;
+    }
+
+    // There is always room for the children of a relay that leaves
+    EXPECT_EQ ( 0, dropped );
+    EXPECT_EQ ( 1001 - left, checkTree ( tree ) );
+    EXPECT_EQ ( 1000 - left, tree.size() );
+    EXPECT_LE ( tree.getMaxDepth(), 7 );
+
+    // New spectators fill the gaps
+    for ( uint32_t i = 0; i < left; ++i )
+        ASSERT_NE ( RelayTree::None, join ( tree, RelayTree::getCapacity ( 64, MAX_CAPACITY ), 50 ) );
+
+    EXPECT_EQ ( 1001, checkTree ( tree ) );
+    EXPECT_LE ( tree.getMaxDepth(), 7 );
+}
+
+#endif // NOT RELEASE
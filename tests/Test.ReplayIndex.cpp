@@ -0,0 +1,163 @@
+#ifndef RELEASE
+
+#include "ReplayIndex.hpp"
+#include "ReplayCreator.hpp"
+
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <cstring>
+#include <ctime>
+
+using namespace std;
+
+namespace fs = std::filesystem;
+
+
+#define TEST_INDEX_FOLDER   "test_replay_index"
+#define TEST_INDEX_FILE     "test_replay_index.bin"
+#define TEST_RESULTS_FILE   TEST_INDEX_FOLDER "/results.csv"
+
+// Characters used in the test replays
+#define CIEL                ( 2 )
+#define RIES                ( 30 )
+#define HIME                ( 51 )
+
+
+// Write the header of a replay, which is all the index reads
+static void writeReplay ( const string& file, time_t date, int stage, int chara1, int moon1, int chara2, int moon2 )
+{
+    ReplayCreator::ReplayFile rf;
+    memset ( ( char * ) &rf, 0, 0x60 );
+    memcpy ( rf.headername, FILE_HEADER, sizeof ( rf.headername ) );
+
+    const tm *local = localtime ( &date );
+    rf.year = local->tm_year + 1900;
+    rf.month = local->tm_mon + 1;
+    rf.day = local->tm_mday;
+    rf.hour = local->tm_hour;
+    rf.minute = local->tm_min;
+    rf.second = local->tm_sec;
+    rf.stage = stage;
+    rf.p1.character = chara1;
+    rf.p1.moon = moon1;
+    rf.p2.character = chara2;
+    rf.p2.moon = moon2;
+    rf.numRounds = 3;
+
+    fs::create_directories ( fs::path ( file ).parent_path() );
+
+    ofstream fout ( file, ios::out | ios::binary );
+    fout.write ( ( const char * ) &rf, 0x60 );
+}
+
+static vector<string> queryPaths ( const ReplayIndex& index, const ReplayIndex::Query& query )
+{
+    vector<string> paths;
+
+    for ( size_t i : index.query ( query ) )
+        paths.push_back ( index.getString ( index.get ( i ).path ) );
+
+    return paths;
+}
+
+
+TEST ( ReplayIndex, UpdateAndQuery )
+{
+    fs::remove_all ( TEST_INDEX_FOLDER );
+
+    const time_t t = 1700000000;
+
+    writeReplay ( TEST_INDEX_FOLDER "/a/1.rep", t, 5, CIEL, 0, RIES, 2 );
+    writeReplay ( TEST_INDEX_FOLDER "/a/2.rep", t + 600, 5, CIEL, 0, RIES, 2 );
+    writeReplay ( TEST_INDEX_FOLDER "/b/3.rep", t + 1200, 7, HIME, 1, CIEL, 1 );
+
+    // Not a replay
+    ofstream ( TEST_INDEX_FOLDER "/b/4.rep" ) << "junk";
+
+    // The local player is first, so the second row is from the p2 side of 2.rep
+    ofstream ( TEST_RESULTS_FILE )
+            << "Alice,C-Ciel,2,Bob,H-Ries,1," << ( t + 20 ) << endl
+            << "Bob,H-Ries,2,Alice,C-Ciel,0," << ( t + 610 ) << endl
+            << "Carol,F-Hime,1,Dave,F-Ciel,2," << ( t + 5000 ) << endl;
+
+    ReplayIndex::UpdateStats stats;
+
+    {
+        ReplayIndex index;
+        stats = index.update ( TEST_INDEX_FOLDER, TEST_RESULTS_FILE, 2 );
+        ASSERT_TRUE ( index.save ( TEST_INDEX_FILE ) );
+    }
+
+    EXPECT_EQ ( 4, stats.added );
+    EXPECT_EQ ( 1, stats.invalid );
+    EXPECT_EQ ( 2, stats.matched );
+
+    ReplayIndex index;
+    ASSERT_TRUE ( index.load ( TEST_INDEX_FILE ) );
+    ASSERT_EQ ( 3, index.size() );
+
+    // The newest first
+    ReplayIndex::Query query;
+    EXPECT_EQ ( vector<string> ( { "b/3.rep", "a/2.rep", "a/1.rep" } ), queryPaths ( index, query ) );
+
+    const ReplayIndex::Entry& entry = index.get ( 1 );
+    EXPECT_STREQ ( "Alice", index.getString ( entry.names[0] ) );
+    EXPECT_STREQ ( "Bob", index.getString ( entry.names[1] ) );
+    EXPECT_EQ ( 0, entry.wins[0] );
+    EXPECT_EQ ( 2, entry.wins[1] );
+
+    query.limit = 1;
+    EXPECT_EQ ( vector<string> ( { "b/3.rep" } ), queryPaths ( index, query ) );
+
+    query = ReplayIndex::Query();
+    query.player = "alice";
+    EXPECT_EQ ( vector<string> ( { "a/2.rep", "a/1.rep" } ), queryPaths ( index, query ) );
+
+    query.result = ReplayIndex::Result::Win;
+    EXPECT_EQ ( vector<string> ( { "a/1.rep" } ), queryPaths ( index, query ) );
+
+    // Alice never played Ries
+    query = ReplayIndex::Query();
+    query.player = "Alice";
+    ASSERT_TRUE ( ReplayIndex::parseChara ( "H-Ries", query.chara, query.moon ) );
+    EXPECT_TRUE ( queryPaths ( index, query ).empty() );
+
+    query = ReplayIndex::Query();
+    ASSERT_TRUE ( ReplayIndex::parseChara ( "ciel", query.chara, query.moon ) );
+    EXPECT_EQ ( -1, query.moon );
+    EXPECT_EQ ( 3, queryPaths ( index, query ).size() );
+
+    query.stage = 5;
+    query.from = t + 1;
+    EXPECT_EQ ( vector<string> ( { "a/2.rep" } ), queryPaths ( index, query ) );
+
+    // Only the new and changed replays are read again
+    fs::remove ( TEST_INDEX_FOLDER "/a/1.rep" );
+    writeReplay ( TEST_INDEX_FOLDER "/b/3.rep", t + 1200, 8, HIME, 1, CIEL, 1 );
+    writeReplay ( TEST_INDEX_FOLDER "/b/5.rep", t + 1800, 7, HIME, 1, CIEL, 1 );
+    fs::last_write_time ( TEST_INDEX_FOLDER "/b/3.rep", fs::file_time_type::clock::now() + 1h );
+
+    stats = index.update ( TEST_INDEX_FOLDER, TEST_RESULTS_FILE, 2 );
+
+    // Files that aren't replays aren't indexed, so they are read again
+    EXPECT_EQ ( 2, stats.added );
+    EXPECT_EQ ( 1, stats.changed );
+    EXPECT_EQ ( 1, stats.removed );
+    EXPECT_EQ ( 1, stats.unchanged );
+    EXPECT_EQ ( 1, stats.invalid );
+
+    query = ReplayIndex::Query();
+    query.stage = 8;
+    EXPECT_EQ ( vector<string> ( { "b/3.rep" } ), queryPaths ( index, query ) );
+
+    query = ReplayIndex::Query();
+    query.player = "Bob";
+    EXPECT_EQ ( vector<string> ( { "a/2.rep" } ), queryPaths ( index, query ) );
+
+    fs::remove_all ( TEST_INDEX_FOLDER );
+    fs::remove ( TEST_INDEX_FILE );
+}
+
+#endif // NOT RELEASE
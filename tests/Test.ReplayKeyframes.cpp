@@ -0,0 +1,128 @@
+#ifndef RELEASE
+
+#include "ReplayKeyframes.hpp"
+
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <cstdio>
+
+using namespace std;
+
+
+#define TEST_KEYFRAMES      "test_replay.keyframes"
+#define TEST_STATE_SIZE     ( 4096 )
+
+
+// A game state of random bytes where a few bytes change every frame
+static string makeState ( uint32_t index, uint32_t frame )
+{
+    string state ( TEST_STATE_SIZE, '\0' );
+    uint32_t seed = index;
+
+    for ( size_t i = 0; i < state.size(); ++i )
+        state[i] = char ( ( seed = seed * 1103515245 + 12345 ) >> 16 );
+
+    for ( size_t i = 0; i < 64; ++i )
+        state[( i * 61 + frame ) % state.size()] = char ( frame + i );
+
+    return state;
+}
+
+static void addKeyframe ( ReplayKeyframes& keyframes, uint32_t index, uint32_t frame )
+{
+    const string state = makeState ( index, frame );
+    ASSERT_TRUE ( keyframes.add ( index, frame, {{ frame, index }}, "fpenv", &state[0] ) );
+}
+
+static void checkKeyframe ( const ReplayKeyframes& keyframes, uint32_t index, uint32_t frame )
+{
+    const size_t i = keyframes.find ( {{ frame, index }} );
+    ASSERT_LT ( i, keyframes.size() );
+
+    EXPECT_EQ ( index, keyframes.get ( i ).netplayState );
+    EXPECT_EQ ( frame, keyframes.get ( i ).startWorldTime );
+    EXPECT_EQ ( "fpenv", keyframes.get ( i ).fpEnv );
+
+    string state ( TEST_STATE_SIZE, '\0' );
+    ASSERT_TRUE ( keyframes.decode ( i, &state[0] ) );
+    EXPECT_EQ ( makeState ( index, frame ), state );
+}
+
+
+TEST ( ReplayKeyframes, FindAndDecode )
+{
+    ReplayKeyframes keyframes;
+    keyframes.reset ( TEST_STATE_SIZE );
+
+    // Added out of order, and the second round starts with a keyframe before the first one added
+    addKeyframe ( keyframes, 3, 0 );
+    addKeyframe ( keyframes, 3, 600 );
+    addKeyframe ( keyframes, 3, 300 );
+    addKeyframe ( keyframes, 5, 300 );
+    addKeyframe ( keyframes, 5, 0 );
+
+    ASSERT_EQ ( 5, keyframes.size() );
+
+    string state = makeState ( 3, 300 );
+    EXPECT_FALSE ( keyframes.add ( 0, 0, {{ 300, 3 }}, "", &state[0] ) );
+
+    // Deltas are much smaller than the full states
+    EXPECT_TRUE ( keyframes.get ( 0 ).isFull() );
+    EXPECT_FALSE ( keyframes.get ( 1 ).isFull() );
+    EXPECT_LT ( keyframes.get ( 1 ).data.size() * 4, keyframes.get ( 0 ).data.size() );
+
+    // Seeks land on the newest keyframe at or before the target in the same index
+    EXPECT_EQ ( 0, keyframes.find ( {{ 299, 3 }} ) );
+    EXPECT_EQ ( 1, keyframes.find ( {{ 300, 3 }} ) );
+    EXPECT_EQ ( 2, keyframes.find ( {{ 5000, 3 }} ) );
+    EXPECT_EQ ( 4, keyframes.find ( {{ 5000, 5 }} ) );
+    EXPECT_EQ ( keyframes.size(), keyframes.find ( {{ 0, 2 }} ) );
+    EXPECT_EQ ( keyframes.size(), keyframes.find ( {{ 100, 4 }} ) );
+
+    // Decode in an order that switches between the cached bases
+    checkKeyframe ( keyframes, 3, 600 );
+    checkKeyframe ( keyframes, 5, 300 );
+    checkKeyframe ( keyframes, 3, 300 );
+    checkKeyframe ( keyframes, 3, 0 );
+    checkKeyframe ( keyframes, 5, 0 );
+}
+
+TEST ( ReplayKeyframes, SaveLoad )
+{
+    {
+        ReplayKeyframes keyframes;
+        keyframes.reset ( TEST_STATE_SIZE );
+
+        for ( uint32_t index = 0; index < 3; ++index )
+            for ( uint32_t frame = 0; frame < 1000; frame += REPLAY_KEYFRAME_INTERVAL )
+                addKeyframe ( keyframes, index, frame );
+
+        ASSERT_TRUE ( keyframes.save ( TEST_KEYFRAMES ) );
+    }
+
+    ReplayKeyframes keyframes;
+    ASSERT_TRUE ( keyframes.load ( TEST_KEYFRAMES ) );
+    ASSERT_EQ ( TEST_STATE_SIZE, keyframes.getStateSize() );
+    ASSERT_EQ ( 12, keyframes.size() );
+
+    for ( uint32_t index = 0; index < 3; ++index )
+        for ( uint32_t frame = 0; frame < 1000; frame += REPLAY_KEYFRAME_INTERVAL )
+            checkKeyframe ( keyframes, index, frame );
+
+    // A truncated file is rejected
+    ifstream fin ( TEST_KEYFRAMES, ios::in | ios::binary );
+    string data ( ( istreambuf_iterator<char> ( fin ) ), istreambuf_iterator<char>() );
+    fin.close();
+
+    ofstream fout ( TEST_KEYFRAMES, ios::out | ios::binary );
+    fout.write ( data.c_str(), data.size() - 4 );
+    fout.close();
+
+    EXPECT_FALSE ( keyframes.load ( TEST_KEYFRAMES ) );
+    EXPECT_TRUE ( keyframes.empty() );
+
+    remove ( TEST_KEYFRAMES );
+}
+
+#endif // NOT RELEASE
@@ -0,0 +1,146 @@
+#ifndef RELEASE
+
+#include "ReplayWriter.hpp"
+#include "SpscQueue.hpp"
+
+#include <gtest/gtest.h>
+
+#include <fstream>
+#include <cstdio>
+
+using namespace std;
+
+
+#define TEST_REPLAY_STREAM  "test_replay.repstream"
+#define TEST_REPLAY_RAW     "test_replay.repraw"
+#define TEST_QUEUE_COUNT    ( 10000 )
+
+
+typedef SpscQueue<uint32_t, 64> TestQueue;
+
+THREAD ( TestProducer, TestQueue );
+
+void TestProducer::run()
+{
+    for ( uint32_t i = 0; i < TEST_QUEUE_COUNT; )
+    {
+        if ( context.push ( i ) )
+            ++i;
+    }
+}
+
+
+TEST ( SpscQueue, ProducerConsumer )
+{
+    TestQueue queue;
+    TestProducer producer ( queue );
+    producer.start();
+
+    // The consumer must see every element in order while the producer keeps filling the queue
+    uint32_t expected = 0, value;
+
+    while ( expected < TEST_QUEUE_COUNT )
+    {
+        if ( queue.pop ( value ) )
+            ASSERT_EQ ( expected++, value );
+    }
+
+    producer.join();
+
+    EXPECT_TRUE ( queue.empty() );
+    EXPECT_EQ ( TEST_QUEUE_COUNT, queue.getPopped() );
+}
+
+TEST ( ReplayWriter, StreamMatch )
+{
+    // Frames pushed before the file is opened are dropped
+    ReplayWriter writer;
+    writer.push ( {{ 0, 1 }}, 0xFFFF, 0xFFFF );
+
+    writer.open ( TEST_REPLAY_STREAM );
+
+    // Two rounds, the first one longer than a chunk
+    for ( uint32_t i = 0; i < REPLAY_WRITER_CHUNK_FRAMES + 10; ++i )
+        ASSERT_TRUE ( writer.push ( {{ i, 3 }}, i, i + 1 ) );
+
+    for ( uint32_t i = 0; i < 5; ++i )
+        ASSERT_TRUE ( writer.push ( {{ i, 5 }}, 0x10 + i, 0x20 + i ) );
+
+    writer.close();
+
+    // Jobs run after the frames before them are written
+    bool exported = false;
+    writer.post ( [&]() { exported = ReplayWriter::exportRaw ( TEST_REPLAY_STREAM, TEST_REPLAY_RAW ); } );
+
+    // Frames pushed after closing are dropped
+    writer.push ( {{ 5, 5 }}, 0xFFFF, 0xFFFF );
+
+    writer.stop();
+
+    EXPECT_TRUE ( exported );
+
+    vector<ReplayWriter::Round> rounds;
+    ASSERT_TRUE ( ReplayWriter::read ( TEST_REPLAY_STREAM, rounds ) );
+    ASSERT_EQ ( 2, rounds.size() );
+
+    EXPECT_EQ ( 3, rounds[0].index );
+    ASSERT_EQ ( REPLAY_WRITER_CHUNK_FRAMES + 10, rounds[0].p1.size() );
+    EXPECT_EQ ( 300, rounds[0].p1[300] );
+    EXPECT_EQ ( 301, rounds[0].p2[300] );
+
+    EXPECT_EQ ( 5, rounds[1].index );
+    ASSERT_EQ ( 5, rounds[1].p2.size() );
+    EXPECT_EQ ( 0x24, rounds[1].p2[4] );
+
+    // The raw export has the number of rounds, then the number of frames and the inputs of each round
+    ifstream fin ( TEST_REPLAY_RAW );
+    string line;
+
+    getline ( fin, line );
+    EXPECT_EQ ( "2", line );
+
+    for ( size_t i = 0; i < 1 + REPLAY_WRITER_CHUNK_FRAMES + 10; ++i )
+        getline ( fin, line );
+
+    getline ( fin, line );
+    EXPECT_EQ ( "5", line );
+
+    getline ( fin, line );
+    EXPECT_EQ ( "0010 0020", line );
+
+    fin.close();
+
+    remove ( TEST_REPLAY_STREAM );
+    remove ( TEST_REPLAY_RAW );
+}
+
+TEST ( ReplayWriter, IncompleteChunk )
+{
+    {
+        ReplayWriter writer;
+        writer.open ( TEST_REPLAY_STREAM );
+
+        for ( uint32_t i = 0; i < REPLAY_WRITER_CHUNK_FRAMES + 10; ++i )
+            ASSERT_TRUE ( writer.push ( {{ i, 0 }}, i, i ) );
+
+        writer.close();
+    }
+
+    // Simulate a crash in the middle of writing the last chunk
+    ifstream fin ( TEST_REPLAY_STREAM, ios::in | ios::binary );
+    string data ( ( istreambuf_iterator<char> ( fin ) ), istreambuf_iterator<char>() );
+    fin.close();
+
+    ofstream fout ( TEST_REPLAY_STREAM, ios::out | ios::binary );
+    fout.write ( data.c_str(), data.size() - 4 );
+    fout.close();
+
+    vector<ReplayWriter::Round> rounds;
+    ASSERT_TRUE ( ReplayWriter::read ( TEST_REPLAY_STREAM, rounds ) );
+    ASSERT_EQ ( 1, rounds.size() );
+    EXPECT_EQ ( REPLAY_WRITER_CHUNK_FRAMES, rounds[0].p1.size() );
+
+    remove ( TEST_REPLAY_STREAM );
+}
+
+#endif // NOT RELEASE
@@ -0,0 +1,89 @@
+#ifndef RELEASE
+
+#include "SendQueue.hpp"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+
+static string concat ( const vector<span<const char>>& buffers )
+{
+    string bytes;
+
+    for ( const span<const char>& buffer : buffers )
+        bytes.append ( buffer.data(), buffer.size() );
+
+    return bytes;
+}
+
+
+TEST ( SendQueue, Order )
+{
+    SendQueue queue;
+
+    const auto hello = make_shared<const string> ( "hello" );
+    const auto world = make_shared<const string> ( " world" );
+
+    // Only the unsent bytes after the offset are queued
+    EXPECT_TRUE ( queue.push ( hello, 0, 2 ) );
+    EXPECT_TRUE ( queue.push ( world, 10 ) );
+
+    EXPECT_EQ ( 9, queue.getBytes() );
+    EXPECT_EQ ( 2, queue.getCount() );
+    EXPECT_EQ ( 20, queue.getAge ( 20 ) );
+
+    vector<span<const char>> buffers;
+
+    queue.gather ( buffers );
+    EXPECT_EQ ( "llo world", concat ( buffers ) );
+
+    queue.gather ( buffers, 1 );
+    EXPECT_EQ ( "llo", concat ( buffers ) );
+
+    // Partial sends leave the rest of the front buffer
+    queue.consume ( 5, 30 );
+    EXPECT_EQ ( 4, queue.getBytes() );
+    EXPECT_EQ ( 1, queue.getCount() );
+    EXPECT_EQ ( 20, queue.getAge ( 30 ) );
+
+    queue.gather ( buffers );
+    EXPECT_EQ ( "orld", concat ( buffers ) );
+
+    queue.consume ( 4, 50 );
+    EXPECT_TRUE ( queue.empty() );
+    EXPECT_EQ ( 0, queue.getAge ( 50 ) );
+
+    EXPECT_EQ ( 9, queue.getStats().sentBytes );
+    EXPECT_EQ ( 2, queue.getStats().latencyMs.count() );
+    EXPECT_EQ ( 40, queue.getStats().latencyMs.max() );
+}
+
+TEST ( SendQueue, Limit )
+{
+    SendQueue queue;
+    queue.limit = 10;
+
+    const auto bytes = make_shared<const string> ( 6, 'x' );
+
+    EXPECT_TRUE ( queue.push ( bytes, 0 ) );
+    EXPECT_FALSE ( queue.push ( bytes, 0 ) );
+
+    EXPECT_EQ ( 6, queue.getBytes() );
+    EXPECT_EQ ( 1, queue.getStats().overflows );
+
+    // Shared buffers are not copied
+    EXPECT_EQ ( 2, bytes.use_count() );
+
+    queue.clear();
+
+    EXPECT_TRUE ( queue.empty() );
+    EXPECT_EQ ( 1, bytes.use_count() );
+    EXPECT_EQ ( 6, queue.getStats().maxBytes );
+}
+
+#endif // NOT RELEASE
@@ -0,0 +1,90 @@
+#ifndef RELEASE
+
+#include "Messages.hpp"
+#include "GoBackN.hpp"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+using namespace std;
+
+
+#define CHUNK_FRAMES ( 1800 )
+
+
+TEST ( SpectateHistory, ChunksAdvanceAcrossIndexes )
+{
+    // A new spectator starts from the first frame of the spectate start index
+    IndexedFrame pos = {{ NUM_INPUTS - 1, 3 }};
+    uint32_t start = 0, end = 0;
+
+    // Index 3 is over and had 2500 frames, so it is sent in two chunks, then the pos moves to index 4
+    ASSERT_TRUE ( SpectateHistory::getNextChunk ( pos, 2500, true, CHUNK_FRAMES, start, end ) );
+    EXPECT_EQ ( 0, start );
+    EXPECT_EQ ( CHUNK_FRAMES, end );
+    EXPECT_EQ ( 3, pos.parts.index );
+
+    ASSERT_TRUE ( SpectateHistory::getNextChunk ( pos, 2500, true, CHUNK_FRAMES, start, end ) );
+    EXPECT_EQ ( CHUNK_FRAMES, start );
+    EXPECT_EQ ( 2500, end );
+    EXPECT_EQ ( 4, pos.parts.index );
+    EXPECT_EQ ( NUM_INPUTS - 1, pos.parts.frame );
+
+    // Index 4 is over without any inputs, so it is skipped
+    EXPECT_FALSE ( SpectateHistory::getNextChunk ( pos, 0, true, CHUNK_FRAMES, start, end ) );
+    EXPECT_EQ ( 5, pos.parts.index );
+
+    // Index 5 is the current index, so the pos stays on it after sending every input so far
+    ASSERT_TRUE ( SpectateHistory::getNextChunk ( pos, 700, false, CHUNK_FRAMES, start, end ) );
+    EXPECT_EQ ( 0, start );
+    EXPECT_EQ ( 700, end );
+    EXPECT_EQ ( 5, pos.parts.index );
+
+    // Same as a BothInputs message ending on the last sent frame
+    BothInputs last ( pos );
+    EXPECT_EQ ( 700, last.getStartFrame() );
+
+    // Nothing until more inputs arrive, then only the new inputs are sent
+    EXPECT_FALSE ( SpectateHistory::getNextChunk ( pos, 700, false, CHUNK_FRAMES, start, end ) );
+    EXPECT_EQ ( 5, pos.parts.index );
+
+    ASSERT_TRUE ( SpectateHistory::getNextChunk ( pos, 710, false, CHUNK_FRAMES, start, end ) );
+    EXPECT_EQ ( 700, start );
+    EXPECT_EQ ( 710, end );
+    EXPECT_EQ ( 5, pos.parts.index );
+}
+
+TEST ( SpectateHistory, EncodedSizeBeforeGoBackNSend )
+{
+    struct Owner : public GoBackN::Owner
+    {
+        void goBackNSendRaw ( GoBackN *gbn, const MsgPtr& msg ) override {}
+        void goBackNRecvRaw ( GoBackN *gbn, const MsgPtr& msg ) override {}
+        void goBackNRecvMsg ( GoBackN *gbn, const MsgPtr& msg ) override {}
+        void goBackNTimeout ( GoBackN *gbn ) override {}
+    };
+
+    Owner owner;
+    GoBackN gbn ( &owner );
+
+    SpectateHistory *history = new SpectateHistory ( 1, 0 );
+    history->inputs[0].resize ( CHUNK_FRAMES, 0x12 );
+    history->inputs[1].resize ( CHUNK_FRAMES, 0x34 );
+
+    MsgPtr msg ( history );
+
+    // The catch-up counts the bytes from the shared encoding, which is only valid until the message is sent
+    const size_t bytes = ::Protocol::encodeShared ( msg )->size();
+
+    ASSERT_NE ( nullptr, ::Protocol::getShared ( msg ) );
+    EXPECT_GT ( bytes, 0 );
+
+    // Sending over a GoBackN socket sets the sequence, which drops the shared encoding
+    gbn.sendViaGoBackN ( msg );
+
+    EXPECT_EQ ( nullptr, ::Protocol::getShared ( msg ) );
+    EXPECT_EQ ( 1, msg->getAs<SpectateHistory>().getSequence() );
+}
+
+#endif // NOT RELEASE
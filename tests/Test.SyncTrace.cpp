@@ -0,0 +1,129 @@
+#ifndef RELEASE
+
+#include "SyncTrace.hpp"
+#include "NetplayStates.hpp"
+#include "StringUtils.hpp"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <cstring>
+
+using namespace std;
+
+
+#define TEST_TRACE_FILE     "test_sync.trace"
+#define TEST_TRACE_FILE2    "test_sync2.trace"
+
+
+static SyncTrace::Prefix prefix ( uint32_t frame )
+{
+    return { CC_GAME_MODE_IN_GAME, NetplayState::InGame, {{ frame, 3 }} };
+}
+
+static SyncTrace::Character character ( uint32_t player, uint32_t health )
+{
+    return { player, 2, 1, 0, 10, 4, health, 11400, 7000.0f, 1.5f, 300, 0, -1200, 0, 1 };
+}
+
+// Trace the frames [0, 10), rolling back to frame 5 after frame 7, with the given health for player 2 on frame 6
+static void writeTrace ( const string& file, uint32_t health, bool rollback )
+{
+    SyncTrace trace;
+    ASSERT_TRUE ( trace.open ( file ) );
+
+    for ( uint32_t i = 0; i < 10; ++i )
+    {
+        trace.write ( SyncTrace::Type::Inputs, prefix ( i ), SyncTrace::Inputs { 0x12, 0x34 } );
+        trace.write ( SyncTrace::Type::Character, prefix ( i ), character ( 1, 11400 ) );
+        trace.write ( SyncTrace::Type::Character, prefix ( i ), character ( 2, i == 6 ? health : 11400 ) );
+
+        if ( ! rollback || i != 7 )
+            continue;
+
+        // The frames before the rollback had different state, but the rerun fixed it
+        trace.write ( SyncTrace::Type::Rollback, prefix ( i ), SyncTrace::Rollback { {{ 5, 3 }}, {{ 5, 3 }} } );
+
+        for ( uint32_t j = 5; j <= i; ++j )
+        {
+            trace.write ( SyncTrace::Type::Reinputs, prefix ( j ), SyncTrace::Inputs { 0x12, 0x34 } );
+            trace.write ( SyncTrace::Type::Character, prefix ( j ), character ( 2, 11400 ) );
+        }
+    }
+}
+
+
+TEST ( SyncTrace, DecodeMatchesSyncLog )
+{
+    SyncTrace::RngState rngState;
+    rngState.rngState0 = 0x01020304;
+    rngState.rngState1 = 0;
+    rngState.rngState2 = 0xFFFFFFFF;
+    memset ( rngState.rngState3, 0xAB, sizeof ( rngState.rngState3 ) );
+
+    {
+        SyncTrace trace;
+        ASSERT_TRUE ( trace.open ( TEST_TRACE_FILE ) );
+
+        trace.write ( SyncTrace::Type::Inputs, prefix ( 1 ), SyncTrace::Inputs { 0x12, 0xABCD } );
+        trace.write ( SyncTrace::Type::RngState, prefix ( 1 ), rngState );
+        trace.write ( SyncTrace::Type::Character, prefix ( 1 ), character ( 2, 9000 ) );
+        trace.write ( SyncTrace::Type::Round, prefix ( 1 ), SyncTrace::Round { -1, 0, 4752, 1, 2, -30, 40 } );
+        trace.write ( SyncTrace::Type::RollbackFailed, prefix ( 2 ), SyncTrace::Rollback { {{ 1, 3 }}, {{ 0, 0 }} } );
+    }
+
+    SyncTraceReader reader;
+    ASSERT_TRUE ( reader.open ( TEST_TRACE_FILE ) );
+
+    vector<string> lines;
+    SyncTrace::Header header;
+    const char *payload;
+
+    while ( reader.next ( header, payload ) )
+        lines.push_back ( SyncTrace::decode ( header, payload ) );
+
+    ASSERT_EQ ( 5, lines.size() );
+
+    // The same as LOG_SYNC wrote
+    const string prefix = "In-game [1] NetplayState::InGame [3:1] ";
+
+    EXPECT_EQ ( prefix + "Inputs: 0x0012 0xabcd", lines[0] );
+    EXPECT_EQ ( prefix + "RngState: 04 03 02 01 00 00 00 00 ff ff ff ff "
+                + formatAsHex ( rngState.rngState3, sizeof ( rngState.rngState3 ) ), lines[1] );
+    EXPECT_EQ ( prefix + "P2: C=2; M=1; c=0; seq=10; st=4; hp=9000; rh=11400; gb=7000.0; gq=1.5; mt=300; ht=0; "
+                "x=-1200; y=0; f=1", lines[2] );
+    EXPECT_EQ ( prefix + "roundOverTimer=-1; introState=0; roundTimer=4752; realTimer=1; hitsparks=2; "
+                "camera={ -30, 40 }", lines[3] );
+    EXPECT_EQ ( "In-game [1] NetplayState::InGame [3:2] Rollback to target=[3:1] failed!", lines[4] );
+
+    remove ( TEST_TRACE_FILE );
+}
+
+TEST ( SyncTrace, DiffAfterRollbacks )
+{
+    SyncTrace::Divergence divergence;
+
+    // Same final state, even though one side rolled back over a different frame
+    writeTrace ( TEST_TRACE_FILE, 11400, false );
+    writeTrace ( TEST_TRACE_FILE2, 5000, true );
+
+    ASSERT_TRUE ( SyncTrace::diff ( TEST_TRACE_FILE, TEST_TRACE_FILE2, divergence ) );
+    EXPECT_FALSE ( divergence.diverged );
+    EXPECT_EQ ( 10, divergence.numFrames );
+
+    // Different final state
+    writeTrace ( TEST_TRACE_FILE, 5000, false );
+
+    ASSERT_TRUE ( SyncTrace::diff ( TEST_TRACE_FILE, TEST_TRACE_FILE2, divergence ) );
+    ASSERT_TRUE ( divergence.diverged );
+    EXPECT_EQ ( 6, divergence.indexedFrame.parts.frame );
+    EXPECT_NE ( string::npos, divergence.first.find ( "P2: C=2; M=1; c=0; seq=10; st=4; hp=5000;" ) );
+    EXPECT_NE ( string::npos, divergence.second.find ( "P2: C=2; M=1; c=0; seq=10; st=4; hp=11400;" ) );
+
+    EXPECT_FALSE ( SyncTrace::diff ( TEST_TRACE_FILE, "missing.trace", divergence ) );
+
+    remove ( TEST_TRACE_FILE );
+    remove ( TEST_TRACE_FILE2 );
+}
+
+#endif // NOT RELEASE
@@ -0,0 +1,77 @@
+#ifndef RELEASE
+
+#include "TimeSync.hpp"
+
+#include <gtest/gtest.h>
+
+using namespace std;
+
+
+TEST ( TimeSync, LatencyCancelsOut )
+{
+    // Game A runs 3 frames ahead of game B, with 2 frames of one way latency
+    const int ahead = 3, latency = 2;
+
+    TimeSync a, b;
+
+    for ( uint32_t frame = 100; frame < 100 + TIME_SYNC_WINDOW; ++frame )
+    {
+        EXPECT_FALSE ( a.isReady() );
+        EXPECT_EQ ( 0, a.getSlowdownFrames ( 1.0f, 10 ) );
+
+        // Inputs from the other side arrive after the latency
+        a.addLocalAdvantage ( ( int ) ( frame + ahead ) - ( int ) ( frame - latency ) );
+        b.addLocalAdvantage ( ( int ) frame - ( int ) ( frame + ahead - latency ) );
+    }
+
+    a.setRemoteAdvantage ( b.getLocalAdvantage() );
+    b.setRemoteAdvantage ( a.getLocalAdvantage() );
+
+    ASSERT_TRUE ( a.isReady() );
+    ASSERT_TRUE ( b.isReady() );
+
+    EXPECT_FLOAT_EQ ( ahead, a.getFrameAdvantage() );
+    EXPECT_FLOAT_EQ ( -ahead, b.getFrameAdvantage() );
+
+    EXPECT_EQ ( ahead, a.getSlowdownFrames ( 1.0f, 10 ) );
+    EXPECT_EQ ( 2, a.getSlowdownFrames ( 1.0f, 2 ) );
+    EXPECT_EQ ( 0, a.getSlowdownFrames ( 4.0f, 10 ) );
+    EXPECT_EQ ( 0, b.getSlowdownFrames ( 1.0f, 10 ) );
+
+    a.reset();
+
+    EXPECT_FALSE ( a.isReady() );
+    EXPECT_EQ ( 0, a.getFrameAdvantage() );
+}
+
+TEST ( TimeSync, RateAdjustBelowOneFrame )
+{
+    TimeSync a;
+
+    EXPECT_EQ ( 1.0, a.getRateAdjust ( 1.0f, 60, 0.001 ) );
+
+    for ( uint32_t i = 0; i < TIME_SYNC_WINDOW; ++i )
+        a.addLocalAdvantage ( 1 );
+
+    // Half a frame ahead, which is too small to slow down whole frames
+    a.setRemoteAdvantage ( 0.0f );
+
+    ASSERT_FLOAT_EQ ( 0.5f, a.getFrameAdvantage() );
+    EXPECT_EQ ( 0, a.getSlowdownFrames ( 1.0f, 10 ) );
+
+    // Run 60 frames in the time of 60.5 frames, unless that is more than the limit
+    EXPECT_DOUBLE_EQ ( 60 / 60.5, a.getRateAdjust ( 1.0f, 60, 0.01 ) );
+    EXPECT_DOUBLE_EQ ( 0.999, a.getRateAdjust ( 1.0f, 60, 0.001 ) );
+
+    // A whole frame ahead is left to slow down
+    a.setRemoteAdvantage ( -1.0f );
+
+    EXPECT_EQ ( 1.0, a.getRateAdjust ( 1.0f, 60, 0.001 ) );
+
+    // Behind is left to the other side
+    a.setRemoteAdvantage ( 2.0f );
+
+    EXPECT_EQ ( 1.0, a.getRateAdjust ( 1.0f, 60, 0.001 ) );
+}
+
+#endif // NOT RELEASE
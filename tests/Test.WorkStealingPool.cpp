@@ -0,0 +1,59 @@
+#ifndef RELEASE
+
+#include "WorkStealingPool.hpp"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+
+#define TEST_POOL_JOBS      ( 1000 )
+#define TEST_POOL_THREADS   ( 4 )
+
+
+TEST ( WorkStealingPool, RunsEveryJobOnce )
+{
+    vector<atomic<uint32_t>> runs ( TEST_POOL_JOBS );
+    vector<atomic<uint32_t>> workers ( TEST_POOL_THREADS );
+
+    // The jobs dealt to the first worker are much slower, so the others have to steal them
+    const size_t stolen = WorkStealingPool::run ( TEST_POOL_JOBS, TEST_POOL_THREADS, [&] ( size_t job, size_t worker )
+    {
+        ++runs[job];
+        ++workers[worker];
+
+        if ( job < TEST_POOL_JOBS / TEST_POOL_THREADS )
+            this_thread::sleep_for ( chrono::milliseconds ( 1 ) );
+    } );
+
+    for ( size_t i = 0; i < TEST_POOL_JOBS; ++i )
+        ASSERT_EQ ( 1, runs[i] ) << "job " << i;
+
+    uint32_t total = 0;
+
+    for ( const auto& count : workers )
+        total += count;
+
+    EXPECT_EQ ( TEST_POOL_JOBS, total );
+    EXPECT_GT ( stolen, 0 );
+}
+
+TEST ( WorkStealingPool, MoreThreadsThanJobs )
+{
+    vector<atomic<uint32_t>> runs ( 3 );
+
+    WorkStealingPool::run ( runs.size(), 16, [&] ( size_t job, size_t ) { ++runs[job]; } );
+
+    for ( const auto& count : runs )
+        EXPECT_EQ ( 1, count );
+
+    // No jobs is fine too
+    WorkStealingPool::run ( 0, 4, [&] ( size_t, size_t ) { ADD_FAILURE(); } );
+}
+
+#endif // NOT RELEASE
@@ -0,0 +1,109 @@
+#include "InputsContainer.hpp"
+#include "StringUtils.hpp"
+
+#include <chrono>
+#include <vector>
+#include <cstdlib>
+
+using namespace std;
+
+
+// Number of frames per index, about one long round
+#define BENCHMARK_FRAMES    ( 6000 )
+
+// Number of indexes to run
+#define BENCHMARK_INDEXES   ( 50 )
+
+
+typedef InputsContainer<uint16_t> Inputs;
+
+// Remote inputs to send, mostly repeated inputs like real play
+static vector<uint16_t> remoteInputs;
+
+// Prevents the compiler from optimizing the results away
+static volatile size_t sink = 0;
+
+
+// Compare one input at a time like InputsContainer used to, then copy without comparing
+static void setScalar ( Inputs& inputs, uint32_t index, uint32_t frame, const uint16_t *t, size_t n )
+{
+    for ( size_t i = 0; i < n; ++i )
+    {
+        if ( inputs.get ( index, frame + i ) == t[i] )
+            continue;
+
+        sink = sink + frame + i;
+        break;
+    }
+
+    inputs.set ( index, frame, t, n );
+}
+
+// Send a window of NUM_INPUTS inputs every frame, each window overlaps the previous one except for the latest input.
+// Returns the number of nanoseconds per window.
+template<typename F>
+static double run ( F setWindow, bool overlapping )
+{
+    Inputs inputs;
+
+    const auto start = chrono::steady_clock::now();
+
+    size_t windows = 0;
+
+    for ( uint32_t index = 0; index < BENCHMARK_INDEXES; ++index )
+    {
+        const uint32_t step = ( overlapping ? 1 : NUM_INPUTS );
+
+        for ( uint32_t end = step; end <= BENCHMARK_FRAMES; end += step )
+        {
+            const uint32_t frame = ( end > NUM_INPUTS ? end - NUM_INPUTS : 0 );
+
+            setWindow ( inputs, index, frame, &remoteInputs[frame], end - frame );
+            ++windows;
+        }
+
+        sink = sink + inputs.getLastChangedFrame().parts.frame;
+        inputs.clearLastChangedFrame();
+    }
+
+    const auto elapsed = chrono::duration_cast<chrono::nanoseconds> ( chrono::steady_clock::now() - start );
+
+    return double ( elapsed.count() ) / windows;
+}
+
+
+int main ( int argc, char *argv[] )
+{
+    remoteInputs.resize ( BENCHMARK_FRAMES );
+
+    srand ( 12345 );
+
+    uint16_t input = 0;
+
+    for ( uint16_t& t : remoteInputs )
+    {
+        if ( rand() % 8 == 0 )
+            input = rand() % 0x100;
+
+        t = input;
+    }
+
+    const auto scalar = [] ( Inputs & inputs, uint32_t index, uint32_t frame, const uint16_t *t, size_t n )
+    {
+        setScalar ( inputs, index, frame, t, n );
+    };
+
+    const auto vectorised = [] ( Inputs & inputs, uint32_t index, uint32_t frame, const uint16_t *t, size_t n )
+    {
+        inputs.set ( index, frame, t, n, 0 );
+    };
+
+    PRINT ( "%u indexes of %u frames, %u inputs per window", BENCHMARK_INDEXES, BENCHMARK_FRAMES, NUM_INPUTS );
+    PRINT ( "method,windows,ns_per_window" );
+    PRINT ( "scalar,overlapping,%.1f", run ( scalar, true ) );
+    PRINT ( "set,overlapping,%.1f", run ( vectorised, true ) );
+    PRINT ( "scalar,new,%.1f", run ( scalar, false ) );
+    PRINT ( "set,new,%.1f", run ( vectorised, false ) );
+
+    return 0;
+}
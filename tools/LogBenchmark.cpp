@@ -0,0 +1,119 @@
+#include "Logger.hpp"
+#include "Constants.hpp"
+#include "StringUtils.hpp"
+
+#include <chrono>
+#include <vector>
+#include <string>
+#include <cstdio>
+
+using namespace std;
+
+
+// Default number of LOG calls per thread
+#define DEFAULT_CALLS ( 200000 )
+
+
+struct BenchmarkContext
+{
+    Logger logger;
+
+    size_t calls;
+
+    // Total nanoseconds spent in LOG calls by every thread
+    double totalNs = 0;
+
+    Mutex mutex;
+};
+
+THREAD ( BenchmarkThread, BenchmarkContext );
+
+void BenchmarkThread::run()
+{
+    const string name = "benchmark";
+    const IndexedFrame indexedFrame = {{ 1234, 5 }};
+
+    const auto start = chrono::steady_clock::now();
+
+    // Typical messages from the netplay code, with integer, string, and formatted arguments
+    for ( size_t i = 0; i < context.calls; ++i )
+    {
+        if ( i % 2 )
+            LOG_TO ( context.logger, "[%s] delay=%u; rollback=%u; %s=%08x", indexedFrame, i & 7, i & 15, name, i );
+        else
+            LOG_TO ( context.logger, "frame=%u; inputs=[ %04x %04x ]", i, 0x1234u, 0xABCDu );
+    }
+
+    const double ns = chrono::duration<double, nano> ( chrono::steady_clock::now() - start ).count();
+
+    Lock lock ( context.mutex );
+    context.totalNs += ns;
+}
+
+// Log from the given number of threads, returns the nanoseconds per call and the total milliseconds until written
+static void benchmark ( const string& file, uint32_t options, size_t numThreads, size_t calls, double& nsPerCall,
+                        double& totalMs )
+{
+    BenchmarkContext context;
+    context.calls = calls;
+    context.logger.initialize ( file, options );
+
+    const auto start = chrono::steady_clock::now();
+
+    vector<ThreadPtr> threads;
+
+    for ( size_t i = 0; i < numThreads; ++i )
+    {
+        threads.push_back ( ThreadPtr ( new BenchmarkThread ( context ) ) );
+        threads.back()->start();
+    }
+
+    for ( const ThreadPtr& thread : threads )
+        thread->join();
+
+    context.logger.deinitialize();
+
+    totalMs = chrono::duration<double, milli> ( chrono::steady_clock::now() - start ).count();
+    nsPerCall = context.totalNs / ( numThreads * calls );
+
+    remove ( file.c_str() );
+}
+
+
+int main ( int argc, char *argv[] )
+{
+    size_t numThreads = 1;
+
+    vector<string> args ( argv + 1, argv + argc );
+
+    if ( ! args.empty() && args[0].compare ( 0, 2, "-j" ) == 0 )
+    {
+        numThreads = lexical_cast<size_t> ( args[0].substr ( 2 ) );
+        args.erase ( args.begin() );
+    }
+
+    if ( args.empty() || args.size() > 2 || numThreads == 0 )
+    {
+        PRINT ( "Usage: %s [-jTHREADS] file [calls]", argv[0] );
+        PRINT ( "Times LOG calls per thread (default %u) to a temporary log file, written synchronously then",
+                DEFAULT_CALLS );
+        PRINT ( "asynchronously." );
+        PRINT ( "Prints the nanoseconds per call, and the total time until every message was written." );
+        return -1;
+    }
+
+    const size_t calls = ( args.size() > 1 ? lexical_cast<size_t> ( args[1] ) : DEFAULT_CALLS );
+
+    PRINT ( "mode,threads,calls,ns_per_call,total_ms" );
+
+    for ( uint32_t options : { LOG_DEFAULT_OPTIONS, LOG_DEFAULT_OPTIONS | LOG_ASYNC } )
+    {
+        double nsPerCall, totalMs;
+        benchmark ( args[0], options, numThreads, calls, nsPerCall, totalMs );
+
+        PRINT ( "%s,%u,%u,%.1f,%.1f", ( options & LOG_ASYNC ) ? "async" : "sync", uint32_t ( numThreads ),
+                uint32_t ( calls ), nsPerCall, totalMs );
+    }
+
+    return 0;
+}
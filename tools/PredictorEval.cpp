@@ -0,0 +1,206 @@
+#include "InputsContainer.hpp"
+#include "InputPredictor.hpp"
+#include "StringUtils.hpp"
+
+#include <array>
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace std;
+
+
+// Default number of frames it takes for a remote input to arrive
+#define DEFAULT_LATENCY     ( 4 )
+
+
+// Inputs of one player: index -> frame -> input
+typedef vector<vector<uint16_t>> PlayerInputs;
+
+// Totals for one predictor
+struct Result
+{
+    // Number of remote inputs that arrived after being predicted
+    size_t predicted = 0;
+
+    // Number of times an arriving input caused a rollback
+    size_t rollbacks = 0;
+
+    // Number of frames re-simulated by rollbacks
+    size_t rollbackFrames = 0;
+};
+
+
+// Read a .repraw file exported by NetplayManager::exportInputs
+static bool loadRepraw ( const string& file, array<PlayerInputs, 2>& players )
+{
+    FILE *fp = fopen ( file.c_str(), "r" );
+
+    if ( ! fp )
+    {
+        PRINT ( "Failed to open '%s'", file );
+        return false;
+    }
+
+    uint32_t numIndexes = 0;
+
+    if ( fscanf ( fp, "%u", &numIndexes ) != 1 )
+    {
+        PRINT ( "'%s' is not a .repraw file", file );
+        fclose ( fp );
+        return false;
+    }
+
+    players[0].resize ( numIndexes );
+    players[1].resize ( numIndexes );
+
+    for ( uint32_t index = 0; index < numIndexes; ++index )
+    {
+        uint32_t numFrames = 0;
+
+        if ( fscanf ( fp, "%u", &numFrames ) != 1 )
+        {
+            PRINT ( "'%s' is truncated after %u indexes", file, index );
+            fclose ( fp );
+            return false;
+        }
+
+        players[0][index].resize ( numFrames );
+        players[1][index].resize ( numFrames );
+
+        for ( uint32_t frame = 0; frame < numFrames; ++frame )
+        {
+            uint32_t p1, p2;
+
+            if ( fscanf ( fp, "%x %x", &p1, &p2 ) != 2 )
+            {
+                PRINT ( "'%s' is truncated at [%u:%u]", file, index, frame );
+                fclose ( fp );
+                return false;
+            }
+
+            players[0][index][frame] = p1;
+            players[1][index][frame] = p2;
+        }
+    }
+
+    fclose ( fp );
+    return true;
+}
+
+// Replay the inputs of one player as if they were a remote player's, arriving the given number of frames late.
+// Each frame, the game simulates with the input it has, then the next remote input arrives and is checked.
+static void evaluate ( const PlayerInputs& inputs, InputPredictorType type, uint32_t latency, Result& result )
+{
+    unique_ptr<InputPredictor> predictor ( InputPredictor::create ( type ) );
+
+    InputsContainer<uint16_t> container;
+    container.setPredictor ( predictor.get() );
+
+    for ( uint32_t index = 0; index < inputs.size(); ++index )
+    {
+        const vector<uint16_t>& frames = inputs[index];
+
+        for ( uint32_t frame = 0; frame < frames.size() + latency; ++frame )
+        {
+            // The input that arrives this frame
+            if ( frame >= latency )
+            {
+                const uint32_t arrived = frame - latency;
+
+                container.set ( index, arrived, &frames[arrived], 1, 0 );
+                ++result.predicted;
+
+                const IndexedFrame changed = container.getLastChangedFrame();
+
+                if ( changed.value != MaxIndexedFrame.value )
+                {
+                    ++result.rollbacks;
+                    result.rollbackFrames += frame - changed.parts.frame;
+                    container.clearLastChangedFrame();
+
+                    // Re-simulate with the corrected inputs
+                    for ( uint32_t i = changed.parts.frame; i < frame; ++i )
+                        container.get ( index, i );
+                }
+            }
+
+            if ( frame < frames.size() )
+                container.get ( index, frame );
+        }
+    }
+}
+
+
+int main ( int argc, char *argv[] )
+{
+    if ( argc < 2 )
+    {
+        PRINT ( "Usage: %s [--latency frames] inputs.repraw [inputs.repraw ...]", argv[0] );
+        PRINT ( "Replays each player's exported inputs as late remote inputs through each input predictor," );
+        PRINT ( "and reports how often each predictor was wrong and how many frames it rolled back." );
+        return -1;
+    }
+
+    int arg = 1;
+    uint32_t latency = DEFAULT_LATENCY;
+
+    if ( string ( argv[arg] ) == "--latency" && arg + 1 < argc )
+    {
+        latency = strtoul ( argv[arg + 1], 0, 10 );
+        arg += 2;
+    }
+
+    const vector<InputPredictorType> types =
+    {
+        InputPredictorType::HoldLast,
+        InputPredictorType::HoldDirection,
+        InputPredictorType::Frequency,
+    };
+
+    vector<Result> results ( types.size() );
+
+    size_t numFiles = 0;
+
+    for ( ; arg < argc; ++arg )
+    {
+        array<PlayerInputs, 2> players;
+
+        if ( ! loadRepraw ( argv[arg], players ) )
+            continue;
+
+        // Each file is a separate match, so each predictor learns from scratch
+        for ( size_t i = 0; i < types.size(); ++i )
+        {
+            evaluate ( players[0], types[i], latency, results[i] );
+            evaluate ( players[1], types[i], latency, results[i] );
+        }
+
+        ++numFiles;
+    }
+
+    if ( numFiles == 0 )
+    {
+        PRINT ( "No inputs were loaded" );
+        return -1;
+    }
+
+    PRINT ( "%u files, %u frames of latency", numFiles, latency );
+    PRINT ( "predictor,inputs,mispredictions,misprediction_rate,rollback_frames,rollback_frames_saved" );
+
+    // Savings are relative to holding the last input, which is what the game does without a predictor
+    const Result& baseline = results[0];
+
+    for ( size_t i = 0; i < types.size(); ++i )
+    {
+        const Result& r = results[i];
+
+        PRINT ( "%s,%u,%u,%.4f,%u,%d", types[i], r.predicted, r.rollbacks,
+                r.predicted ? double ( r.rollbacks ) / r.predicted : 0.0, r.rollbackFrames,
+                int ( baseline.rollbackFrames ) - int ( r.rollbackFrames ) );
+    }
+
+    return 0;
+}
@@ -0,0 +1,401 @@
+#include "ReplayCreator.hpp"
+#include "MappedFile.hpp"
+#include "WorkStealingPool.hpp"
+#include "StringUtils.hpp"
+
+#include <filesystem>
+#include <algorithm>
+#include <streambuf>
+#include <istream>
+#include <cstring>
+#include <cstdlib>
+#include <thread>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <map>
+
+using namespace std;
+
+namespace fs = std::filesystem;
+
+
+// Extensions of the files this tool processes
+#define REPLAY_EXTENSION        ".rep"
+#define REPLAY_RAW_EXTENSION    ".repraw"
+
+// Size of the replay file header, and of the fixed parts of each round, see ReplayCreator::dump
+#define REPLAY_HEADER_SIZE      ( 0x60 )
+#define REPLAY_ROUND_SIZE       ( 0x8C + 4 * 4 + 4 + 144 )
+
+
+// Read-only stream buffer over mapped memory, so the text parsers can read a mapped file without copying it
+struct MemoryBuffer : public streambuf
+{
+    MemoryBuffer ( const char *data, size_t size )
+    {
+        char *ptr = const_cast<char *> ( data );
+        setg ( ptr, ptr, ptr + size );
+    }
+};
+
+// The result of one file, printed as one CSV line
+struct Result
+{
+    string status;
+
+    // The rest of the columns, without the file
+    string columns;
+};
+
+
+static string rawPath ( const string& replayFile )
+{
+    return replayFile.substr ( 0, replayFile.size() - strlen ( REPLAY_EXTENSION ) ) + REPLAY_RAW_EXTENSION;
+}
+
+// Find every file with one of the given extensions under a folder, sorted and relative to the folder
+static vector<string> findFiles ( const string& folder, const vector<string>& extensions )
+{
+    vector<string> files;
+    error_code error;
+
+    for ( fs::recursive_directory_iterator it ( folder, error ), end; ! error && it != end; it.increment ( error ) )
+    {
+        error_code ec;
+
+        if ( ! it->is_regular_file ( ec ) )
+            continue;
+
+        const string ext = it->path().extension().string();
+
+        if ( find ( extensions.begin(), extensions.end(), ext ) != extensions.end() )
+            files.push_back ( fs::relative ( it->path(), folder ).generic_string() );
+    }
+
+    if ( error )
+        PRINT ( "Failed to scan '%s': %s", folder, error.message() );
+
+    sort ( files.begin(), files.end() );
+    return files;
+}
+
+static uint32_t countFrames ( const vector<ReplayCreator::Input>& inputs )
+{
+    uint32_t frames = 0;
+
+    for ( const ReplayCreator::Input& in : inputs )
+        frames += in.duration;
+
+    return frames;
+}
+
+// Map and parse a replay, and check that it is exactly the size of what it contains
+static bool loadReplay ( const string& file, ReplayCreator::ReplayFile& rf, string& error )
+{
+    MappedFile mapped;
+
+    if ( ! mapped.open ( file ) )
+    {
+        error = "unreadable";
+        return false;
+    }
+
+    if ( ! ReplayCreator().parse ( &rf, mapped.data(), mapped.size() ) )
+    {
+        error = "truncated";
+        return false;
+    }
+
+    if ( memcmp ( rf.headername, FILE_HEADER, sizeof ( rf.headername ) ) != 0 )
+    {
+        error = "bad header";
+        return false;
+    }
+
+    size_t size = REPLAY_HEADER_SIZE;
+
+    for ( const ReplayCreator::Round& round : rf.rounds )
+    {
+        size += REPLAY_ROUND_SIZE + 4 * round.rngstates.size() + 6 * ( round.p1Inputs.size() + round.p2Inputs.size()
+                + round.p3Inputs.size() + round.p4Inputs.size() );
+    }
+
+    if ( size != mapped.size() )
+    {
+        error = "trailing data";
+        return false;
+    }
+
+    return true;
+}
+
+// Check that a raw inputs file has the number of rounds, then the number of frames and "p1 p2" hex inputs per round
+static bool checkRaw ( const string& file, uint32_t& rounds, uint32_t& frames, string& error )
+{
+    MappedFile mapped;
+
+    if ( ! mapped.open ( file ) )
+    {
+        error = "unreadable";
+        return false;
+    }
+
+    MemoryBuffer buffer ( mapped.data(), mapped.size() );
+    istream in ( &buffer );
+    string line;
+
+    const auto readNumber = [&] ( uint32_t& value )
+    {
+        char *end = 0;
+        return getline ( in, line ) && ! line.empty()
+               && ( value = strtoul ( line.c_str(), &end, 10 ), *end == '\0' || *end == '\r' );
+    };
+
+    const auto isHex = [] ( const char *str, const char *end )
+    {
+        return ( str < end && all_of ( str, end, [] ( char c ) { return isxdigit ( ( unsigned char ) c ); } ) );
+    };
+
+    frames = 0;
+
+    if ( ! readNumber ( rounds ) )
+    {
+        error = "bad round count";
+        return false;
+    }
+
+    for ( uint32_t i = 0; i < rounds; ++i )
+    {
+        uint32_t numFrames;
+
+        if ( ! readNumber ( numFrames ) )
+        {
+            error = format ( "bad frame count in round %u", i );
+            return false;
+        }
+
+        for ( uint32_t j = 0; j < numFrames; ++j )
+        {
+            if ( ! getline ( in, line ) )
+            {
+                error = format ( "truncated in round %u", i );
+                return false;
+            }
+
+            const char *begin = line.c_str(), *end = begin + line.size();
+
+            if ( end > begin && end[-1] == '\r' )
+                --end;
+
+            const char *space = find ( begin, end, ' ' );
+
+            if ( ! isHex ( begin, space ) || space == end || ! isHex ( space + 1, end ) )
+            {
+                error = format ( "bad input in round %u frame %u", i, j );
+                return false;
+            }
+        }
+
+        frames += numFrames;
+    }
+
+    return true;
+}
+
+
+static Result validate ( const string& folder, const string& file )
+{
+    const string path = folder + "/" + file;
+    string error;
+
+    if ( fs::path ( file ).extension() == REPLAY_RAW_EXTENSION )
+    {
+        uint32_t rounds = 0, frames = 0;
+
+        if ( ! checkRaw ( path, rounds, frames, error ) )
+            return { "invalid", format ( "%u,,,%s", rounds, error ) };
+
+        return { "ok", format ( "%u,%u,%u,", rounds, frames, frames ) };
+    }
+
+    ReplayCreator::ReplayFile rf;
+
+    if ( ! loadReplay ( path, rf, error ) )
+        return { "invalid", format ( ",,,%s", error ) };
+
+    uint32_t p1 = 0, p2 = 0;
+
+    for ( const ReplayCreator::Round& round : rf.rounds )
+    {
+        p1 += countFrames ( round.p1Inputs );
+        p2 += countFrames ( round.p2Inputs );
+    }
+
+    return { "ok", format ( "%u,%u,%u,", rf.numRounds, p1, p2 ) };
+}
+
+static Result repair ( const string& folder, const string& output, const string& file )
+{
+    string error;
+
+    ReplayCreator creator;
+    ReplayCreator::ReplayFile rf;
+
+    if ( ! loadReplay ( folder + "/" + file, rf, error ) )
+        return { "invalid", format ( ",%s", error ) };
+
+    MappedFile raw;
+
+    if ( ! raw.open ( rawPath ( folder + "/" + file ) ) )
+        return { "skipped", ",no " REPLAY_RAW_EXTENSION };
+
+    try
+    {
+        MemoryBuffer buffer ( raw.data(), raw.size() );
+        istream in ( &buffer );
+
+        if ( ! creator.fixReplay ( &rf, in, 0 ) )
+            return { "invalid", ",too many rounds in " REPLAY_RAW_EXTENSION };
+    }
+    catch ( const exception& exc )
+    {
+        return { "invalid", format ( ",bad " REPLAY_RAW_EXTENSION ": %s", exc.what() ) };
+    }
+
+    string path = output + "/" + file;
+
+    error_code ec;
+    fs::create_directories ( fs::path ( path ).parent_path(), ec );
+
+    creator.dump ( rf, &path[0] );
+
+    // Read back what was written
+    ReplayCreator::ReplayFile fixed;
+
+    if ( ! loadReplay ( path, fixed, error ) )
+        return { "failed", format ( ",output %s", error ) };
+
+    return { "ok", format ( "%u,", fixed.numRounds ) };
+}
+
+static Result diff ( const string& folder1, const string& folder2, const string& file )
+{
+    string error;
+
+    ReplayCreator creator;
+    ReplayCreator::ReplayFile rf1, rf2;
+
+    if ( ! loadReplay ( folder1 + "/" + file, rf1, error ) )
+        return { "invalid", format ( ",,,,first %s", error ) };
+
+    if ( ! fs::exists ( folder2 + "/" + file ) )
+        return { "missing", ",,,," };
+
+    if ( ! loadReplay ( folder2 + "/" + file, rf2, error ) )
+        return { "invalid", format ( ",,,,second %s", error ) };
+
+    for ( int i = 0; i < min ( rf1.numRounds, rf2.numRounds ); ++i )
+    {
+        const int p1 = creator.findInputDiff ( rf1.rounds[i].p1Inputs, rf2.rounds[i].p1Inputs );
+        const int p2 = creator.findInputDiff ( rf1.rounds[i].p2Inputs, rf2.rounds[i].p2Inputs );
+        const int rng = creator.findRngDiff ( rf1.rounds[i].rngstates, rf2.rounds[i].rngstates );
+
+        if ( p1 >= 0 || p2 >= 0 || rng >= 0 )
+            return { "different", format ( "%d,%d,%d,%d,", i, p1, p2, rng ) };
+    }
+
+    if ( rf1.numRounds != rf2.numRounds )
+        return { "different", format ( "%d,,,,rounds %d vs %d", min ( rf1.numRounds, rf2.numRounds ),
+                                       rf1.numRounds, rf2.numRounds ) };
+
+    return { "same", ",,,," };
+}
+
+
+int main ( int argc, char *argv[] )
+{
+    size_t numThreads = thread::hardware_concurrency();
+
+    vector<string> args ( argv + 1, argv + argc );
+
+    if ( ! args.empty() && args[0].compare ( 0, 2, "-j" ) == 0 )
+    {
+        numThreads = lexical_cast<size_t> ( args[0].substr ( 2 ) );
+        args.erase ( args.begin() );
+    }
+
+    const string command = ( args.empty() ? "" : args[0] );
+
+    if ( ! ( ( command == "validate" && args.size() == 2 ) || ( command == "repair" && args.size() == 3 )
+             || ( command == "diff" && args.size() == 3 ) ) )
+    {
+        PRINT ( "Usage: %s [-jTHREADS] validate folder", argv[0] );
+        PRINT ( "       %s [-jTHREADS] repair folder output", argv[0] );
+        PRINT ( "       %s [-jTHREADS] diff folder1 folder2", argv[0] );
+        PRINT ( "" );
+        PRINT ( "validate: checks every %s and %s file under folder", REPLAY_EXTENSION, REPLAY_RAW_EXTENSION );
+        PRINT ( "repair:   rewrites the inputs of every %s that has a %s next to it, into the same path under output",
+                REPLAY_EXTENSION, REPLAY_RAW_EXTENSION );
+        PRINT ( "diff:     compares every %s under folder1 with the same path under folder2,", REPLAY_EXTENSION );
+        PRINT ( "          giving the first different round, then p1 input, p2 input, and rng state, -1 if same" );
+        PRINT ( "" );
+        PRINT ( "Prints one CSV line per file, sorted by path, and a summary to stderr." );
+        PRINT ( "Uses every core by default." );
+        return -1;
+    }
+
+    vector<string> files;
+    string header;
+    function<Result ( const string& )> process;
+
+    if ( command == "validate" )
+    {
+        files = findFiles ( args[1], { REPLAY_EXTENSION, REPLAY_RAW_EXTENSION } );
+        header = "status,rounds,p1_frames,p2_frames,error,file";
+        process = [&] ( const string& file ) { return validate ( args[1], file ); };
+    }
+    else if ( command == "repair" )
+    {
+        files = findFiles ( args[1], { REPLAY_EXTENSION } );
+        header = "status,rounds,error,file";
+        process = [&] ( const string& file ) { return repair ( args[1], args[2], file ); };
+    }
+    else
+    {
+        files = findFiles ( args[1], { REPLAY_EXTENSION } );
+        header = "status,round,p1_input,p2_input,rng,error,file";
+        process = [&] ( const string& file ) { return diff ( args[1], args[2], file ); };
+    }
+
+    vector<Result> results ( files.size() );
+
+    const auto start = chrono::steady_clock::now();
+
+    const size_t stolen = WorkStealingPool::run ( files.size(), numThreads, [&] ( size_t i, size_t )
+    {
+        results[i] = process ( files[i] );
+    } );
+
+    const double elapsedMs = chrono::duration<double, milli> ( chrono::steady_clock::now() - start ).count();
+
+    PRINT ( "%s", header );
+
+    map<string, size_t> counts;
+
+    for ( size_t i = 0; i < files.size(); ++i )
+    {
+        PRINT ( "%s,%s,%s", results[i].status, results[i].columns, files[i] );
+        ++counts[results[i].status];
+    }
+
+    string summary;
+
+    for ( const auto& kv : counts )
+        summary += format ( "; %s=%u", kv.first, uint32_t ( kv.second ) );
+
+    fprintf ( stderr, "%s: %u files%s; %u threads; %u stolen; %.1f ms\n", command.c_str(), uint32_t ( files.size() ),
+              summary.c_str(), uint32_t ( max<size_t> ( numThreads, 1 ) ), uint32_t ( stolen ), elapsedMs );
+
+    return ( counts["invalid"] + counts["failed"] ? -1 : 0 );
+}
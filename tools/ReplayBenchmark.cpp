@@ -0,0 +1,131 @@
+#include "ReplayManager.hpp"
+#include "StringUtils.hpp"
+
+#include <chrono>
+#include <string>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <cstdio>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+
+// Prevents the compiler from optimizing the results away
+static volatile size_t sink = 0;
+
+
+// Get the resident set size of this process in KB
+static size_t getResidentKB()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+
+    if ( ! GetProcessMemoryInfo ( GetCurrentProcess(), &counters, sizeof ( counters ) ) )
+        return 0;
+
+    return counters.WorkingSetSize / 1024;
+#else
+    FILE *fp = fopen ( "/proc/self/statm", "r" );
+
+    if ( ! fp )
+        return 0;
+
+    unsigned long pages = 0, resident = 0;
+
+    if ( fscanf ( fp, "%lu %lu", &pages, &resident ) != 2 )
+        resident = 0;
+
+    fclose ( fp );
+    return resident * sysconf ( _SC_PAGESIZE ) / 1024;
+#endif
+}
+
+static double getElapsedMs ( const chrono::steady_clock::time_point& start )
+{
+    return chrono::duration<double, milli> ( chrono::steady_clock::now() - start ).count();
+}
+
+// Read every frame the way replay playback does, returns the number of frames read
+static size_t walk ( ReplayManager& replay )
+{
+    size_t frames = 0;
+
+    for ( uint32_t index = 0; index <= replay.getLastIndex(); ++index )
+    {
+        sink = sink + replay.getGameMode ( {{ 0, index }} ) + replay.getStateStr ( {{ 0, index }} ).size();
+
+        if ( replay.getRngState ( {{ 0, index }} ) )
+            ++sink;
+
+        for ( uint32_t frame = 0; frame < replay.getNumFrames ( index ); ++frame )
+        {
+            const IndexedFrame indexedFrame = {{ frame, index }};
+
+            const ReplayManager::Inputs& inputs = replay.getInputs ( indexedFrame );
+            sink = sink + inputs.p1 + inputs.p2;
+
+            if ( replay.getRollbackTarget ( indexedFrame ).value != MaxIndexedFrame.value )
+                sink = sink + replay.getReinputs ( indexedFrame ).size();
+
+            ++frames;
+        }
+    }
+
+    return frames;
+}
+
+
+int main ( int argc, char *argv[] )
+{
+    if ( argc < 2 )
+    {
+        PRINT ( "Usage: %s [--real] replay", argv[0] );
+        PRINT ( "Loads a text sync log or binary replay file, then reads every frame like replay playback." );
+        PRINT ( "Reports the time taken and how much the resident set grew, run once per file to compare formats." );
+        return -1;
+    }
+
+    int arg = 1;
+    bool real = false;
+
+    if ( string ( argv[arg] ) == "--real" && arg + 1 < argc )
+    {
+        real = true;
+        ++arg;
+    }
+
+    const string file = argv[arg];
+
+    ReplayManager replay;
+
+    const size_t baseKB = getResidentKB();
+
+    auto start = chrono::steady_clock::now();
+
+    if ( ! replay.load ( file, real ) )
+    {
+        PRINT ( "Failed to load '%s'", file );
+        return -1;
+    }
+
+    const double loadMs = getElapsedMs ( start );
+    const size_t loadKB = getResidentKB();
+
+    start = chrono::steady_clock::now();
+
+    const size_t frames = walk ( replay );
+
+    const double walkMs = getElapsedMs ( start );
+    const size_t walkKB = getResidentKB();
+
+    PRINT ( "format,indexes,frames,load_ms,load_rss_kb,walk_ms,walk_rss_kb" );
+    PRINT ( "%s,%u,%u,%.1f,%d,%.1f,%d", replay.isBinary() ? "binary" : "text", replay.getLastIndex() + 1, frames,
+            loadMs, int ( loadKB - baseKB ), walkMs, int ( walkKB - baseKB ) );
+
+    return 0;
+}
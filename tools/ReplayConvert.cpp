@@ -0,0 +1,161 @@
+#include "ReplayManager.hpp"
+#include "Messages.hpp"
+#include "StringUtils.hpp"
+
+#include <string>
+#include <fstream>
+
+using namespace std;
+
+
+// Extension added to the input file when no output file is given
+#define DEFAULT_BINARY_EXTENSION ".bin"
+
+
+static uint64_t getFileSize ( const string& file )
+{
+    ifstream fin ( file.c_str(), ios::in | ios::binary | ios::ate );
+    return ( fin.good() ? uint64_t ( fin.tellg() ) : 0 );
+}
+
+// Compare everything the replay playback reads, returns the number of mismatches
+static size_t verify ( ReplayManager& text, ReplayManager& binary )
+{
+    size_t mismatches = 0;
+
+    const auto mismatch = [&] ( const IndexedFrame& indexedFrame, const char *what )
+    {
+        if ( mismatches < 10 )
+            PRINT ( "Mismatched %s at [%s]", what, indexedFrame );
+
+        ++mismatches;
+    };
+
+    if ( text.getLastIndex() != binary.getLastIndex() || text.getLastFrame() != binary.getLastFrame() )
+        mismatch ( {{ binary.getLastFrame(), binary.getLastIndex() }}, "last frame" );
+
+    for ( uint32_t index = 0; index <= text.getLastIndex(); ++index )
+    {
+        const IndexedFrame first = {{ 0, index }};
+
+        if ( text.getGameMode ( first ) != binary.getGameMode ( first ) )
+            mismatch ( first, "game mode" );
+
+        if ( text.getStateStr ( first ) != binary.getStateStr ( first ) )
+            mismatch ( first, "netplay state" );
+
+        MsgPtr textRng = text.getRngState ( first ), binaryRng = binary.getRngState ( first );
+
+        if ( bool ( textRng ) != bool ( binaryRng )
+                || ( textRng && textRng->getAs<RngState>().dump() != binaryRng->getAs<RngState>().dump() ) )
+        {
+            mismatch ( first, "RngState" );
+        }
+
+        if ( text.getNumFrames ( index ) != binary.getNumFrames ( index ) )
+            mismatch ( first, "number of frames" );
+
+        for ( uint32_t frame = 0; frame < text.getNumFrames ( index ); ++frame )
+        {
+            const IndexedFrame indexedFrame = {{ frame, index }};
+
+            const ReplayManager::Inputs& a = text.getInputs ( indexedFrame );
+            const ReplayManager::Inputs& b = binary.getInputs ( indexedFrame );
+
+            if ( a.p1 != b.p1 || a.p2 != b.p2 )
+                mismatch ( indexedFrame, "inputs" );
+
+            if ( text.getRollbackTarget ( indexedFrame ).value != binary.getRollbackTarget ( indexedFrame ).value )
+                mismatch ( indexedFrame, "rollback target" );
+
+            const span<const ReplayManager::Inputs> c = text.getReinputs ( indexedFrame );
+            const span<const ReplayManager::Inputs> d = binary.getReinputs ( indexedFrame );
+
+            bool same = ( c.size() == d.size() );
+
+            for ( size_t i = 0; same && i < c.size(); ++i )
+            {
+                same = ( c[i].indexedFrame.value == d[i].indexedFrame.value
+                         && c[i].p1 == d[i].p1 && c[i].p2 == d[i].p2 );
+            }
+
+            if ( ! same )
+                mismatch ( indexedFrame, "reinputs" );
+        }
+    }
+
+    for ( uint32_t index = 0; index <= text.getLastIndex() + 1; ++index )
+    {
+        MsgPtr a = text.getInitialStateBefore ( index ), b = binary.getInitialStateBefore ( index );
+
+        if ( bool ( a ) != bool ( b ) )
+        {
+            mismatch ( {{ 0, index }}, "initial state" );
+            continue;
+        }
+
+        if ( ! a )
+            continue;
+
+        const InitialGameState& c = a->getAs<InitialGameState>();
+        const InitialGameState& d = b->getAs<InitialGameState>();
+
+        if ( c.indexedFrame.value != d.indexedFrame.value || c.chara != d.chara || c.moon != d.moon
+                || c.color != d.color )
+        {
+            mismatch ( {{ 0, index }}, "initial state" );
+        }
+    }
+
+    return mismatches;
+}
+
+
+int main ( int argc, char *argv[] )
+{
+    if ( argc < 2 )
+    {
+        PRINT ( "Usage: %s sync.log [output]", argv[0] );
+        PRINT ( "Converts a text sync log to a binary replay file, then checks the binary replay against the text." );
+        PRINT ( "The default output is the input file with %s added.", DEFAULT_BINARY_EXTENSION );
+        return -1;
+    }
+
+    const string input = argv[1];
+    const string output = ( argc > 2 ? argv[2] : input + DEFAULT_BINARY_EXTENSION );
+
+    if ( BinaryReplay::isBinaryReplay ( input ) )
+    {
+        PRINT ( "'%s' is already a binary replay", input );
+        return -1;
+    }
+
+    ReplayManager text;
+
+    if ( ! text.load ( input, false ) )
+    {
+        PRINT ( "Failed to load '%s'", input );
+        return -1;
+    }
+
+    if ( ! text.save ( output ) )
+    {
+        PRINT ( "Failed to write '%s'", output );
+        return -1;
+    }
+
+    ReplayManager binary;
+
+    if ( ! binary.load ( output, false ) )
+    {
+        PRINT ( "Failed to map '%s'", output );
+        return -1;
+    }
+
+    const size_t mismatches = verify ( text, binary );
+
+    PRINT ( "%s: %llu bytes -> %s: %llu bytes; %u indexes; %u mismatches",
+            input, getFileSize ( input ), output, getFileSize ( output ), text.getLastIndex() + 1, mismatches );
+
+    return ( mismatches ? -1 : 0 );
+}
@@ -0,0 +1,195 @@
+#include "ReplayIndex.hpp"
+#include "StringUtils.hpp"
+
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <ctime>
+
+using namespace std;
+
+
+static double getElapsedMs ( const chrono::steady_clock::time_point& start )
+{
+    return chrono::duration<double, milli> ( chrono::steady_clock::now() - start ).count();
+}
+
+// Parse a local date as YYYY-MM-DD, returns -1 if invalid
+static int64_t parseDate ( const string& str )
+{
+    tm date = {};
+
+    if ( sscanf ( str.c_str(), "%d-%d-%d", &date.tm_year, &date.tm_mon, &date.tm_mday ) != 3 )
+        return -1;
+
+    date.tm_year -= 1900;
+    date.tm_mon -= 1;
+    date.tm_isdst = -1;
+    return mktime ( &date );
+}
+
+static string formatDate ( int64_t value )
+{
+    const time_t t = value;
+    char buffer[32];
+    strftime ( buffer, sizeof ( buffer ), "%Y-%m-%d %H:%M:%S", localtime ( &t ) );
+    return buffer;
+}
+
+static int usage ( const char *name )
+{
+    PRINT ( "Usage: %s [-jTHREADS] update index folder [results.csv]", name );
+    PRINT ( "       %s query index [options]", name );
+    PRINT ( "" );
+    PRINT ( "update: adds the new and changed .rep files under folder to the index, and removes deleted ones." );
+    PRINT ( "        Player names and wins are matched from results.csv, by characters and time." );
+    PRINT ( "" );
+    PRINT ( "query options:" );
+    PRINT ( "  --player NAME        either player" );
+    PRINT ( "  --chara [M-]NAME     either character, eg. Ciel or C-Ciel, the same side as --player if both are given" );
+    PRINT ( "  --stage ID" );
+    PRINT ( "  --from YYYY-MM-DD" );
+    PRINT ( "  --to YYYY-MM-DD      inclusive" );
+    PRINT ( "  --result win|loss    for the side of --player / --chara" );
+    PRINT ( "  --limit N            most matches to print, newest first" );
+    PRINT ( "" );
+    PRINT ( "Prints one CSV line per match, and timings to stderr." );
+    return -1;
+}
+
+
+int main ( int argc, char *argv[] )
+{
+    size_t numThreads = thread::hardware_concurrency();
+
+    vector<string> args ( argv + 1, argv + argc );
+
+    if ( ! args.empty() && args[0].compare ( 0, 2, "-j" ) == 0 )
+    {
+        numThreads = lexical_cast<size_t> ( args[0].substr ( 2 ) );
+        args.erase ( args.begin() );
+    }
+
+    if ( args.size() < 2 )
+        return usage ( argv[0] );
+
+    const string& indexFile = args[1];
+
+    ReplayIndex index;
+
+    auto start = chrono::steady_clock::now();
+
+    if ( args[0] == "update" )
+    {
+        if ( args.size() < 3 || args.size() > 4 )
+            return usage ( argv[0] );
+
+        index.load ( indexFile );
+
+        const ReplayIndex::UpdateStats stats = index.update ( args[2], ( args.size() > 3 ? args[3] : "" ), numThreads );
+
+        if ( ! index.save ( indexFile ) )
+        {
+            PRINT ( "Failed to write '%s'", indexFile );
+            return -1;
+        }
+
+        fprintf ( stderr, "%u replays; added=%u; changed=%u; removed=%u; unchanged=%u; invalid=%u; matched=%u; "
+                  "%.1f ms\n", uint32_t ( index.size() ), uint32_t ( stats.added ), uint32_t ( stats.changed ),
+                  uint32_t ( stats.removed ), uint32_t ( stats.unchanged ), uint32_t ( stats.invalid ),
+                  uint32_t ( stats.matched ), getElapsedMs ( start ) );
+        return 0;
+    }
+
+    if ( args[0] != "query" )
+        return usage ( argv[0] );
+
+    ReplayIndex::Query query;
+
+    for ( size_t i = 2; i < args.size(); i += 2 )
+    {
+        if ( i + 1 >= args.size() )
+            return usage ( argv[0] );
+
+        const string& opt = args[i];
+        const string& value = args[i + 1];
+
+        if ( opt == "--player" )
+        {
+            query.player = value;
+        }
+        else if ( opt == "--chara" )
+        {
+            if ( ! ReplayIndex::parseChara ( value, query.chara, query.moon ) )
+            {
+                PRINT ( "Unknown character '%s'", value );
+                return -1;
+            }
+        }
+        else if ( opt == "--stage" )
+        {
+            query.stage = lexical_cast<int> ( value );
+        }
+        else if ( opt == "--from" || opt == "--to" )
+        {
+            const int64_t date = parseDate ( value );
+
+            if ( date < 0 )
+            {
+                PRINT ( "Invalid date '%s'", value );
+                return -1;
+            }
+
+            if ( opt == "--from" )
+                query.from = date;
+            else
+                query.to = date + 24 * 60 * 60;
+        }
+        else if ( opt == "--result" && ( value == "win" || value == "loss" ) )
+        {
+            query.result = ( value == "win" ? ReplayIndex::Result::Win : ReplayIndex::Result::Loss );
+        }
+        else if ( opt == "--limit" )
+        {
+            query.limit = lexical_cast<size_t> ( value );
+        }
+        else
+        {
+            return usage ( argv[0] );
+        }
+    }
+
+    if ( ! index.load ( indexFile ) )
+    {
+        PRINT ( "Failed to load '%s'", indexFile );
+        return -1;
+    }
+
+    const double loadMs = getElapsedMs ( start );
+
+    start = chrono::steady_clock::now();
+
+    const vector<size_t> matches = index.query ( query );
+
+    const double queryMs = getElapsedMs ( start );
+
+    PRINT ( "date,stage,player1,chara1,wins1,player2,chara2,wins2,rounds,file" );
+
+    for ( size_t i : matches )
+    {
+        const ReplayIndex::Entry& entry = index.get ( i );
+
+        PRINT ( "%s,%u,%s,%s,%s,%s,%s,%s,%u,%s", formatDate ( entry.date ), entry.stage,
+                index.getString ( entry.names[0] ), ReplayIndex::formatChara ( entry.chara[0], entry.moon[0] ),
+                ( entry.hasResult() ? format ( "%u", entry.wins[0] ) : "" ),
+                index.getString ( entry.names[1] ), ReplayIndex::formatChara ( entry.chara[1], entry.moon[1] ),
+                ( entry.hasResult() ? format ( "%u", entry.wins[1] ) : "" ),
+                entry.numRounds, index.getString ( entry.path ) );
+    }
+
+    fprintf ( stderr, "%u matches of %u replays; load %.1f ms; query %.3f ms\n", uint32_t ( matches.size() ),
+              uint32_t ( index.size() ), loadMs, queryMs );
+    return 0;
+}
@@ -0,0 +1,151 @@
+#include "ReplayKeyframes.hpp"
+#include "MemDump.hpp"
+#include "StringUtils.hpp"
+
+#include <chrono>
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstring>
+
+using namespace std;
+
+
+// Extension added to the capture file for the keyframes file
+#define KEYFRAMES_EXTENSION ".keyframes"
+
+
+static double getElapsedMs ( const chrono::steady_clock::time_point& start )
+{
+    return chrono::duration<double, milli> ( chrono::steady_clock::now() - start ).count();
+}
+
+// Build keyframes from every interval frames of a state capture, and record the last frame of each index
+static bool buildKeyframes ( const string& file, uint32_t interval, ReplayKeyframes& keyframes,
+                             vector<IndexedFrame>& roundEnds )
+{
+    FILE *fp = fopen ( file.c_str(), "rb" );
+
+    if ( ! fp )
+    {
+        PRINT ( "Failed to open '%s'", file );
+        return false;
+    }
+
+    uint32_t header[2];
+
+    if ( fread ( header, sizeof ( header ), 1, fp ) != 1 || header[0] != MEM_DUMP_CAPTURE_MAGIC )
+    {
+        PRINT ( "'%s' is not a state capture file", file );
+        fclose ( fp );
+        return false;
+    }
+
+    keyframes.reset ( header[1] );
+
+    vector<char> state ( header[1] );
+    MemDumpCaptureHeader current;
+
+    while ( fread ( &current, sizeof ( current ), 1, fp ) == 1 )
+    {
+        if ( fread ( &state[0], state.size(), 1, fp ) != 1 )
+            break;
+
+        const IndexedFrame indexedFrame = {{ current.frame, current.index }};
+
+        if ( roundEnds.empty() || roundEnds.back().parts.index != current.index )
+            roundEnds.push_back ( indexedFrame );
+        else if ( roundEnds.back().value < indexedFrame.value )
+            roundEnds.back() = indexedFrame;
+
+        // The capture file doesn't have the netplay state or floating point environment, they don't affect the cost
+        if ( current.frame % interval == 0 )
+            keyframes.add ( 0, 0, indexedFrame, string ( 28, '\0' ), &state[0] );
+    }
+
+    fclose ( fp );
+    return true;
+}
+
+
+int main ( int argc, char *argv[] )
+{
+    if ( argc < 2 )
+    {
+        PRINT ( "Usage: %s capture [interval]", argv[0] );
+        PRINT ( "Builds replay keyframes every interval frames (default %u) from a state capture file,", REPLAY_KEYFRAME_INTERVAL );
+        PRINT ( "saves them with %s added, then times seeking to the end of the first, middle, and last round.",
+                KEYFRAMES_EXTENSION );
+        PRINT ( "Each seek loads the keyframes file from scratch, like the first seek after opening a replay." );
+        return -1;
+    }
+
+    const string capture = argv[1];
+    const string file = capture + KEYFRAMES_EXTENSION;
+    const uint32_t interval = ( argc > 2 ? lexical_cast<uint32_t> ( argv[2] ) : REPLAY_KEYFRAME_INTERVAL );
+
+    ReplayKeyframes keyframes;
+    vector<IndexedFrame> roundEnds;
+
+    auto start = chrono::steady_clock::now();
+
+    if ( ! buildKeyframes ( capture, interval, keyframes, roundEnds ) || roundEnds.empty() )
+        return -1;
+
+    const double buildMs = getElapsedMs ( start );
+
+    if ( ! keyframes.save ( file ) )
+    {
+        PRINT ( "Failed to write '%s'", file );
+        return -1;
+    }
+
+    PRINT ( "keyframes,rounds,state_bytes,raw_bytes,compressed_bytes,build_ms" );
+    PRINT ( "%u,%u,%u,%llu,%u,%.1f", keyframes.size(), roundEnds.size(), keyframes.getStateSize(),
+            uint64_t ( keyframes.size() ) * keyframes.getStateSize(), keyframes.getCompressedSize(), buildMs );
+
+    PRINT ( "round,target,keyframe,resim_frames,load_ms,decode_ms,seek_ms" );
+
+    vector<char> state ( keyframes.getStateSize() );
+
+    for ( size_t round : { size_t ( 0 ), roundEnds.size() / 2, roundEnds.size() - 1 } )
+    {
+        const IndexedFrame target = roundEnds[round];
+
+        start = chrono::steady_clock::now();
+
+        ReplayKeyframes loaded;
+
+        if ( ! loaded.load ( file ) )
+        {
+            PRINT ( "Failed to load '%s'", file );
+            return -1;
+        }
+
+        const double loadMs = getElapsedMs ( start );
+
+        const size_t keyframe = loaded.find ( target );
+
+        if ( keyframe == loaded.size() )
+        {
+            PRINT ( "%u,%s,none,,%.1f,,", round + 1, target, loadMs );
+            continue;
+        }
+
+        start = chrono::steady_clock::now();
+
+        if ( ! loaded.decode ( keyframe, &state[0] ) )
+        {
+            PRINT ( "Failed to decode keyframe %u", keyframe );
+            return -1;
+        }
+
+        const double decodeMs = getElapsedMs ( start );
+        const IndexedFrame found = loaded.get ( keyframe ).indexedFrame;
+
+        PRINT ( "%u,%s,%s,%u,%.1f,%.1f,%.1f", round + 1, target, found, target.parts.frame - found.parts.frame,
+                loadMs, decodeMs, loadMs + decodeMs );
+    }
+
+    return 0;
+}
@@ -0,0 +1,300 @@
+#include "MemDump.hpp"
+#include "StringUtils.hpp"
+
+#include <emmintrin.h>
+
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+using namespace std;
+
+
+#define LOG_FILE "statediff.log"
+
+// Max number of ranked nodes to print
+#define MAX_SUMMARY_LINES ( 100 )
+
+
+// Accumulated differences for a single layout node
+struct NodeDiff
+{
+    // Index into the layout
+    size_t node = 0;
+
+    // Number of snapshots where this node differs
+    size_t snapshots = 0;
+
+    // Total number of differing bytes over all snapshots
+    size_t bytes = 0;
+
+    // Smallest and largest differing offset from the start of the node
+    size_t minOffset = SIZE_MAX, maxOffset = 0;
+
+    // The first snapshot where this node differs
+    size_t firstSnapshot = SIZE_MAX;
+};
+
+
+// Append each range [start, end) where a and b differ, comparing 16 bytes at a time
+static void findDiffRanges ( const char *a, const char *b, size_t len, vector<pair<size_t, size_t>>& ranges )
+{
+    size_t i = 0, start = SIZE_MAX;
+
+    for ( ; i + 16 <= len; i += 16 )
+    {
+        const __m128i x = _mm_loadu_si128 ( ( const __m128i * ) ( a + i ) );
+        const __m128i y = _mm_loadu_si128 ( ( const __m128i * ) ( b + i ) );
+
+        // Bit N is set if byte N is equal
+        const uint32_t equal = _mm_movemask_epi8 ( _mm_cmpeq_epi8 ( x, y ) );
+
+        // Fast path: the whole block is equal, or the whole block is different
+        if ( equal == 0xFFFF )
+        {
+            if ( start != SIZE_MAX )
+            {
+                ranges.push_back ( { start, i } );
+                start = SIZE_MAX;
+            }
+            continue;
+        }
+
+        if ( equal == 0 )
+        {
+            if ( start == SIZE_MAX )
+                start = i;
+            continue;
+        }
+
+        for ( size_t j = 0; j < 16; ++j )
+        {
+            const bool same = ( equal >> j ) & 1;
+
+            if ( ! same && start == SIZE_MAX )
+            {
+                start = i + j;
+            }
+            else if ( same && start != SIZE_MAX )
+            {
+                ranges.push_back ( { start, i + j } );
+                start = SIZE_MAX;
+            }
+        }
+    }
+
+    for ( ; i < len; ++i )
+    {
+        const bool same = ( a[i] == b[i] );
+
+        if ( ! same && start == SIZE_MAX )
+        {
+            start = i;
+        }
+        else if ( same && start != SIZE_MAX )
+        {
+            ranges.push_back ( { start, i } );
+            start = SIZE_MAX;
+        }
+    }
+
+    if ( start != SIZE_MAX )
+        ranges.push_back ( { start, len } );
+}
+
+// Read a whole snapshot into the given buffer, reusing its memory
+static bool readSnapshot ( const string& file, vector<char>& buffer, size_t expectedSize )
+{
+    FILE *fp = fopen ( file.c_str(), "rb" );
+
+    if ( ! fp )
+    {
+        PRINT ( "Failed to open '%s'", file );
+        return false;
+    }
+
+    buffer.resize ( expectedSize );
+
+    const size_t read = fread ( &buffer[0], 1, expectedSize, fp );
+    const bool atEnd = ( fgetc ( fp ) == EOF );
+
+    fclose ( fp );
+
+    if ( read != expectedSize || ! atEnd )
+    {
+        PRINT ( "'%s' is not a saved state for this layout (expected %u bytes)", file, expectedSize );
+        return false;
+    }
+
+    return true;
+}
+
+// Format the pointer path to a layout node, eg. 0x67BDE8 [0x320]+0x38 [0x0]+0x0
+static string describeNode ( const vector<MemDumpList::LayoutNode>& layout, size_t node,
+                             const MemDumpList& allAddrs )
+{
+    const MemDumpList::LayoutNode& n = layout[node];
+
+    if ( n.depth == 0 )
+        return format ( "0x%06X", ( uint32_t ) ( uintptr_t ) allAddrs.addrs[n.index].addr );
+
+    // The parent is the closest previous node with a smaller depth
+    size_t parent = node;
+    while ( layout[parent].depth >= n.depth )
+        --parent;
+
+    const MemDumpPtr& ptr = * ( const MemDumpPtr * ) n.mem;
+
+    return describeNode ( layout, parent, allAddrs ) + format ( " [0x%X]+0x%X", ptr.srcOffset, ptr.dstOffset );
+}
+
+
+int main ( int argc, char *argv[] )
+{
+    if ( argc < 4 )
+    {
+        PRINT ( "Usage: %s rollback.bin base.bin snapshot.bin [snapshot.bin ...]", argv[0] );
+        PRINT ( "Diffs each snapshot against the base snapshot, then ranks the memory dumps that differ." );
+        PRINT ( "Use --sequential as the first argument to diff each snapshot against the previous one instead." );
+        return -1;
+    }
+
+    Logger::get().initialize ( LOG_FILE, 0 );
+
+    int arg = 1;
+    bool sequential = false;
+
+    if ( string ( argv[arg] ) == "--sequential" )
+    {
+        sequential = true;
+        ++arg;
+    }
+
+    MemDumpList allAddrs;
+
+    if ( ! allAddrs.load ( argv[arg] ) || allAddrs.empty() )
+    {
+        PRINT ( "Failed to load memory layout from '%s'", argv[arg] );
+        return -1;
+    }
+
+    ++arg;
+
+    const vector<MemDumpList::LayoutNode> layout = allAddrs.getLayout();
+
+    vector<NodeDiff> diffs ( layout.size() );
+    for ( size_t i = 0; i < layout.size(); ++i )
+        diffs[i].node = i;
+
+    vector<char> base, snapshot;
+
+    if ( ! readSnapshot ( argv[arg], base, allAddrs.totalSize ) )
+        return -1;
+
+    ++arg;
+
+    vector<pair<size_t, size_t>> ranges;
+    vector<size_t> touched;
+    size_t numSnapshots = 0, numDiffering = 0, totalBytes = 0;
+
+    for ( ; arg < argc; ++arg )
+    {
+        if ( ! readSnapshot ( argv[arg], snapshot, allAddrs.totalSize ) )
+            return -1;
+
+        ranges.clear();
+        findDiffRanges ( &base[0], &snapshot[0], allAddrs.totalSize, ranges );
+
+        touched.clear();
+
+        // Map each differing range to the layout nodes it overlaps
+        for ( const auto& range : ranges )
+        {
+            LOG ( "%s: differs at dump offset [0x%X, 0x%X)", argv[arg], range.first, range.second );
+
+            auto it = upper_bound ( layout.begin(), layout.end(), range.first,
+            [] ( size_t offset, const MemDumpList::LayoutNode & n ) { return offset < n.dumpOffset; } );
+
+            for ( --it; it != layout.end() && it->dumpOffset < range.second; ++it )
+            {
+                const size_t start = max ( range.first, it->dumpOffset );
+                const size_t end = min ( range.second, it->dumpOffset + it->mem->size );
+
+                if ( start >= end )
+                    continue;
+
+                NodeDiff& diff = diffs[it - layout.begin()];
+
+                if ( touched.empty() || touched.back() != diff.node )
+                {
+                    if ( diff.firstSnapshot == SIZE_MAX )
+                        diff.firstSnapshot = numSnapshots;
+
+                    ++diff.snapshots;
+                    touched.push_back ( diff.node );
+                }
+
+                diff.bytes += end - start;
+                diff.minOffset = min ( diff.minOffset, start - it->dumpOffset );
+                diff.maxOffset = max ( diff.maxOffset, end - it->dumpOffset );
+            }
+
+            totalBytes += range.second - range.first;
+        }
+
+        if ( ! ranges.empty() )
+            ++numDiffering;
+
+        ++numSnapshots;
+
+        if ( sequential )
+            swap ( base, snapshot );
+    }
+
+    // Rank the differing nodes by how often they differ, then by how many bytes differ
+    diffs.erase ( remove_if ( diffs.begin(), diffs.end(), [] ( const NodeDiff & d ) { return d.snapshots == 0; } ),
+                  diffs.end() );
+
+    sort ( diffs.begin(), diffs.end(), [] ( const NodeDiff & a, const NodeDiff & b )
+    {
+        if ( a.snapshots != b.snapshots )
+            return a.snapshots > b.snapshots;
+        if ( a.bytes != b.bytes )
+            return a.bytes > b.bytes;
+        return a.node < b.node;
+    } );
+
+    PRINT ( "%u of %u snapshots differ; %u bytes differ in total; %u of %u memory dumps differ",
+            numDiffering, numSnapshots, totalBytes, diffs.size(), layout.size() );
+
+    if ( diffs.empty() )
+        return 0;
+
+    PRINT ( "rank,snapshots,bytes,first,region,depth,offset_start,offset_end,size,node" );
+
+    for ( size_t i = 0; i < diffs.size() && i < MAX_SUMMARY_LINES; ++i )
+    {
+        const NodeDiff& d = diffs[i];
+        const MemDumpList::LayoutNode& n = layout[d.node];
+
+        PRINT ( "%u,%u,%u,%u,%u,%u,0x%X,0x%X,%u,%s", i + 1, d.snapshots, d.bytes, d.firstSnapshot, n.index, n.depth,
+                d.minOffset, d.maxOffset, n.mem->size, describeNode ( layout, d.node, allAddrs ) );
+    }
+
+    if ( diffs.size() > MAX_SUMMARY_LINES )
+        PRINT ( "... %u more in %s", diffs.size() - MAX_SUMMARY_LINES, LOG_FILE );
+
+    for ( size_t i = MAX_SUMMARY_LINES; i < diffs.size(); ++i )
+    {
+        const NodeDiff& d = diffs[i];
+        const MemDumpList::LayoutNode& n = layout[d.node];
+
+        LOG ( "%u,%u,%u,%u,%u,%u,0x%X,0x%X,%u,%s", i + 1, d.snapshots, d.bytes, d.firstSnapshot, n.index, n.depth,
+              d.minOffset, d.maxOffset, n.mem->size, describeNode ( layout, d.node, allAddrs ) );
+    }
+
+    Logger::get().deinitialize();
+    return 0;
+}
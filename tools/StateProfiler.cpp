@@ -0,0 +1,368 @@
+#include "MemDump.hpp"
+#include "StringUtils.hpp"
+
+#include <emmintrin.h>
+
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+using namespace std;
+
+
+// Granularity of the profile, memory dumps are shrunk to whole cache lines
+#define CACHE_LINE_SIZE             ( 64 )
+
+// A line is considered render-only if it never changed after a skipped frame,
+// even though at least this many changes would be expected from its rate of change after rendered frames.
+#define MIN_EXPECTED_SKIPPED_CHANGES ( 5.0 )
+
+// Max number of regions to list in the report
+#define MAX_REPORT_LINES            ( 50 )
+
+
+// A cache line of a top level memory dump, or a whole child pointer
+struct Line
+{
+    // Index into the layout
+    size_t node;
+
+    // Offset of this line in the saved dump
+    size_t dumpOffset;
+
+    // Size of this line
+    size_t size;
+
+    // Number of changes after a rendered / skipped frame
+    size_t renderedChanges = 0, skippedChanges = 0;
+
+    Line ( size_t node, size_t dumpOffset, size_t size ) : node ( node ), dumpOffset ( dumpOffset ), size ( size ) {}
+};
+
+// What to do with each line
+enum class LineState : uint8_t { Kept, NeverChanged, RenderOnly };
+
+
+// Totals for the report
+static size_t numRenderedFrames = 0, numSkippedFrames = 0;
+
+
+// True if the given byte ranges differ, comparing 16 bytes at a time
+static bool differs ( const char *a, const char *b, size_t len )
+{
+    size_t i = 0;
+
+    for ( ; i + 16 <= len; i += 16 )
+    {
+        const __m128i x = _mm_loadu_si128 ( ( const __m128i * ) ( a + i ) );
+        const __m128i y = _mm_loadu_si128 ( ( const __m128i * ) ( b + i ) );
+
+        if ( _mm_movemask_epi8 ( _mm_cmpeq_epi8 ( x, y ) ) != 0xFFFF )
+            return true;
+    }
+
+    return memcmp ( a + i, b + i, len - i ) != 0;
+}
+
+// Split the saved dump into lines. Top level memory dumps are split along address aligned cache lines,
+// since those can be shrunk. Child pointers are kept as a single line with all their children, since the memory
+// they point to can move around.
+static vector<Line> getLines ( const vector<MemDumpList::LayoutNode>& layout, const MemDumpList& allAddrs )
+{
+    vector<Line> lines;
+
+    for ( size_t i = 0; i < layout.size(); ++i )
+    {
+        const MemDumpList::LayoutNode& n = layout[i];
+
+        if ( n.depth > 0 )
+        {
+            // Only the first child pointer of each subtree has a line, which covers the whole subtree
+            if ( n.depth > 1 )
+                continue;
+
+            lines.push_back ( Line ( i, n.dumpOffset, n.mem->getTotalSize() ) );
+            continue;
+        }
+
+        const uintptr_t addr = ( uintptr_t ) allAddrs.addrs[n.index].addr;
+
+        for ( size_t offset = 0; offset < n.mem->size; )
+        {
+            const size_t end = min<size_t> ( n.mem->size, ( ( addr + offset ) / CACHE_LINE_SIZE + 1 )
+                                             * CACHE_LINE_SIZE - addr );
+
+            lines.push_back ( Line ( i, n.dumpOffset + offset, end - offset ) );
+            offset = end;
+        }
+    }
+
+    return lines;
+}
+
+// Read all the game states in a capture file, and count the changes of each line between consecutive frames
+static bool profileCapture ( const string& file, const MemDumpList& allAddrs, vector<Line>& lines )
+{
+    FILE *fp = fopen ( file.c_str(), "rb" );
+
+    if ( ! fp )
+    {
+        PRINT ( "Failed to open '%s'", file );
+        return false;
+    }
+
+    uint32_t header[2];
+
+    if ( fread ( header, sizeof ( header ), 1, fp ) != 1
+            || header[0] != MEM_DUMP_CAPTURE_MAGIC || header[1] != allAddrs.totalSize )
+    {
+        PRINT ( "'%s' was not captured with this layout", file );
+        fclose ( fp );
+        return false;
+    }
+
+    MemDumpCaptureHeader previous = { 0, 0, 0 }, current;
+
+    vector<char> previousState ( allAddrs.totalSize ), currentState ( allAddrs.totalSize );
+
+    size_t numStates = 0;
+
+    while ( fread ( &current, sizeof ( current ), 1, fp ) == 1 )
+    {
+        if ( fread ( &currentState[0], allAddrs.totalSize, 1, fp ) != 1 )
+        {
+            PRINT ( "'%s' is truncated after %u states", file, numStates );
+            break;
+        }
+
+        // Only compare consecutive frames, game states are re-captured out of order after a rollback
+        if ( numStates > 0 && current.index == previous.index && current.frame == previous.frame + 1 )
+        {
+            if ( current.rendered )
+                ++numRenderedFrames;
+            else
+                ++numSkippedFrames;
+
+            for ( Line& line : lines )
+            {
+                if ( ! differs ( &previousState[line.dumpOffset], &currentState[line.dumpOffset], line.size ) )
+                    continue;
+
+                if ( current.rendered )
+                    ++line.renderedChanges;
+                else
+                    ++line.skippedChanges;
+            }
+        }
+
+        previous = current;
+        swap ( previousState, currentState );
+        ++numStates;
+    }
+
+    fclose ( fp );
+
+    PRINT ( "'%s': %u states", file, numStates );
+    return true;
+}
+
+static LineState getLineState ( const Line& line, bool keepRenderOnly )
+{
+    if ( line.renderedChanges == 0 && line.skippedChanges == 0 )
+        return LineState::NeverChanged;
+
+    if ( keepRenderOnly || line.skippedChanges > 0 || numRenderedFrames == 0 )
+        return LineState::Kept;
+
+    const double expectedSkippedChanges = numSkippedFrames * double ( line.renderedChanges ) / numRenderedFrames;
+
+    if ( expectedSkippedChanges >= MIN_EXPECTED_SKIPPED_CHANGES )
+        return LineState::RenderOnly;
+
+    return LineState::Kept;
+}
+
+
+int main ( int argc, char *argv[] )
+{
+    if ( argc < 4 )
+    {
+        PRINT ( "Usage: %s [--keep-render-only] rollback.bin output.bin capture.cap [capture.cap ...]", argv[0] );
+        PRINT ( "Profiles which cache lines of the rollback memory change between captured game states," );
+        PRINT ( "then writes a smaller rollback.bin without the lines that never changed or only changed when "
+                "rendering." );
+        return -1;
+    }
+
+    int arg = 1;
+    bool keepRenderOnly = false;
+
+    if ( string ( argv[arg] ) == "--keep-render-only" )
+    {
+        keepRenderOnly = true;
+        ++arg;
+    }
+
+    MemDumpList allAddrs;
+
+    if ( ! allAddrs.load ( argv[arg] ) || allAddrs.empty() )
+    {
+        PRINT ( "Failed to load memory layout from '%s'", argv[arg] );
+        return -1;
+    }
+
+    const string output = argv[arg + 1];
+
+    const vector<MemDumpList::LayoutNode> layout = allAddrs.getLayout();
+
+    vector<Line> lines = getLines ( layout, allAddrs );
+
+    for ( arg += 2; arg < argc; ++arg )
+    {
+        if ( ! profileCapture ( argv[arg], allAddrs, lines ) )
+            return -1;
+    }
+
+    if ( numRenderedFrames + numSkippedFrames == 0 )
+    {
+        PRINT ( "No consecutive frames were captured" );
+        return -1;
+    }
+
+    // Rebuild each top level memory dump from the lines that are kept
+    MemDumpList minAddrs;
+
+    // Bytes dropped per region, for the report
+    vector<pair<size_t, size_t>> neverChanged ( allAddrs.addrs.size() ), renderOnly ( allAddrs.addrs.size() );
+
+    for ( size_t i = 0; i < allAddrs.addrs.size(); ++i )
+        neverChanged[i].second = renderOnly[i].second = i;
+
+    for ( size_t i = 0; i < lines.size(); )
+    {
+        const MemDumpList::LayoutNode& n = layout[lines[i].node];
+        const MemDump& mem = allAddrs.addrs[n.index];
+
+        ASSERT ( n.depth == 0 );
+
+        // Collect all the lines of this memory dump, and its child pointers
+        size_t end = i + 1;
+        while ( end < lines.size() && layout[lines[end].node].index == n.index )
+            ++end;
+
+        vector<LineState> states;
+        for ( size_t j = i; j < end; ++j )
+            states.push_back ( getLineState ( lines[j], keepRenderOnly ) );
+
+        // Keep the lines that contain the value of a kept child pointer
+        for ( size_t j = i; j < end; ++j )
+        {
+            if ( layout[lines[j].node].depth == 0 || states[j - i] != LineState::Kept )
+                continue;
+
+            const MemDumpPtr& ptr = * ( const MemDumpPtr * ) layout[lines[j].node].mem;
+
+            for ( size_t k = i; k < end; ++k )
+            {
+                if ( layout[lines[k].node].depth > 0 )
+                    continue;
+
+                const size_t offset = lines[k].dumpOffset - n.dumpOffset;
+
+                if ( offset < ptr.srcOffset + 4 && ptr.srcOffset < offset + lines[k].size )
+                    states[k - i] = LineState::Kept;
+            }
+        }
+
+        for ( size_t j = i; j < end; ++j )
+        {
+            if ( states[j - i] == LineState::NeverChanged )
+                neverChanged[n.index].first += lines[j].size;
+            else if ( states[j - i] == LineState::RenderOnly )
+                renderOnly[n.index].first += lines[j].size;
+        }
+
+        // Merge runs of kept lines into new memory dumps, moving the kept child pointers into the run they're in
+        for ( size_t j = i; j < end; )
+        {
+            if ( layout[lines[j].node].depth > 0 || states[j - i] != LineState::Kept )
+            {
+                ++j;
+                continue;
+            }
+
+            const size_t start = lines[j].dumpOffset - n.dumpOffset;
+            size_t size = 0;
+
+            while ( j < end && layout[lines[j].node].depth == 0 && states[j - i] == LineState::Kept )
+                size += lines[j++].size;
+
+            vector<MemDumpPtr> ptrs;
+
+            for ( size_t k = i; k < end; ++k )
+            {
+                if ( layout[lines[k].node].depth == 0 || states[k - i] != LineState::Kept )
+                    continue;
+
+                const MemDumpPtr& ptr = * ( const MemDumpPtr * ) layout[lines[k].node].mem;
+
+                if ( ptr.srcOffset >= start && ptr.srcOffset + 4 <= start + size )
+                    ptrs.push_back ( MemDumpPtr ( ptr.srcOffset - start, ptr.dstOffset, ptr.size, ptr.ptrs ) );
+            }
+
+            minAddrs.append ( MemDump ( mem.addr + start, size, ptrs ) );
+        }
+
+        i = end;
+    }
+
+    minAddrs.update();
+
+    if ( ! minAddrs.save ( output ) )
+    {
+        PRINT ( "Failed to write '%s'", output );
+        return -1;
+    }
+
+    // Report
+    size_t totalNeverChanged = 0, totalRenderOnly = 0;
+
+    for ( size_t i = 0; i < allAddrs.addrs.size(); ++i )
+    {
+        totalNeverChanged += neverChanged[i].first;
+        totalRenderOnly += renderOnly[i].first;
+    }
+
+    PRINT ( "Profiled %u frames after rendering, %u frames with rendering skipped",
+            numRenderedFrames, numSkippedFrames );
+    PRINT ( "Old size: %u bytes in %u memory dumps", allAddrs.totalSize, allAddrs.addrs.size() );
+    PRINT ( "New size: %u bytes in %u memory dumps", minAddrs.totalSize, minAddrs.addrs.size() );
+    PRINT ( "Saved %u bytes per frame: %u never changed; %u only changed when rendering%s",
+            allAddrs.totalSize - minAddrs.totalSize, totalNeverChanged, totalRenderOnly,
+            keepRenderOnly ? " (kept)" : "" );
+
+    if ( ! keepRenderOnly && numSkippedFrames == 0 )
+        PRINT ( "No frames with rendering skipped were captured, so render-only lines can't be detected" );
+
+    // List the regions with the most bytes dropped
+    vector<pair<size_t, size_t>> dropped ( allAddrs.addrs.size() );
+
+    for ( size_t i = 0; i < allAddrs.addrs.size(); ++i )
+        dropped[i] = { neverChanged[i].first + renderOnly[i].first, i };
+
+    sort ( dropped.begin(), dropped.end(), greater<pair<size_t, size_t>>() );
+
+    PRINT ( "region,address,size,never_changed,render_only" );
+
+    for ( size_t i = 0; i < dropped.size() && i < MAX_REPORT_LINES && dropped[i].first; ++i )
+    {
+        const size_t j = dropped[i].second;
+
+        PRINT ( "%u,0x%06X,%u,%u,%u", j, ( uint32_t ) ( uintptr_t ) allAddrs.addrs[j].addr,
+                allAddrs.addrs[j].getTotalSize(), neverChanged[j].first, renderOnly[j].first );
+    }
+
+    return 0;
+}
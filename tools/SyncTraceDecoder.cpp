@@ -0,0 +1,105 @@
+#include "SyncTrace.hpp"
+#include "StringUtils.hpp"
+
+#include <chrono>
+#include <vector>
+#include <string>
+#include <cstdio>
+
+using namespace std;
+
+
+static double getElapsedMs ( const chrono::steady_clock::time_point& start )
+{
+    return chrono::duration<double, milli> ( chrono::steady_clock::now() - start ).count();
+}
+
+static int usage ( const char *name )
+{
+    PRINT ( "Usage: %s decode trace [sync.log]", name );
+    PRINT ( "       %s diff trace1 trace2", name );
+    PRINT ( "" );
+    PRINT ( "decode: writes the records of a sync trace as the text lines sync.log used to have, to stdout by default." );
+    PRINT ( "diff: aligns the traces of two peers by frame, and prints the first frame where the state differs after" );
+    PRINT ( "      any rollbacks. Exits with 1 if the traces diverge." );
+    return -1;
+}
+
+static int decode ( const string& traceFile, const string& outFile )
+{
+    SyncTraceReader reader;
+
+    if ( ! reader.open ( traceFile ) )
+    {
+        PRINT ( "'%s' is not a sync trace", traceFile );
+        return -1;
+    }
+
+    FILE *out = ( outFile.empty() ? stdout : fopen ( outFile.c_str(), "w" ) );
+
+    if ( ! out )
+    {
+        PRINT ( "Failed to write '%s'", outFile );
+        return -1;
+    }
+
+    const auto start = chrono::steady_clock::now();
+
+    SyncTrace::Header header;
+    const char *payload;
+    size_t count = 0;
+
+    while ( reader.next ( header, payload ) )
+    {
+        const string line = SyncTrace::decode ( header, payload );
+        fprintf ( out, "%s\n", line.c_str() );
+        ++count;
+    }
+
+    if ( out != stdout )
+        fclose ( out );
+
+    fprintf ( stderr, "%u records; %.1f ms\n", uint32_t ( count ), getElapsedMs ( start ) );
+    return 0;
+}
+
+static int diff ( const string& traceFile1, const string& traceFile2 )
+{
+    const auto start = chrono::steady_clock::now();
+
+    SyncTrace::Divergence divergence;
+
+    if ( ! SyncTrace::diff ( traceFile1, traceFile2, divergence ) )
+    {
+        PRINT ( "Failed to read '%s' or '%s'", traceFile1, traceFile2 );
+        return -1;
+    }
+
+    fprintf ( stderr, "%u frames in both traces; %.1f ms\n", uint32_t ( divergence.numFrames ),
+              getElapsedMs ( start ) );
+
+    if ( ! divergence.diverged )
+    {
+        PRINT ( "No differences" );
+        return 0;
+    }
+
+    PRINT ( "First divergent frame [%s]", divergence.indexedFrame );
+    PRINT ( "< %s", divergence.first );
+    PRINT ( "> %s", divergence.second );
+    return 1;
+}
+
+
+int main ( int argc, char *argv[] )
+{
+    const vector<string> args ( argv + 1, argv + argc );
+
+    if ( args.size() >= 2 && args.size() <= 3 && args[0] == "decode" )
+        return decode ( args[1], ( args.size() > 2 ? args[2] : "" ) );
+
+    if ( args.size() == 3 && args[0] == "diff" )
+        return diff ( args[1], args[2] );
+
+    return usage ( argv[0] );
+}